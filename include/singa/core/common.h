@@ -24,6 +24,7 @@
 #include <atomic>
 #include <memory>
 #include "singa/utils/logging.h"
+#include "singa/utils/thread_pool.h"
 
 #ifdef USE_CUDA
 #include <cuda_runtime.h>
@@ -63,6 +64,14 @@ class Block {
       : data_(ptr), size_(size), offset_(offset) {
     ref_count_ = 1;  // std::make_shared<std::atomic<int>>(1);
   }
+  /// Wrap host memory owned by 'owner', e.g., a memory-mapped file. The
+  /// memory is released with the last reference to the owner instead of by
+  /// the device. The block is initialized.
+  Block(void* ptr, size_t size, size_t offset, std::shared_ptr<void> owner)
+      : data_(ptr), size_(size), offset_(offset), initialized_(true),
+        owner_(owner) {
+    ref_count_ = 1;
+  }
   // Disabled as it is not used currently.
   // Block(void* ptr, size_t size, size_t offset, std::shared_ptr<atomic<int>>
   //  ref) : data_(ptr), size_(size), offset_(offset), ref_count_(ref) {}
@@ -87,6 +96,8 @@ class Block {
   bool initialized() const {
     return initialized_;
   }
+  /// Return true if the memory is not allocated by a device.
+  bool external() const { return owner_ != nullptr; }
 
  private:
   Block() {}
@@ -94,6 +105,7 @@ class Block {
   size_t size_ = 0;
   size_t offset_ = 0;
   bool initialized_ = false;
+  std::shared_ptr<void> owner_;
   // Disabled as it is not used currently.
   // std::shared_ptr<std::atomic<int>> ref_count_ = nullptr;
   std::atomic<int> ref_count_;
@@ -101,6 +113,9 @@ class Block {
 
 typedef struct _Context {
   std::mt19937 random_generator;
+  /// Workers for splitting one operation into chunks; nullptr for running
+  /// the operation by the calling thread only.
+  ThreadPool* thread_pool = nullptr;
 #ifdef USE_CUDA
   cublasHandle_t cublas_handle;
   cudaStream_t stream;
@@ -63,8 +63,9 @@ class Device {
 
   virtual void SetRandSeed(unsigned seed) = 0;
 
-  /// Called by Tensor.
-  Block* NewBlock(int size);
+  /// Called by Tensor. The memory is zero-filled if 'zero' is true, otherwise
+  /// its content is undefined, e.g., memory reused by the pool of CppCPU.
+  Block* NewBlock(int size, bool zero = false);
 
   /// Called by Tensor.
   void FreeBlock(Block* block);
@@ -83,6 +84,9 @@ class Device {
                            size_t dst_offset = 0);
   /// Submit the operation to the device, which may execute it right now or
   /// delay it depending on the scheduler.
+  /// If the device has a scheduler, the operation is run asynchronously after
+  /// the pending operations on 'read_blocks' and 'write_blocks'; hence 'fn'
+  /// must capture (by value) all objects it accesses except Block memory.
   void Exec(function<void(Context*)>&& fn, const vector<Block*> read_blocks,
                     const vector<Block*> write_blocks,
                     bool use_rand_generator = false);
@@ -93,6 +97,22 @@ class Device {
   /// wait for all operations submitted to this device.
   void Sync();
 
+  /// Return true if operations are executed asynchronously by the scheduler.
+  bool async() const { return scheduler_ != nullptr; }
+
+  /// Serve the Blocks allocated within iterations (see StartIteration()) from
+  /// an arena planned according to the block lifetimes of a recorded
+  /// iteration. It is effective for the Blocks allocated after this call.
+  void EnableVirtualMemory();
+
+  /// Mark the start and end of one training iteration, e.g., by
+  /// FeedForwardNet::TrainOnBatch. No effect without virtual memory.
+  void StartIteration();
+  void EndIteration();
+
+  /// Return the virtual memory, nullptr if not enabled.
+  VirtualMemory* vm() const { return vm_.get(); }
+
   /// Return the programming language for this device.
   LangType lang() const {
     return lang_;
@@ -100,7 +120,8 @@ class Device {
 
   virtual std::shared_ptr<Device> host() const { return host_;}
 
-  Context* context(int k) {
+  /// Return the context of the k-th executor.
+  virtual Context* context(int k) {
     return &ctx_;
   }
 
@@ -122,12 +143,23 @@ class Device {
   /// Free device memory.
   virtual void Free(void* ptr) = 0;
 
+  /// Set 'size' bytes of device memory at 'ptr' to 'value'.
+  virtual void Memset(void* ptr, int value, size_t size) = 0;
+
+ private:
+  /// Free the memory of the block and delete the block.
+  void ReleaseBlock(Block* block);
+
  protected:
   int id_ = 0;
   int num_executors_ = 0;
   unsigned seed_ = 0;
-  // Scheduler* scheduler_ = nullptr;
-  // VirtualMemory* vm_ = nullptr;
+  /// Created by sub-classes with multiple executors; nullptr means all
+  /// operations are executed synchronously by the caller thread.
+  std::unique_ptr<Scheduler> scheduler_;
+  /// Created by EnableVirtualMemory(); sub-classes must reset it in their
+  /// destructors, as it frees memory via Free().
+  std::unique_ptr<VirtualMemory> vm_;
   /// Programming language type, could be kCpp, kCuda, kOpencl
   LangType lang_;
   // SafeQueue<Operation> op_queue_;
@@ -147,9 +179,22 @@ class CppCPU : public Device {
  public:
   ~CppCPU();
   CppCPU();
+  /// If 'num_executors' > 1, operations are scheduled according to their
+  /// data dependency and independent ones run concurrently on the executors.
+  /// Each executor has its own Context (e.g., random generator), and large
+  /// operations are split into chunks run by a work-stealing thread pool.
+  explicit CppCPU(int num_executors);
+  /// Construct the device with the given memory pool, which may be shared
+  /// with other CppCPU devices.
+  CppCPU(int num_executors, std::shared_ptr<DeviceMemPool> pool);
 
   std::shared_ptr<Device> host() const override { return defaultDevice;}
+  /// Executor k is seeded with 'seed' + k.
   void SetRandSeed(unsigned seed) override;
+  Context* context(int k) override;
+  /// Return the bytes of memory in use, excluding the memory cached by the
+  /// pool.
+  size_t GetAllocatedMem() override;
 
  protected:
   void DoExec(function<void(Context*)>&& fn, int executor) override;
@@ -157,11 +202,19 @@ class CppCPU : public Device {
   void CopyToFrom(void* dst, const void* src, size_t nBytes,
                   CopyDirection direction, Context* ctx) override;
 
-  /// Allocate cpu memory.
+  /// Allocate cpu memory, which is not zero-initialized.
   void* Malloc(int size) override;
 
   /// Free cpu memory.
   void Free(void* ptr) override;
+
+  void Memset(void* ptr, int value, size_t size) override;
+
+ private:
+  /// Contexts of executors 1, 2, ...; executor 0 uses 'ctx_'.
+  vector<Context> executor_ctx_;
+  std::unique_ptr<ThreadPool> thread_pool_;
+  shared_ptr<DeviceMemPool> pool_;
 };
 
 
@@ -187,12 +240,14 @@ class CudaGPU : public Device {
   void CopyToFrom(void* dst, const void* src, size_t nBytes,
                   CopyDirection direction, Context* ctx) override;
 
-  /// Allocate cpu memory.
+  /// Allocate gpu memory, which is not zero-initialized.
   void* Malloc(int size) override;
 
-  /// Free cpu memory.
+  /// Free gpu memory.
   void Free(void* ptr) override;
 
+  void Memset(void* ptr, int value, size_t size) override;
+
  private:
   void Setup();
 
@@ -253,6 +308,9 @@ protected:
   /// This has the effect of freeing up device memory.
   void Free(void* ptr) override;
 
+  /// Fills the buffer via the command queue of the current context.
+  void Memset(void* ptr, int value, size_t size) override;
+
 private:
 
   static const std::string cl_src_path;
@@ -21,6 +21,10 @@
 
 #include <mutex>
 #include <atomic>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
 #include "singa/proto/core.pb.h"
 #include "singa/singa_config.h"
 
@@ -32,7 +36,72 @@
 namespace singa {
 
 /// Manage device memory pool including garbage collection, memory opt.
-class VirtualMemory {};
+///
+/// It reuses memory across training iterations according to the liveness of
+/// blocks. The allocations and frees between StartIteration() and
+/// EndIteration() of one iteration are recorded, from which an arena plan is
+/// computed: every block freed within the iteration gets an offset in one
+/// arena such that blocks with overlapping lifetimes do not overlap in memory.
+/// In later iterations, the k-th allocation is served from the arena if it
+/// has the recorded size and its range is not in use. If the allocations
+/// differ from the recorded ones (e.g., the batch size changes), the plan is
+/// dropped and the next iteration is recorded again. Other allocations are
+/// forwarded to the device.
+class VirtualMemory {
+ public:
+  typedef std::function<void*(size_t)> MallocFn;
+  typedef std::function<void(void*)> FreeFn;
+
+  /// 'malloc' and 'free' allocate and free the device memory.
+  VirtualMemory(MallocFn malloc, FreeFn free);
+  /// Free the arena.
+  ~VirtualMemory();
+
+  void* Malloc(size_t size);
+  void Free(void* ptr);
+
+  void StartIteration();
+  void EndIteration();
+
+  /// Return the bytes of the arena, 0 if there is no plan.
+  size_t arena_size();
+  /// Return the num of allocations served from the arena since the last
+  /// StartIteration().
+  size_t num_arena_allocs();
+
+ private:
+  struct Record {
+    size_t size;
+    /// time of the allocation and the free; -1 if not freed in the iteration
+    int malloc_time, free_time = -1;
+    /// offset in the arena; -1 if not in the arena
+    long offset = -1;
+  };
+
+  /// Compute the offsets of the recorded blocks and allocate the arena.
+  void Plan();
+
+ private:
+  MallocFn malloc_;
+  FreeFn free_;
+  std::mutex mtx_;
+  bool in_iteration_ = false;
+  /// true if recording the iteration; false if replaying the plan
+  bool recording_ = true;
+  /// true if the current iteration deviates from the plan
+  bool stale_ = false;
+  int clock_ = 0;
+  std::vector<Record> records_;
+  /// recorded blocks that are not freed yet
+  std::unordered_map<void*, size_t> record_index_;
+  char* arena_ = nullptr;
+  size_t arena_size_ = 0;
+  /// index of the next allocation in the plan
+  size_t cursor_ = 0;
+  size_t num_arena_allocs_ = 0;
+  /// offset -> end of the arena ranges in use
+  std::map<size_t, size_t> live_;
+};
 
 class DeviceMemPool {
  public:
@@ -50,6 +119,46 @@ class DeviceMemPool {
 //  size_t init_size_ = 0, max_size_ = 0;
 };
 
+/// Caching pool of host memory.
+///
+/// Requests are rounded up to size classes (four per power of two), and freed
+/// memory is cached per size class for later requests of the same class.
+/// Caches are sharded; every thread uses its own shard and only falls back to
+/// the other shards (e.g., memory freed by another thread) when its shard is
+/// empty. Memory is 64-byte aligned and NOT zero-initialized.
+class CppMemPool : public DeviceMemPool {
+ public:
+  /// Memory beyond 'max_cache_size' bytes is returned to the system when
+  /// freed; 0 for caching all freed memory.
+  explicit CppMemPool(size_t max_cache_size = 0);
+  ~CppMemPool();
+
+  void Malloc(void** ptr, const size_t size) override;
+  void Free(void* ptr) override;
+
+  /// Return the bytes cached for reuse and the total bytes managed, i.e.,
+  /// cached plus in use.
+  std::pair<size_t, size_t> GetMemUsage() override;
+
+  /// Return the memory cached by all shards to the system.
+  void ReleaseCache();
+
+ private:
+  struct Shard {
+    std::mutex mtx;
+    /// free memory of each size class
+    std::vector<std::vector<void*>> free_list;
+  };
+  /// Take one cached chunk of 'size_class' from the shard, or nullptr.
+  void* Take(Shard* shard, int size_class);
+  Shard* LocalShard();
+
+ private:
+  std::vector<Shard> shards_;
+  size_t max_cache_size_;
+  std::atomic<size_t> in_use_, cached_;
+};
+
 #ifdef USE_CUDA
 class CnMemPool : public DeviceMemPool {
  public:
@@ -18,10 +18,104 @@
 #ifndef SINGA_CORE_SCHEDULER_H_
 #define SINGA_CORE_SCHEDULER_H_
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "singa/core/common.h"
+
+using std::vector;
+using std::function;
+
 namespace singa {
 
 /// Scheduling Tensor operations with dependency detection.
-class Scheduler {};
+///
+/// Every operation is submitted together with the Blocks it reads and writes.
+/// For each Block with pending operations, the scheduler records the last
+/// writer and the readers since that write, from which a DAG of the pending
+/// operations is built on the fly: an operation depends on the last writer of
+/// every Block it accesses and on the readers of every Block it writes.
+/// Operations whose dependencies are done are run concurrently by
+/// 'num_executors' executor threads.
+///
+/// Operations are run after Submit() returns, hence they must own (i.e.,
+/// capture by value) everything they access, except the memory of the
+/// declared Blocks.
+class Scheduler {
+ public:
+  /// Run one operation on the executor with the given index, e.g.,
+  /// Device::DoExec.
+  typedef function<void(function<void(Context*)>&&, int)> ExecFn;
+
+  /// Launch 'num_executors' threads for running operations via 'exec'.
+  Scheduler(int num_executors, ExecFn exec);
+
+  /// Wait for all pending operations and then stop the executor threads.
+  ~Scheduler();
+
+  /// Add one operation, which would be run once the operations submitted
+  /// before it and accessing the same Blocks (with at least one writing) are
+  /// done. Operations using the random generator are run in submission order.
+  void Submit(function<void(Context*)>&& fn, const vector<Block*>& read_blocks,
+              const vector<Block*>& write_blocks,
+              bool use_rand_generator = false);
+
+  /// Block until all submitted operations are done.
+  /// It returns immediately if called by an operation of this scheduler.
+  void Wait();
+
+  /// Return the number of operations that are submitted but not done.
+  size_t num_pending();
+
+  int num_executors() const { return static_cast<int>(executors_.size()); }
+
+ private:
+  struct Operation {
+    function<void(Context*)> fn;
+    /// num of operations it depends on that are not done
+    int num_deps = 0;
+    /// operations that depend on this one
+    vector<Operation*> successors;
+    /// Blocks (and the random generator) accessed by this operation
+    vector<const void*> keys;
+  };
+
+  struct AccessRecord {
+    Operation* writer = nullptr;
+    vector<Operation*> readers;
+  };
+
+  /// Loop of each executor thread.
+  void Run(int executor);
+
+  /// Release the successors of 'op' and delete it; 'mtx_' must be held.
+  void Done(Operation* op);
+
+  /// Let 'op' run after 'dep'; 'mtx_' must be held.
+  void AddDependency(Operation* dep, Operation* op);
+
+ private:
+  ExecFn exec_;
+  std::unordered_map<const void*, AccessRecord> records_;
+  std::deque<Operation*> ready_;
+  size_t num_pending_ = 0;
+  bool stop_ = false;
+  std::mutex mtx_;
+  std::condition_variable ready_cv_, done_cv_;
+  vector<std::thread> executors_;
+  /// Key for serializing operations that use the random generator.
+  const char rand_key_ = 0;
+
+  /// The scheduler whose executor is the calling thread.
+  static thread_local Scheduler* current_;
+  /// The operation being run by the calling executor thread.
+  static thread_local Operation* running_;
+};
 
 }  // namespace singa
 #endif  // SINGA_CORE_SCHEDULER_H_
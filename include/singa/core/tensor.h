@@ -36,7 +36,8 @@ typedef vector<size_t> Shape;
 /// hardcode the width of types defined in DataType
 const size_t kDataWidth[] = {sizeof(float),  sizeof(float) / 2,
                              sizeof(int),    sizeof(char),
-                             sizeof(double), sizeof(unsigned char)
+                             sizeof(double), sizeof(unsigned char),
+                             sizeof(float) / 2
                             };
 inline size_t SizeOf(DataType t) {
   static_assert(kNumDataType == sizeof(kDataWidth) / sizeof(size_t),
@@ -58,14 +59,20 @@ class Tensor {
   ~Tensor();
   Tensor();
 
-  /// Constructor using default device.
+  /// Constructor using default device. The values are zero.
   explicit Tensor(const Shape &shape, DataType dtype = kFloat32);
 
-  /// Constructor with shape, device and data type
+  /// Constructor with shape, device and data type. The values are zero.
   Tensor(const Shape &shape,
          std::shared_ptr<Device> dev,
          DataType dtype = kFloat32);
 
+  /// Constructor over an existing block, e.g., one wrapping external memory;
+  /// the tensor takes over one reference of the block. The stride is
+  /// generated from the shape if it is empty.
+  Tensor(Block *block, const Shape &shape, std::shared_ptr<Device> dev,
+         DataType dtype = kFloat32, const vector<int> &stride = {});
+
   /// Copy constructor.  No deep copy.
   Tensor(const Tensor &from);
 
@@ -84,8 +91,10 @@ class Tensor {
   std::shared_ptr<Device> device() const { return device_; }
 
   /// Return immutable Tensor values with given type.
+  /// It waits until the pending operations of the device are done.
   template <typename SType>
   const SType *data() const {
+    device_->Sync();
     return static_cast<const SType *>(block()->data());
   }
 
@@ -248,7 +257,10 @@ class Tensor {
   /// The previous block would be deleted.
   Tensor& ResetLike(const Tensor &t);
 
-  /// Reset the data type, it would reallocate block if type changes.
+  /// Reset the data type and convert the values into it, e.g., for storing
+  /// parameters in kFloat16 or kBFloat16. Conversions into integer types
+  /// round to nearest and saturate. The result is contiguous.
+  /// For int8 with a scale, use Quantize() and Dequantize() instead.
   Tensor& AsType(const DataType type);
 
   /// Reset the device.
@@ -363,6 +375,13 @@ void Square(const Tensor &in, Tensor *out);
 void Tanh(const Tensor &in, Tensor *out);
 void Transform(const Tensor &in, Tensor *out);
 
+/// Quantize a kFloat32 tensor into a kChar (int8) tensor,
+/// out[i] = clamp(round(in[i] / scale), -127, 127), e.g., with
+/// scale = max(|in|) / 127.
+Tensor Quantize(const Tensor &in, const float scale);
+/// Recover a kFloat32 tensor from Quantize(), out[i] = in[i] * scale.
+Tensor Dequantize(const Tensor &in, const float scale);
+
 /// Element-wise opeartion, out[i]=in[i]^x
 template <typename SType>
 Tensor Pow(const Tensor &in, const SType x);
@@ -0,0 +1,130 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SINGA_CORE_TENSOR_EXPR_H_
+#define SINGA_CORE_TENSOR_EXPR_H_
+
+#include <memory>
+
+#include "singa/core/tensor.h"
+
+namespace singa {
+
+/// Operators of the nodes of a TensorExpr.
+enum class ExprOp {
+  kLeaf, kScalar,
+  // unary
+  kAbs, kExp, kLog, kReLU, kSigmoid, kSign, kSqrt, kSquare, kTanh,
+  // binary
+  kAdd, kSub, kMult, kDiv, kPow, kLT, kLE, kGT, kGE
+};
+
+/// A lazily evaluated expression of elementwise Tensor operations.
+///
+/// Elementwise ops on a TensorExpr do not compute anything; they build an
+/// expression graph whose leaves are Tensors (and scalars). Eval()
+/// materializes the graph in a single pass over the output, which avoids the
+/// temporary Tensor and the memory pass of every intermediate op. E.g.,
+/// \code
+/// Tensor y = AddRow(b, MultRow(w, SubRow(mean, x) / std)).Eval();
+/// \endcode
+///
+/// Binary ops broadcast their operands following the rules of the Tensor ops.
+/// A sub-expression whose shape differs from the output (e.g., a row vector
+/// that is broadcast to every row) is evaluated first into a small Tensor.
+/// The leaves must be float32 Tensors on the same device. CppCPU devices run
+/// the fused loop; other devices evaluate the graph by the eager Tensor ops.
+/// Unlike the eager ops, the fused loop does not check the domain of Log,
+/// Sqrt and Div.
+class TensorExpr {
+ public:
+  /// A leaf node; it shares the memory of 't'.
+  TensorExpr(const Tensor& t);
+  /// A scalar node, which is broadcast to the shape of the other operand.
+  explicit TensorExpr(float x);
+
+  /// Shape of the result; empty for scalars.
+  const Shape& shape() const;
+
+  /// The device of the leaf Tensors.
+  std::shared_ptr<Device> device() const;
+
+  /// Return a new Tensor with the result.
+  Tensor Eval() const;
+
+  /// Write the result into 'out', which must be contiguous and have the
+  /// shape of this expression. 'out' may be a leaf of the expression only if
+  /// the leaf has the same shape and memory layout (i.e., no broadcasting).
+  void Eval(Tensor* out) const;
+
+  /// Build a unary or binary node; used by the functions below.
+  static TensorExpr Apply(ExprOp op, const TensorExpr& a);
+  static TensorExpr Apply(ExprOp op, const TensorExpr& a, const TensorExpr& b);
+
+ private:
+  struct Node;
+  friend class ExprProgram;
+  explicit TensorExpr(std::shared_ptr<Node> node) : node_(node) {}
+
+  std::shared_ptr<Node> node_;
+};
+
+// ============Unary ops================================================
+TensorExpr Abs(const TensorExpr& in);
+TensorExpr Exp(const TensorExpr& in);
+TensorExpr Log(const TensorExpr& in);
+TensorExpr ReLU(const TensorExpr& in);
+TensorExpr Sigmoid(const TensorExpr& in);
+TensorExpr Sign(const TensorExpr& in);
+TensorExpr Sqrt(const TensorExpr& in);
+TensorExpr Square(const TensorExpr& in);
+TensorExpr Tanh(const TensorExpr& in);
+
+// ============Binary ops===============================================
+// The (Tensor, TensorExpr) overloads keep the template Tensor operators
+// (e.g., operator+(const Tensor&, SType)) from matching.
+#define DECLARE_EXPR_BINARY_OP(fn)                              \
+  TensorExpr fn(const TensorExpr& lhs, const TensorExpr& rhs);  \
+  TensorExpr fn(const Tensor& lhs, const TensorExpr& rhs);      \
+  TensorExpr fn(const TensorExpr& lhs, float rhs);              \
+  TensorExpr fn(float lhs, const TensorExpr& rhs);
+
+DECLARE_EXPR_BINARY_OP(operator+)
+DECLARE_EXPR_BINARY_OP(operator-)
+DECLARE_EXPR_BINARY_OP(operator*)
+DECLARE_EXPR_BINARY_OP(operator/)
+DECLARE_EXPR_BINARY_OP(operator<)
+DECLARE_EXPR_BINARY_OP(operator<=)
+DECLARE_EXPR_BINARY_OP(operator>)
+DECLARE_EXPR_BINARY_OP(operator>=)
+DECLARE_EXPR_BINARY_OP(Pow)
+#undef DECLARE_EXPR_BINARY_OP
+
+// ============Matrix (row/column) ops==================================
+// Lazy versions of the in-place ops in tensor.h, e.g., AddRow(v, M) is the
+// expression of M + v for every row of M. 'M' must be a matrix.
+TensorExpr AddRow(const TensorExpr& v, const TensorExpr& M);
+TensorExpr SubRow(const TensorExpr& v, const TensorExpr& M);
+TensorExpr MultRow(const TensorExpr& v, const TensorExpr& M);
+TensorExpr DivRow(const TensorExpr& v, const TensorExpr& M);
+TensorExpr AddColumn(const TensorExpr& v, const TensorExpr& M);
+TensorExpr SubColumn(const TensorExpr& v, const TensorExpr& M);
+TensorExpr MultColumn(const TensorExpr& v, const TensorExpr& M);
+TensorExpr DivColumn(const TensorExpr& v, const TensorExpr& M);
+
+}  // namespace singa
+#endif  // SINGA_CORE_TENSOR_EXPR_H_
@@ -19,6 +19,7 @@
 #ifndef SINGA_IO_DECODER_H_
 #define SINGA_IO_DECODER_H_
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include "singa/core/tensor.h"
@@ -35,34 +36,80 @@ class Decoder {
 
   /// Decode value to get data and labels
   virtual std::vector<Tensor> Decode(std::string value) = 0;
+
+  /// Decode the 'size' bytes at 'value' into the 'index'-th sample of the
+  /// batch tensors, whose first dimension is the batch, e.g., the tensors of
+  /// a DataPipeline batch. Subclasses write the sample in place; by default
+  /// the tensors from Decode() are copied.
+  /// It may be called concurrently for different indices.
+  virtual void DecodeInto(const char* value, size_t size, size_t index,
+                          std::vector<Tensor>* batch);
 };
 
+/// Convert 'height' x 'width' pixels of 'channel' interleaved uint8 values
+/// (i.e., HWC) into floats in CHW order if 'chw' is true, otherwise in HWC.
+void ImageToFloat(const uint8_t* hwc, size_t height, size_t width,
+                  size_t channel, bool chw, float* out);
+
 #ifdef USE_OPENCV
 /// Decode the string as an ImageRecord object and convert it into a image
 /// tensor (dtype is kFloat32) and a label tensor (dtype is kInt).
+///
+/// DecodeInto() parses the record in place, decodes its JPEG bytes without
+/// copying them and writes the pixels into the batch tensor directly; the
+/// record must have a label if the batch has a label tensor. With
+/// reduce_factor 2, 4 or 8, large images are decoded at a reduced size in
+/// the DCT domain; with keep_uint8, the image tensor is kUChar, i.e., 4x
+/// smaller than float until it is normalized, e.g., by ImageTransformer.
 class JPGDecoder : public Decoder {
  public:
   void Setup(const DecoderConf& conf) override {
     image_dim_order_ = conf.image_dim_order();
+    reduce_factor_ = conf.reduce_factor();
+    keep_uint8_ = conf.keep_uint8();
+    CHECK(reduce_factor_ == 1 || reduce_factor_ == 2 || reduce_factor_ == 4 ||
+          reduce_factor_ == 8) << "Invalid reduce factor " << reduce_factor_;
   }
   std::vector<Tensor> Decode(std::string value) override;
+  void DecodeInto(const char* value, size_t size, size_t index,
+                  std::vector<Tensor>* batch) override;
 
   const std::string image_dim_order() const { return image_dim_order_; }
+  int reduce_factor() const { return reduce_factor_; }
+  bool keep_uint8() const { return keep_uint8_; }
 
  private:
   /// Indicate the dimension order for the output image tensor.
   std::string image_dim_order_ = "CHW";
+  int reduce_factor_ = 1;
+  bool keep_uint8_ = false;
 };
 #endif
 
 /// Decode the string of csv formated data  into data tensor
 /// (dtype is kFloat32) and optionally a label tensor (dtype is kInt).
+///
+/// Besides one row per Decode() call, DecodeBlock() and DecodeFile() decode
+/// many rows at once into a {rows, cols} data tensor and a {rows} label
+/// tensor, parsing chunks of lines in parallel.
 class CSVDecoder : public Decoder {
  public:
   void Setup(const DecoderConf& conf) override {
     has_label_ = conf.has_label();
   }
   std::vector<Tensor> Decode(std::string value) override;
+  void DecodeInto(const char* value, size_t size, size_t index,
+                  std::vector<Tensor>* batch) override;
+
+  /// Decode the non-empty lines of the 'size' bytes at 'text', one row per
+  /// line, into tensors on the host device 'dev'. All rows must have the
+  /// same number of values. The chunks are parsed by the thread pool of dev.
+  std::vector<Tensor> DecodeBlock(const char* text, size_t size,
+                                  std::shared_ptr<Device> dev = defaultDevice);
+  /// Memory-map the csv file at 'path' and decode all of its rows by
+  /// DecodeBlock().
+  std::vector<Tensor> DecodeFile(const std::string& path,
+                                 std::shared_ptr<Device> dev = defaultDevice);
 
   const bool has_label() const { return has_label_; }
 
@@ -33,7 +33,10 @@
 #include <atomic>
 #include <string>
 #include <netinet/in.h>
+#include <sys/uio.h>
+#include <memory>
 #include <queue>
+#include <utility>
 
 namespace singa {
 
@@ -59,6 +62,13 @@ class NetworkThread;
 class EndPoint;
 class EndPointFactory;
 
+/// A message is sent as [header, metadata, payload].
+///
+/// The header and metadata are copied into a buffer of the message. The
+/// payload is either copied too (setPayload()) or referenced in the caller's
+/// buffer (setPayloadRef()), which is then sent by scatter-gather I/O without
+/// copying. On the receiving side, the payload is read directly into a buffer
+/// posted by EndPoint::postRecv() if there is one.
 class Message {
 private:
   uint8_t type_;
@@ -66,13 +76,24 @@ private:
   std::size_t msize_ = 0;
   std::size_t psize_ = 0;
   std::size_t processed_ = 0;
+  /// header, metadata and the copied payload
   char *msg_ = nullptr;
+  /// referenced payload, not owned; nullptr if the payload is in msg_
+  char *payload_ = nullptr;
+  /// keeps the referenced payload alive
+  std::shared_ptr<void> owner_;
   static const int hsize_ =
       sizeof(id_) + 2 * sizeof(std::size_t) + sizeof(type_);
   char mdata_[hsize_];
   friend class NetworkThread;
   friend class EndPoint;
 
+  /// bytes in msg_
+  std::size_t bufSize();
+  /// Set 'iov' to the pieces after the first 'processed_' bytes of the
+  /// message; return the number of pieces (at most 2).
+  int pending(struct iovec *iov);
+
 public:
   Message(int = MSG_DATA, uint32_t = 0);
   Message(const Message &) = delete;
@@ -81,6 +102,13 @@ public:
 
   void setMetadata(const void *, int);
   void setPayload(const void *, int);
+  /// Reference 'size' bytes at 'buf' as the payload without copying them.
+  /// The bytes are read when the message is sent (again after reconnection),
+  /// hence they must be kept valid and unchanged until the message is
+  /// acknowledged; 'owner' (e.g., a shared_ptr to a Tensor over the buffer) is
+  /// held by the message until it is destroyed.
+  void setPayloadRef(const void *buf, std::size_t size,
+                     std::shared_ptr<void> owner = nullptr);
 
   std::size_t getMetadata(void **);
   std::size_t getPayload(void **);
@@ -94,6 +122,8 @@ private:
   std::queue<Message *> send_;
   std::queue<Message *> recv_;
   std::queue<Message *> to_ack_;
+  /// buffers posted for the payloads of the next messages
+  std::queue<std::pair<char *, std::size_t>> posted_;
   std::condition_variable cv_;
   std::mutex mtx_;
   struct sockaddr_in addr_;
@@ -114,6 +144,11 @@ private:
 public:
   int send(Message *);
   Message *recv();
+  /// Post a buffer of 'size' bytes for the payload of a following message
+  /// from this EndPoint, which is read into it directly if it fits; buffers
+  /// are used in the order of posting. The buffer must be valid until the
+  /// Message using it is received.
+  void postRecv(void *buf, std::size_t size);
 };
 
 class EndPointFactory {
@@ -130,6 +165,10 @@ public:
   EndPointFactory(NetworkThread *thread) : thread_(thread) {}
   ~EndPointFactory();
   EndPoint *getEp(const char *host);
+  /// Wait until the node at 'host' has connected to this node and return its
+  /// EndPoint; unlike getEp(), no connection is made from this side, which
+  /// avoids redundant connections if the other side calls getEp().
+  EndPoint *waitEp(const char *host);
   void getNewEps(std::vector<EndPoint *> &neps);
 };
 
@@ -146,6 +185,11 @@ private:
   std::unordered_map<int, ev_io> fd_rwatcher_map_;
   std::unordered_map<int, EndPoint *> fd_ep_map_;
   std::map<int, Message> pending_msgs_;
+  /// local address of the listening and connecting sockets
+  struct in_addr local_addr_;
+  std::mutex ready_mtx_;
+  std::condition_variable ready_cv_;
+  bool ready_ = false;
 
   void handleConnLost(int, EndPoint *, bool = true);
   void doWork();
@@ -156,7 +200,11 @@ private:
 public:
   EndPointFactory *epf_;
 
-  NetworkThread(int);
+  /// Listen on 'port' of 'host', or of all local addresses if 'host' is
+  /// empty; return when it is ready. With a 'host', the connections to other
+  /// nodes are made from its address too, hence several nodes on one machine
+  /// can use different addresses, e.g., 127.0.0.2 and 127.0.0.3.
+  NetworkThread(int port, const std::string &host = "");
   void notify(int signal);
 
   void onRecv(int fd);
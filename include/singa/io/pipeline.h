@@ -0,0 +1,101 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SINGA_IO_PIPELINE_H_
+#define SINGA_IO_PIPELINE_H_
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "singa/core/tensor.h"
+#include "singa/io/decoder.h"
+#include "singa/io/reader.h"
+#include "singa/io/transformer.h"
+#include "singa/utils/safe_queue.h"
+#include "singa/utils/thread_pool.h"
+
+namespace singa {
+
+/// DataPipeline produces mini-batches from a Reader in the background.
+///
+/// A loader thread reads the values of a batch from the Reader, and the
+/// values are decoded by the Decoder and the first decoded tensor, e.g., the
+/// image, is transformed by the Transformer (if any) on a pool of worker
+/// threads. The samples are written into pre-allocated batch tensors on a
+/// host device, one per decoded tensor, e.g., {batchsize, C, H, W} for the
+/// images and {batchsize, 1} for the labels; without a Transformer, they are
+/// decoded in place by Decoder::DecodeInto().
+///
+/// Up to 'prefetch' batches are prepared ahead of the one returned by
+/// Next(), e.g., 2 for double buffering. The batch tensors are recycled, hence
+/// the tensors returned by Next() are overwritten after the next call of
+/// Next(); copy them (e.g., to the training device) to keep them.
+///
+/// The Reader, Decoder and Transformer are not owned by the pipeline. The
+/// Decoder and Transformer are called concurrently by the workers.
+class DataPipeline {
+ public:
+  /// @param transformer could be nullptr
+  /// @param device a host (kCpp) device for the batch tensors
+  DataPipeline(io::Reader* reader, Decoder* decoder, Transformer* transformer,
+               size_t batchsize, int num_workers = 4, int prefetch = 2,
+               std::shared_ptr<Device> device = defaultDevice);
+  ~DataPipeline() { Stop(); }
+
+  /// Start a pass over the Reader from its first tuple; 'flag' is passed to
+  /// Transformer::Apply().
+  void Start(int flag = kTrain);
+  /// Get the next batch, which has fewer than batchsize samples only at the
+  /// end of the data. Return false after the last batch of the pass.
+  bool Next(std::vector<Tensor>* batch);
+  /// Stop the pass; the loader and the workers are stopped.
+  void Stop();
+
+  size_t batchsize() const { return batchsize_; }
+
+ private:
+  /// Pre-allocated tensors of one batch.
+  struct Slot {
+    std::vector<Tensor> tensors;
+    size_t size = 0;
+  };
+  /// Loop of the loader thread.
+  void Load(int flag);
+  /// Decode, transform and copy the values into the slot.
+  void Fill(int flag, const std::vector<std::string>& values, Slot* slot);
+  /// Decode and transform one value.
+  std::vector<Tensor> Process(int flag, const std::string& value);
+
+  io::Reader* reader_;
+  Decoder* decoder_;
+  Transformer* transformer_;
+  size_t batchsize_;
+  std::shared_ptr<Device> device_;
+  std::unique_ptr<ThreadPool> pool_;
+  std::vector<Slot> slots_;
+  /// ids of slots to be filled and of filled slots; -1 marks the end
+  std::unique_ptr<SafeQueue<int>> free_, ready_;
+  std::thread loader_;
+  /// slot returned by the last Next()
+  int held_ = -1;
+  bool ended_ = true;
+};
+
+}  // namespace singa
+#endif  // SINGA_IO_PIPELINE_H_
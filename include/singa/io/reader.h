@@ -19,10 +19,17 @@
 #ifndef SINGA_IO_READER_H_
 #define SINGA_IO_READER_H_
 
+#include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <functional>
+#include <memory>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 #include "singa/singa_config.h"
+#include "singa/utils/safe_queue.h"
 
 #ifdef USE_LMDB
 #include <lmdb.h>
@@ -35,6 +42,23 @@ namespace io {
 
 using std::string;
 
+/// A non-owning view of a contiguous byte range, e.g., a field of a
+/// memory-mapped file. It is valid as long as the owner of the bytes is.
+class StringView {
+ public:
+  StringView() = default;
+  StringView(const char* data, size_t size) : data_(data), size_(size) {}
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  /// Copy the bytes out into a string.
+  std::string ToString() const { return std::string(data_, size_); }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
 /// General Reader that provides functions for reading tuples.
 /// Subclasses implement the functions for a specific data storage, e.g., CSV
 /// file, HDFS, kvfile, leveldb, lmdb, etc.
@@ -67,6 +91,15 @@ class Reader {
 };
 
 /// Binfilereader reads tuples from binary file with key-value pairs.
+///
+/// Open(path) memory-maps the file and indexes the offsets of all tuples,
+/// which gives zero-copy reads via Read(StringView*, StringView*), O(1)
+/// Count() and Seek(), and random or shuffled access without loading the
+/// file into memory. The index is loaded from the sidecar file path + ".idx"
+/// if it is consistent with the data file (see SaveIndex()), otherwise it is
+/// built by a scan over the mapped file.
+/// Open(path, capacity) streams the file through a buffer of capacity bytes
+/// instead, which supports sequential reads only.
 class BinFileReader : public Reader {
  public:
   ~BinFileReader() { Close(); }
@@ -78,16 +111,42 @@ class BinFileReader : public Reader {
   void Close() override;
   /// \copydoc Read(std::string* key, std::string* value)
   bool Read(std::string* key, std::string* value) override;
+  /// Read the next tuple without copying it; the views point into the
+  /// mapped file and are valid until Close(). Memory-mapped mode only.
+  bool Read(StringView* key, StringView* value);
+  /// Read the i-th tuple of the file, regardless of the cursor and the read
+  /// order. Memory-mapped mode only.
+  void ReadAt(size_t i, StringView* key, StringView* value) const;
   /// \copydoc Count()
   int Count() override;
   /// \copydoc SeekToFirst()
   void SeekToFirst() override;
+  /// Move the cursor to the i-th tuple of the read order; i == Count() is
+  /// the end. Memory-mapped mode only.
+  void Seek(size_t i);
+  /// Position of the cursor in the read order.
+  size_t Tell() const { return cursor_; }
+  /// Permute the order in which Read() returns the tuples using 'seed', and
+  /// seek to the first one. Memory-mapped mode only.
+  void Shuffle(unsigned seed);
+  /// Write the offset index into path + ".idx" for later Open() calls.
+  /// Return false if the sidecar file cannot be written.
+  bool SaveIndex() const;
+  /// return true if the file is memory-mapped
+  bool mapped() const { return mmap_mode_; }
   /// return path to binary file
   inline std::string path() { return path_; }
 
  protected:
   /// Open a file with path_ and initialize buf_
   bool OpenFile();
+  /// Memory-map path_ and load or build the index.
+  bool MapFile();
+  /// Scan the mapped file for the offsets of all tuples.
+  void BuildIndex();
+  /// Load the index from the sidecar file; return false if it is missing or
+  /// stale.
+  bool LoadIndex();
   /// Read the next filed, including content_len and content;
   /// return true if succeed.
   bool ReadField(std::string* content);
@@ -110,6 +169,21 @@ class BinFileReader : public Reader {
   int bufsize_ = 0;
   /// magic word
   const char kMagicWord[2] = {'s', 'g'};
+
+  /// true if opened by Open(path)
+  bool mmap_mode_ = false;
+  /// start of the mapped file
+  const char* map_ = nullptr;
+  /// bytes of the mapped file
+  size_t size_ = 0;
+  /// modification time of the mapped file in nanoseconds
+  int64_t mtime_ = 0;
+  /// offsets of the tuples in the file
+  std::vector<uint64_t> index_;
+  /// read order of the tuples if shuffled; empty for the file order
+  std::vector<uint32_t> order_;
+  /// next position in the read order
+  size_t cursor_ = 0;
 };
 
 /// TextFileReader reads tuples from CSV file.
@@ -138,6 +212,75 @@ class TextFileReader : public Reader {
   int lineNo_ = 0;
 };
 
+/// ShardedReader reads tuples from a set of shard files, e.g., BinFile
+/// shards, in parallel.
+///
+/// Open(pattern) expands a glob pattern into the shards. Each epoch, i.e.,
+/// the pass between Open() or SeekToFirst() and Read() returning false,
+/// assigns the shards round-robin to the I/O threads, which read them
+/// ahead into bounded queues. Read() interleaves the tuples of the threads
+/// in blocks of 'block' tuples. The order of the tuples is deterministic:
+/// it depends only on the shards, the number of threads, the block size and,
+/// if shards are shuffled, on the seed and the epoch.
+class ShardedReader : public Reader {
+ public:
+  /// Create a Reader for one shard; BinFileReader by default.
+  typedef std::function<Reader*()> ReaderCreator;
+
+  /// @param num_threads number of I/O threads (at most one per shard)
+  /// @param capacity number of tuple blocks buffered by each thread
+  /// @param block number of consecutive tuples taken from one thread
+  /// @param shuffle whether to permute the shards every epoch
+  /// @param seed seed of the shard permutation
+  explicit ShardedReader(int num_threads = 4, int capacity = 64,
+                         int block = 16, bool shuffle = false,
+                         unsigned seed = 0, ReaderCreator creator = nullptr);
+  ~ShardedReader() { Close(); }
+  /// Open the shards matching the glob pattern 'path', sorted by name.
+  bool Open(const std::string& path) override;
+  /// Open the given shards.
+  bool Open(const std::vector<std::string>& shards);
+  /// \copydoc Close()
+  void Close() override;
+  /// \copydoc Read(std::string* key, std::string* value)
+  bool Read(std::string* key, std::string* value) override;
+  /// Total number of tuples of all shards.
+  int Count() override;
+  /// Stop the current epoch and start the next one.
+  void SeekToFirst() override;
+  /// return the shard files
+  const std::vector<std::string>& shards() const { return shards_; }
+  /// return the number of finished or started epochs
+  int epoch() const { return epoch_; }
+
+ private:
+  typedef std::vector<std::pair<std::string, std::string>> Block;
+  /// Shuffle the shards if needed and start the I/O threads.
+  void StartEpoch();
+  /// Close the queues and join the I/O threads.
+  void StopEpoch();
+  /// Read the shards assigned to a thread into its queue.
+  void Run(SafeQueue<Block>* queue, std::vector<std::string> shards);
+  Reader* CreateReader() const;
+
+  int num_threads_, capacity_, block_;
+  bool shuffle_;
+  unsigned seed_;
+  ReaderCreator creator_;
+  std::vector<std::string> shards_;
+  int epoch_ = 0;
+  int count_ = -1;
+  std::vector<std::unique_ptr<SafeQueue<Block>>> queues_;
+  std::vector<std::thread> threads_;
+  /// threads whose queues are not drained
+  std::vector<size_t> live_;
+  /// position in live_ of the thread to take the next block from
+  size_t next_ = 0;
+  /// current block and position inside it
+  Block block_buf_;
+  size_t pos_ = 0;
+};
+
 #ifdef USE_LMDB
 /// LMDBReader reads tuples from LMDB.
 class LMDBReader : public Reader {
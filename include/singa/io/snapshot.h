@@ -27,11 +27,18 @@
 #include "singa/utils/logging.h"
 #include "singa/proto/core.pb.h"
 #include "singa/core/tensor.h"
+#include "singa/utils/safe_queue.h"
 
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_set>
 #include <unordered_map>
 #include <memory>
+#include <vector>
 
 namespace singa {
 /// The snapshot management.
@@ -41,28 +48,46 @@ namespace singa {
 /// construction. Users either randomly initialize the layer parameters or using
 /// the parameters from checkpoint files using Snapshot after creating the
 /// neural network.
+///
+/// Since v2, <prefix>.bin stores tensors in a binary format: a file header
+/// ("sgts" and the format version), then one record per tensor, which is a
+/// header (key, data type, shape, stride, data offset, data size and a
+/// checksum of the data) followed by the raw data at a 64-byte aligned
+/// offset. Each tensor is written by one write of its data. The file ends with
+/// an index, i.e., a copy of the record headers, and a footer ("sgti") with
+/// the offset of the index.
+///
+/// In kRead mode, the file is memory-mapped and only the index is parsed;
+/// Read(key) returns a tensor over the mapped data without copying it (writes
+/// to the tensor are private to the process), hence only the pages of the
+/// tensors being read are loaded. Files of the older protobuf format are
+/// still readable; with memory mapping, the tensors are parsed when read.
 class Snapshot {
  public:
   enum Mode { kRead, kWrite };
-  /// <prefix>.model is the binary file for parameter key-value pair.
+  /// <prefix>.bin (<prefix>.model before v1.0.1) is the binary file of the
+  /// tensors.
   /// <prefix>.meta is the text file describing information about paramters,
   /// i.e.
   /// name and shape, one line per parameter.
   /// kRead for reading snapshot, whereas kWrite for dumping out snapshot.
-  /// max_param_size: in MB
+  /// max_param_size: in MB, the largest tensor of the older format
   Snapshot(const std::string& prefix, Mode mode, int max_param_size = 10);
-  ~Snapshot() {}
+  /// Write the index of the binary file in kWrite mode.
+  ~Snapshot();
   /// Read parameters saved as tensors from checkpoint file.
   std::vector<std::pair<std::string, Tensor>> Read();
+  /// Read all parameters in the order of the file; they are decoded (and
+  /// checked) by 'num_threads' threads; 0 for the number of cores.
+  std::vector<std::pair<std::string, Tensor>> ReadAll(int num_threads = 0);
   /// Read parameter shapes from description file.
   std::vector<std::pair<std::string, Shape>> ReadShape();
   /// Read parameter returned as a tensor for a given parameter name.
   Tensor Read(const std::string& Key);
   /// Read parameter shape for a given parameter name.
   Shape ReadShape(const std::string& key);
-  /// Serialize and dump out parameter. This method will write two files, one
-  /// binary file is for serialized tensors, the other csv file is for parameter
-  /// names and shapes.
+  /// Dump out parameter. This method will write two files, one binary file is
+  /// for the tensors, the other csv file is for parameter names and shapes.
   void Write(const std::string& key, const Tensor& param);
   /// available for singa > 1.0.1
   int version() const {
@@ -70,18 +95,104 @@ class Snapshot {
   }
 
  private:
+  /// Header of a tensor in the binary file.
+  struct Record {
+    DataType data_type = kFloat32;
+    Shape shape;
+    std::vector<int> stride;
+    uint64_t offset = 0;
+    uint64_t nbytes = 0;
+    uint64_t checksum = 0;
+    bool verified = false;
+    /// serialized TensorProto of the older format
+    io::StringView proto;
+  };
+  /// Map the binary file and parse its index (or record headers); return
+  /// false if it is not of the binary format.
+  bool OpenTensorFile(const std::string& path);
+  /// Parse the record header at 'pos' within [0, end) of 'base' and add the
+  /// record; return the position after the header.
+  uint64_t AddRecord(const char* base, uint64_t pos, uint64_t end,
+                     const std::string& path);
+  /// Open the file of the older protobuf format.
+  void OpenProtoFile(const std::string& prefix, int max_param_size);
+  Record* Find(const std::string& key);
+  /// Create the tensor over the mapped data of a record or parse it.
+  Tensor MakeTensor(Record* record);
+
   /// version of SINGA which generates the snapshot
   int version_ = 0;
   std::string prefix_;
   Mode mode_;
-  std::unique_ptr<io::BinFileWriter> bin_writer_ptr_;
+  std::ofstream bin_file_;
+  /// bytes written to bin_file_
+  uint64_t bin_pos_ = 0;
+  /// record headers for the index
+  std::string index_;
   std::unique_ptr<io::Writer> text_writer_ptr_;
+  /// true for files of the protobuf format; parsed tensors are cached in
+  /// param_map_
+  bool proto_format_ = false;
+  /// memory-mapped file of the protobuf format
   std::unique_ptr<io::BinFileReader> bin_reader_ptr_;
+  /// mapped (or loaded) binary file
+  std::shared_ptr<char> file_;
+  /// keys in the order of the file
+  std::vector<std::string> keys_;
+  std::unordered_map<std::string, Record> records_;
   /// Check whether parameter name is unique.
   std::unordered_set<std::string> param_names_;
-  /// Preload key-parameter tensor pairs for seeking a specified key.
+  /// Parsed key-parameter tensor pairs of the protobuf format.
   std::unordered_map<std::string, Tensor> param_map_;
 };
+
+/// Checkpointer dumps Snapshots of the parameters in the background.
+///
+/// Save() captures the parameter tensors at a step boundary: it holds a
+/// reference of each tensor and submits a copy of its data into a host buffer
+/// to the tensor's device. With an asynchronous device, the copy is ordered
+/// by the scheduler before the later updates of the parameter, hence training
+/// continues without waiting for it. A background thread writes the captured
+/// data as the Snapshot <prefix>-<step> into temporary files, syncs them to
+/// disk and renames them to the final names, hence a checkpoint either exists
+/// completely or not at all. Only the last 'keep' checkpoints written by the
+/// Checkpointer are kept.
+class Checkpointer {
+ public:
+  /// @param keep the number of checkpoints to keep; 0 for all.
+  /// @param max_pending the max number of captured checkpoints waiting to be
+  /// written; Save() blocks if there are that many.
+  explicit Checkpointer(const std::string& prefix, int keep = 3,
+                        int max_pending = 1);
+  /// Wait for the pending checkpoints.
+  ~Checkpointer();
+  /// Capture the tensors and write them in the background.
+  void Save(int step, const std::vector<std::pair<std::string, Tensor>>& params);
+  /// Block until all captured checkpoints are written.
+  void Wait();
+  /// Prefixes of the checkpoints kept, from the oldest.
+  std::vector<std::string> checkpoints();
+
+ private:
+  struct Job;
+  /// Loop of the writer thread.
+  void Run();
+  /// Write the captured tensors as a snapshot.
+  void Write(Job* job);
+
+  std::string prefix_;
+  size_t keep_;
+  /// host device of the captured tensors; it has no scheduler, hence
+  /// accessing them does not wait for the parameter devices.
+  std::shared_ptr<Device> host_;
+  SafeQueue<std::shared_ptr<Job>> jobs_;
+  std::thread writer_;
+  std::mutex mtx_;
+  std::condition_variable done_cv_;
+  /// number of jobs that are captured but not written
+  int num_pending_ = 0;
+  std::deque<std::string> kept_;
+};
 }  //  namespace singa
 
 #endif  //  SINGA_UTILS_SNAPSHOT_H_
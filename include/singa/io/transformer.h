@@ -38,6 +38,15 @@ class Transformer {
   virtual Tensor Apply(int flag, Tensor& input) = 0;
 };
 
+/// ImageTransformer resizes, crops, mirrors and normalizes images.
+///
+/// The input is a float or uint8 (kUChar) image, i.e., {C, H, W} or
+/// {H, W, C} according to image_dim_order, a gray image {H, W}, or a batch of
+/// images {N, C, H, W} or {N, H, W, C}; the output is float. Crop, mirror and normalization (rescale, featurewise_center
+/// and featurewise_std_norm) are fused into a single pass over each (resized)
+/// image; the images of a batch are processed in parallel. In kTrain mode the
+/// crop offsets and the horizontal mirroring are random per image, drawn from
+/// a per-thread generator; kEval uses the central crop without mirroring.
 class ImageTransformer: public Transformer {
  public:
   void Setup(const TransformerConf& conf) override {
@@ -52,6 +61,8 @@ class ImageTransformer: public Transformer {
     /// if crop_shape not contain 2 elements, ignore crop option.
     if (conf.crop_shape_size() == 2)
       crop_shape_ = {conf.crop_shape(0), conf.crop_shape(1)};      
+    mean_.assign(conf.mean().begin(), conf.mean().end());
+    std_.assign(conf.std().begin(), conf.std().end());
   }
 
   Tensor Apply(int flag, Tensor& input) override;
@@ -64,6 +75,8 @@ class ImageTransformer: public Transformer {
   const float rescale() const { return rescale_; }
   const Shape crop_shape() const { return crop_shape_; }
   const string image_dim_order() const { return image_dim_order_; }
+  const std::vector<float>& mean() const { return mean_; }
+  const std::vector<float>& stddev() const { return std_; }
 
  private:
   bool featurewise_center_ = false;
@@ -74,6 +87,7 @@ class ImageTransformer: public Transformer {
   float rescale_ = 0.f;
   Shape crop_shape_ = {};
   std::string image_dim_order_ = "CHW";
+  std::vector<float> mean_, std_;
 };
 
 #ifdef USE_OPENCV
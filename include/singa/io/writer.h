@@ -19,10 +19,17 @@
 #ifndef SINGA_IO_WRITER_H_
 #define SINGA_IO_WRITER_H_
 
+#include <condition_variable>
 #include <cstring>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 #include "singa/singa_config.h"
+#include "singa/utils/safe_queue.h"
 
 #ifdef USE_LMDB
 #include <lmdb.h>
@@ -74,6 +81,10 @@ class Writer {
 ///  - key_len and key are optional.)
 /// When BinFile is created, it will remove the last tuple if the value size
 /// and key size do not match because the last write crashed.
+///
+/// By default, the tuples are buffered and a full buffer is written by the
+/// calling thread. With OpenAsync(), full buffers are handed to a background
+/// I/O thread, hence Write() only blocks when all buffers are being written.
 class BinFileWriter : public Writer {
  public:
   ~BinFileWriter() { Close(); }
@@ -81,18 +92,40 @@ class BinFileWriter : public Writer {
   bool Open(const std::string &path, Mode mode) override;
   /// \copydoc Open(const std::string& path), user defines capacity
   bool Open(const std::string &path, Mode mode, int capacity);
+  /// Open the file for writing 'num_buffers' buffers of 'capacity' bytes in
+  /// turn: Write() fills one while the others are written by the I/O thread.
+  /// With 'direct', the file is opened with O_DIRECT (if supported), which
+  /// bypasses the page cache, and the buffers are written in blocks aligned
+  /// to kDirectAlign; the unaligned tail is written by Close().
+  bool OpenAsync(const std::string &path, Mode mode, int capacity = 16 << 20,
+                 int num_buffers = 2, bool direct = false);
   /// \copydoc Close()
   void Close() override;
   /// \copydoc Write(const std::string& key, const std::string& value) override;
   bool Write(const std::string &key, const std::string &value) override;
-  /// \copydoc Flush()
+  /// Write the buffered tuples. In the async mode, it hands the buffer to the
+  /// I/O thread and waits for the outstanding buffers only; with O_DIRECT,
+  /// the unaligned tail is kept in the buffer.
   void Flush() override;
   /// return path to binary file
   inline std::string path() { return path_; }
+  /// return true if the file is written with O_DIRECT
+  bool direct() const { return direct_; }
+
+  /// alignment of the buffers and of the writes with O_DIRECT
+  static const int kDirectAlign = 4096;
 
  protected:
   /// Open a file with path_ and initialize buf_
   bool OpenFile();
+  /// Open the file descriptor and the buffers of the async mode
+  bool OpenAsyncFile(int num_buffers, bool direct);
+  /// Write out the buffer, or hand it to the I/O thread in the async mode
+  void Spill();
+  /// Loop of the I/O thread
+  void Run();
+  /// Write 'size' bytes to the file
+  void WriteOut(const char *data, size_t size);
 
  private:
   /// file to be written
@@ -108,6 +141,22 @@ class BinFileWriter : public Writer {
   int bufsize_ = 0;
   /// magic word
   const char kMagicWord[2] = {'s', 'g'};
+
+  /// true for OpenAsync()
+  bool async_ = false;
+  bool direct_ = false;
+  /// file descriptor of the async mode; fdat_ is used without POSIX
+  int fd_ = -1;
+  /// aligned buffers of the async mode, one of which is buf_
+  std::vector<char *> buffers_;
+  std::unique_ptr<SafeQueue<char *>> free_;
+  /// buffers and bytes to be written by the I/O thread
+  std::unique_ptr<SafeQueue<std::pair<char *, size_t>>> full_;
+  std::thread io_thread_;
+  std::mutex mtx_;
+  std::condition_variable written_cv_;
+  /// number of buffers handed to the I/O thread and not written
+  int num_writing_ = 0;
 };
 
 /// TextFileWriter write training/validation/test tuples in CSV file.
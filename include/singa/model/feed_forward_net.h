@@ -21,6 +21,7 @@
 #include "singa/model/loss.h"
 #include "singa/model/metric.h"
 #include "singa/model/updater.h"
+#include <functional>
 #include <thread>
 #include <memory>
 namespace singa {
@@ -72,6 +73,19 @@ class FeedForwardNet {
   /// registered in Updater.;
   void Compile(bool shuffle, bool to_register, std::shared_ptr<Updater> updater,
                Loss* loss, Metric* metric);
+  /// Update the parameters while TrainOnBatch() runs the backward pass,
+  /// instead of after it. The gradients of the layers are coalesced into
+  /// buckets of at least 'bucket_size' bytes from the last layer, and every
+  /// bucket is passed to Updater::ApplyBucket() by a background thread as
+  /// soon as it is full; hence the gradient exchange of the top layers
+  /// overlaps with the backward pass of the lower ones. 0 disables it.
+  /// Replicas sharing one Updater must use the same bucket size. It cannot be
+  /// used with the virtual memory of the device (see
+  /// Device::EnableVirtualMemory()).
+  void OverlapUpdate(size_t bucket_size) {
+    bucket_size_ = bucket_size;
+    bucket_updater_.reset();
+  }
 
   /// Conduct the training giving the training data 'x' and label 'y'.
   /// 'val_split' of training data is used for
@@ -89,6 +103,7 @@ class FeedForwardNet {
   void Train(size_t batchsize, int nb_epoch, const Tensor& x, const Tensor& y,
              const Tensor& val_x, const Tensor& val_y);
   /// Train the neural net over one batch of training data.
+  /// It is one iteration for the virtual memory of the device of 'x'.
   const std::pair<float, float> TrainOnBatch(int epoch, const Tensor& x,
                                              const Tensor& y);
 
@@ -120,7 +135,11 @@ class FeedForwardNet {
   const Tensor Forward(int flag, const Tensor& x);
   /// Backward layers one by one using the gradient batch 'grad'.
   /// Returns the parameter gradients.
-  const vector<Tensor> Backward(int flag, const Tensor& grad);
+  /// If 'emit' is set, it is called with every layer and its parameter
+  /// gradients right after the backward of the layer.
+  const vector<Tensor> Backward(
+      int flag, const Tensor& grad,
+      const std::function<void(Layer*, const vector<Tensor>&)>& emit = nullptr);
 
   /// Clone the neuaral net by cloning every layer to the given device.
   /// If 'device' is nullptr, then clone it one the current device.
@@ -128,7 +147,11 @@ class FeedForwardNet {
   /// Move the layer data to the given device.
   void ToDevice(std::shared_ptr<Device> device);
   void ToHost() { ToDevice(defaultDevice); }
-  /// Set the data type of each layer.
+  /// Convert the parameters of each layer into dtype, e.g., kFloat16 or
+  /// kBFloat16 to halve the memory of a model for inference. Dense layers
+  /// compute with the converted parameters in the type of their input; the
+  /// other layers with parameters support kFloat32 only. int8 needs a scale,
+  /// see Quantize().
   void AsType(DataType dtype);
 
   /// A wrapper method to spawn a thread to execute Train() method.
@@ -159,6 +182,12 @@ class FeedForwardNet {
   bool shuffle_ = true;
   Device* device_ = nullptr;
   DataType dtype_ = kFloat32;
+
+  /// see OverlapUpdate()
+  size_t bucket_size_ = 0;
+  /// the background thread applying the buckets, created on demand
+  class BucketUpdater;
+  std::shared_ptr<BucketUpdater> bucket_updater_;
 };
 
 } /* singa */
@@ -31,6 +31,32 @@
 namespace singa {
 
 typedef vector<size_t> Shape;
+
+/// Copies of the parameters of a layer in the type it computes in, for the
+/// parameters kept in another type after Layer::AsType(), e.g., kFloat16.
+/// A copy is converted at its first use and reused until Clear(), which the
+/// layer calls when its parameters are converted, moved or set.
+class ParamCache {
+ public:
+  /// Return 'param' if it is of 'dtype', otherwise the i-th copy, i.e.,
+  /// 'param' converted into 'dtype'.
+  Tensor Get(size_t i, const Tensor& param, DataType dtype) {
+    if (param.data_type() == dtype) return param;
+    if (copies_.size() <= i) copies_.resize(i + 1);
+    Tensor& copy = copies_[i];
+    if (copy.data_type() != dtype || copy.shape() != param.shape() ||
+        copy.device() != param.device()) {
+      copy = param;
+      copy.AsType(dtype);
+    }
+    return copy;
+  }
+  void Clear() { copies_.clear(); }
+
+ private:
+  vector<Tensor> copies_;
+};
+
 /// The base layer class.
 /// Generally, a layer conducts feature transformation against a set of Tensor
 /// to generate a set of Tensor. Each layer may have some parameters.
@@ -159,7 +185,8 @@ class Layer {
   virtual void ToDevice(std::shared_ptr<Device> device) {
   }
 
-  /// Set the data type of Tensor in this layer.
+  /// Set the data type of Tensor in this layer and convert their values, e.g.,
+  /// parameters and running statistics.
   virtual void AsType(DataType dtype) {
   }
 
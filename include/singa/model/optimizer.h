@@ -19,11 +19,16 @@
 #ifndef SINGA_MODEL_OPTIMIZER_H_
 #define SINGA_MODEL_OPTIMIZER_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "singa/core/tensor.h"
+#include "singa/io/network.h"
 #include "singa/proto/model.pb.h"
 
 using std::string;
@@ -254,55 +259,89 @@ inline std::shared_ptr<Optimizer> CreateOptimizer(const string& type) {
   return opt;
 }
 // ============LocalAllReduce for single node multiple workers ==============
-/// Updater for training models on a single node with multiple devices (workers)
-/// All model parameters are partitioned such that each parameter is updated on
-/// one device. In specific, each worker has a model replica. All workers share
-/// the same LocalAllReduce instance. Parameters are registered at first, and
-/// then after every iteration, the gradients are aggregated by one worker (or
-/// device) for parameter updating.
-/*
-class LocalAllReduce : public Optimizer{
- pulbic:
-  LocalAllReduce(Optimizer* opt);
-  void Setup(const string& str) {
-    AllReduce conf;
-    conf.ParseFromString(str);
-    this->Setup(conf);
-  }
-  void Setup(const AllReduce& conf) {}
-
-  /// Register all model parameters.
-  /// Instructions include:
-  /// 1. Copy parameters from the master worker (who initialized the parameters)
-  /// to others.
-  /// 2. Partition parameters onto worker devices. For example, model parameter
-  /// set is {A, B, C}, nb_workers = 3, then worker 0/1/2 would be in charge of
-  /// updating A/B/C respectively. A gradient Tensor for A/B/C would be created
-  /// on device 0/1/2, dentoed as GA/GB/GC. 0/1/2 would call the internal opt to
-register the specs
-  /// for A/B/C.
-  void Register(const vector<string>& names,
-                const vector<Tensor>& values,
-                const vector<ParamSpecs>& specs) override;
-
-  /// Aggregate parameter gradients and call internal opt to do the update.
-  /// Continue with the example for Register(), worker 0 would copy B's gradient
-  /// to device 1 and add it with GB.  A callback func is added to
-  /// 1. check UpdateNow() and call opt to do the real update.
-  /// 2. broadcast the new parameters back to worker 0 and 2.
-  void Update(int step, float lr, const string& name, const Tensor& grad,
-              Tensor* param) override;
-
-  /// Decide when to call the internal Optimizer for real update.
-  /// One simple implementation would return true until all workers has
-  /// aggregated their gradients. We can also add a user configuration field
-  /// to control this, e.g., if do it when 80% workers has aggregated.
-  boo UpdateNow();
+/// LocalAllReduce sums the tensors of N workers (threads) of one process,
+/// e.g., the gradients of the model replicas, which is shared by the workers.
+///
+/// The tensors are split into N chunks and every worker sums one chunk over
+/// all workers, hence the aggregation is done by all workers in parallel
+/// (reduce-scatter); then the summed chunks are copied to the other workers
+/// (all-gather). A list of tensors, e.g., all gradients of a step, is
+/// processed as one bucket, i.e., it is split into N chunks as a whole, which
+/// avoids synchronizing the workers for every small tensor.
+///
+/// Host tensors of kFloat32 are summed directly; other tensors are copied
+/// chunk by chunk to the device of the worker owning the chunk.
+class LocalAllReduce {
+ public:
+  explicit LocalAllReduce(int num_workers);
+
+  /// Called by every worker with its tensors, which must be of the same
+  /// sizes for all workers. It returns when all workers have called it, and
+  /// then the tensors of every worker are the sum of all, scaled by 'scale',
+  /// e.g., 1 / N to average them.
+  void AllReduce(int rank, vector<Tensor>* tensors, float scale = 1.0f);
+  void AllReduce(int rank, Tensor* tensor, float scale = 1.0f);
+  /// Like AllReduce(), but only the tensors of the worker 'root' are set to
+  /// the (scaled) sum.
+  void Reduce(int rank, vector<Tensor>* tensors, int root = 0,
+              float scale = 1.0f);
+
+  /// Return when all workers have called it. The workers spin for a short
+  /// while before they sleep, as they usually arrive close to each other.
+  void Barrier();
+
+  int num_workers() const { return num_workers_; }
+
+ private:
+  /// Sum chunk 'rank' into the tensors of 'dst' (or every worker's own if
+  /// 'dst' < 0), and copy it to the other workers if 'gather'.
+  void Run(int rank, vector<Tensor>* tensors, int dst, bool gather,
+           float scale);
+
+  int num_workers_;
+  vector<vector<Tensor>*> tensors_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  /// number of workers in the barrier and number of barriers passed
+  std::atomic<int> count_{0}, generation_{0};
+};
+
+#ifdef ENABLE_DIST
+/// RingAllReduce sums the tensors of N processes, one call per process, by
+/// the ring algorithm over EndPoint.
+///
+/// The tensors of a call are copied into one host buffer, which is split into
+/// N chunks. In N - 1 steps, every process sends a chunk to the next process
+/// in the ring and adds the chunk from the previous one into its buffer, after
+/// which it holds the sum of one chunk (reduce-scatter); in another N - 1
+/// steps, the summed chunks are passed around the ring (all-gather). Every
+/// process hence sends and receives 2 (N - 1) / N of the data, regardless of
+/// N. The chunks are sent without copying them into messages.
+///
+/// Only kFloat32 tensors are supported. Every process needs an address of its
+/// own (see NetworkThread), and the EndPoint of its neighbours must not be
+/// used by others, e.g., DistUpdater, at the same time.
+class RingAllReduce {
+ public:
+  /// @param hosts hosts of all processes in the ring, in the same order for
+  /// all of them; 'rank' is the index of this process.
+  RingAllReduce(NetworkThread* net, const vector<string>& hosts, int rank);
+
+  /// Called by every process with tensors of the same sizes; the tensors are
+  /// set to the sum of all, scaled by 'scale'.
+  void AllReduce(vector<Tensor>* tensors, float scale = 1.0f);
 
  private:
-  int nb_workers_;
-  vector<Tensor> aggregated_gradients_;
+  /// Send [begin, end) of the buffer owned by 'owner' to the next process.
+  void Send(const float* begin, const float* end, std::shared_ptr<void> owner);
+  /// Receive the next chunk from the previous process.
+  std::shared_ptr<Message> Receive(size_t size);
+
+  int num_, rank_;
+  EndPoint *prev_, *next_;
+  /// sequence numbers of the last message sent and received
+  uint32_t sent_ = 0, received_ = 0;
 };
-*/
+#endif  // ENABLE_DIST
 }
 #endif  // SINGA_MODEL_OPTIMIZER_H_
@@ -19,9 +19,11 @@
 #ifndef SINGA_MODEL_UPDATER_H_
 #define SINGA_MODEL_UPDATER_H_
 
+#include "singa/singa_config.h"
 #include "singa/model/optimizer.h"
 #include "singa/core/device.h"
 #include "singa/core/tensor.h"
+#include "singa/io/network.h"
 #include "singa/utils/logging.h"
 
 #include <memory>
@@ -32,6 +34,7 @@
 #include <utility>
 #include <unordered_map>
 #include <atomic>
+#include <thread>
 
 namespace singa {
 /// Basic Updater class just forward all the method function call
@@ -46,6 +49,12 @@ class Updater {
   virtual void Register(const string& name, const ParamSpec& specs);
   /// Forward Apply() to Optimizer.
   virtual void Apply(int step, const string& name, Tensor& grad, Tensor& value);
+  /// Update a bucket of parameters, e.g., the gradients of several layers
+  /// coalesced during the backward pass (see FeedForwardNet::OverlapUpdate()).
+  /// Sub-classes that aggregate gradients may exchange a bucket at once; this
+  /// one calls Apply() for every parameter.
+  virtual void ApplyBucket(int step, const vector<string>& names,
+                           vector<Tensor>& grads, vector<Tensor>& values);
   Optimizer* GetOptimizer() { return opt_; }
 
   // No copy allowed.
@@ -58,6 +67,17 @@ class Updater {
 
 /// LocalUpdater do gradient aggregation and update gradient calling
 /// the wrapped Optimizer on a specific device (i.e., CPU or GPU).
+/// The gradients are averaged by all threads in parallel, each on a part of
+/// the gradient (see LocalAllReduce), in place into the gradients of the first
+/// arriving thread, which then runs the Optimizer. Hence the gradients of
+/// the threads must not share memory.
+///
+/// Parameters get consecutive indices at Register(), which is not thread-safe
+/// and must be done before training; Apply() is then lock-free apart from the
+/// barriers of the threads. The updated value is kept in the value tensor of
+/// the first replica on the device of the updater, which is updated in place.
+/// It is copied into the other replicas, unless they share its memory, e.g.,
+/// threads training one set of parameters.
 class LocalUpdater : public Updater {
  public:
   LocalUpdater(int total_num, Optimizer* opt,
@@ -71,27 +91,156 @@ class LocalUpdater : public Updater {
   /// all the partial gradients are aggrageted in a synchronized style training.
   virtual void Apply(int step, const string& name, Tensor& grad,
                      Tensor& value) override;
+  /// Like Apply() above, but for the parameter of the given index, which
+  /// saves looking up the name.
+  void Apply(int step, int index, Tensor& grad, Tensor& value);
+  /// Average the gradients of the bucket by one LocalAllReduce call. All
+  /// threads must pass the same buckets in the same order.
+  void ApplyBucket(int step, const vector<string>& names,
+                   vector<Tensor>& grads, vector<Tensor>& values) override;
+  /// Return the index of a registered parameter, i.e., the number of
+  /// parameters registered before it.
+  int Index(const string& name) const;
+
  private:
-  template <typename T1, typename T2>
-  struct key_hasher {
-    size_t operator() (const std::pair<T1, T2>& p) const {
-      auto h1 = std::hash<T1>{}(p.first);
-      auto h2 = std::hash<T2>{}(p.second);
-      return h1 ^ h2;
-    }
+  /// Update the parameters of the given indices together, whose first one
+  /// synchronizes the threads.
+  void Update(int step, const vector<int>& indices, vector<Tensor>& grads,
+              vector<Tensor>& values);
+
+  struct Param {
+    string name;
+    /// number of threads that have called Apply() in this step, if it is the
+    /// first one of the updated parameters
+    std::atomic<int> arrived{0};
+    /// the averaged gradient copied to the device of the updater, if the
+    /// first arriving thread has it on another device
+    Tensor grad;
+    /// the updated value
+    Tensor value;
+    std::unique_ptr<LocalAllReduce> reducer;
   };
 
   int total_num_;
   std::shared_ptr<Device> dev_;
-  std::unordered_map<std::string, std::atomic<int>> dev_index_;
-  std::unordered_map<std::string, int> to_updater_finished_;
-  std::unordered_map<std::pair<int, std::string>, Tensor,
-    key_hasher<int, std::string>> grad_buffer_;
-  std::unordered_map<std::string, Tensor> sum_, param_buffer_;
-  std::unordered_map<std::string, std::mutex> mtx_;
-  std::unordered_map<std::string, std::condition_variable>
-    to_updater_all_finished_;
+  std::unordered_map<string, int> index_;
+  vector<std::unique_ptr<Param>> params_;
+};
+
+#ifdef ENABLE_DIST
+/// DistUpdater updates parameters on parameter servers (see ParamServer) for
+/// data parallel training with one worker process per model replica.
+///
+/// Parameters are sharded over the servers by the hash of their names, hence
+/// all workers must list the servers in the same order. Every process needs an
+/// address of its own (see NetworkThread), e.g., 127.0.0.x on one machine.
+/// The Optimizer of the servers updates the parameters; the one of the workers
+/// is only set up.
+class DistUpdater : public Updater {
+ public:
+  /// @param net the network thread of this process, whose port is used to
+  /// connect the servers.
+  /// @param servers hosts of the servers.
+  DistUpdater(Optimizer* opt, NetworkThread* net,
+              const std::vector<std::string>& servers);
+  /// Call Stop().
+  ~DistUpdater() override;
+  /// Register the parameter on its server.
+  void Register(const string& name, const ParamSpec& specs) override;
+  /// Send the gradient to the server of the parameter and wait for the
+  /// updated value, which is received directly into 'value' if it is on a
+  /// host device. The first call for a parameter also sends 'value' to
+  /// initialize it on the server, unless another worker has done so.
+  /// Calls for parameters on different servers can run concurrently.
+  void Apply(int step, const string& name, Tensor& grad,
+             Tensor& value) override;
+  /// Get the current value of the parameter from its server.
+  void Pull(const string& name, Tensor& value);
+  /// Tell the servers that this worker has finished; ParamServer::Run()
+  /// returns after all workers have stopped.
+  void Stop();
+
+ private:
+  struct Server {
+    EndPoint* ep;
+    /// sequence number of the last request
+    uint32_t seq = 0;
+    std::mutex mtx;
+  };
+  /// Send the request of 'op' and receive the value of the parameter.
+  void Request(int op, int step, const string& name, const Tensor& grad,
+               Tensor& value);
+  /// Receive the reply of the request 'seq'; nullptr if disconnected.
+  Message* Receive(Server* server, uint32_t seq);
+
+  std::vector<std::unique_ptr<Server>> servers_;
+  /// whether the parameter has been sent to initialize the server
+  std::unordered_map<std::string, bool> initialized_;
+  bool stopped_ = false;
+};
+
+/// ParamServer updates its shard of the parameters with the gradients from
+/// the DistUpdater of every worker.
+///
+/// If 'staleness' is negative, training is synchronous: the gradients of
+/// a parameter from all (running) workers are averaged and applied at once,
+/// and then the new value is sent to all of them. Otherwise, a gradient is
+/// applied when it arrives and the worker gets the value back once no worker
+/// is more than 'staleness' updates (of this parameter) behind it, i.e.,
+/// stale synchronous parallel; 0 makes the workers proceed in lock step, but
+/// unlike the synchronous mode, each gradient is applied separately.
+///
+/// The requests of the workers are received by one thread per worker and are
+/// handled one at a time, as Optimizer is not thread-safe.
+class ParamServer {
+ public:
+  /// @param workers hosts of the workers.
+  /// @param dev the device to update the parameters on.
+  ParamServer(Optimizer* opt, NetworkThread* net,
+              const std::vector<std::string>& workers, int staleness = -1,
+              std::shared_ptr<Device> dev = defaultDevice);
+  /// Wait for all workers to connect and serve them until they have stopped.
+  void Run();
+
+ private:
+  struct Param {
+    Tensor value, sum;
+    /// number of gradients in 'sum' and the step of the last one for
+    /// synchronous training
+    int count = 0, step = 0;
+    /// number of gradients applied from each worker
+    std::vector<int> clock;
+    /// workers waiting for the value
+    std::vector<int> waiting;
+  };
+  /// Receive and handle the requests of the worker.
+  void Serve(int worker);
+  /// Return false if the worker stops.
+  bool Handle(int worker, Message* msg);
+  /// Mark the worker stopped and release the workers waiting for it.
+  void Leave(int worker);
+  /// Update the parameter with the averaged gradients and reply to all.
+  void Update(const string& name, Param* param);
+  /// Reply to the waiting workers that are not too far ahead.
+  void ReplyReady(const string& name, Param* param);
+  /// Send the current value of the parameter to the workers.
+  void Reply(const string& name, const Param& param,
+             const std::vector<int>& workers);
+
+  Optimizer* opt_;
+  NetworkThread* net_;
+  std::vector<std::string> workers_;
+  int staleness_;
+  std::shared_ptr<Device> dev_;
+  std::vector<EndPoint*> eps_;
+  std::vector<bool> stopped_;
+  /// sequence number of the last request from each worker
+  std::vector<uint32_t> seq_;
+  int running_ = 0;
+  std::unordered_map<std::string, Param> params_;
+  std::mutex mtx_;
 };
+#endif  // ENABLE_DIST
 }  //  namespace singa
 
 #endif  //  SINGA_MODEL_UPDATER_H_
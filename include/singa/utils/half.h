@@ -0,0 +1,123 @@
+/************************************************************
+*
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an
+* "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+* KIND, either express or implied.  See the License for the
+* specific language governing permissions and limitations
+* under the License.
+*
+*************************************************************/
+
+#ifndef SINGA_UTILS_HALF_H_
+#define SINGA_UTILS_HALF_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace singa {
+
+/// Convert a float into IEEE 754 binary16 bits, rounding to nearest even.
+inline uint16_t FloatToHalfBits(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000u);
+  uint32_t abs = x & 0x7fffffffu;
+  if (abs > 0x7f800000u)  // nan, kept quiet
+    return sign | 0x7e00u | ((abs >> 13) & 0x3ffu);
+  if (abs >= 0x477ff000u)  // inf, or rounds beyond 65504
+    return sign | 0x7c00u;
+  if (abs < 0x38800000u) {  // subnormal half
+    if (abs < 0x33000000u) return sign;  // rounds to 0
+    uint32_t shift = 126u - (abs >> 23);
+    uint32_t m = (abs & 0x7fffffu) | 0x800000u;
+    uint32_t r = m >> shift, rem = m & ((1u << shift) - 1),
+             halfway = 1u << (shift - 1);
+    if (rem > halfway || (rem == halfway && (r & 1u))) r++;
+    return static_cast<uint16_t>(sign | r);
+  }
+  // re-bias the exponent; a carry of the rounding goes into the exponent
+  uint32_t r = (abs - 0x38000000u) >> 13, rem = abs & 0x1fffu;
+  if (rem > 0x1000u || (rem == 0x1000u && (r & 1u))) r++;
+  return static_cast<uint16_t>(sign | r);
+}
+
+/// Convert IEEE 754 binary16 bits into a float, which is exact.
+inline float HalfBitsToFloat(uint16_t h) {
+  uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+  uint32_t exp = (h >> 10) & 0x1fu, mant = h & 0x3ffu, x;
+  if (exp == 0x1fu) {
+    x = sign | 0x7f800000u | (mant << 13);
+  } else if (exp != 0) {
+    x = sign | ((exp + 112u) << 23) | (mant << 13);
+  } else {
+    float f = static_cast<float>(mant) * (1.0f / 16777216.0f);  // 2^-24
+    return sign ? -f : f;
+  }
+  float f;
+  std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+/// Half precision (fp16) floating point number for storage.
+///
+/// There is no fp16 arithmetic; values are converted implicitly to float for
+/// computation and converted back explicitly, e.g., half(x).
+struct half {
+  uint16_t bits;
+
+  half() = default;
+  explicit half(float f) : bits(FloatToHalfBits(f)) {}
+  operator float() const { return HalfBitsToFloat(bits); }
+};
+
+/// Convert a float into bfloat16 bits, rounding to nearest even.
+inline uint16_t FloatToBFloat16Bits(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  if ((x & 0x7fffffffu) > 0x7f800000u)  // nan, kept quiet
+    return static_cast<uint16_t>((x >> 16) | 0x40u);
+  return static_cast<uint16_t>((x + 0x7fffu + ((x >> 16) & 1u)) >> 16);
+}
+
+/// Convert bfloat16 bits into a float, which is exact.
+inline float BFloat16BitsToFloat(uint16_t b) {
+  uint32_t x = static_cast<uint32_t>(b) << 16;
+  float f;
+  std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+/// Brain floating point (bf16) number for storage, i.e., the upper 16 bits
+/// of a float. Like half, it is computed in float.
+struct bfloat16 {
+  uint16_t bits;
+
+  bfloat16() = default;
+  explicit bfloat16(float f) : bits(FloatToBFloat16Bits(f)) {}
+  operator float() const { return BFloat16BitsToFloat(bits); }
+};
+
+/// Convert 'n' fp16 values into float, using F16C instructions if available.
+void HalfToFloat(const half* in, float* out, size_t n);
+/// Convert 'n' floats into fp16, rounding to nearest even.
+void FloatToHalf(const float* in, half* out, size_t n);
+/// Convert 'n' bf16 values into float.
+void BFloat16ToFloat(const bfloat16* in, float* out, size_t n);
+/// Convert 'n' floats into bf16, rounding to nearest even.
+void FloatToBFloat16(const float* in, bfloat16* out, size_t n);
+
+}  // namespace singa
+
+#endif  // SINGA_UTILS_HALF_H_
@@ -28,25 +28,47 @@
 #include <mutex>
 #include <condition_variable>
 #include <thread>
+#include <utility>
 
 /**
  * Thread-safe queue.
+ *
+ * It is unbounded by default; with a capacity, Push blocks while the queue is
+ * full, which makes it a bounded producer-consumer buffer. Close() wakes up
+ * all blocked producers and consumers.
  */
 template <typename T, class Container = std::queue<T>>
 class SafeQueue {
  public:
   SafeQueue() = default;
+  /**
+   * @param[in] capacity, max number of elements in the queue; 0 for no limit.
+   */
+  explicit SafeQueue(size_t capacity) : capacity_(capacity) {}
   ~SafeQueue() {
     std::lock_guard<std::mutex> lock(mutex_);
   }
 
   /**
    * Push an element into the queue. Blocking operation.
-   * @return true if success;
+   * @return true if success; false if the queue is closed.
    */
   bool Push(const T& e) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    queue_.push(e);
+    T copy(e);
+    return Push(std::move(copy));
+  }
+
+  /**
+   * Move an element into the queue; it blocks while the queue is full.
+   * @return true if success; false if the queue is closed.
+   */
+  bool Push(T&& e) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this]() {
+      return closed_ || capacity_ == 0 || queue_.size() < capacity_;
+    });
+    if (closed_) return false;
+    queue_.push(std::move(e));
     condition_.notify_one();
     return true;
   }
@@ -58,9 +80,22 @@ class SafeQueue {
   void Pop(T& e) {
     std::unique_lock<std::mutex> lock(mutex_);
     condition_.wait(lock, [this]() { return !queue_.empty(); });
-    e = queue_.front();
-    queue_.pop();
+    PopFront(e);
   }
+
+  /**
+   * Pop an element from the queue; it blocks until one element is poped or
+   * the queue is closed.
+   * @return false if the queue is closed and empty.
+   */
+  bool WaitAndPop(T& e) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this]() { return closed_ || !queue_.empty(); });
+    if (queue_.empty()) return false;
+    PopFront(e);
+    return true;
+  }
+
   /**
    * Pop an item from the queue until one element is poped or timout.
    * @param[in] timeout, return false after waiting this number of microseconds
@@ -77,8 +112,7 @@ class SafeQueue {
         return false;
     }
 
-    item = queue_.front();
-    queue_.pop();
+    PopFront(item);
     return true;
   }
 
@@ -92,11 +126,20 @@ class SafeQueue {
     if (queue_.empty())
       return false;
 
-    e = queue_.front();
-    queue_.pop();
+    PopFront(e);
     return true;
   }
 
+  /**
+   * Reject further pushes and wake up all waiting threads. The elements
+   * already in the queue can still be poped.
+   */
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    condition_.notify_all();
+    not_full_.notify_all();
+  }
 
   /**
    * @return Number of elements in the queue.
@@ -107,9 +150,24 @@ class SafeQueue {
   }
 
  private:
+  // move the front element out, with the lock held
+  void PopFront(T& e) {
+    e = std::move(Front(queue_));
+    queue_.pop();
+    if (capacity_ > 0) not_full_.notify_one();
+  }
+  template <typename Q>
+  static auto Front(Q& q) -> decltype(q.front()) { return q.front(); }
+  // priority_queue only gives const access to its top
+  template <typename U, typename C, typename P>
+  static U Front(std::priority_queue<U, C, P>& q) { return q.top(); }
+
   Container queue_;
   mutable std::mutex mutex_;
   std::condition_variable condition_;
+  std::condition_variable not_full_;
+  size_t capacity_ = 0;
+  bool closed_ = false;
 };
 
 /**
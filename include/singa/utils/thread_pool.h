@@ -0,0 +1,88 @@
+/************************************************************
+*
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an
+* "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+* KIND, either express or implied.  See the License for the
+* specific language governing permissions and limitations
+* under the License.
+*
+*************************************************************/
+
+#ifndef SINGA_UTILS_THREAD_POOL_H_
+#define SINGA_UTILS_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace singa {
+
+/// A pool of worker threads with work stealing.
+///
+/// Every worker owns a task deque. A worker pops tasks from the back of its
+/// own deque and, when it is empty, steals from the front of the others.
+/// Tasks submitted by a worker go to its own deque (hence nested parallelism
+/// stays local unless other workers are idle); tasks submitted by other
+/// threads are distributed over the deques in round-robin.
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads);
+  /// Run the remaining tasks and join the workers.
+  ~ThreadPool();
+
+  /// Add a task which would be run by one worker.
+  void Submit(std::function<void()>&& task);
+
+  /// Run fn(b, e) over chunks [b, e) that cover [begin, end); each chunk has
+  /// at least 'grain' elements except the last one. The calling thread runs
+  /// chunks too and returns after all chunks are done.
+  void ParallelFor(size_t begin, size_t end, size_t grain,
+                   const std::function<void(size_t, size_t)>& fn);
+
+  int num_threads() const { return static_cast<int>(workers_.size()); }
+
+ private:
+  struct TaskQueue {
+    std::mutex mtx;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  /// Loop of each worker thread.
+  void Run(int worker);
+  /// Take one task from the own deque of 'worker' or steal one from others.
+  bool Take(int worker, std::function<void()>* task);
+
+ private:
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+  std::vector<std::thread> workers_;
+  /// num of tasks in all deques
+  std::atomic<size_t> num_tasks_;
+  std::atomic<unsigned> next_queue_;
+  bool stop_ = false;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+
+  /// The pool whose worker is the calling thread, and the worker index.
+  static thread_local ThreadPool* current_;
+  static thread_local int worker_;
+};
+
+}  // namespace singa
+
+#endif  // SINGA_UTILS_THREAD_POOL_H_
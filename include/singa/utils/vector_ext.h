@@ -0,0 +1,52 @@
+/************************************************************
+*
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an
+* "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+* KIND, either express or implied.  See the License for the
+* specific language governing permissions and limitations
+* under the License.
+*
+*************************************************************/
+
+#ifndef SINGA_UTILS_VECTOR_EXT_H_
+#define SINGA_UTILS_VECTOR_EXT_H_
+
+#include <cstdint>
+
+// GCC vector extensions (also supported by Clang) used by the Cpp kernels.
+// SINGA_VECTOR_EXT is defined if the vector types and their arithmetic are
+// available; SINGA_CONVERTVECTOR if __builtin_convertvector is, too.
+#if defined(__GNUC__)
+#define SINGA_VECTOR_EXT
+#endif
+
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 9)
+#define SINGA_CONVERTVECTOR
+#endif
+
+#ifdef SINGA_VECTOR_EXT
+namespace singa {
+// 16 bytes fit the SSE/NEON registers of the baseline ABI
+typedef float f32x4 __attribute__((vector_size(16)));
+typedef int32_t i32x4 __attribute__((vector_size(16)));
+typedef uint8_t u8x4 __attribute__((vector_size(4)));
+typedef float f32x8 __attribute__((vector_size(32)));
+typedef int32_t i32x8 __attribute__((vector_size(32)));
+typedef int8_t i8x8 __attribute__((vector_size(8)));
+typedef uint16_t u16x8 __attribute__((vector_size(16)));
+typedef uint32_t u32x8 __attribute__((vector_size(32)));
+}  // namespace singa
+#endif  // SINGA_VECTOR_EXT
+
+#endif  // SINGA_UTILS_VECTOR_EXT_H_
@@ -17,20 +17,50 @@
  */
 
 #include "singa/core/device.h"
+#include <cstring>
 
 namespace singa {
 
 std::shared_ptr<Device> defaultDevice=std::make_shared<CppCPU>();
 
-CppCPU::CppCPU() : Device(-1, 1) {
+CppCPU::CppCPU() : CppCPU(1) {}
+
+CppCPU::CppCPU(int num_executors)
+    : CppCPU(num_executors, std::make_shared<CppMemPool>()) {}
+
+CppCPU::CppCPU(int num_executors, std::shared_ptr<DeviceMemPool> pool)
+    : Device(-1, num_executors), pool_(pool) {
+  CHECK_GT(num_executors, 0);
+  CHECK(pool != nullptr);
   lang_ = kCpp;
 #ifdef USE_MKLDNN
   ctx_.engine = new mkldnn::engine(mkldnn::engine::cpu, 0);
 #endif //USE_MKLDNN
   //host_ = nullptr;
+  if (num_executors > 1) {
+    // the executor running an operation joins the pool workers on it
+    thread_pool_.reset(new ThreadPool(num_executors - 1));
+    ctx_.thread_pool = thread_pool_.get();
+    executor_ctx_.resize(num_executors - 1);
+    for (size_t i = 0; i < executor_ctx_.size(); i++) {
+      executor_ctx_[i].random_generator.seed(std::mt19937::default_seed + i + 1);
+      executor_ctx_[i].thread_pool = thread_pool_.get();
+#ifdef USE_MKLDNN
+      executor_ctx_[i].engine = ctx_.engine;
+#endif  // USE_MKLDNN
+    }
+    scheduler_.reset(new Scheduler(num_executors,
+        [this](function<void(Context*)>&& fn, int executor) {
+          DoExec(std::move(fn), executor);
+        }));
+  }
 }
 
 CppCPU::~CppCPU() {
+  // wait for pending operations before the context is released
+  scheduler_.reset();
+  vm_.reset();
+  thread_pool_.reset();
 #ifdef USE_MKLDNN
   delete(ctx_.engine);
 #endif //USE_MKLDNN
@@ -39,29 +69,40 @@ CppCPU::~CppCPU() {
 
 void CppCPU::SetRandSeed(unsigned seed) {
   ctx_.random_generator.seed(seed);
+  for (size_t i = 0; i < executor_ctx_.size(); i++)
+    executor_ctx_[i].random_generator.seed(seed + i + 1);
 }
 
+Context* CppCPU::context(int k) {
+  CHECK_LT(k, num_executors_);
+  return k == 0 ? &ctx_ : &executor_ctx_[k - 1];
+}
 
 void CppCPU::DoExec(function<void(Context*)>&& fn, int executor) {
-  CHECK_EQ(executor, 0);
-  fn(&ctx_);
+  fn(context(executor));
 }
 
 
+size_t CppCPU::GetAllocatedMem() {
+  auto ret = pool_->GetMemUsage();
+  return ret.second - ret.first;
+}
+
 void* CppCPU::Malloc(int size) {
-  if (size > 0) {
-    void *ptr = malloc(size);
-    memset(ptr, 0, size);
-    return ptr;
-  } else {
-    return nullptr;
-  }
+  void* ptr = nullptr;
+  if (size > 0)
+    pool_->Malloc(&ptr, size);
+  return ptr;
 }
 
 
 void CppCPU::Free(void* ptr) {
   if (ptr != nullptr)
-    free(ptr);
+    pool_->Free(ptr);
+}
+
+void CppCPU::Memset(void* ptr, int value, size_t size) {
+  memset(ptr, value, size);
 }
 
 
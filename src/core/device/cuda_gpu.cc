@@ -32,6 +32,7 @@ const cudaMemcpyKind copyKind[] = {cudaMemcpyHostToHost, cudaMemcpyHostToDevice,
                                    cudaMemcpyDeviceToDevice};
 
 CudaGPU::~CudaGPU() {
+  vm_.reset();
   if (ctx_.cublas_handle) CUBLAS_CHECK(cublasDestroy(ctx_.cublas_handle));
   if (ctx_.curand_generator)
     CURAND_CHECK(curandDestroyGenerator(ctx_.curand_generator));
@@ -108,8 +109,6 @@ void* CudaGPU::Malloc(int size) {
   if (size > 0) {
     CUDA_CHECK(cudaSetDevice(id_));
     pool_->Malloc((void**)&ptr, size);
-    // TODO(wangwei) remove the memset.
-    CUDA_CHECK(cudaMemset(ptr, 0, size));
   }
   return ptr;
 }
@@ -122,5 +121,10 @@ void CudaGPU::Free(void* ptr) {
   }
 }
 
+void CudaGPU::Memset(void* ptr, int value, size_t size) {
+  CUDA_CHECK(cudaSetDevice(id_));
+  CUDA_CHECK(cudaMemset(ptr, value, size));
+}
+
 }  // namespace singa
 #endif  // USE_CUDA
@@ -27,16 +27,20 @@ Device::Device(int id, int num_executors)
 
 void Device::Exec(function<void(Context*)>&& fn, const vector<Block*> read_blocks,
                     const vector<Block*> write_blocks, bool use_rand_generator) {
-  // TODO(wangwei) execute operations scheduled by the scheduler.
-  DoExec(std::move(fn), 0);
+  if (scheduler_ != nullptr)
+    scheduler_->Submit(std::move(fn), read_blocks, write_blocks,
+                       use_rand_generator);
+  else
+    DoExec(std::move(fn), 0);
 }
 
 // TODO(wangwei) get Block from the memory manager
-Block* Device::NewBlock(int size) {
+Block* Device::NewBlock(int size, bool zero) {
   CHECK_GE(size, 0) << "size is negative, could be caused by the type cast "
     << "from size_t to int. In that case, the size is too large.";
   if (size > 0) {
-    void* ptr = Malloc(size);
+    void* ptr = vm_ != nullptr ? vm_->Malloc(size) : Malloc(size);
+    if (zero) Memset(ptr, 0, size);
     return new Block(ptr, size);
   } else {
     return nullptr;
@@ -46,8 +50,43 @@ Block* Device::NewBlock(int size) {
 // TODO(wangwei) return Block to the memory manager
 void Device::FreeBlock(Block* block) {
   if (block != nullptr) {
-    Free(block->mutable_data());
-    delete block;
+    if (scheduler_ != nullptr) {
+      // release it after the pending operations on it are done
+      scheduler_->Submit([this, block](Context* ctx) {
+        ReleaseBlock(block);
+      }, {}, {block});
+    } else {
+      ReleaseBlock(block);
+    }
+  }
+}
+
+void Device::ReleaseBlock(Block* block) {
+  // external memory is released with its owner
+  if (!block->external()) {
+    if (vm_ != nullptr)
+      vm_->Free(block->mutable_data());
+    else
+      Free(block->mutable_data());
+  }
+  delete block;
+}
+
+void Device::EnableVirtualMemory() {
+  if (vm_ == nullptr)
+    vm_.reset(new VirtualMemory([this](size_t size) { return Malloc(size); },
+                                [this](void* ptr) { Free(ptr); }));
+}
+
+void Device::StartIteration() {
+  if (vm_ != nullptr) vm_->StartIteration();
+}
+
+void Device::EndIteration() {
+  if (vm_ != nullptr) {
+    // blocks are freed asynchronously by the scheduler
+    Sync();
+    vm_->EndIteration();
   }
 }
 
@@ -71,6 +110,12 @@ void Device::CopyDataFromHostPtr(Block* dst, const void* src, size_t nBytes,
   Exec([this, dstptr, src, nBytes,
         direct](Context* ctx) { CopyToFrom(dstptr, src, nBytes, direct, ctx); },
        {}, {dst});
+  // 'src' is owned by the caller, which may release it after this call.
+  Sync();
+}
+
+void Device::Sync() {
+  if (scheduler_ != nullptr)
+    scheduler_->Wait();
 }
-void Device::Sync() {}
 }  // namespace singa
@@ -49,6 +49,7 @@ OpenclDevice::OpenclDevice(int id, int num_executors)
 
 
 OpenclDevice::~OpenclDevice() {
+  vm_.reset();
 
   // Flush and finish the command queue.
   auto cmdq = ocl::current_context().get_queue();
@@ -147,6 +148,17 @@ void OpenclDevice::Free(void* p) {
   clReleaseMemObject(buffer);
 }
 
+
+void OpenclDevice::Memset(void* ptr, int value, size_t size) {
+  cl_uchar pattern = static_cast<cl_uchar>(value);
+  auto cmdq = ocl::current_context().get_queue();
+  cl_int err = clEnqueueFillBuffer(cmdq.handle().get(),
+                                   static_cast<cl_mem>(ptr), &pattern,
+                                   sizeof(pattern), 0, size, 0, nullptr,
+                                   nullptr);
+  CHECK_EQ(err, CL_SUCCESS) << "clEnqueueFillBuffer failed";
+}
+
 } // namespace singa
 
 #endif // USE_OPENCL
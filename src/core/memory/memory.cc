@@ -15,13 +15,15 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-#ifndef DISABLE_WARNINGS
-
 #include "singa/core/memory.h"
 #include "singa/utils/logging.h"
 #include "singa/proto/core.pb.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 
+#ifndef DISABLE_WARNINGS
+
 #ifdef USE_CUDA
 
 namespace singa {
@@ -113,3 +115,249 @@ void CudaMemPool::Free(void *ptr) {
 #endif
 
 #endif
+
+namespace singa {
+
+namespace {
+const int kNumShards = 16;
+/// alignment of the returned memory, which is also the header size for
+/// recording the size class.
+const size_t kAlign = 64;
+
+/// 64, 128, 192, 256, then four classes per power of two, e.g., 320, 384,
+/// 448, 512, 640, ...
+int SizeClass(size_t size) {
+  if (size <= 256) return size == 0 ? 0 : static_cast<int>((size - 1) / 64);
+  int p = 0;
+  while ((size - 1) >> (p + 1)) p++;
+  size_t step = size_t(1) << (p - 2);
+  return 4 + (p - 8) * 4 + static_cast<int>((size - 1 - (size_t(1) << p)) / step);
+}
+
+size_t ClassSize(int c) {
+  if (c < 4) return (c + 1) * 64;
+  int p = 8 + (c - 4) / 4, k = (c - 4) % 4;
+  return (size_t(1) << p) + (k + 1) * (size_t(1) << (p - 2));
+}
+}  // namespace
+
+CppMemPool::CppMemPool(size_t max_cache_size)
+    : shards_(kNumShards), max_cache_size_(max_cache_size), in_use_(0),
+      cached_(0) {}
+
+CppMemPool::~CppMemPool() {
+  ReleaseCache();
+}
+
+CppMemPool::Shard* CppMemPool::LocalShard() {
+  static std::atomic<unsigned> next_shard(0);
+  static thread_local unsigned shard = next_shard++;
+  return &shards_[shard % shards_.size()];
+}
+
+void* CppMemPool::Take(Shard* shard, int size_class) {
+  std::lock_guard<std::mutex> lock(shard->mtx);
+  if (static_cast<size_t>(size_class) >= shard->free_list.size()
+      || shard->free_list[size_class].empty())
+    return nullptr;
+  void* base = shard->free_list[size_class].back();
+  shard->free_list[size_class].pop_back();
+  return base;
+}
+
+void CppMemPool::Malloc(void** ptr, const size_t size) {
+  int c = SizeClass(size);
+  size_t nbytes = ClassSize(c);
+  Shard* local = LocalShard();
+  void* base = Take(local, c);
+  // fall back to the memory cached by other threads
+  for (size_t i = 0; base == nullptr && i < shards_.size(); i++)
+    if (&shards_[i] != local) base = Take(&shards_[i], c);
+  if (base != nullptr) {
+    cached_ -= nbytes;
+  } else {
+    CHECK_EQ(posix_memalign(&base, kAlign, nbytes + kAlign), 0)
+        << "Failed to allocate " << nbytes << " bytes";
+    *static_cast<int*>(base) = c;
+  }
+  in_use_ += nbytes;
+  *ptr = static_cast<char*>(base) + kAlign;
+}
+
+void CppMemPool::Free(void* ptr) {
+  if (ptr == nullptr) return;
+  void* base = static_cast<char*>(ptr) - kAlign;
+  int c = *static_cast<int*>(base);
+  size_t nbytes = ClassSize(c);
+  in_use_ -= nbytes;
+  if (max_cache_size_ > 0 && cached_ + nbytes > max_cache_size_) {
+    free(base);
+    return;
+  }
+  Shard* shard = LocalShard();
+  std::lock_guard<std::mutex> lock(shard->mtx);
+  if (shard->free_list.size() <= static_cast<size_t>(c))
+    shard->free_list.resize(c + 1);
+  shard->free_list[c].push_back(base);
+  cached_ += nbytes;
+}
+
+std::pair<size_t, size_t> CppMemPool::GetMemUsage() {
+  size_t cached = cached_;
+  return std::make_pair(cached, cached + in_use_);
+}
+
+void CppMemPool::ReleaseCache() {
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    for (size_t c = 0; c < shard.free_list.size(); c++) {
+      for (void* base : shard.free_list[c]) free(base);
+      cached_ -= ClassSize(c) * shard.free_list[c].size();
+      shard.free_list[c].clear();
+    }
+  }
+}
+
+}  // namespace singa
+
+namespace singa {
+
+namespace {
+/// blocks in the arena are aligned to this num of bytes
+const size_t kArenaAlign = 64;
+
+size_t AlignArena(size_t size) {
+  return (size + kArenaAlign - 1) / kArenaAlign * kArenaAlign;
+}
+}  // namespace
+
+VirtualMemory::VirtualMemory(MallocFn malloc, FreeFn free)
+    : malloc_(malloc), free_(free) {}
+
+VirtualMemory::~VirtualMemory() {
+  if (arena_ != nullptr) free_(arena_);
+}
+
+void* VirtualMemory::Malloc(size_t size) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (!in_iteration_) return malloc_(size);
+  if (recording_) {
+    void* ptr = malloc_(size);
+    Record rec;
+    rec.size = size;
+    rec.malloc_time = clock_++;
+    record_index_[ptr] = records_.size();
+    records_.push_back(rec);
+    return ptr;
+  }
+  size_t k = cursor_++;
+  if (k >= records_.size() || records_[k].size != size) {
+    stale_ = true;
+    return malloc_(size);
+  }
+  if (records_[k].offset < 0) return malloc_(size);
+  size_t begin = records_[k].offset, end = begin + size;
+  // the range may still be in use, e.g., a block is freed later than in the
+  // recorded iteration
+  auto it = live_.lower_bound(begin);
+  if ((it != live_.end() && it->first < end)
+      || (it != live_.begin() && std::prev(it)->second > begin))
+    return malloc_(size);
+  live_[begin] = end;
+  num_arena_allocs_++;
+  return arena_ + begin;
+}
+
+void VirtualMemory::Free(void* ptr) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  char* p = static_cast<char*>(ptr);
+  if (arena_ != nullptr && p >= arena_ && p < arena_ + arena_size_) {
+    live_.erase(p - arena_);
+    return;
+  }
+  auto it = record_index_.find(ptr);
+  if (it != record_index_.end()) {
+    records_[it->second].free_time = clock_++;
+    record_index_.erase(it);
+  }
+  free_(ptr);
+}
+
+void VirtualMemory::StartIteration() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  in_iteration_ = true;
+  stale_ = false;
+  cursor_ = 0;
+  num_arena_allocs_ = 0;
+  if (recording_) {
+    records_.clear();
+    record_index_.clear();
+    clock_ = 0;
+  }
+}
+
+void VirtualMemory::EndIteration() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  in_iteration_ = false;
+  if (recording_) {
+    // blocks alive after the iteration are not planned
+    record_index_.clear();
+    // the arena can only be replaced when none of its blocks is in use
+    if (live_.empty()) {
+      Plan();
+      recording_ = false;
+    }
+  } else if (stale_ || cursor_ != records_.size()) {
+    recording_ = true;
+  }
+}
+
+void VirtualMemory::Plan() {
+  std::vector<size_t> order;
+  for (size_t i = 0; i < records_.size(); i++)
+    if (records_[i].free_time >= 0) order.push_back(i);
+  // place large blocks first, each at the lowest offset that does not
+  // overlap the placed blocks whose lifetimes overlap with it
+  std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return records_[a].size > records_[b].size;
+  });
+  std::vector<size_t> placed;
+  size_t total = 0;
+  for (size_t i : order) {
+    Record& rec = records_[i];
+    size_t size = AlignArena(rec.size);
+    std::vector<std::pair<size_t, size_t>> busy;
+    for (size_t j : placed) {
+      const Record& other = records_[j];
+      if (rec.malloc_time < other.free_time && other.malloc_time < rec.free_time)
+        busy.push_back(std::make_pair(other.offset,
+                                      other.offset + AlignArena(other.size)));
+    }
+    std::sort(busy.begin(), busy.end());
+    size_t offset = 0;
+    for (auto& range : busy) {
+      if (offset + size <= range.first) break;
+      offset = std::max(offset, range.second);
+    }
+    rec.offset = offset;
+    placed.push_back(i);
+    total = std::max(total, offset + size);
+  }
+  if (total > arena_size_) {
+    if (arena_ != nullptr) free_(arena_);
+    arena_ = static_cast<char*>(malloc_(total));
+    arena_size_ = total;
+  }
+}
+
+size_t VirtualMemory::arena_size() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return arena_size_;
+}
+
+size_t VirtualMemory::num_arena_allocs() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return num_arena_allocs_;
+}
+
+}  // namespace singa
@@ -17,3 +17,144 @@
  */
 
 #include "singa/core/scheduler.h"
+#include <algorithm>
+
+namespace singa {
+
+thread_local Scheduler* Scheduler::current_ = nullptr;
+thread_local Scheduler::Operation* Scheduler::running_ = nullptr;
+
+Scheduler::Scheduler(int num_executors, ExecFn exec) : exec_(exec) {
+  CHECK_GT(num_executors, 0);
+  for (int i = 0; i < num_executors; i++)
+    executors_.push_back(std::thread(&Scheduler::Run, this, i));
+}
+
+Scheduler::~Scheduler() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  if (current_ == this) {
+    // The last reference to the owner (e.g., the device) was released by
+    // destroying the closure of the running operation. Finish that operation
+    // here so that its successors can proceed on other executors.
+    Done(running_);
+    running_ = nullptr;
+  }
+  done_cv_.wait(lock, [this]() { return num_pending_ == 0; });
+  stop_ = true;
+  ready_cv_.notify_all();
+  lock.unlock();
+  for (auto& t : executors_) {
+    if (t.get_id() == std::this_thread::get_id())
+      t.detach();
+    else
+      t.join();
+  }
+  if (current_ == this) current_ = nullptr;
+}
+
+void Scheduler::AddDependency(Operation* dep, Operation* op) {
+  // skip self-dependency and duplicates; 'op' is the latest operation, so a
+  // duplicate must be the last successor.
+  if (dep == op || (!dep->successors.empty() && dep->successors.back() == op))
+    return;
+  dep->successors.push_back(op);
+  op->num_deps++;
+}
+
+void Scheduler::Submit(function<void(Context*)>&& fn,
+                       const vector<Block*>& read_blocks,
+                       const vector<Block*>& write_blocks,
+                       bool use_rand_generator) {
+  Operation* op = new Operation();
+  op->fn = std::move(fn);
+  for (auto b : read_blocks)
+    if (b != nullptr) op->keys.push_back(b);
+  size_t num_reads = op->keys.size();
+  for (auto b : write_blocks)
+    if (b != nullptr) op->keys.push_back(b);
+  if (use_rand_generator) op->keys.push_back(&rand_key_);
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (size_t i = 0; i < op->keys.size(); i++) {
+    AccessRecord& rec = records_[op->keys[i]];
+    if (rec.writer != nullptr) AddDependency(rec.writer, op);
+    if (i >= num_reads)
+      for (auto r : rec.readers) AddDependency(r, op);
+  }
+  // writes are recorded after reads, hence a Block that is both read and
+  // written is recorded as written.
+  for (size_t i = 0; i < op->keys.size(); i++) {
+    AccessRecord& rec = records_[op->keys[i]];
+    if (i >= num_reads) {
+      rec.writer = op;
+      rec.readers.clear();
+    } else if (rec.readers.empty() || rec.readers.back() != op) {
+      rec.readers.push_back(op);
+    }
+  }
+  num_pending_++;
+  if (op->num_deps == 0) {
+    ready_.push_back(op);
+    ready_cv_.notify_one();
+  }
+}
+
+void Scheduler::Done(Operation* op) {
+  for (auto key : op->keys) {
+    auto it = records_.find(key);
+    if (it == records_.end()) continue;
+    AccessRecord& rec = it->second;
+    if (rec.writer == op) rec.writer = nullptr;
+    rec.readers.erase(std::remove(rec.readers.begin(), rec.readers.end(), op),
+                      rec.readers.end());
+    if (rec.writer == nullptr && rec.readers.empty()) records_.erase(it);
+  }
+  for (auto succ : op->successors) {
+    if (--succ->num_deps == 0) {
+      ready_.push_back(succ);
+      ready_cv_.notify_one();
+    }
+  }
+  delete op;
+  if (--num_pending_ == 0) done_cv_.notify_all();
+}
+
+void Scheduler::Wait() {
+  if (current_ == this) return;
+  std::unique_lock<std::mutex> lock(mtx_);
+  done_cv_.wait(lock, [this]() { return num_pending_ == 0; });
+}
+
+size_t Scheduler::num_pending() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return num_pending_;
+}
+
+void Scheduler::Run(int executor) {
+  current_ = this;
+  while (true) {
+    Operation* op = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      ready_cv_.wait(lock, [this]() { return stop_ || !ready_.empty(); });
+      if (ready_.empty()) break;
+      op = ready_.front();
+      ready_.pop_front();
+    }
+    running_ = op;
+    exec_(std::move(op->fn), executor);
+    {
+      // Release the captured objects (e.g., Tensors) outside of the lock, as
+      // it may free Blocks, i.e., submit new operations.
+      auto fn = std::move(op->fn);
+    }
+    // this scheduler has been destroyed while releasing the closure.
+    if (current_ != this) return;
+    running_ = nullptr;
+    std::lock_guard<std::mutex> lock(mtx_);
+    Done(op);
+  }
+  current_ = nullptr;
+}
+
+}  // namespace singa
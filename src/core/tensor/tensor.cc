@@ -16,6 +16,7 @@
  * limitations under the License.
  */
 #include "singa/core/tensor.h"
+#include "singa/utils/half.h"
 #include "singa/utils/stacktrace.h"
 #include "./tensor_math.h"
 #include "./tensor_math_cpp.h"
@@ -29,6 +30,17 @@
 
 namespace singa {
 
+namespace {
+/// A tensor for the result of an operation that writes all its elements,
+/// hence its memory is not zero-filled.
+Tensor NewOutput(const Shape &shape, std::shared_ptr<Device> dev,
+                 DataType dtype) {
+  size_t size = Product(shape) * SizeOf(dtype);
+  if (size == 0) return Tensor(shape, dev, dtype);
+  return Tensor(dev->NewBlock((int)size), shape, dev, dtype);
+}
+}  // namespace
+
 Tensor::~Tensor() {
   if (block_ != nullptr && block_->DecRefCount() == 0)
     device_->FreeBlock(block_);
@@ -45,7 +57,7 @@ Tensor::Tensor(const Shape &shape, DataType dtype)
   : data_type_(dtype), device_(defaultDevice), shape_(shape) {
   size_t size = Product(shape_) * SizeOf(data_type_);
   if (size)
-    block_ = device_->NewBlock((int)size);
+    block_ = device_->NewBlock((int)size, true);
   generate_stride();
 }
 
@@ -56,10 +68,19 @@ Tensor::Tensor(const Shape &shape, std::shared_ptr<Device> device,
   : data_type_(dtype), device_(device), shape_(shape) {
   size_t size = Product(shape_) * SizeOf(data_type_);
   if (size)
-    block_ = device_->NewBlock((int)size);
+    block_ = device_->NewBlock((int)size, true);
   generate_stride();
 }
 
+Tensor::Tensor(Block *block, const Shape &shape, std::shared_ptr<Device> device,
+               DataType dtype, const vector<int> &stride)
+  : data_type_(dtype), device_(device), block_(block), shape_(shape),
+    stride_(stride) {
+  CHECK(block_ != nullptr);
+  CHECK_EQ(block_->size(), Product(shape_) * SizeOf(data_type_));
+  if (stride_.empty()) generate_stride();
+}
+
 
 Tensor::Tensor(const Tensor &in) : data_type_(in.data_type_),
   device_(in.device_),  block_(in.block()),  shape_(in.shape_),
@@ -83,7 +104,7 @@ Tensor& Tensor::ResetLike(const Tensor &in) {
       device_->FreeBlock(block_);
     device_ = in.device_;
     data_type_ = in.data_type_;
-    block_ = device_->NewBlock((int)in.MemSize());
+    block_ = device_->NewBlock((int)in.MemSize(), true);
   }
   shape_ = in.shape_;
   stride_ = in.stride_;
@@ -94,7 +115,8 @@ Tensor& Tensor::Resize(const Shape& shape) {
   if (Size() != Product(shape)) {
     if (block_ != nullptr && block_->DecRefCount() == 0)
       device_->FreeBlock(block_);
-    block_ = device_->NewBlock((int)(Product(shape) * SizeOf(data_type_)));
+    block_ = device_->NewBlock((int)(Product(shape) * SizeOf(data_type_)),
+                               true);
   }
   shape_ = shape;
   generate_stride();
@@ -108,19 +130,11 @@ Tensor Resize(const Tensor& in, const Shape& shape) {
 }
 
 
-Tensor& Tensor::AsType(const DataType type) {
-  if (data_type_ != type) {
-    if (block_ != nullptr && block_->DecRefCount() == 0)
-      device_->FreeBlock(block_);
-    block_ = device_->NewBlock((int)(Product(shape_) * SizeOf(type)));
-    data_type_ = type;
-  }
-  return *this;
-}
-
 Tensor& Tensor::ToDevice(std::shared_ptr<Device> dst) {
   // TODO(wangwei) the comparison is restricted. May compare against device ID?
   if (device_ != dst) {
+    // the block is initialized by pending operations
+    device_->Sync();
     Tensor tmp(shape_, dst, data_type_);
     if (block_ != nullptr && Size() && block_->initialized())
       tmp.CopyData(*this);
@@ -158,6 +172,10 @@ template void Tensor::CopyDataFromHostPtr(const float *src, const size_t num,
     const size_t offset);
 template void Tensor::CopyDataFromHostPtr(const int *src, const size_t num,
     const size_t offset);
+template void Tensor::CopyDataFromHostPtr(const double *src, const size_t num,
+    const size_t offset);
+template void Tensor::CopyDataFromHostPtr(const half *src, const size_t num,
+    const size_t offset);
 
 void Tensor::CopyData(const Tensor &src) {
   CHECK_EQ(Size(), src.Size());
@@ -446,13 +464,15 @@ GenUnaryTensorArgMemberFn(operator-=, Sub);
 GenUnaryTensorArgMemberFn(operator*=, EltwiseMult);
 GenUnaryTensorArgMemberFn(operator/=, Div);
 
-#define GenUnaryScalarArgMemberFn(op, fn) \
-  template <typename DType>               \
-  Tensor &Tensor::op(const DType x) {     \
-    fn(*this, x, this);                   \
-    return *this;                         \
-  }                                       \
-  template Tensor &Tensor::op<float>(const float x)
+#define GenUnaryScalarArgMemberFn(op, fn)              \
+  template <typename DType>                            \
+  Tensor &Tensor::op(const DType x) {                  \
+    fn(*this, x, this);                                \
+    return *this;                                      \
+  }                                                    \
+  template Tensor &Tensor::op<float>(const float x);   \
+  template Tensor &Tensor::op<double>(const double x); \
+  template Tensor &Tensor::op<int>(const int x)
 
 GenUnaryScalarArgMemberFn(operator-=, Sub);
 GenUnaryScalarArgMemberFn(operator+=, Add);
@@ -564,7 +584,7 @@ void RepeatDataToFrom(bool broadcast_flag, const vector<size_t>& repeats, int ax
         break;                                                      \
       }                                                             \
       case kChar: {                                                 \
-        typedef char DType;                                         \
+        typedef int8_t DType;                                       \
         { __VA_ARGS__ }                                             \
         break;                                                      \
       }                                                             \
@@ -573,6 +593,21 @@ void RepeatDataToFrom(bool broadcast_flag, const vector<size_t>& repeats, int ax
         { __VA_ARGS__ }                                             \
         break;                                                      \
       }                                                             \
+      case kFloat16: {                                              \
+        typedef half DType;                                         \
+        { __VA_ARGS__ }                                             \
+        break;                                                      \
+      }                                                             \
+      case kBFloat16: {                                             \
+        typedef bfloat16 DType;                                     \
+        { __VA_ARGS__ }                                             \
+        break;                                                      \
+      }                                                             \
+      case kUChar: {                                                \
+        typedef unsigned char DType;                                \
+        { __VA_ARGS__ }                                             \
+        break;                                                      \
+      }                                                             \
       default:                                                      \
         LOG(FATAL) << "Unknow data type = " << DataType_Name(type); \
     }                                                               \
@@ -605,6 +640,24 @@ void RepeatDataToFrom(bool broadcast_flag, const vector<size_t>& repeats, int ax
         { __VA_ARGS__ }                                        \
         break;                                                 \
       }                                                        \
+      case ((kDouble << _SwitchShift) + kCpp): {               \
+        typedef double DType;                                  \
+        typedef lang::Cpp Lang;                                \
+        { __VA_ARGS__ }                                        \
+        break;                                                 \
+      }                                                        \
+      case ((kInt << _SwitchShift) + kCpp): {                  \
+        typedef int DType;                                     \
+        typedef lang::Cpp Lang;                                \
+        { __VA_ARGS__ }                                        \
+        break;                                                 \
+      }                                                        \
+      case ((kFloat16 << _SwitchShift) + kCpp): {              \
+        typedef half DType;                                    \
+        typedef lang::Cpp Lang;                                \
+        { __VA_ARGS__ }                                        \
+        break;                                                 \
+      }                                                        \
       default:                                                 \
         LOG(FATAL) << "Unknown combination of data type "      \
                    << DataType_Name(dtype) << " and language " \
@@ -612,6 +665,57 @@ void RepeatDataToFrom(bool broadcast_flag, const vector<size_t>& repeats, int ax
     }                                                          \
   } while (0)
 
+Tensor& Tensor::AsType(const DataType type) {
+  if (data_type_ != type) {
+    if (block_ == nullptr || Size() == 0) {
+      *this = Tensor(shape_, device_, type);
+    } else if (device_->lang() == kCpp) {
+      // ordered after the pending operations on the block by Exec(); a block
+      // that is not initialized by them is not converted
+      Tensor in(*this), ret = NewOutput(shape_, device_, type);
+      TYPE_SWITCH(data_type_, SrcType, {
+        TYPE_SWITCH(type, DType, {
+          device_->Exec([in, ret](Context * ctx) mutable {
+            if (in.block()->initialized())
+              cpp::Cast<SrcType, DType>(in, &ret, ctx);
+          }, {block_}, {ret.block()});
+        });
+      });
+      *this = std::move(ret);
+    } else {
+      // convert on the host
+      auto dev = device_;
+      ToHost().AsType(type).ToDevice(dev);
+    }
+  }
+  return *this;
+}
+
+Tensor Quantize(const Tensor &in, const float scale) {
+  CHECK_EQ(in.data_type(), kFloat32);
+  CHECK_GT(scale, 0.f);
+  Tensor out(in.shape(), in.device(), kChar);
+  TYPE_LANG_SWITCH(in.data_type(), DType, in.device()->lang(), Lang, {
+    Tensor t(out);
+    in.device()->Exec([in, t, scale](Context * ctx) mutable {
+      Quantize<DType, Lang>(in, scale, &t, ctx);
+    }, {in.block()}, {out.block()});
+  });
+  return out;
+}
+
+Tensor Dequantize(const Tensor &in, const float scale) {
+  CHECK_EQ(in.data_type(), kChar);
+  Tensor out(in.shape(), in.device(), kFloat32);
+  TYPE_LANG_SWITCH(out.data_type(), DType, in.device()->lang(), Lang, {
+    Tensor t(out);
+    in.device()->Exec([in, t, scale](Context * ctx) mutable {
+      Dequantize<DType, Lang>(in, scale, &t, ctx);
+    }, {in.block()}, {out.block()});
+  });
+  return out;
+}
+
 // =============Element-wise operations====================================
 float Tensor::L1() const {
   float nrm = 0.0f;
@@ -622,6 +726,7 @@ float Tensor::L1() const {
       nrm = TypeCast<DType, float>(ret);
     }, {this->block()}, {});
   });
+  device_->Sync();
   return nrm / Size();
 }
 
@@ -635,37 +740,40 @@ float Tensor::L2() const {
       nrm = TypeCast<DType, float>(ret);
     }, {this->block()}, {});
   });
+  device_->Sync();
   return nrm / Size();
 }
 
 template <typename SType>
 void Tensor::SetValue(const SType x) {
-  CHECK_EQ(sizeof(SType), SizeOf(data_type_));
   //auto size = Size();
   auto ptr = block_;
 
   TYPE_LANG_SWITCH(data_type_, DType, device_->lang(), Lang, {
-    // TODO(wangwei) cast x to DType
-    device_->Exec([this, x, ptr](Context * ctx) {
-      Set<DType, Lang>(x, this, ctx);
+    DType y = TypeCast<SType, DType>(x);
+    Tensor t(*this);
+    device_->Exec([t, y](Context * ctx) mutable {
+      Set<DType, Lang>(y, &t, ctx);
     }, {}, {ptr});
   });
 }
 template void Tensor::SetValue<float>(const float x);
+template void Tensor::SetValue<double>(const double x);
 template void Tensor::SetValue<int>(const int x);
 
 #define EltwiseUnaryTensorFn(fn, t, ret)                               \
   do {                                                                 \
     TYPE_LANG_SWITCH(t.data_type(), DType, t.device()->lang(), Lang, { \
-      ret->device()->Exec([t, ret](Context * ctx) {                    \
-        fn<DType, Lang>(t, ret, ctx);       \
+      Tensor _ret(*ret);                                               \
+      ret->device()->Exec([t, _ret](Context * ctx) mutable {           \
+        fn<DType, Lang>(t, &_ret, ctx);                                \
       }, {t.block()}, {ret->block()});                                 \
     });                                                                \
   } while (0)
 
 #define GenUnaryTensorFn(fn)                             \
   Tensor fn(const Tensor &in) {                          \
-    Tensor ret(in.shape(), in.device(), in.data_type()); \
+    Tensor ret = NewOutput(in.shape(), in.device(), in.data_type()); \
     auto *retptr = &ret;                                 \
     EltwiseUnaryTensorFn(fn, in, retptr);                \
     return ret;                                          \
@@ -687,9 +795,9 @@ GenUnaryTensorFn(Transform);
   do {                                                                      \
     TYPE_LANG_SWITCH(lhs.data_type(), DType, lhs.device()->lang(), Lang, {  \
       CHECK_EQ(sizeof(DType), SizeOf(rhs.data_type()));                     \
-      ret->device()->Exec([lhs, rhs, ret](Context * ctx) {                  \
-        fn<DType, Lang>(lhs, rhs, ret, \
-                        ctx);                                               \
+      Tensor _ret(*ret);                                                    \
+      ret->device()->Exec([lhs, rhs, _ret](Context * ctx) mutable {         \
+        fn<DType, Lang>(lhs, rhs, &_ret, ctx);                              \
       }, {lhs.block(), rhs.block()}, {ret->block()});                       \
     });                                                                     \
   } while (0)
@@ -699,11 +807,11 @@ GenUnaryTensorFn(Transform);
     if (lhs.shape() != rhs.shape()) {                          \
       auto lhs_ = Broadcast(lhs, rhs.shape());                 \
       auto rhs_ = Broadcast(rhs, lhs.shape());                 \
-      Tensor ret(lhs_.shape(), lhs.device(), lhs.data_type()); \
+      Tensor ret = NewOutput(lhs_.shape(), lhs.device(), lhs.data_type()); \
       fn(lhs_, rhs_, &ret);                                      \
       return ret;                                              \
     } else {                                                   \
-      Tensor ret(lhs.shape(), lhs.device(), lhs.data_type());  \
+      Tensor ret = NewOutput(lhs.shape(), lhs.device(), lhs.data_type()); \
       fn(lhs, rhs, &ret);                                      \
       return ret;                                              \
     }                                                          \
@@ -736,27 +844,31 @@ GenBinaryTensorFn(operator>=, GE);
 #define EltwiseTensorScalarFn(fn, t, x, ret)                            \
   do {                                                                  \
     TYPE_LANG_SWITCH(t.data_type(), DType, t.device()->lang(), Lang, {  \
-      static_assert(std::is_same<SType, DType>::value,                  \
-                    "The Scalar type must match the Tensor data type"); \
-      ret->device()->Exec([t, x, ret](Context * ctx) {                  \
-        fn<DType, Lang>(t, x, ret, ctx);     \
+      DType _x = TypeCast<SType, DType>(x);                             \
+      Tensor _ret(*ret);                                                \
+      ret->device()->Exec([t, _x, _ret](Context * ctx) mutable {        \
+        fn<DType, Lang>(t, _x, &_ret, ctx);                             \
       }, {t.block()}, {ret->block()});                                  \
     });                                                                 \
   } while (0)
 
-#define GenTensorScalarFn(op, fn)                             \
-  template <typename SType>                                   \
-  Tensor op(const Tensor &in, const SType x) {                \
-    Tensor ret(in.shape(), in.device(), in.data_type());      \
-    fn(in, x, &ret);                                          \
-    return ret;                                               \
-  }                                                           \
-  template <typename SType>                                   \
-  void fn(const Tensor &in, const SType x, Tensor *ret) {     \
-    EltwiseTensorScalarFn(fn, in, x, ret);                    \
-  }                                                           \
-  template Tensor op <float>(const Tensor &in, const float x); \
-  template void fn<float>(const Tensor &in, const float x, Tensor *ret)
+#define GenTensorScalarFn(op, fn)                                           \
+  template <typename SType>                                                 \
+  Tensor op(const Tensor &in, const SType x) {                              \
+    Tensor ret = NewOutput(in.shape(), in.device(), in.data_type());        \
+    fn(in, x, &ret);                                                        \
+    return ret;                                                             \
+  }                                                                         \
+  template <typename SType>                                                 \
+  void fn(const Tensor &in, const SType x, Tensor *ret) {                   \
+    EltwiseTensorScalarFn(fn, in, x, ret);                                  \
+  }                                                                         \
+  template Tensor op <float>(const Tensor &in, const float x);              \
+  template void fn<float>(const Tensor &in, const float x, Tensor *ret);    \
+  template Tensor op <double>(const Tensor &in, const double x);            \
+  template void fn<double>(const Tensor &in, const double x, Tensor *ret);  \
+  template Tensor op <int>(const Tensor &in, const int x);                  \
+  template void fn<int>(const Tensor &in, const int x, Tensor *ret)
 
 GenTensorScalarFn(operator+, Add);
 GenTensorScalarFn(operator-, Sub);
@@ -780,9 +892,10 @@ void Div(const SType alpha, const Tensor &in, Tensor *out) {
   CheckDataTypeAndLang(in, *out);
   CHECK(in.shape() == out->shape());
   TYPE_LANG_SWITCH(in.data_type(), DType, in.device()->lang(), Lang, {
-    // TODO(wangwei) type cast SType to DType;
-    in.device()->Exec([alpha, in, out](Context * ctx) {
-      Div<DType, Lang>(alpha, in, out, ctx);
+    DType x = TypeCast<SType, DType>(alpha);
+    Tensor t(*out);
+    in.device()->Exec([x, in, t](Context * ctx) mutable {
+      Div<DType, Lang>(x, in, &t, ctx);
     }, {in.block()}, {out->block()});
   });
 }
@@ -790,39 +903,24 @@ template void Div<float>(const float, const Tensor &, Tensor *);
 
 // =============Matrix operations============================================
 Tensor Average(const Tensor &M, int axis) {
-  // operator/ only has implementation for float scalar type, hence it is
-  // necessary to cast the denominator to a float.
-  // TODO(wangwei) implement function for cast scalar type involved in Tensor
-  // functions. E.g.,
-  // template<S, D>
-  // D CastTo(S x) {
-  //   return D(x);
-  // }
-  // for speical types, e.g., fp16:
-  // tempalte<>
-  // fp16 CastType(float x) {
-  //    ....
-  // }
-  if (axis == 0) {
-    return Sum(M, 0) / (1.0f * M.shape(0));
-  } else {
-    CHECK_EQ(axis, 1);
-    return Sum(M, 1) / (1.0f * M.shape(1));
-  }
+  // scale the sum in place instead of allocating the quotient
+  CHECK(axis == 0 || axis == 1) << "Not support Average over axis = " << axis;
+  Tensor out = Sum(M, axis);
+  out *= 1.0f / M.shape(axis);
+  return out;
 }
-// TODO(wangwei) conside async exec
+
 template <>
 float Sum<float>(const Tensor &in) {
   float s = 0.0f;
-  Tensor one(in.shape(), in.device(), in.data_type());
-  one.SetValue(1.0f);
   TYPE_LANG_SWITCH(in.data_type(), DType, in.device()->lang(), Lang, {
-    one.device()->Exec([in, one, &s](Context * ctx) {
+    in.device()->Exec([in, &s](Context * ctx) {
       DType ret = DType(0);
-      Dot<DType, Lang>(in, one, &ret, ctx);
-      s = ret;
-    }, {in.block(), one.block()}, {});
+      Sum<DType, Lang>(in, &ret, ctx);
+      s = TypeCast<DType, float>(ret);
+    }, {in.block()}, {});
   });
+  in.device()->Sync();
   return s;
 }
 
@@ -848,7 +946,7 @@ Tensor SoftMax(const Tensor &in) {
 Tensor RowMax(const Tensor &in) {
   Tensor ret({in.shape(0)}, in.device(), in.data_type());
   TYPE_LANG_SWITCH(in.data_type(), DType, in.device()->lang(), Lang, {
-    in.device()->Exec([&in, &ret](Context * ctx) {
+    in.device()->Exec([in, ret](Context * ctx) mutable {
       //size_t nrow = 1;
       //if (in.nDim() > 1) nrow = in.shape(0);
       //size_t ncol = in.Size() / nrow;
@@ -1088,9 +1186,9 @@ void MultColumn(const Tensor &v, Tensor *M) {
   CHECK_EQ(v.Size(), M->shape(0));
   CheckDataTypeAndLang(*M, v);
   TYPE_LANG_SWITCH(v.data_type(), DType, v.device()->lang(), Lang, {
-    v.device()->Exec([M, v](Context * ctx) {
-      DGMM<DType, Lang>(false, *M, v,
-      M, ctx);
+    Tensor t(*M);
+    v.device()->Exec([t, v](Context * ctx) mutable {
+      DGMM<DType, Lang>(false, t, v, &t, ctx);
     }, {M->block(), v.block()}, {M->block()});
   });
 }
@@ -1103,9 +1201,9 @@ void MultRow(const Tensor &v, Tensor *M) {
   CHECK_EQ(v.Size(), M->shape(1));
   CheckDataTypeAndLang(*M, v);
   TYPE_LANG_SWITCH(v.data_type(), DType, v.device()->lang(), Lang, {
-    v.device()->Exec([M, v](Context * ctx) {
-      DGMM<DType, Lang>(true, *M, v,
-      M, ctx);
+    Tensor t(*M);
+    v.device()->Exec([t, v](Context * ctx) mutable {
+      DGMM<DType, Lang>(true, t, v, &t, ctx);
     }, {M->block(), v.block()}, {M->block()});
   });
 }
@@ -1115,7 +1213,16 @@ void SubColumn(const Tensor &v, Tensor *M) { AddColumn(-1, 1, v, M); }
 void SubRow(const Tensor &v, Tensor *M) { AddRow(-1, 1, v, M); }
 
 void SumColumns(const Tensor &M, Tensor *v) {
-  if (M.transpose()) {
+  if (M.device()->lang() == kCpp) {
+    CHECK_EQ(M.nDim(), 2u);
+    CHECK_EQ(M.shape(0), v->Size());
+    TYPE_LANG_SWITCH(M.data_type(), DType, M.device()->lang(), Lang, {
+      Tensor t(*v);
+      M.device()->Exec([M, t](Context * ctx) mutable {
+        SumColumns<DType, Lang>(M, &t, ctx);
+      }, {M.block()}, {v->block()});
+    });
+  } else if (M.transpose()) {
     Tensor X = Transpose(M);
     SumRows(X, v);
   } else {
@@ -1130,7 +1237,16 @@ void SumColumns(const Tensor &M, Tensor *v) {
   }
 }
 void SumRows(const Tensor &M, Tensor *v) {
-  if (M.transpose()) {
+  if (M.device()->lang() == kCpp) {
+    CHECK_EQ(M.nDim(), 2u);
+    CHECK_EQ(M.shape(1), v->Size());
+    TYPE_LANG_SWITCH(M.data_type(), DType, M.device()->lang(), Lang, {
+      Tensor t(*v);
+      M.device()->Exec([M, t](Context * ctx) mutable {
+        SumRows<DType, Lang>(M, &t, ctx);
+      }, {M.block()}, {v->block()});
+    });
+  } else if (M.transpose()) {
     Tensor X = Transpose(M);
     SumColumns(X, v);
   } else {
@@ -1150,8 +1266,9 @@ template <typename SType>
 void Bernoulli(const SType p, Tensor *out) {
   TYPE_LANG_SWITCH(out->data_type(), DType, out->device()->lang(), Lang, {
     auto prob = TypeCast<SType, DType>(p);
-    out->device()->Exec([prob, out](Context * ctx) {
-      Bernoulli<DType, Lang>(prob, out, ctx);
+    Tensor t(*out);
+    out->device()->Exec([prob, t](Context * ctx) mutable {
+      Bernoulli<DType, Lang>(prob, &t, ctx);
     }, {}, {out->block()}, true);
   });
 }
@@ -1163,8 +1280,9 @@ void Uniform(const SType low, const SType high, Tensor *out) {
   TYPE_LANG_SWITCH(out->data_type(), DType, out->device()->lang(), Lang, {
     auto l = TypeCast<SType, DType>(low);
     auto h = TypeCast<SType, DType>(high);
-    out->device()->Exec([l, h, out](Context * ctx) {
-      Uniform<DType, Lang>(l, h, out, ctx);
+    Tensor t(*out);
+    out->device()->Exec([l, h, t](Context * ctx) mutable {
+      Uniform<DType, Lang>(l, h, &t, ctx);
     }, {}, {out->block()}, true);
   });
 }
@@ -1176,8 +1294,9 @@ void Gaussian(const SType mean, const SType std, Tensor *out) {
   TYPE_LANG_SWITCH(out->data_type(), DType, out->device()->lang(), Lang, {
     auto m = TypeCast<SType, DType>(mean);
     auto s = TypeCast<SType, DType>(std);
-    out->device()->Exec([m, s, out](Context * ctx) {
-      Gaussian<DType, Lang>(m, s, out, ctx);
+    Tensor t(*out);
+    out->device()->Exec([m, s, t](Context * ctx) mutable {
+      Gaussian<DType, Lang>(m, s, &t, ctx);
     }, {}, {out->block()}, true);
   });
 }
@@ -1189,8 +1308,9 @@ template <typename SType>
 void Axpy(const SType alpha, const Tensor &in, Tensor *out) {
   TYPE_LANG_SWITCH(in.data_type(), DType, in.device()->lang(), Lang, {
     auto a = TypeCast<SType, DType>(alpha);
-    out->device()->Exec([a, in, out](Context * ctx) {
-      Axpy<DType, Lang>(a, in, out, ctx);
+    Tensor t(*out);
+    out->device()->Exec([a, in, t](Context * ctx) mutable {
+      Axpy<DType, Lang>(a, in, &t, ctx);
     }, {in.block(), out->block()}, {out->block()});
   });
 }
@@ -1219,8 +1339,9 @@ void Mult(const SType alpha, const Tensor &A, const Tensor &B, const SType beta,
     TYPE_LANG_SWITCH(A.data_type(), DType, A.device()->lang(), Lang, {
       auto a = TypeCast<SType, DType>(alpha);
       auto b = TypeCast<SType, DType>(beta);
-      C->device()->Exec([a, A, b, B, C](Context * ctx) {
-        GEMV<DType, Lang>(a, A, B, b, C, ctx);
+      Tensor t(*C);
+      C->device()->Exec([a, A, b, B, t](Context * ctx) mutable {
+        GEMV<DType, Lang>(a, A, B, b, &t, ctx);
       }, {A.block(), B.block()}, {C->block()});
     });
   } else {
@@ -1228,9 +1349,9 @@ void Mult(const SType alpha, const Tensor &A, const Tensor &B, const SType beta,
     TYPE_LANG_SWITCH(A.data_type(), DType, A.device()->lang(), Lang, {
       auto a = TypeCast<SType, DType>(alpha);
       auto b = TypeCast<SType, DType>(beta);
-      C->device()->Exec([a, A, b, B, C](Context * ctx) {
-        GEMM<DType, Lang>(a, A, B, b, C,
-        ctx);
+      Tensor t(*C);
+      C->device()->Exec([a, A, b, B, t](Context * ctx) mutable {
+        GEMM<DType, Lang>(a, A, B, b, &t, ctx);
       }, {A.block(), B.block()}, {C->block()});
     });
   }
@@ -1258,10 +1379,11 @@ void ComputeCrossEntropy(const Tensor &p, const Tensor &t, Tensor *loss) {
   if (p.nDim() == 2u) batchsize = p.shape(0);
   size_t dim = p.Size() / batchsize;
   TYPE_LANG_SWITCH(p.data_type(), DType, p.device()->lang(), Lang, {
-    p.device()->Exec([batchsize, dim, t, p, loss](Context * ctx) {
+    Block* lblock = loss->block();
+    p.device()->Exec([batchsize, dim, t, p, lblock](Context * ctx) {
       bool int_target = t.Size() == batchsize;
       ComputeCrossEntropy<DType, Lang>(int_target, batchsize, dim, p.block(),
-      t.block(), loss->block(), ctx);
+      t.block(), lblock, ctx);
     }, {p.block(), t.block()}, {loss->block()});
   });
 }
@@ -1273,10 +1395,11 @@ void SoftmaxCrossEntropyBwd(const Tensor &t, Tensor *p) {
   if (p->nDim() == 2u) batchsize = p->shape(0);
   size_t dim = p->Size() / batchsize;
   TYPE_LANG_SWITCH(p->data_type(), DType, p->device()->lang(), Lang, {
-    p->device()->Exec([batchsize, dim, t, p](Context * ctx) {
+    Block* pblock = p->block();
+    p->device()->Exec([batchsize, dim, t, pblock](Context * ctx) {
       bool int_target = t.Size() == batchsize;
       SoftmaxCrossEntropyBwd<DType, Lang>(int_target, batchsize, dim,
-      p->block(), t.block(), p->block(), ctx);
+      pblock, t.block(), pblock, ctx);
     }, {p->block(), t.block()}, {p->block()});
   });
 }
@@ -0,0 +1,489 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "singa/core/tensor_expr.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace singa {
+
+struct TensorExpr::Node {
+  ExprOp op;
+  Shape shape;
+  /// for kLeaf
+  Tensor tensor;
+  /// for kScalar
+  float scalar = 0.f;
+  std::shared_ptr<Node> lhs, rhs;
+};
+
+namespace {
+/// num of elements processed by each op of the fused loop at a time
+const size_t kBlockSize = 256;
+/// num of elements per task of the thread pool
+const size_t kGrain = 1 << 15;
+
+template <ExprOp op>
+inline float Eval(float a, float b);
+
+#define DEFINE_EXPR_OP(op, expr)                               \
+  template <>                                                  \
+  inline float Eval<ExprOp::op>(float a, float b) { return expr; }
+
+DEFINE_EXPR_OP(kAbs, std::fabs(a))
+DEFINE_EXPR_OP(kExp, std::exp(a))
+DEFINE_EXPR_OP(kLog, std::log(a))
+DEFINE_EXPR_OP(kReLU, a >= 0.f ? a : 0.f)
+DEFINE_EXPR_OP(kSigmoid, 1.f / (1.f + std::exp(-a)))
+DEFINE_EXPR_OP(kSign, static_cast<float>((a > 0.f) - (a < 0.f)))
+DEFINE_EXPR_OP(kSqrt, std::sqrt(a))
+DEFINE_EXPR_OP(kSquare, a * a)
+DEFINE_EXPR_OP(kTanh, std::tanh(a))
+DEFINE_EXPR_OP(kAdd, a + b)
+DEFINE_EXPR_OP(kSub, a - b)
+DEFINE_EXPR_OP(kMult, a * b)
+DEFINE_EXPR_OP(kDiv, a / b)
+DEFINE_EXPR_OP(kPow, std::pow(a, b))
+DEFINE_EXPR_OP(kLT, a < b ? 1.f : 0.f)
+DEFINE_EXPR_OP(kLE, a <= b ? 1.f : 0.f)
+DEFINE_EXPR_OP(kGT, a > b ? 1.f : 0.f)
+DEFINE_EXPR_OP(kGE, a >= b ? 1.f : 0.f)
+#undef DEFINE_EXPR_OP
+
+/// Apply 'op' over one block of registers. The trip count is constant and
+/// the registers do not overlap, which lets the compiler vectorize the loop.
+template <ExprOp op>
+void EvalBlock(const float* __restrict__ a, const float* __restrict__ b,
+               float* __restrict__ dst) {
+  for (size_t i = 0; i < kBlockSize; i++) dst[i] = Eval<op>(a[i], b[i]);
+}
+
+typedef void (*BlockFn)(const float*, const float*, float*);
+
+#define EXPR_OP_CASES(MACRO)                                              \
+  MACRO(kAbs) MACRO(kExp) MACRO(kLog) MACRO(kReLU) MACRO(kSigmoid)        \
+  MACRO(kSign) MACRO(kSqrt) MACRO(kSquare) MACRO(kTanh) MACRO(kAdd)       \
+  MACRO(kSub) MACRO(kMult) MACRO(kDiv) MACRO(kPow) MACRO(kLT) MACRO(kLE)  \
+  MACRO(kGT) MACRO(kGE)
+
+BlockFn GetBlockFn(ExprOp op) {
+  switch (op) {
+#define BLOCK_FN_CASE(op) \
+    case ExprOp::op: return EvalBlock<ExprOp::op>;
+    EXPR_OP_CASES(BLOCK_FN_CASE)
+#undef BLOCK_FN_CASE
+    default:
+      LOG(FATAL) << "Not an operator: " << static_cast<int>(op);
+  }
+  return nullptr;
+}
+
+float EvalScalar(ExprOp op, float a, float b) {
+  switch (op) {
+#define SCALAR_CASE(op) \
+    case ExprOp::op: return Eval<ExprOp::op>(a, b);
+    EXPR_OP_CASES(SCALAR_CASE)
+#undef SCALAR_CASE
+    default:
+      LOG(FATAL) << "Not an operator: " << static_cast<int>(op);
+  }
+  return 0.f;
+}
+
+bool IsUnary(ExprOp op) { return op >= ExprOp::kAbs && op <= ExprOp::kTanh; }
+
+/// The shape of the result of a binary op; the rules follow Broadcast().
+Shape BroadcastShape(const Shape& a, const Shape& b) {
+  if (a.empty()) return b;
+  if (b.empty()) return a;
+  Shape shape(std::max(a.size(), b.size()));
+  for (size_t i = 0; i < shape.size(); i++) {
+    size_t x = i < a.size() ? a[a.size() - 1 - i] : 1;
+    size_t y = i < b.size() ? b[b.size() - 1 - i] : 1;
+    CHECK(x == y || x == 1 || y == 1) << "Cannot broadcast dimension " << x
+                                      << " to " << y;
+    shape[shape.size() - 1 - i] = std::max(x, y);
+  }
+  return shape;
+}
+
+/// Strides of a contiguous tensor of the given shape.
+vector<int> ContiguousStride(const Shape& shape) {
+  vector<int> stride(shape.size());
+  int s = 1;
+  for (size_t i = shape.size(); i > 0; i--) {
+    stride[i - 1] = s;
+    s *= static_cast<int>(shape[i - 1]);
+  }
+  return stride;
+}
+
+/// Copy elements [begin, begin + len) of 't' in row-major order of its
+/// shape into 'dst', where 'src' is the data of 't'. Broadcast dimensions
+/// have stride 0, e.g., a row vector broadcast to a matrix is copied row
+/// by row.
+void LoadStrided(const Tensor& t, const float* src, size_t begin, size_t len,
+                 float* dst) {
+  const Shape& shape = t.shape();
+  const vector<int>& stride = t.stride();
+  size_t ndim = shape.size(), inner = shape.back();
+  int inner_stride = stride.back();
+  for (size_t i = begin, end = begin + len; i < end;) {
+    size_t col = i % inner, r = i / inner;
+    long offset = static_cast<long>(col) * inner_stride;
+    for (size_t k = ndim - 1; k > 0; k--) {
+      offset += static_cast<long>(r % shape[k - 1]) * stride[k - 1];
+      r /= shape[k - 1];
+    }
+    size_t n = std::min(inner - col, end - i);
+    const float* p = src + offset;
+    if (inner_stride == 1)
+      std::memcpy(dst, p, n * sizeof(float));
+    else if (inner_stride == 0)
+      std::fill(dst, dst + n, *p);
+    else
+      for (size_t j = 0; j < n; j++) dst[j] = p[j * inner_stride];
+    dst += n;
+    i += n;
+  }
+}
+}  // namespace
+
+/// A fused loop compiled from a TensorExpr. The nodes are assigned registers,
+/// i.e., buffers of kBlockSize floats, in post-order. The loop loads each leaf
+/// into its register and applies every op over the block, before moving to
+/// the next block, hence intermediate results stay in cache.
+class ExprProgram {
+ public:
+  typedef TensorExpr::Node Node;
+
+  ExprProgram(const std::shared_ptr<Node>& root) : shape_(root->shape) {
+    root_ = Compile(root);
+  }
+
+  std::shared_ptr<Device> device() const { return device_; }
+
+  /// Submit the loop writing into 'out' to the device.
+  static void Run(std::shared_ptr<const ExprProgram> prog, Tensor* out);
+
+  /// Evaluate the graph by the Tensor ops, for devices other than CppCPU.
+  static Tensor EvalEager(const std::shared_ptr<Node>& node,
+                          std::shared_ptr<Device> dev);
+
+ private:
+  struct Instr {
+    BlockFn fn;
+    int dst, lhs, rhs;
+  };
+  struct Leaf {
+    Tensor tensor;
+    int reg;
+    bool contiguous;
+  };
+
+  int Compile(const std::shared_ptr<Node>& node);
+  int AddLeaf(const Tensor& t);
+  /// Compute elements [begin, end) of the output.
+  void Compute(size_t begin, size_t end, const vector<const float*>& src,
+               float* dst) const;
+
+ private:
+  Shape shape_;
+  int num_regs_ = 0, root_ = -1;
+  vector<Leaf> leaves_;
+  vector<std::pair<int, float>> consts_;
+  vector<Instr> instrs_;
+  std::shared_ptr<Device> device_;
+};
+
+int ExprProgram::Compile(const std::shared_ptr<Node>& node) {
+  if (node->op == ExprOp::kScalar) {
+    consts_.push_back(std::make_pair(num_regs_, node->scalar));
+    return num_regs_++;
+  }
+  if (node->shape != shape_) {
+    // e.g., the vector of AddRow, which is evaluated once and then broadcast
+    Tensor t = node->op == ExprOp::kLeaf ? node->tensor
+                                         : TensorExpr(node).Eval();
+    return AddLeaf(Broadcast(t, shape_));
+  }
+  if (node->op == ExprOp::kLeaf) return AddLeaf(node->tensor);
+  Instr ins;
+  ins.fn = GetBlockFn(node->op);
+  ins.lhs = Compile(node->lhs);
+  ins.rhs = node->rhs == nullptr ? ins.lhs : Compile(node->rhs);
+  ins.dst = num_regs_++;
+  instrs_.push_back(ins);
+  return ins.dst;
+}
+
+int ExprProgram::AddLeaf(const Tensor& t) {
+  if (device_ == nullptr) device_ = t.device();
+  CHECK(device_ == t.device()) << "The tensors must be on the same device";
+  CHECK(t.shape() == shape_);
+  Leaf leaf;
+  leaf.tensor = t;
+  leaf.reg = num_regs_++;
+  leaf.contiguous = t.stride() == ContiguousStride(shape_);
+  leaves_.push_back(leaf);
+  return leaf.reg;
+}
+
+void ExprProgram::Compute(size_t begin, size_t end,
+                          const vector<const float*>& src, float* dst) const {
+  vector<float> regs(num_regs_ * kBlockSize);
+  for (const auto& c : consts_)
+    std::fill_n(regs.begin() + c.first * kBlockSize, kBlockSize, c.second);
+  for (size_t b = begin; b < end; b += kBlockSize) {
+    size_t len = std::min(kBlockSize, end - b);
+    for (size_t k = 0; k < leaves_.size(); k++) {
+      const Leaf& leaf = leaves_[k];
+      float* reg = regs.data() + leaf.reg * kBlockSize;
+      if (leaf.contiguous)
+        std::memcpy(reg, src[k] + b, len * sizeof(float));
+      else
+        LoadStrided(leaf.tensor, src[k], b, len, reg);
+    }
+    for (const auto& ins : instrs_)
+      ins.fn(regs.data() + ins.lhs * kBlockSize,
+             regs.data() + ins.rhs * kBlockSize,
+             regs.data() + ins.dst * kBlockSize);
+    std::memcpy(dst + b, regs.data() + root_ * kBlockSize,
+                len * sizeof(float));
+  }
+}
+
+void ExprProgram::Run(std::shared_ptr<const ExprProgram> prog, Tensor* out) {
+  vector<Block*> read_blocks;
+  for (const auto& leaf : prog->leaves_)
+    read_blocks.push_back(leaf.tensor.block());
+  Tensor ret(*out);
+  out->device()->Exec([prog, ret](Context* ctx) mutable {
+    vector<const float*> src;
+    for (const auto& leaf : prog->leaves_)
+      src.push_back(static_cast<const float*>(leaf.tensor.block()->data()));
+    float* dst = static_cast<float*>(ret.block()->mutable_data());
+    size_t n = ret.Size();
+    if (ctx->thread_pool != nullptr && n >= 2 * kGrain)
+      ctx->thread_pool->ParallelFor(0, n, kGrain, [&](size_t b, size_t e) {
+        prog->Compute(b, e, src, dst);
+      });
+    else
+      prog->Compute(0, n, src, dst);
+  }, read_blocks, {out->block()});
+}
+
+Tensor ExprProgram::EvalEager(const std::shared_ptr<Node>& node,
+                              std::shared_ptr<Device> dev) {
+  switch (node->op) {
+    case ExprOp::kLeaf:
+      return node->tensor;
+    case ExprOp::kScalar: {
+      // broadcast by the binary op
+      Tensor t(Shape{1}, dev);
+      t.SetValue(node->scalar);
+      return t;
+    }
+    default:
+      break;
+  }
+  Tensor a = EvalEager(node->lhs, dev);
+  switch (node->op) {
+    case ExprOp::kAbs: return Abs(a);
+    case ExprOp::kExp: return Exp(a);
+    case ExprOp::kLog: return Log(a);
+    case ExprOp::kReLU: return ReLU(a);
+    case ExprOp::kSigmoid: return Sigmoid(a);
+    case ExprOp::kSign: return Sign(a);
+    case ExprOp::kSqrt: return Sqrt(a);
+    case ExprOp::kSquare: return Square(a);
+    case ExprOp::kTanh: return Tanh(a);
+    default:
+      break;
+  }
+  Tensor b = EvalEager(node->rhs, dev);
+  switch (node->op) {
+    case ExprOp::kAdd: return a + b;
+    case ExprOp::kSub: return a - b;
+    case ExprOp::kMult: return a * b;
+    case ExprOp::kDiv: return a / b;
+    case ExprOp::kPow: return Pow(a, b);
+    case ExprOp::kLT: return a < b;
+    case ExprOp::kLE: return a <= b;
+    case ExprOp::kGT: return a > b;
+    case ExprOp::kGE: return a >= b;
+    default:
+      LOG(FATAL) << "Not an operator: " << static_cast<int>(node->op);
+  }
+  return Tensor();
+}
+
+TensorExpr::TensorExpr(const Tensor& t) : node_(std::make_shared<Node>()) {
+  CHECK_EQ(t.data_type(), kFloat32) << "Only float32 tensors are supported";
+  node_->op = ExprOp::kLeaf;
+  node_->shape = t.shape();
+  node_->tensor = t;
+}
+
+TensorExpr::TensorExpr(float x) : node_(std::make_shared<Node>()) {
+  node_->op = ExprOp::kScalar;
+  node_->scalar = x;
+}
+
+const Shape& TensorExpr::shape() const { return node_->shape; }
+
+std::shared_ptr<Device> TensorExpr::device() const {
+  vector<const Node*> nodes{node_.get()};
+  while (!nodes.empty()) {
+    const Node* node = nodes.back();
+    nodes.pop_back();
+    if (node->op == ExprOp::kLeaf) return node->tensor.device();
+    if (node->lhs != nullptr) nodes.push_back(node->lhs.get());
+    if (node->rhs != nullptr) nodes.push_back(node->rhs.get());
+  }
+  return nullptr;
+}
+
+Tensor TensorExpr::Eval() const {
+  auto dev = device();
+  CHECK(dev != nullptr) << "The expression has no tensor";
+  Tensor out(shape(), dev, kFloat32);
+  Eval(&out);
+  return out;
+}
+
+void TensorExpr::Eval(Tensor* out) const {
+  CHECK(out->shape() == shape());
+  CHECK_EQ(out->data_type(), kFloat32);
+  CHECK(out->stride() == ContiguousStride(out->shape()))
+      << "The output tensor must be contiguous";
+  if (out->device()->lang() != kCpp) {
+    out->CopyData(ExprProgram::EvalEager(node_, out->device()));
+    return;
+  }
+  auto prog = std::make_shared<ExprProgram>(node_);
+  CHECK(prog->device() == out->device())
+      << "The output must be on the device of the expression";
+  ExprProgram::Run(prog, out);
+}
+
+TensorExpr TensorExpr::Apply(ExprOp op, const TensorExpr& a) {
+  CHECK(IsUnary(op));
+  if (a.node_->op == ExprOp::kScalar)
+    return TensorExpr(EvalScalar(op, a.node_->scalar, 0.f));
+  auto node = std::make_shared<Node>();
+  node->op = op;
+  node->shape = a.shape();
+  node->lhs = a.node_;
+  return TensorExpr(node);
+}
+
+TensorExpr TensorExpr::Apply(ExprOp op, const TensorExpr& a,
+                             const TensorExpr& b) {
+  CHECK(op >= ExprOp::kAdd) << "Not a binary operator";
+  if (a.node_->op == ExprOp::kScalar && b.node_->op == ExprOp::kScalar)
+    return TensorExpr(EvalScalar(op, a.node_->scalar, b.node_->scalar));
+  auto node = std::make_shared<Node>();
+  node->op = op;
+  node->shape = BroadcastShape(a.shape(), b.shape());
+  node->lhs = a.node_;
+  node->rhs = b.node_;
+  return TensorExpr(node);
+}
+
+#define DEFINE_EXPR_UNARY_OP(fn, op)          \
+  TensorExpr fn(const TensorExpr& in) {       \
+    return TensorExpr::Apply(ExprOp::op, in); \
+  }
+
+DEFINE_EXPR_UNARY_OP(Abs, kAbs)
+DEFINE_EXPR_UNARY_OP(Exp, kExp)
+DEFINE_EXPR_UNARY_OP(Log, kLog)
+DEFINE_EXPR_UNARY_OP(ReLU, kReLU)
+DEFINE_EXPR_UNARY_OP(Sigmoid, kSigmoid)
+DEFINE_EXPR_UNARY_OP(Sign, kSign)
+DEFINE_EXPR_UNARY_OP(Sqrt, kSqrt)
+DEFINE_EXPR_UNARY_OP(Square, kSquare)
+DEFINE_EXPR_UNARY_OP(Tanh, kTanh)
+#undef DEFINE_EXPR_UNARY_OP
+
+#define DEFINE_EXPR_BINARY_OP(fn, op)                                    \
+  TensorExpr fn(const TensorExpr& lhs, const TensorExpr& rhs) {          \
+    return TensorExpr::Apply(ExprOp::op, lhs, rhs);                      \
+  }                                                                      \
+  TensorExpr fn(const Tensor& lhs, const TensorExpr& rhs) {              \
+    return TensorExpr::Apply(ExprOp::op, TensorExpr(lhs), rhs);          \
+  }                                                                      \
+  TensorExpr fn(const TensorExpr& lhs, float rhs) {                      \
+    return TensorExpr::Apply(ExprOp::op, lhs, TensorExpr(rhs));          \
+  }                                                                      \
+  TensorExpr fn(float lhs, const TensorExpr& rhs) {                      \
+    return TensorExpr::Apply(ExprOp::op, TensorExpr(lhs), rhs);          \
+  }
+
+DEFINE_EXPR_BINARY_OP(operator+, kAdd)
+DEFINE_EXPR_BINARY_OP(operator-, kSub)
+DEFINE_EXPR_BINARY_OP(operator*, kMult)
+DEFINE_EXPR_BINARY_OP(operator/, kDiv)
+DEFINE_EXPR_BINARY_OP(operator<, kLT)
+DEFINE_EXPR_BINARY_OP(operator<=, kLE)
+DEFINE_EXPR_BINARY_OP(operator>, kGT)
+DEFINE_EXPR_BINARY_OP(operator>=, kGE)
+DEFINE_EXPR_BINARY_OP(Pow, kPow)
+#undef DEFINE_EXPR_BINARY_OP
+
+namespace {
+/// Expression of 'v' reshaped into a row or a column of 'M'.
+TensorExpr AsVector(const TensorExpr& v, const TensorExpr& M, bool row) {
+  CHECK_EQ(M.shape().size(), 2u);
+  size_t n = M.shape().at(row ? 1 : 0);
+  if (v.shape() == (row ? Shape{n} : Shape{n, 1})) return v;
+  // a row vector is broadcast as is; a column has to be reshaped
+  CHECK_EQ(Product(v.shape()), n);
+  Tensor t = v.Eval();
+  return TensorExpr(Reshape(t, row ? Shape{n} : Shape{n, 1}));
+}
+}  // namespace
+
+TensorExpr AddRow(const TensorExpr& v, const TensorExpr& M) {
+  return M + AsVector(v, M, true);
+}
+TensorExpr SubRow(const TensorExpr& v, const TensorExpr& M) {
+  return M - AsVector(v, M, true);
+}
+TensorExpr MultRow(const TensorExpr& v, const TensorExpr& M) {
+  return M * AsVector(v, M, true);
+}
+TensorExpr DivRow(const TensorExpr& v, const TensorExpr& M) {
+  return M / AsVector(v, M, true);
+}
+TensorExpr AddColumn(const TensorExpr& v, const TensorExpr& M) {
+  return M + AsVector(v, M, false);
+}
+TensorExpr SubColumn(const TensorExpr& v, const TensorExpr& M) {
+  return M - AsVector(v, M, false);
+}
+TensorExpr MultColumn(const TensorExpr& v, const TensorExpr& M) {
+  return M * AsVector(v, M, false);
+}
+TensorExpr DivColumn(const TensorExpr& v, const TensorExpr& M) {
+  return M / AsVector(v, M, false);
+}
+
+}  // namespace singa
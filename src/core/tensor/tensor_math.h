@@ -121,7 +121,7 @@ template <typename DType, typename Lang>
 void Div(const Tensor &in, const DType x, Tensor *out,
          Context *ctx) {
   CHECK_NE(x, 0.f);
-  EltwiseMult<DType, Lang>(in, DType(1) / x, out, ctx);
+  EltwiseMult<DType, Lang>(in, DType(DType(1) / x), out, ctx);
 }
 
 /// out[i] = in1[i] / in2[i]
@@ -131,6 +131,13 @@ void Div(const Tensor &in1, const Tensor &in2, Tensor *out,
   LOG(FATAL) << "Div-Pair Not Implemented";
 }
 
+/// out[i] = in[i] * scale, where 'in' is int8 (kChar) and 'out' is DType.
+template <typename DType, typename Lang>
+void Dequantize(const Tensor &in, const float scale, Tensor *out,
+                Context *ctx) {
+  LOG(FATAL) << "Dequantize Not Implemented";
+}
+
 /// out[i] = in[i] * x
 template <typename DType, typename Lang>
 void EltwiseMult(const Tensor &in, const DType x, Tensor *out,
@@ -218,6 +225,14 @@ void Pow(const Tensor &in1, const Tensor &in2, Tensor *out,
   LOG(FATAL) << "Pow-Pair Not Implemented";
 }
 
+/// out[i] = clamp(round(in[i] / scale), -127, 127), where 'in' is DType and
+/// 'out' is int8 (kChar).
+template <typename DType, typename Lang>
+void Quantize(const Tensor &in, const float scale, Tensor *out,
+              Context *ctx) {
+  LOG(FATAL) << "Quantize Not Implemented";
+}
+
 /// out[i]=max(0, in[i])
 template <typename DType, typename Lang>
 void ReLU(const Tensor &in, Tensor *out, Context *ctx) {
@@ -256,7 +271,7 @@ void Square(const Tensor &in, Tensor *out, Context *ctx) {
 template <typename DType, typename Lang>
 void Sub(const Tensor &in, const DType x, Tensor *out,
          Context *ctx) {
-  Add<DType, Lang>(in, -x, out, ctx);
+  Add<DType, Lang>(in, DType(-x), out, ctx);
 }
 
 /// out[i] = in1[i] - in2[i]
@@ -272,6 +287,18 @@ void Sum(const Tensor &in, DType *out, Context *ctx) {
   LOG(FATAL) << "Sum Not Implemented";
 }
 
+/// out[r] = sum_c in[r][c], i.e., sum the columns of matrix 'in'
+template <typename DType, typename Lang>
+void SumColumns(const Tensor &in, Tensor *out, Context *ctx) {
+  LOG(FATAL) << "SumColumns Not Implemented";
+}
+
+/// out[c] = sum_r in[r][c], i.e., sum the rows of matrix 'in'
+template <typename DType, typename Lang>
+void SumRows(const Tensor &in, Tensor *out, Context *ctx) {
+  LOG(FATAL) << "SumRows Not Implemented";
+}
+
 /// out[i]=tanh(in[i])
 template <typename DType, typename Lang>
 void Tanh(const Tensor &in, Tensor *out, Context *ctx) {
@@ -315,13 +342,13 @@ void Uniform(const float low, const float high, Tensor *out,
 // BLAS functions, ref to http://docs.nvidia.com/cuda/cublas
 // *********************************************************
 
-/// outurn the index of the element with the max value.
+/// outurn the index of the element with the max absolute value.
 template <typename DType, typename Lang>
 void Amax(const Tensor &in, size_t *out, Context *ctx) {
   LOG(FATAL) << "Amax Not Implemented";
 }
 
-/// outurn the index of the element with the min value.
+/// outurn the index of the element with the min absolute value.
 template <typename DType, typename Lang>
 void Amin(const Tensor &in, size_t *out, Context *ctx) {
   LOG(FATAL) << "Amin Not Implemented";
@@ -341,7 +368,7 @@ void Axpy(const DType alpha, const Tensor &in, Tensor *out,
 
 /// out = ||in||_2^2, i.e, L2 norm.
 template <typename DType, typename Lang>
-void Nrm2(const Tensor &in, float *out, Context *ctx) {
+void Nrm2(const Tensor &in, DType *out, Context *ctx) {
   LOG(FATAL) << "Nrm2 Not Implemented";
 }
 
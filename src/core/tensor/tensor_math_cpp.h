@@ -23,10 +23,16 @@
 #include <cfloat>
 #include "singa/core/common.h"
 #include "singa/core/tensor.h"
+#include "singa/utils/half.h"
+#include "singa/utils/vector_ext.h"
 #include <math.h>
 #include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
 #include <sstream>
 #include <iterator>
+#include <limits>
 #include <iostream>
 
 #ifdef USE_CBLAS
@@ -124,351 +130,1207 @@ inline int next_offset(int offset, const vector<size_t>& shape, const vector<int
   return offset;
 }
 
+// min num of elements per chunk for splitting one operation over the
+// thread pool of the context
+const size_t kParallelGrain = 1 << 15;
+
+// run fn(begin, end) over chunks of [0, n) using the thread pool of ctx;
+// 'cost' is the num of elements processed per item.
+inline void parallel_for(Context* ctx, size_t n,
+                         const std::function<void(size_t, size_t)>& fn,
+                         size_t cost = 1) {
+  if (ctx == nullptr || ctx->thread_pool == nullptr
+      || n * cost < 2 * kParallelGrain)
+    fn(0, n);
+  else
+    ctx->thread_pool->ParallelFor(0, n, std::max<size_t>(kParallelGrain / cost, 1), fn);
+}
+
+// ******************************************************************************************
+// Elementwise kernels
+// ******************************************************************************************
+
+// Functors derived from SimdFn have a template operator() that works on both
+// scalars and simd_vec (below), hence they are run with SIMD instructions.
+// The instruction set (AVX-512, AVX2, or 128-bit vectors) is chosen at
+// runtime. Other functors (e.g., lambdas) are called per element, but still
+// inlined.
+#if defined(__GNUC__)
+#define SINGA_INLINE inline __attribute__((always_inline))
+#if defined(__x86_64__) || defined(__i386__)
+#define SINGA_X86_DISPATCH
+#endif
+#else
+#define SINGA_INLINE inline
+#endif
+
+struct SimdFn {};
+
+// return 'a' where 'mask' is true and 'b' otherwise; 'mask' is a bool for
+// scalars and an integer vector for vectors.
+template <typename M, typename T>
+SINGA_INLINE T select(M mask, T a, T b) {
+  return mask ? a : b;
+}
+
+// broadcast a scalar to T, i.e., DType or a vector of DType
+template <typename T, typename DType>
+SINGA_INLINE T broadcast(DType x) {
+  return T{} + x;
+}
+
+#ifdef SINGA_VECTOR_EXT
+// A GCC vector of B bytes wrapped in a struct, which is passed and returned
+// in memory. The register ABI of 32- and 64-byte vectors depends on the
+// enabled instruction set, whereas the functors are compiled for the baseline
+// one; once inlined, the wrapper is free.
+template <size_t B, typename DType>
+struct simd_vec {
+  typedef DType value_type;
+  typedef DType type __attribute__((vector_size(B)));
+  typedef decltype(type{} < type{}) mask_type;
+  type v;
+};
+
+// result of comparing two simd_vec, i.e., an integer vector
+template <size_t B, typename DType>
+struct simd_mask {
+  typename simd_vec<B, DType>::mask_type m;
+};
+
+#define DEFINE_SIMD_ARITH(Op)                                                \
+  template <size_t B, typename DType>                                        \
+  SINGA_INLINE simd_vec<B, DType> operator Op(const simd_vec<B, DType>& a,   \
+                                              const simd_vec<B, DType>& b) { \
+    return {a.v Op b.v};                                                     \
+  }                                                                          \
+  template <size_t B, typename DType>                                        \
+  SINGA_INLINE simd_vec<B, DType> operator Op(                               \
+      const simd_vec<B, DType>& a,                                           \
+      typename simd_vec<B, DType>::value_type x) {                           \
+    return {a.v Op x};                                                       \
+  }
+
+#define DEFINE_SIMD_COMPARE(Op)                                              \
+  template <size_t B, typename DType>                                        \
+  SINGA_INLINE simd_mask<B, DType> operator Op(const simd_vec<B, DType>& a,  \
+                                               const simd_vec<B, DType>& b) {\
+    return {a.v Op b.v};                                                     \
+  }
+
+DEFINE_SIMD_ARITH(+)
+DEFINE_SIMD_ARITH(-)
+DEFINE_SIMD_ARITH(*)
+DEFINE_SIMD_COMPARE(<)
+DEFINE_SIMD_COMPARE(<=)
+DEFINE_SIMD_COMPARE(>)
+DEFINE_SIMD_COMPARE(>=)
+
+template <size_t B, typename DType>
+SINGA_INLINE simd_vec<B, DType> operator-(const simd_vec<B, DType>& a) {
+  return {-a.v};
+}
+
+template <size_t B, typename DType>
+SINGA_INLINE simd_vec<B, DType> select(const simd_mask<B, DType>& mask,
+                                       const simd_vec<B, DType>& a,
+                                       const simd_vec<B, DType>& b) {
+  return {mask.m ? a.v : b.v};
+}
+#endif  // SINGA_VECTOR_EXT
+
+struct AddFn : SimdFn {
+  template <typename T> SINGA_INLINE T operator()(const T& a, const T& b) const { return a + b; }
+};
+
+struct SubFn : SimdFn {
+  template <typename T> SINGA_INLINE T operator()(const T& a, const T& b) const { return a - b; }
+};
+
+struct MultFn : SimdFn {
+  template <typename T> SINGA_INLINE T operator()(const T& a, const T& b) const { return a * b; }
+};
+
 template <typename DType>
-void traverse_unary(const Tensor & in, Tensor * out, std::function<DType(DType)> func) {
+struct AddScalarFn : SimdFn {
+  DType x;
+  explicit AddScalarFn(DType x) : x(x) {}
+  template <typename T> SINGA_INLINE T operator()(const T& a) const { return a + x; }
+};
 
-  DType *outPtr = static_cast<DType *>(out->block()->mutable_data());
-  const DType *inPtr = static_cast<const DType *>(in.block()->data());
-  /*
-  vector<int> traversal_info = generate_traversal_info(in);
-  vector<int> shape_multipliers = generate_shape_multipliers(in);
+template <typename DType>
+struct MultScalarFn : SimdFn {
+  DType x;
+  explicit MultScalarFn(DType x) : x(x) {}
+  template <typename T> SINGA_INLINE T operator()(const T& a) const { return a * x; }
+};
 
-  for (size_t i = 0; i < in.Size(); i++) {
-    outPtr[i] = func(inPtr[traversal_info[in.shape().size()]]);
-    traverse_next(in, shape_multipliers, traversal_info, i + 1);
+// 1 if the comparison is true, otherwise 0
+#define DEFINE_COMPARE_FN(Name, Op)                                         \
+  template <typename DType>                                                 \
+  struct Name##Fn : SimdFn {                                                \
+    template <typename T>                                                   \
+    SINGA_INLINE T operator()(const T& a, const T& b) const {               \
+      return select(a Op b, broadcast<T>(DType(1)), broadcast<T>(DType(0)));\
+    }                                                                       \
+  };                                                                        \
+  template <typename DType>                                                 \
+  struct Name##ScalarFn : SimdFn {                                          \
+    DType x;                                                                \
+    explicit Name##ScalarFn(DType x) : x(x) {}                              \
+    template <typename T> SINGA_INLINE T operator()(const T& a) const {     \
+      return select(a Op broadcast<T>(x), broadcast<T>(DType(1)),           \
+                    broadcast<T>(DType(0)));                                \
+    }                                                                       \
+  };
+
+DEFINE_COMPARE_FN(GE, >=)
+DEFINE_COMPARE_FN(GT, >)
+DEFINE_COMPARE_FN(LE, <=)
+DEFINE_COMPARE_FN(LT, <)
+
+template <typename DType>
+struct AbsFn : SimdFn {
+  template <typename T> SINGA_INLINE T operator()(const T& a) const {
+    return select(a < broadcast<T>(DType(0)), -a, a);
+  }
+};
+
+template <typename DType>
+struct ReLUFn : SimdFn {
+  template <typename T> SINGA_INLINE T operator()(const T& a) const {
+    return select(a >= broadcast<T>(DType(0)), a, broadcast<T>(DType(0)));
+  }
+};
+
+template <typename DType>
+struct SignFn : SimdFn {
+  template <typename T> SINGA_INLINE T operator()(const T& a) const {
+    T zero = broadcast<T>(DType(0)), one = broadcast<T>(DType(1));
+    return select(a > zero, one, zero) - select(a < zero, one, zero);
+  }
+};
+
+template <typename DType>
+struct ClampFn : SimdFn {
+  DType low, high;
+  ClampFn(DType low, DType high) : low(low), high(high) {}
+  template <typename T> SINGA_INLINE T operator()(const T& a) const {
+    T l = broadcast<T>(low), h = broadcast<T>(high);
+    return select(a < l, l, select(a > h, h, a));
+  }
+};
+
+struct IdentityFn : SimdFn {
+  template <typename T> SINGA_INLINE T operator()(const T& a) const { return a; }
+};
+
+struct SquareFn : SimdFn {
+  template <typename T> SINGA_INLINE T operator()(const T& a) const { return a * a; }
+};
+
+struct MaxFn : SimdFn {
+  template <typename T> SINGA_INLINE T operator()(const T& a, const T& b) const {
+    return select(a < b, b, a);
+  }
+};
+
+struct MinFn : SimdFn {
+  template <typename T> SINGA_INLINE T operator()(const T& a, const T& b) const {
+    return select(b < a, b, a);
+  }
+};
+
+#ifdef SINGA_VECTOR_EXT
+// out[i] = op(in[i]) using vectors of B bytes and scalars for the tail
+template <size_t B, typename DType, typename Op>
+SINGA_INLINE void unary_simd(const DType* in, DType* out, size_t n, const Op& op) {
+  typedef simd_vec<B, DType> V;
+  const size_t w = B / sizeof(DType);
+  size_t i = 0;
+  for (; i + w <= n; i += w) {
+    V a, r;
+    memcpy(&a, in + i, B);
+    r = op(a);
+    memcpy(out + i, &r, B);
+  }
+  for (; i < n; i++) out[i] = op(in[i]);
+}
+
+// out[i] = op(in1[i], in2[i]) using vectors of B bytes
+template <size_t B, typename DType, typename Op>
+SINGA_INLINE void binary_simd(const DType* in1, const DType* in2, DType* out,
+                              size_t n, const Op& op) {
+  typedef simd_vec<B, DType> V;
+  const size_t w = B / sizeof(DType);
+  size_t i = 0;
+  for (; i + w <= n; i += w) {
+    V a, b, r;
+    memcpy(&a, in1 + i, B);
+    memcpy(&b, in2 + i, B);
+    r = op(a, b);
+    memcpy(out + i, &r, B);
+  }
+  for (; i < n; i++) out[i] = op(in1[i], in2[i]);
+}
+#endif  // SINGA_VECTOR_EXT
+
+#ifdef SINGA_X86_DISPATCH
+enum SimdISA { kSimd128, kAVX2, kAVX512 };
+
+// the widest instruction set supported by the running cpu
+inline SimdISA simd_isa() {
+  static const SimdISA isa = []() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return kAVX512;
+    if (__builtin_cpu_supports("avx2")) return kAVX2;
+    return kSimd128;
+  }();
+  return isa;
+}
+
+template <typename DType, typename Op>
+__attribute__((target("avx2")))
+void unary_avx2(const DType* in, DType* out, size_t n, const Op& op) {
+  unary_simd<32>(in, out, n, op);
+}
+
+template <typename DType, typename Op>
+__attribute__((target("avx512f")))
+void unary_avx512(const DType* in, DType* out, size_t n, const Op& op) {
+  unary_simd<64>(in, out, n, op);
+}
+
+template <typename DType, typename Op>
+__attribute__((target("avx2")))
+void binary_avx2(const DType* in1, const DType* in2, DType* out, size_t n,
+                 const Op& op) {
+  binary_simd<32>(in1, in2, out, n, op);
+}
+
+template <typename DType, typename Op>
+__attribute__((target("avx512f")))
+void binary_avx512(const DType* in1, const DType* in2, DType* out, size_t n,
+                   const Op& op) {
+  binary_simd<64>(in1, in2, out, n, op);
+}
+#endif  // SINGA_X86_DISPATCH
+
+// out[i] = op(in[i]) for contiguous arrays
+template <typename DType, typename Op>
+void unary_kernel(const DType* in, DType* out, size_t n, const Op& op,
+                  std::false_type /*simd*/) {
+  for (size_t i = 0; i < n; i++) out[i] = op(in[i]);
+}
+
+template <typename DType, typename Op>
+void unary_kernel(const DType* in, DType* out, size_t n, const Op& op,
+                  std::true_type /*simd*/) {
+#ifdef SINGA_X86_DISPATCH
+  switch (simd_isa()) {
+    case kAVX512: unary_avx512(in, out, n, op); return;
+    case kAVX2: unary_avx2(in, out, n, op); return;
+    default: break;
+  }
+#endif  // SINGA_X86_DISPATCH
+#ifdef SINGA_VECTOR_EXT
+  unary_simd<16>(in, out, n, op);
+#else
+  unary_kernel(in, out, n, op, std::false_type());
+#endif  // SINGA_VECTOR_EXT
+}
+
+// out[i] = op(in1[i], in2[i]) for contiguous arrays
+template <typename DType, typename Op>
+void binary_kernel(const DType* in1, const DType* in2, DType* out, size_t n,
+                   const Op& op, std::false_type /*simd*/) {
+  for (size_t i = 0; i < n; i++) out[i] = op(in1[i], in2[i]);
+}
+
+template <typename DType, typename Op>
+void binary_kernel(const DType* in1, const DType* in2, DType* out, size_t n,
+                   const Op& op, std::true_type /*simd*/) {
+#ifdef SINGA_X86_DISPATCH
+  switch (simd_isa()) {
+    case kAVX512: binary_avx512(in1, in2, out, n, op); return;
+    case kAVX2: binary_avx2(in1, in2, out, n, op); return;
+    default: break;
+  }
+#endif  // SINGA_X86_DISPATCH
+#ifdef SINGA_VECTOR_EXT
+  binary_simd<16>(in1, in2, out, n, op);
+#else
+  binary_kernel(in1, in2, out, n, op, std::false_type());
+#endif  // SINGA_VECTOR_EXT
+}
+
+// Reduce map(in[i]) with op, starting from 'init', for contiguous arrays.
+// Several vector accumulators hide the latency of op, and the lanes are
+// combined pairwise at the end.
+template <typename DType, typename Map, typename Op>
+DType reduce_kernel(const DType* in, size_t n, const Map& map, const Op& op,
+                    DType init, std::false_type /*simd*/) {
+  DType acc[4] = {init, init, init, init};
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    for (size_t k = 0; k < 4; k++) acc[k] = op(acc[k], map(in[i + k]));
+  for (; i < n; i++) acc[0] = op(acc[0], map(in[i]));
+  return op(op(acc[0], acc[1]), op(acc[2], acc[3]));
+}
+
+#ifdef SINGA_VECTOR_EXT
+template <size_t B, typename DType, typename Map, typename Op>
+SINGA_INLINE DType reduce_simd(const DType* in, size_t n, const Map& map,
+                               const Op& op, DType init) {
+  typedef simd_vec<B, DType> V;
+  const size_t w = B / sizeof(DType);
+  V acc0 = broadcast<V>(init), acc1 = acc0, acc2 = acc0, acc3 = acc0, a;
+  size_t i = 0;
+  for (; i + 4 * w <= n; i += 4 * w) {
+    memcpy(&a, in + i, B);
+    acc0 = op(acc0, map(a));
+    memcpy(&a, in + i + w, B);
+    acc1 = op(acc1, map(a));
+    memcpy(&a, in + i + 2 * w, B);
+    acc2 = op(acc2, map(a));
+    memcpy(&a, in + i + 3 * w, B);
+    acc3 = op(acc3, map(a));
+  }
+  for (; i + w <= n; i += w) {
+    memcpy(&a, in + i, B);
+    acc0 = op(acc0, map(a));
+  }
+  acc0 = op(op(acc0, acc1), op(acc2, acc3));
+  DType lanes[w];
+  memcpy(lanes, &acc0, B);
+  for (size_t m = w / 2; m > 0; m /= 2)
+    for (size_t k = 0; k < m; k++) lanes[k] = op(lanes[k], lanes[k + m]);
+  DType tail = init;
+  for (; i < n; i++) tail = op(tail, map(in[i]));
+  return op(lanes[0], tail);
+}
+#endif  // SINGA_VECTOR_EXT
+
+#ifdef SINGA_X86_DISPATCH
+template <typename DType, typename Map, typename Op>
+__attribute__((target("avx2")))
+DType reduce_avx2(const DType* in, size_t n, const Map& map, const Op& op,
+                  DType init) {
+  return reduce_simd<32>(in, n, map, op, init);
+}
+
+template <typename DType, typename Map, typename Op>
+__attribute__((target("avx512f")))
+DType reduce_avx512(const DType* in, size_t n, const Map& map, const Op& op,
+                    DType init) {
+  return reduce_simd<64>(in, n, map, op, init);
+}
+#endif  // SINGA_X86_DISPATCH
+
+template <typename DType, typename Map, typename Op>
+DType reduce_kernel(const DType* in, size_t n, const Map& map, const Op& op,
+                    DType init, std::true_type /*simd*/) {
+#ifdef SINGA_X86_DISPATCH
+  switch (simd_isa()) {
+    case kAVX512: return reduce_avx512(in, n, map, op, init);
+    case kAVX2: return reduce_avx2(in, n, map, op, init);
+    default: break;
+  }
+#endif  // SINGA_X86_DISPATCH
+#ifdef SINGA_VECTOR_EXT
+  return reduce_simd<16>(in, n, map, op, init);
+#else
+  return reduce_kernel(in, n, map, op, init, std::false_type());
+#endif  // SINGA_VECTOR_EXT
+}
+
+// Element type of the computation; fp16 is stored as half but computed (and
+// accumulated) in float.
+template <typename DType>
+struct compute_type { typedef DType type; };
+template <>
+struct compute_type<half> { typedef float type; };
+template <>
+struct compute_type<bfloat16> { typedef float type; };
+template <typename DType>
+using compute_t = typename compute_type<DType>::type;
+
+// fp16 kernels convert chunks into float and run the float kernels
+const size_t kHalfChunk = 256;
+
+template <typename Op, typename Simd>
+void unary_half(const half* in, half* out, size_t n, const Op& op, Simd simd) {
+  float buf[kHalfChunk];
+  for (size_t i = 0; i < n; i += kHalfChunk) {
+    size_t m = std::min(kHalfChunk, n - i);
+    HalfToFloat(in + i, buf, m);
+    unary_kernel(buf, buf, m, op, simd);
+    FloatToHalf(buf, out + i, m);
+  }
+}
+
+template <typename Op, typename Simd>
+void binary_half(const half* in1, const half* in2, half* out, size_t n,
+                 const Op& op, Simd simd) {
+  float buf1[kHalfChunk], buf2[kHalfChunk];
+  for (size_t i = 0; i < n; i += kHalfChunk) {
+    size_t m = std::min(kHalfChunk, n - i);
+    HalfToFloat(in1 + i, buf1, m);
+    HalfToFloat(in2 + i, buf2, m);
+    binary_kernel(buf1, buf2, buf1, m, op, simd);
+    FloatToHalf(buf1, out + i, m);
+  }
+}
+
+template <typename Op>
+void unary_kernel(const half* in, half* out, size_t n, const Op& op,
+                  std::false_type simd) {
+  unary_half(in, out, n, op, simd);
+}
+
+template <typename Op>
+void unary_kernel(const half* in, half* out, size_t n, const Op& op,
+                  std::true_type simd) {
+  unary_half(in, out, n, op, simd);
+}
+
+template <typename Op>
+void binary_kernel(const half* in1, const half* in2, half* out, size_t n,
+                   const Op& op, std::false_type simd) {
+  binary_half(in1, in2, out, n, op, simd);
+}
+
+template <typename Op>
+void binary_kernel(const half* in1, const half* in2, half* out, size_t n,
+                   const Op& op, std::true_type simd) {
+  binary_half(in1, in2, out, n, op, simd);
+}
+
+template <typename Map, typename Op, typename Simd>
+float reduce_kernel(const half* in, size_t n, const Map& map, const Op& op,
+                    float init, Simd simd) {
+  float buf[kHalfChunk], r = init;
+  for (size_t i = 0; i < n; i += kHalfChunk) {
+    size_t m = std::min(kHalfChunk, n - i);
+    HalfToFloat(in + i, buf, m);
+    r = op(r, reduce_kernel(buf, m, map, op, init, simd));
   }
-  */
+  return r;
+}
+
+// Reductions split the input into blocks of kReduceBlock elements, which are
+// reduced in parallel, and combine the block results pairwise. Hence sums
+// are pairwise, i.e., the rounding error grows with log(n) rather than n,
+// and the result does not depend on the number of threads.
+const size_t kReduceBlock = 1 << 12;
+
+// Reduce map(in[i]) with op, where 'in' has 'n' contiguous elements; the
+// result is in the computation type.
+template <typename DType, typename Map, typename Op>
+compute_t<DType> reduce(const DType* in, size_t n, const Map& map, const Op& op,
+                        compute_t<DType> init, Context* ctx) {
+  typedef compute_t<DType> CType;
+  typename std::is_base_of<SimdFn, Map>::type simd;
+  size_t nblock = (n + kReduceBlock - 1) / kReduceBlock;
+  if (nblock <= 1) return reduce_kernel(in, n, map, op, init, simd);
+  vector<CType> partial(nblock);
+  parallel_for(ctx, nblock, [&](size_t begin, size_t end) {
+    for (size_t b = begin; b < end; b++) {
+      size_t offset = b * kReduceBlock;
+      partial[b] = reduce_kernel(in + offset,
+                                 std::min(kReduceBlock, n - offset), map, op,
+                                 init, simd);
+    }
+  }, kReduceBlock);
+  for (size_t m = 1; m < nblock; m *= 2)
+    for (size_t b = 0; b + m < nblock; b += 2 * m)
+      partial[b] = op(partial[b], partial[b + m]);
+  return partial[0];
+}
+
+// Convert 'n' contiguous elements into the computation type, using 'buf' if
+// a conversion is needed.
+template <typename DType>
+const DType* load_compute(const DType* in, DType* buf, size_t n) {
+  return in;
+}
+
+inline const float* load_compute(const half* in, float* buf, size_t n) {
+  HalfToFloat(in, buf, n);
+  return buf;
+}
+
+// Visit the rows (i.e., the last dimension) of N tensors with the same shape
+// but different strides. fn(offsets, len) processes one row of 'len' elements
+// whose first elements are at 'offsets'. The outer index is advanced like an
+// odometer instead of per element, and rows are split over the thread pool.
+template <size_t N, typename Fn>
+void traverse_rows(const Shape& shape,
+                   const std::array<const vector<int>*, N>& strides,
+                   Context* ctx, Fn fn) {
+  size_t ndim = shape.size(), n = Product(shape);
+  if (n == 0) return;
+  size_t len = shape[ndim - 1], nrow = n / len;
+  parallel_for(ctx, nrow, [&](size_t begin, size_t end) {
+    vector<size_t> idx(ndim - 1, 0);
+    std::array<int, N> offsets;
+    offsets.fill(0);
+    size_t r = begin;
+    for (int k = static_cast<int>(ndim) - 2; k >= 0; k--) {
+      idx[k] = r % shape[k];
+      r /= shape[k];
+      for (size_t j = 0; j < N; j++) offsets[j] += idx[k] * strides[j]->at(k);
+    }
+    for (size_t row = begin; row < end; row++) {
+      fn(offsets, len);
+      for (int k = static_cast<int>(ndim) - 2; k >= 0; k--) {
+        for (size_t j = 0; j < N; j++) offsets[j] += strides[j]->at(k);
+        if (++idx[k] < shape[k]) break;
+        for (size_t j = 0; j < N; j++)
+          offsets[j] -= strides[j]->at(k) * shape[k];
+        idx[k] = 0;
+      }
+    }
+  }, len);
+}
+
+template <typename DType, typename Op>
+void traverse_unary(const Tensor & in, Tensor * out, Op func,
+                    Context* ctx = nullptr) {
+  DType *outPtr = static_cast<DType *>(out->block()->mutable_data());
+  const DType *inPtr = static_cast<const DType *>(in.block()->data());
+  typename std::is_base_of<SimdFn, Op>::type simd;
   CHECK(in.shape() == out->shape());
   if (in.stride() == out->stride()) {
-    for (size_t i = 0; i < in.Size(); i++)
-      outPtr[i] = func(inPtr[i]);
+    parallel_for(ctx, in.Size(), [&](size_t b, size_t e) {
+      unary_kernel(inPtr + b, outPtr + b, e - b, func, simd);
+    });
   } else {
-    LOG(INFO) << "not equal stride";
-    size_t in_offset = 0, out_offset = 0;
-    vector<int> in_idx(in.nDim(), 0), out_idx(out->nDim(), 0);
-    for (size_t i = 0; i < Product(in.shape()); i++) {
-      outPtr[out_offset] = func(inPtr[in_offset]);
-      out_offset = next_offset(out_offset, out->shape(), out->stride(), &out_idx);
-      in_offset = next_offset(in_offset, in.shape(), in.stride(), &in_idx);
-    }
+    int in_step = in.stride().back(), out_step = out->stride().back();
+    std::array<const vector<int>*, 2> strides = {{&in.stride(), &out->stride()}};
+    traverse_rows<2>(in.shape(), strides, ctx,
+        [&](const std::array<int, 2>& offsets, size_t len) {
+      const DType* x = inPtr + offsets[0];
+      DType* y = outPtr + offsets[1];
+      if (in_step == 1 && out_step == 1) {
+        unary_kernel(x, y, len, func, simd);
+      } else {
+        for (size_t i = 0; i < len; i++)
+          y[i * out_step] = static_cast<DType>(
+              func(static_cast<compute_t<DType>>(x[i * in_step])));
+      }
+    });
   }
 }
 
 
-template <typename DType>
+template <typename DType, typename Op>
 void traverse_binary(const Tensor &in1, const Tensor &in2, Tensor* out,
-                     std::function<DType(DType, DType)> func) {
+                     Op func, Context* ctx = nullptr) {
   DType *outPtr = static_cast<DType *>(out->block()->mutable_data());
   const DType *in1Ptr = static_cast<const DType *>(in1.block()->data());
   const DType *in2Ptr = static_cast<const DType *>(in2.block()->data());
-  /*
-  vector<int> traversal_info_in1 = generate_traversal_info(in1);
-  vector<int> traversal_info_in2 = generate_traversal_info(in2);
-  vector<int> shape_multipliers_in1 = generate_shape_multipliers(in1);
-  vector<int> shape_multipliers_in2 = generate_shape_multipliers(in2);
-
-  for (size_t i = 0; i < in1.Size(); i++) {
-    outPtr[i] = func(in1Ptr[traversal_info_in1[in1.shape().size()]],
-                     in2Ptr[traversal_info_in2[in2.shape().size()]]);
-    traverse_next(in1, shape_multipliers_in1, traversal_info_in1, i + 1);
-    traverse_next(in2, shape_multipliers_in2, traversal_info_in2, i + 1);
-  }
-  */
+  typename std::is_base_of<SimdFn, Op>::type simd;
   auto prod = Product(in1.shape());
   CHECK(in1.shape() == out->shape());
   CHECK(in2.shape() == out->shape());
   if ((in1.stride() == out->stride()) && (in2.stride() == in1.stride())) {
-    for (size_t i = 0; i < prod; i++)
-      outPtr[i] = func(in1Ptr[i], in2Ptr[i]);
+    parallel_for(ctx, prod, [&](size_t b, size_t e) {
+      binary_kernel(in1Ptr + b, in2Ptr + b, outPtr + b, e - b, func, simd);
+    });
   } else {
-    /*
-    LOG(INFO) << "not equal stride";
-    std::ostringstream s1, s2, s3, s4, s5, s6;
-    std::copy(in1.stride().begin(), in1.stride().end(), std::ostream_iterator<int>(s1, ", "));
-    std::copy(in2.stride().begin(), in2.stride().end(), std::ostream_iterator<int>(s2, ", "));
-    std::copy(out->stride().begin(), out->stride().end(), std::ostream_iterator<int>(s3, ", "));
-
-    std::copy(in1.shape().begin(), in1.shape().end(), std::ostream_iterator<int>(s4, ", "));
-    std::copy(in2.shape().begin(), in2.shape().end(), std::ostream_iterator<int>(s5, ", "));
-    std::copy(out->shape().begin(), out->shape().end(), std::ostream_iterator<int>(s6, ", "));
-
-    LOG(INFO) << s1.str() << ": " << s4.str();
-    LOG(INFO) << s2.str() << ": " << s5.str();
-    LOG(INFO) << s3.str() << ": " << s6.str();
-    LOG(INFO) << Backtrace();
-    */
-
-    size_t in1_offset = 0, in2_offset = 0, out_offset = 0;
-    vector<int> in1_idx(in1.nDim(), 0), in2_idx(in2.nDim(), 0), out_idx(out->nDim(), 0);
-    for (size_t i = 0; i < prod; i++) {
-      outPtr[out_offset] = func(in1Ptr[in1_offset], in2Ptr[in2_offset]);
-      out_offset = next_offset(out_offset, out->shape(), out->stride(), &out_idx);
-      in1_offset = next_offset(in1_offset, in1.shape(), in1.stride(), &in1_idx);
-      in2_offset = next_offset(in2_offset, in2.shape(), in2.stride(), &in2_idx);
-      // LOG(INFO) <<  in1_offset << ", " << in2_offset << ", " << out_offset;
-    }
+    int in1_step = in1.stride().back(), in2_step = in2.stride().back(),
+        out_step = out->stride().back();
+    std::array<const vector<int>*, 3> strides = {{&in1.stride(), &in2.stride(),
+                                                  &out->stride()}};
+    traverse_rows<3>(in1.shape(), strides, ctx,
+        [&](const std::array<int, 3>& offsets, size_t len) {
+      const DType* a = in1Ptr + offsets[0];
+      const DType* b = in2Ptr + offsets[1];
+      DType* y = outPtr + offsets[2];
+      if (in1_step == 1 && in2_step == 1 && out_step == 1) {
+        binary_kernel(a, b, y, len, func, simd);
+      } else {
+        for (size_t i = 0; i < len; i++)
+          y[i * out_step] = static_cast<DType>(
+              func(static_cast<compute_t<DType>>(a[i * in1_step]),
+                   static_cast<compute_t<DType>>(b[i * in2_step])));
+      }
+    });
+  }
+}
+
+// Convert one value into To. Conversions into integers round half away from
+// zero and saturate; nan becomes 0.
+template <typename To, typename From>
+inline typename std::enable_if<!std::is_integral<To>::value, To>::type
+convert_value(From x) {
+  return static_cast<To>(static_cast<compute_t<To>>(x));
+}
+
+template <typename To, typename From>
+inline typename std::enable_if<std::is_integral<To>::value, To>::type
+convert_value(From x) {
+  double v = std::round(static_cast<double>(x));
+  if (v != v) return To(0);
+  if (v <= std::numeric_limits<To>::min()) return std::numeric_limits<To>::min();
+  if (v >= std::numeric_limits<To>::max()) return std::numeric_limits<To>::max();
+  return static_cast<To>(v);
+}
+
+template <typename From, typename To>
+void convert_kernel(const From* in, To* out, size_t n) {
+  for (size_t i = 0; i < n; i++) out[i] = convert_value<To>(in[i]);
+}
+
+// fp16 and bf16 to and from float are converted in bulk (vectorized)
+inline void convert_kernel(const half* in, float* out, size_t n) {
+  HalfToFloat(in, out, n);
+}
+inline void convert_kernel(const float* in, half* out, size_t n) {
+  FloatToHalf(in, out, n);
+}
+inline void convert_kernel(const bfloat16* in, float* out, size_t n) {
+  BFloat16ToFloat(in, out, n);
+}
+inline void convert_kernel(const float* in, bfloat16* out, size_t n) {
+  FloatToBFloat16(in, out, n);
+}
+
+// out[i] = clamp(round(in[i] * inv_scale), -127, 127); the symmetric range
+// keeps -q the negation of q.
+inline void quantize_kernel(const float* in, int8_t* out, size_t n,
+                            float inv_scale) {
+  size_t i = 0;
+#ifdef SINGA_CONVERTVECTOR
+  const f32x8 lo = f32x8{} - 127.f, hi = f32x8{} + 127.f;
+  for (; i + 8 <= n; i += 8) {
+    f32x8 x;
+    std::memcpy(&x, in + i, sizeof(x));
+    x *= inv_scale;
+    x = x < lo ? lo : x;  // nan is kept and truncated into 0 below
+    x = x > hi ? hi : x;
+    x += x < 0 ? f32x8{} - 0.5f : f32x8{} + 0.5f;
+    i8x8 q = __builtin_convertvector(__builtin_convertvector(x, i32x8), i8x8);
+    std::memcpy(out + i, &q, sizeof(q));
+  }
+#endif  // SINGA_CONVERTVECTOR
+  for (; i < n; i++) {
+    float x = std::min(std::max(in[i] * inv_scale, -127.f), 127.f);
+    out[i] = static_cast<int8_t>(x < 0 ? x - 0.5f : x + 0.5f);
   }
 }
 
+inline void dequantize_kernel(const int8_t* in, float* out, size_t n,
+                              float scale) {
+  size_t i = 0;
+#ifdef SINGA_CONVERTVECTOR
+  for (; i + 8 <= n; i += 8) {
+    i8x8 q;
+    std::memcpy(&q, in + i, sizeof(q));
+    f32x8 x = __builtin_convertvector(__builtin_convertvector(q, i32x8), f32x8);
+    x *= scale;
+    std::memcpy(out + i, &x, sizeof(x));
+  }
+#endif  // SINGA_CONVERTVECTOR
+  for (; i < n; i++) out[i] = in[i] * scale;
+}
+
+// Apply kernel(x, y, len) over the contiguous runs of 'in' and 'out', whose
+// element types are SrcType and DType respectively.
+template <typename SrcType, typename DType, typename Kernel>
+void traverse_convert(const Tensor& in, Tensor* out, Kernel kernel,
+                      Context* ctx) {
+  DType *outPtr = static_cast<DType *>(out->block()->mutable_data());
+  const SrcType *inPtr = static_cast<const SrcType *>(in.block()->data());
+  CHECK(in.shape() == out->shape());
+  if (in.stride() == out->stride()) {
+    parallel_for(ctx, in.Size(), [&](size_t b, size_t e) {
+      kernel(inPtr + b, outPtr + b, e - b);
+    });
+  } else {
+    int in_step = in.stride().back(), out_step = out->stride().back();
+    std::array<const vector<int>*, 2> strides = {{&in.stride(), &out->stride()}};
+    traverse_rows<2>(in.shape(), strides, ctx,
+        [&](const std::array<int, 2>& offsets, size_t len) {
+      const SrcType* x = inPtr + offsets[0];
+      DType* y = outPtr + offsets[1];
+      if (in_step == 1 && out_step == 1) {
+        kernel(x, y, len);
+      } else {
+        for (size_t i = 0; i < len; i++)
+          kernel(x + i * in_step, y + i * out_step, 1);
+      }
+    });
+  }
+}
+
+// Reduce map(x) with op over all elements of 'in'. Order does not matter,
+// hence a permuted view (e.g., transposed) is reduced in the order of its
+// block; only broadcast views are traversed by rows.
+template <typename DType, typename Map, typename Op>
+compute_t<DType> reduce_tensor(const Tensor& in, const Map& map, const Op& op,
+                               compute_t<DType> init, Context* ctx) {
+  const DType *inPtr = static_cast<const DType *>(in.block()->data());
+  const auto& stride = in.stride();
+  if (std::find(stride.begin(), stride.end(), 0) == stride.end())
+    return reduce(inPtr, in.Size(), map, op, init, ctx);
+  compute_t<DType> r = init;
+  int step = stride.back();
+  std::array<const vector<int>*, 1> strides = {{&stride}};
+  traverse_rows<1>(in.shape(), strides, nullptr,
+      [&](const std::array<int, 1>& offsets, size_t len) {
+    const DType* x = inPtr + offsets[0];
+    if (step == 1) {
+      r = op(r, reduce(x, len, map, op, init, nullptr));
+    } else {
+      for (size_t i = 0; i < len; i++)
+        r = op(r, map(static_cast<compute_t<DType>>(x[i * step])));
+    }
+  });
+  return r;
+}
+
+// Index of the first element with the max (or min, by 'op') absolute value
+// of contiguous 'in'; each block finds its extreme with SIMD and then scans
+// itself for the position.
+template <typename DType, typename Op>
+size_t arg_reduce_abs(const DType* in, size_t n, const Op& op,
+                      compute_t<DType> init, Context* ctx) {
+  typedef compute_t<DType> CType;
+  AbsFn<CType> abs;
+  size_t nblock = (n + kReduceBlock - 1) / kReduceBlock;
+  vector<std::pair<CType, size_t>> partial(nblock);
+  parallel_for(ctx, nblock, [&](size_t begin, size_t end) {
+    for (size_t b = begin; b < end; b++) {
+      size_t offset = b * kReduceBlock, len = std::min(kReduceBlock, n - offset);
+      CType v = reduce_kernel(in + offset, len, abs, op, init, std::true_type());
+      size_t i = offset;
+      while (i + 1 < offset + len && abs(static_cast<CType>(in[i])) != v) i++;
+      partial[b] = std::make_pair(v, i);
+    }
+  }, kReduceBlock);
+  size_t best = 0;
+  for (size_t b = 1; b < nblock; b++)
+    if (op(partial[best].first, partial[b].first) != partial[best].first)
+      best = b;
+  return nblock ? partial[best].second : 0;
+}
+
 // ******************************************************************************************
 // traversal operations end
 // ******************************************************************************************
 
 // ===================== CUDA Functions =============================
 
-template <>
-void Abs<float, lang::Cpp>(const Tensor& in, Tensor* out, Context *ctx) {
-  traverse_unary<float>(in, out, [](float x) {return fabs(x);});
+// The elementwise kernels are templates over the element type, which are
+// specialized for lang::Cpp below with every type they support.
+namespace cpp {
+
+// index of the max absolute value, like BLAS i?amax but 0-based
+template <typename DType>
+void Amax(const Tensor& in, size_t *out, Context *ctx) {
+  const DType *inPtr = static_cast<const DType *>(in.block()->data());
+  *out = arg_reduce_abs(inPtr, in.Size(), MaxFn(), compute_t<DType>(0), ctx);
 }
 
-template <>
-void Add<float, lang::Cpp>(const Tensor& in, const float x, Tensor* out, Context *ctx) {
-  auto add_lambda = [&x](float a) {
-    return (a + x);
-  };
-  traverse_unary<float>(in, out, add_lambda);
+// index of the min absolute value
+template <typename DType>
+void Amin(const Tensor& in, size_t *out, Context *ctx) {
+  const DType *inPtr = static_cast<const DType *>(in.block()->data());
+  *out = arg_reduce_abs(inPtr, in.Size(), MinFn(),
+                        std::numeric_limits<compute_t<DType>>::max(), ctx);
 }
 
-template <>
-void Add<float, lang::Cpp>(const Tensor& in1, const Tensor& in2, Tensor* out, Context *ctx) {
-  // CHECK_EQ(ctx->stream, nullptr);
-  auto add_lambda_binary = [](float a, float b) {
-    return (a + b);
-  };
-  traverse_binary<float>(in1, in2, out, add_lambda_binary);
+// sum of absolute values
+template <typename DType>
+void Asum(const Tensor& in, DType *out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  *out = static_cast<DType>(reduce_tensor<DType>(in, AbsFn<CType>(), AddFn(),
+                                                 CType(0), ctx));
+}
 
+// Euclidean norm
+template <typename DType>
+void Nrm2(const Tensor& in, DType *out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  *out = static_cast<DType>(std::sqrt(reduce_tensor<DType>(
+      in, SquareFn(), AddFn(), CType(0), ctx)));
 }
 
-template <>
-void Clamp<float, lang::Cpp>(const float low, const float high,
-                             const Tensor& in, Tensor* out,
-                             Context *ctx) {
-  auto clamp_lambda = [&low, &high](float a) {
-    if (a < low) {return low;}
-    else if (a > high) {return high;}
-    else {return a;}
-  };
-  traverse_unary<float>(in, out, clamp_lambda);
+template <typename DType>
+void Abs(const Tensor& in, Tensor* out, Context *ctx) {
+  traverse_unary<DType>(in, out, AbsFn<compute_t<DType>>(), ctx);
 }
 
-template <>
-void Div<float, lang::Cpp>(const float x, const Tensor& in, Tensor* out,
-                           Context *ctx) {
-  auto const_div = [&x](float a) {CHECK_NE(a, 0.f); return x / a;};
-  traverse_unary<float>(in, out, const_div);
+template <typename DType>
+void Add(const Tensor& in, const DType x, Tensor* out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  traverse_unary<DType>(in, out, AddScalarFn<CType>(static_cast<CType>(x)),
+                        ctx);
 }
 
-template <>
-void Div<float, lang::Cpp>(const Tensor& in1, const Tensor& in2,
-                           Tensor* out, Context *ctx) {
-  auto binary_div = [](float a, float b) {CHECK_NE(b, 0.f); return a / b;};
-  traverse_binary<float>(in1, in2, out, binary_div);
+template <typename DType>
+void Add(const Tensor& in1, const Tensor& in2, Tensor* out, Context *ctx) {
+  traverse_binary<DType>(in1, in2, out, AddFn(), ctx);
 }
 
-template <>
-void EltwiseMult<float, lang::Cpp>(const Tensor& in, const float x, Tensor* out,
-                                   Context *ctx) {
-  auto eltwisemult_lambda = [&x](float a) {
-    return (a * x);
-  };
-  traverse_unary<float>(in, out, eltwisemult_lambda);
+/// Convert the elements of 'in' (SrcType) into the type of 'out' (DType).
+template <typename SrcType, typename DType>
+void Cast(const Tensor& in, Tensor* out, Context *ctx) {
+  traverse_convert<SrcType, DType>(in, out,
+      [](const SrcType* x, DType* y, size_t n) { convert_kernel(x, y, n); },
+      ctx);
 }
 
-template <>
-void EltwiseMult<float, lang::Cpp>(const Tensor& in1, const Tensor& in2, Tensor* out,
-                                   Context *ctx) {
-  auto eltwisemult_lambda_binary = [](float a, float b) {
-    return (a * b);
-  };
-  traverse_binary<float>(in1, in2, out, eltwisemult_lambda_binary);
+template <typename DType>
+void Clamp(const DType low, const DType high, const Tensor& in, Tensor* out,
+           Context *ctx) {
+  typedef compute_t<DType> CType;
+  traverse_unary<DType>(in, out, ClampFn<CType>(static_cast<CType>(low),
+                                                static_cast<CType>(high)), ctx);
 }
 
-template <>
-void Exp<float, lang::Cpp>(const Tensor& in, Tensor *out, Context *ctx) {
-  traverse_unary<float>(in, out, [](float x) {return exp(x);});
+template <typename DType>
+void Dequantize(const Tensor& in, const float scale, Tensor* out,
+                Context *ctx) {
+  traverse_convert<int8_t, DType>(in, out,
+      [scale](const int8_t* x, DType* y, size_t n) {
+        dequantize_kernel(x, y, n, scale);
+      }, ctx);
 }
 
-template <>
-void GE<float, lang::Cpp>(const Tensor& in, const float x, Tensor* out,
-                          Context *ctx) {
-  auto ge_lambda = [&x](float a) {
-    return (a >= x) ? 1.f : 0.f;
-  };
-  traverse_unary<float>(in, out, ge_lambda);
+template <typename DType>
+void Div(const DType x, const Tensor& in, Tensor* out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  CType y = static_cast<CType>(x);
+  auto const_div = [y](CType a) {CHECK_NE(a, CType(0)); return y / a;};
+  traverse_unary<DType>(in, out, const_div, ctx);
 }
 
-template <>
-void GE<float, lang::Cpp>(const Tensor& in1, const Tensor& in2, Tensor* out,
-                          Context *ctx) {
-  auto ge_lambda_binary = [](float a, float b) {
-    return (a >= b) ? 1.f : 0.f;
-  };
-  traverse_binary<float>(in1, in2, out, ge_lambda_binary);
+template <typename DType>
+void Div(const Tensor& in, const DType x, Tensor* out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  CType y = static_cast<CType>(x);
+  CHECK_NE(y, CType(0));
+  traverse_unary<DType>(in, out, [y](CType a) {return a / y;}, ctx);
 }
 
-template <>
-void GT<float, lang::Cpp>(const Tensor& in, const float x, Tensor* out,
-                          Context *ctx) {
-  auto gt_lambda = [&x](float a) {
-    return (a > x) ? 1.f : 0.f;
-  };
-  traverse_unary<float>(in, out, gt_lambda);
+template <typename DType>
+void Div(const Tensor& in1, const Tensor& in2, Tensor* out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  auto binary_div = [](CType a, CType b) {CHECK_NE(b, CType(0)); return a / b;};
+  traverse_binary<DType>(in1, in2, out, binary_div, ctx);
 }
 
-template <>
-void GT<float, lang::Cpp>(const Tensor& in1, const Tensor& in2, Tensor* out,
-                          Context *ctx) {
-  auto gt_lambda_binary = [](float a, float b) {
-    return (a > b) ? 1.f : 0.f;
-  };
-  traverse_binary<float>(in1, in2, out, gt_lambda_binary);
+template <typename DType>
+void EltwiseMult(const Tensor& in, const DType x, Tensor* out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  traverse_unary<DType>(in, out, MultScalarFn<CType>(static_cast<CType>(x)),
+                        ctx);
 }
 
-template <>
-void LE<float, lang::Cpp>(const Tensor& in, const float x, Tensor* out,
-                          Context *ctx) {
-  auto le_lambda = [&x](float a) {
-    return (a <= x) ? 1.f : 0.f;
-  };
-  traverse_unary<float>(in, out, le_lambda);
+template <typename DType>
+void EltwiseMult(const Tensor& in1, const Tensor& in2, Tensor* out,
+                 Context *ctx) {
+  traverse_binary<DType>(in1, in2, out, MultFn(), ctx);
 }
 
-template <>
-void LE<float, lang::Cpp>(const Tensor& in1, const Tensor& in2, Tensor* out,
-                          Context *ctx) {
-  auto le_lambda_binary = [](float a, float b) {
-    return (a <= b) ? 1.f : 0.f;
-  };
-  traverse_binary<float>(in1, in2, out, le_lambda_binary);
+template <typename DType>
+void Exp(const Tensor& in, Tensor *out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  traverse_unary<DType>(in, out, [](CType x) {return std::exp(x);}, ctx);
 }
 
-template <>
-void Log<float, lang::Cpp>(const Tensor& in, Tensor* out,
-                           Context *ctx) {
-  auto ulog = [](float a) {CHECK_GT(a, 0.f); return log(a);};
-  traverse_unary<float>(in, out, ulog);
+#define DEFINE_CPP_COMPARE(Name)                                              \
+  template <typename DType>                                                   \
+  void Name(const Tensor& in, const DType x, Tensor* out, Context *ctx) {     \
+    typedef compute_t<DType> CType;                                           \
+    traverse_unary<DType>(in, out,                                            \
+                          Name##ScalarFn<CType>(static_cast<CType>(x)), ctx); \
+  }                                                                           \
+  template <typename DType>                                                   \
+  void Name(const Tensor& in1, const Tensor& in2, Tensor* out,                \
+            Context *ctx) {                                                   \
+    traverse_binary<DType>(in1, in2, out, Name##Fn<compute_t<DType>>(), ctx); \
+  }
+
+DEFINE_CPP_COMPARE(GE)
+DEFINE_CPP_COMPARE(GT)
+DEFINE_CPP_COMPARE(LE)
+DEFINE_CPP_COMPARE(LT)
+#undef DEFINE_CPP_COMPARE
+
+template <typename DType>
+void Log(const Tensor& in, Tensor* out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  auto ulog = [](CType a) {CHECK_GT(a, CType(0)); return std::log(a);};
+  traverse_unary<DType>(in, out, ulog, ctx);
 }
 
-template <>
-void LT<float, lang::Cpp>(const Tensor& in, const float x, Tensor* out,
-                          Context *ctx) {
-  auto lt_lambda = [&x](float a) {
-    return (a < x) ? 1.f : 0.f;
+template <typename DType>
+void Pow(const Tensor& in, const DType x, Tensor *out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  CType e = static_cast<CType>(x);
+  traverse_unary<DType>(in, out, [e](CType y) {return std::pow(y, e);}, ctx);
+}
+
+template <typename DType>
+void Pow(const Tensor& in1, const Tensor& in2, Tensor* out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  auto pow_lambda_binary = [](CType a, CType b) {
+    return std::pow(a, b);
   };
-  traverse_unary<float>(in, out, lt_lambda);
+  traverse_binary<DType>(in1, in2, out, pow_lambda_binary, ctx);
 }
 
+template <typename DType>
+void Quantize(const Tensor& in, const float scale, Tensor* out,
+              Context *ctx) {
+  const float inv_scale = 1.f / scale;
+  traverse_convert<DType, int8_t>(in, out,
+      [inv_scale](const DType* x, int8_t* y, size_t n) {
+        quantize_kernel(x, y, n, inv_scale);
+      }, ctx);
+}
 
-template <>
-void LT<float, lang::Cpp>(const Tensor& in1, const Tensor& in2, Tensor* out,
-                          Context *ctx) {
-  auto lt_lambda_binary = [](float a, float b) {
-    return (a < b) ? 1.f : 0.f;
-  };
-  traverse_binary<float>(in1, in2, out, lt_lambda_binary);
+template <typename DType>
+void ReLU(const Tensor& in, Tensor* out, Context *ctx) {
+  traverse_unary<DType>(in, out, ReLUFn<compute_t<DType>>(), ctx);
 }
 
-template <>
-void Pow<float, lang::Cpp>(const Tensor& in, const float x, Tensor *out, Context *ctx) {
-  traverse_unary<float>(in, out, [x](float y) {return pow(y, x);});
+template <typename DType>
+void Set(const DType x, Tensor* out, Context *ctx) {
+  DType *outPtr = static_cast<DType *>(out->block()->mutable_data());
+  std::fill(outPtr, outPtr + out->Size(), x);
 }
 
-template <>
-void Pow<float, lang::Cpp>(const Tensor& in1, const Tensor& in2, Tensor* out,
-                           Context *ctx) {
-  auto pow_lambda_binary = [](float a, float b) {
-    return pow(a, b);
+template <typename DType>
+void Sigmoid(const Tensor& in, Tensor* out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  auto sigmoid_lambda = [](CType a) {
+    return CType(1) / (CType(1) + std::exp(-a));
   };
-  traverse_binary<float>(in1, in2, out, pow_lambda_binary);
+  traverse_unary<DType>(in, out, sigmoid_lambda, ctx);
 }
 
-template <>
-void ReLU<float, lang::Cpp>(const Tensor& in, Tensor* out,
-                            Context *ctx) {
-  auto relu_lambda = [](float a) {
-    return (a >= 0.f) ? a : 0.f;
-  };
-  traverse_unary<float>(in, out, relu_lambda);
+template <typename DType>
+void Sign(const Tensor& in, Tensor* out, Context *ctx) {
+  traverse_unary<DType>(in, out, SignFn<compute_t<DType>>(), ctx);
 }
 
-template <>
-void Set<float, lang::Cpp>(const float x, Tensor* out,
-                           Context *ctx) {
-  float *outPtr = static_cast<float *>(out->block()->mutable_data());
-  for (size_t i = 0; i < out->Size(); i++) outPtr[i] = x;
+template <typename DType>
+void Sqrt(const Tensor& in, Tensor* out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  auto usqrt = [](CType a) {CHECK_GE(a, CType(0)); return std::sqrt(a);};
+  traverse_unary<DType>(in, out, usqrt, ctx);
 }
 
-template <>
-void Set<int, lang::Cpp>(const int x, Tensor* out,
-                         Context *ctx) {
-  int *outPtr = static_cast<int *>(out->block()->mutable_data());
-  for (size_t i = 0; i < out->Size(); i++) outPtr[i] = x;
+template <typename DType>
+void Sub(const Tensor& in1, const Tensor& in2, Tensor* out, Context *ctx) {
+  traverse_binary<DType>(in1, in2, out, SubFn(), ctx);
 }
 
-template <>
-void Sigmoid<float, lang::Cpp>(const Tensor& in, Tensor* out,
-                               Context *ctx) {
-  auto sigmoid_lambda = [](float a) {
-    return 1.f / (1.f + exp(-a));
-  };
-  traverse_unary<float>(in, out, sigmoid_lambda);
+// sum all elements of input into out
+template <typename DType>
+void Sum(const Tensor& in, DType *out, Context *ctx) {
+  *out = static_cast<DType>(reduce_tensor<DType>(in, IdentityFn(), AddFn(),
+                                                 compute_t<DType>(0), ctx));
 }
 
-template <>
-void Sign<float, lang::Cpp>(const Tensor& in, Tensor* out,
-                            Context *ctx) {
-  auto sign_lambda = [](float a) {
-    return (a > 0) - (a < 0);
-  };
-  traverse_unary<float>(in, out, sign_lambda);
+// out[r] = sum_c in[r][c] for matrix 'in'; rows are reduced in parallel.
+template <typename DType>
+void SumColumns(const Tensor& in, Tensor* out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  const DType *inPtr = static_cast<const DType *>(in.block()->data());
+  DType *outPtr = static_cast<DType *>(out->block()->mutable_data());
+  const size_t nrow = in.shape(0), ncol = in.shape(1);
+  const int rstride = in.stride()[0], cstride = in.stride()[1],
+            ostride = out->stride().back();
+  parallel_for(ctx, nrow, [&](size_t begin, size_t end) {
+    for (size_t r = begin; r < end; r++) {
+      const DType* x = inPtr + r * rstride;
+      CType s = 0;
+      if (cstride == 1) {
+        s = reduce(x, ncol, IdentityFn(), AddFn(), CType(0), nullptr);
+      } else {
+        for (size_t c = 0; c < ncol; c++)
+          s += static_cast<CType>(x[c * cstride]);
+      }
+      outPtr[r * ostride] = static_cast<DType>(s);
+    }
+  }, ncol);
 }
 
-template <>
-void Sqrt<float, lang::Cpp>(const Tensor& in, Tensor* out,
-                            Context *ctx) {
-  auto usqrt = [](float a) {CHECK_GE(a, 0.f); return sqrt(a);};
-  traverse_unary<float>(in, out, usqrt);
+// out[c] = sum_r in[r][c] for matrix 'in'; chunks of columns are accumulated
+// in parallel with SIMD adds of rows.
+template <typename DType>
+void SumRows(const Tensor& in, Tensor* out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  const size_t kChunk = 256;
+  const DType *inPtr = static_cast<const DType *>(in.block()->data());
+  DType *outPtr = static_cast<DType *>(out->block()->mutable_data());
+  const size_t nrow = in.shape(0), ncol = in.shape(1);
+  const int rstride = in.stride()[0], cstride = in.stride()[1],
+            ostride = out->stride().back();
+  parallel_for(ctx, ncol, [&](size_t begin, size_t end) {
+    CType acc[kChunk], buf[kChunk];
+    for (size_t c0 = begin; c0 < end; c0 += kChunk) {
+      size_t m = std::min(kChunk, end - c0);
+      std::fill(acc, acc + m, CType(0));
+      for (size_t r = 0; r < nrow; r++) {
+        const DType* x = inPtr + r * rstride + c0 * cstride;
+        if (cstride == 1) {
+          binary_kernel(acc, load_compute(x, buf, m), acc, m, AddFn(),
+                        std::true_type());
+        } else {
+          for (size_t c = 0; c < m; c++)
+            acc[c] += static_cast<CType>(x[c * cstride]);
+        }
+      }
+      for (size_t c = 0; c < m; c++)
+        outPtr[(c0 + c) * ostride] = static_cast<DType>(acc[c]);
+    }
+  }, nrow);
 }
 
-template <>
-void Sub<float, lang::Cpp>(const Tensor& in1, const Tensor& in2,
-                           Tensor* out, Context *ctx) {
-  // CHECK_EQ(ctx->stream, nullptr);
-  auto sub_lambda_binary = [](float a, float b) {
-    return (a - b);
+template <typename DType>
+void Tanh(const Tensor& in, Tensor* out, Context *ctx) {
+  typedef compute_t<DType> CType;
+  auto tanh_lambda = [](CType a) {
+    return std::tanh(a);
   };
-  traverse_binary<float>(in1, in2, out, sub_lambda_binary);
+  traverse_unary<DType>(in, out, tanh_lambda, ctx);
 }
 
-// sum all elements of input into out
-// TODO(wangwei) optimize using omp
-template <>
-void Sum<float, lang::Cpp>(const Tensor& in, float *out,
-                           Context *ctx) {
-  float s = 0.f;
-  const float *inPtr = static_cast<const float *>(in.block()->data());
-  for (size_t i = 0; i < in.Size(); i++) {
-    s += inPtr[i];
-  }
-  *out = s;
+template <typename DType>
+void Transform(const Tensor& in, Tensor* out, Context *ctx) {
+  traverse_unary<DType>(in, out, IdentityFn(), ctx);
 }
 
+}  // namespace cpp
+
+// Specialize the kernels above for lang::Cpp; the transcendental functions
+// are defined for floating point types only.
+#define SPECIALIZE_CPP_UNARY(fn, DType)                                    \
+  template <>                                                              \
+  void fn<DType, lang::Cpp>(const Tensor& in, Tensor* out, Context *ctx) { \
+    cpp::fn<DType>(in, out, ctx);                                          \
+  }
+
+#define SPECIALIZE_CPP_SCALAR(fn, DType)                                   \
+  template <>                                                              \
+  void fn<DType, lang::Cpp>(const Tensor& in, const DType x, Tensor* out,  \
+                            Context *ctx) {                                \
+    cpp::fn<DType>(in, x, out, ctx);                                       \
+  }
+
+#define SPECIALIZE_CPP_BINARY(fn, DType)                                   \
+  template <>                                                              \
+  void fn<DType, lang::Cpp>(const Tensor& in1, const Tensor& in2,          \
+                            Tensor* out, Context *ctx) {                   \
+    cpp::fn<DType>(in1, in2, out, ctx);                                    \
+  }
+
+#define SPECIALIZE_CPP_OTHERS(unused, DType)                               \
+  template <>                                                              \
+  void Clamp<DType, lang::Cpp>(const DType low, const DType high,          \
+                               const Tensor& in, Tensor* out,              \
+                               Context *ctx) {                             \
+    cpp::Clamp<DType>(low, high, in, out, ctx);                            \
+  }                                                                        \
+  template <>                                                              \
+  void Div<DType, lang::Cpp>(const DType x, const Tensor& in, Tensor* out, \
+                             Context *ctx) {                               \
+    cpp::Div<DType>(x, in, out, ctx);                                      \
+  }                                                                        \
+  template <>                                                              \
+  void Set<DType, lang::Cpp>(const DType x, Tensor* out, Context *ctx) {   \
+    cpp::Set<DType>(x, out, ctx);                                          \
+  }                                                                        \
+  template <>                                                              \
+  void Sum<DType, lang::Cpp>(const Tensor& in, DType *out, Context *ctx) { \
+    cpp::Sum<DType>(in, out, ctx);                                         \
+  }
+
+#define SPECIALIZE_CPP_REDUCE(fn, DType)                                   \
+  template <>                                                              \
+  void fn<DType, lang::Cpp>(const Tensor& in, DType *out, Context *ctx) {  \
+    cpp::fn<DType>(in, out, ctx);                                          \
+  }
+
+#define SPECIALIZE_CPP_ARG(fn, DType)                                      \
+  template <>                                                              \
+  void fn<DType, lang::Cpp>(const Tensor& in, size_t *out, Context *ctx) { \
+    cpp::fn<DType>(in, out, ctx);                                          \
+  }
+
+#define FOR_ALL_CPP_TYPES(SPECIALIZE, fn) \
+  SPECIALIZE(fn, float) SPECIALIZE(fn, double) SPECIALIZE(fn, int) \
+  SPECIALIZE(fn, half)
+#define FOR_REAL_CPP_TYPES(SPECIALIZE, fn) \
+  SPECIALIZE(fn, float) SPECIALIZE(fn, double) SPECIALIZE(fn, half)
+
 template <>
-void Tanh<float, lang::Cpp>(const Tensor& in, Tensor* out,
-                            Context *ctx) {
-  auto tanh_lambda = [](float a) {
-    return tanh(a);
-  };
-  traverse_unary<float>(in, out, tanh_lambda);
+void Dequantize<float, lang::Cpp>(const Tensor& in, const float scale,
+                                  Tensor* out, Context *ctx) {
+  cpp::Dequantize<float>(in, scale, out, ctx);
 }
 
 template <>
-void Transform<float, lang::Cpp>(const Tensor& in, Tensor* out,
-                                 Context *ctx) {
-  auto identity = [](float a) {return a;};
-  traverse_unary<float>(in, out, identity);
+void Quantize<float, lang::Cpp>(const Tensor& in, const float scale,
+                                Tensor* out, Context *ctx) {
+  cpp::Quantize<float>(in, scale, out, ctx);
 }
 
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_UNARY, Abs)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_UNARY, ReLU)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_UNARY, Sign)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_UNARY, Transform)
+FOR_REAL_CPP_TYPES(SPECIALIZE_CPP_UNARY, Exp)
+FOR_REAL_CPP_TYPES(SPECIALIZE_CPP_UNARY, Log)
+FOR_REAL_CPP_TYPES(SPECIALIZE_CPP_UNARY, Sigmoid)
+FOR_REAL_CPP_TYPES(SPECIALIZE_CPP_UNARY, Sqrt)
+FOR_REAL_CPP_TYPES(SPECIALIZE_CPP_UNARY, Tanh)
+
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_SCALAR, Add)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_SCALAR, EltwiseMult)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_SCALAR, GE)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_SCALAR, GT)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_SCALAR, LE)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_SCALAR, LT)
+FOR_REAL_CPP_TYPES(SPECIALIZE_CPP_SCALAR, Pow)
+// the generic Div(in, x) multiplies by 1 / x, which is 0 for integers
+SPECIALIZE_CPP_SCALAR(Div, int)
+
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_BINARY, Add)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_BINARY, Div)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_BINARY, EltwiseMult)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_BINARY, GE)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_BINARY, GT)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_BINARY, LE)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_BINARY, LT)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_BINARY, Sub)
+FOR_REAL_CPP_TYPES(SPECIALIZE_CPP_BINARY, Pow)
+
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_OTHERS, )
+
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_ARG, Amax)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_ARG, Amin)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_REDUCE, Asum)
+FOR_REAL_CPP_TYPES(SPECIALIZE_CPP_REDUCE, Nrm2)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_UNARY, SumColumns)
+FOR_ALL_CPP_TYPES(SPECIALIZE_CPP_UNARY, SumRows)
+
+#undef FOR_ALL_CPP_TYPES
+#undef FOR_REAL_CPP_TYPES
+#undef SPECIALIZE_CPP_UNARY
+#undef SPECIALIZE_CPP_SCALAR
+#undef SPECIALIZE_CPP_BINARY
+#undef SPECIALIZE_CPP_OTHERS
+#undef SPECIALIZE_CPP_REDUCE
+#undef SPECIALIZE_CPP_ARG
+
 template <>
 void Bernoulli<float, lang::Cpp>(const float p, Tensor* out,
                                  Context *ctx) {
@@ -535,19 +1397,6 @@ void DGMM<float, lang::Cpp>(const bool side_right,
 
 
 #ifdef USE_CBLAS
-template <>
-void Amax<float, lang::Cpp>(const Tensor& in, size_t *out,
-                            Context *ctx) {
-  const float *inPtr = static_cast<const float *>(in.block()->data());
-  *out = cblas_isamax(in.Size(), inPtr, 1); //not using strided traversal
-}
-
-template <>
-void Asum<float, lang::Cpp>(const Tensor& in, float *out,
-                            Context *ctx) {
-  const float *inPtr = static_cast<const float *>(in.block()->data());
-  *out = cblas_sasum(in.Size(), inPtr, 1); //not using strided traversal
-}
 
 // template <>
 // void Axpy<float, lang::Cpp>(const float alpha,
@@ -616,13 +1465,6 @@ void Scale<float, lang::Cpp>(const float x, Tensor *out,
   cblas_sscal(out->Size(), x, outPtr, 1); //not using strided traversal
 }
 
-template <>
-void Nrm2<float, lang::Cpp>(const Tensor& in, float *out,
-                            Context *ctx) {
-  const float *inPtr = static_cast<const float *>(in.block()->data());
-  *out = cblas_snrm2(in.Size(), inPtr, 1); //not using strided traversal
-}
-
 template <>
 void GEMV<float, lang::Cpp>(const float alpha, const Tensor& A, const Tensor& v,
                             const float beta, Tensor *out, Context *ctx) {
@@ -663,49 +1505,6 @@ void GEMM<float, lang::Cpp>(const float alpha,
 
 #else
 
-template <>
-void Amax<float, lang::Cpp>(const Tensor& in, size_t *out,
-                            Context *ctx) {
-  size_t maxPos = 0;
-  float maxVal = 0;
-  const float *inPtr = static_cast<const float *>(in.block()->data());
-  for (size_t i = 0; i < in.Size(); i++) { //not using strided traversal
-    if (i == 0) {
-      maxVal = inPtr[i];
-    } else if (inPtr[i] > maxVal) {
-      maxVal = inPtr[i];
-      maxPos = i;
-    }
-  }
-  *out = maxPos;
-}
-template <>
-void Amin<float, lang::Cpp>(const Tensor& in, size_t *out,
-                            Context *ctx) {
-  size_t minPos = 0;
-  float minVal = 0;
-  const float *inPtr = static_cast<const float *>(in.block()->data());
-  for (size_t i = 0; i < in.Size(); i++) { //not using strided traversal
-    if (i == 0) {
-      minVal = inPtr[i];
-    } else if (inPtr[i] > minVal) {
-      minVal = inPtr[i];
-      minPos = i;
-    }
-  }
-  *out = minPos;
-}
-
-template <>
-void Asum<float, lang::Cpp>(const Tensor& in, float *out,
-                            Context *ctx) {
-  float sum = 0;
-  const float *inPtr = static_cast<const float *>(in.block()->data());
-  for (size_t i = 0; i < in.Size(); i++) {
-    sum += fabs(inPtr[i]); //not using strided traversal
-  }
-}
-
 template <>
 void Axpy<float, lang::Cpp>(const float alpha,
                             const Tensor& in, Tensor *out, Context *ctx) {
@@ -19,14 +19,66 @@
 #include "singa/io/reader.h"
 #include "singa/utils/logging.h"
 
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // _WIN32
+
 namespace singa {
 namespace io {
+namespace {
+const char kIndexMagic[4] = {'s', 'g', 'i', 'y'};
+
+bool IsMagic(const char* magic) {
+  return magic[0] == 's' && magic[1] == 'g' && (magic[2] == 0 || magic[2] == 1);
+}
+
+// Parse the tuple at 'offset' of the 'size' bytes at 'base' into views.
+// Return the offset of the next tuple, or 0 if the tuple is truncated or
+// does not start with the magic word.
+uint64_t ParseTuple(const char* base, size_t size, uint64_t offset,
+                    StringView* key, StringView* value) {
+  const char* magic = base + offset;
+  uint64_t pos = offset + 4;
+  if (pos > size || !IsMagic(magic)) return 0;
+  size_t len;
+  if (magic[2] == 1) {
+    if (pos + sizeof(len) > size) return 0;
+    memcpy(&len, base + pos, sizeof(len));
+    pos += sizeof(len);
+    if (len > size - pos) return 0;
+    if (key != nullptr) *key = StringView(base + pos, len);
+    pos += len;
+  } else if (key != nullptr) {
+    *key = StringView();
+  }
+  if (pos + sizeof(len) > size) return 0;
+  memcpy(&len, base + pos, sizeof(len));
+  pos += sizeof(len);
+  if (len > size - pos) return 0;
+  if (value != nullptr) *value = StringView(base + pos, len);
+  return pos + len;
+}
+}  // namespace
+
 bool BinFileReader::Open(const std::string& path) {
+  Close();
   path_ = path;
+#ifdef _WIN32
   return OpenFile();
+#else
+  return MapFile();
+#endif  // _WIN32
 }
 
 bool BinFileReader::Open(const std::string& path, int capacity) {
+  Close();
   path_ = path;
   capacity_ = capacity;
   return OpenFile();
@@ -38,9 +90,25 @@ void BinFileReader::Close() {
     buf_ = nullptr;
   }
   if (fdat_.is_open()) fdat_.close();
+#ifndef _WIN32
+  if (map_ != nullptr) munmap(const_cast<char*>(map_), size_);
+#endif  // _WIN32
+  map_ = nullptr;
+  size_ = 0;
+  mmap_mode_ = false;
+  index_.clear();
+  order_.clear();
+  cursor_ = 0;
 }
 
 bool BinFileReader::Read(std::string* key, std::string* value) {
+  if (mmap_mode_) {
+    StringView k, v;
+    if (!Read(&k, &v)) return false;
+    key->assign(k.data(), k.size());
+    value->assign(v.data(), v.size());
+    return true;
+  }
   CHECK(fdat_.is_open()) << "File not open!";
   char magic[4];
   int smagic = sizeof(magic);
@@ -61,7 +129,23 @@ bool BinFileReader::Read(std::string* key, std::string* value) {
   return true;
 }
 
+bool BinFileReader::Read(StringView* key, StringView* value) {
+  CHECK(mmap_mode_) << "Zero-copy reads need the memory-mapped mode";
+  if (cursor_ >= index_.size()) return false;
+  ReadAt(order_.empty() ? cursor_ : order_[cursor_], key, value);
+  cursor_++;
+  return true;
+}
+
+void BinFileReader::ReadAt(size_t i, StringView* key, StringView* value) const {
+  CHECK(mmap_mode_) << "Random access needs the memory-mapped mode";
+  CHECK_LT(i, index_.size());
+  CHECK_NE(ParseTuple(map_, size_, index_[i], key, value), 0u)
+      << "Corrupt tuple at offset " << index_[i];
+}
+
 int BinFileReader::Count() {
+  if (mmap_mode_) return static_cast<int>(index_.size());
   std::ifstream fin(path_, std::ios::in | std::ios::binary);
   CHECK(fin.is_open()) << "Cannot create file " << path_;
   int count = 0;
@@ -87,6 +171,8 @@ int BinFileReader::Count() {
 }
 
 void BinFileReader::SeekToFirst() {
+  cursor_ = 0;
+  if (mmap_mode_) return;
   bufsize_ = 0;
   offset_ = 0;
   fdat_.clear();
@@ -94,6 +180,114 @@ void BinFileReader::SeekToFirst() {
   CHECK(fdat_.is_open()) << "Cannot create file " << path_;
 }
 
+void BinFileReader::Seek(size_t i) {
+  CHECK(mmap_mode_) << "Seek needs the memory-mapped mode";
+  CHECK_LE(i, index_.size());
+  cursor_ = i;
+}
+
+void BinFileReader::Shuffle(unsigned seed) {
+  CHECK(mmap_mode_) << "Shuffle needs the memory-mapped mode";
+  CHECK_LE(index_.size(), static_cast<size_t>(UINT32_MAX));
+  order_.resize(index_.size());
+  std::iota(order_.begin(), order_.end(), 0u);
+  std::shuffle(order_.begin(), order_.end(), std::mt19937(seed));
+  cursor_ = 0;
+#ifndef _WIN32
+  if (map_ != nullptr)
+    madvise(const_cast<char*>(map_), size_, MADV_RANDOM);
+#endif  // _WIN32
+}
+
+bool BinFileReader::MapFile() {
+#ifdef _WIN32
+  return false;
+#else
+  int fd = open(path_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(WARNING) << "Cannot open file " << path_;
+    return false;
+  }
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Cannot stat file " << path_;
+  size_ = static_cast<size_t>(st.st_size);
+#ifdef __APPLE__
+  mtime_ = st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+  mtime_ = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif  // __APPLE__
+  if (size_ > 0) {
+    void* ptr = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    CHECK(ptr != MAP_FAILED) << "Cannot mmap file " << path_;
+    map_ = static_cast<const char*>(ptr);
+    madvise(ptr, size_, MADV_SEQUENTIAL);
+  }
+  close(fd);
+  mmap_mode_ = true;
+  if (!LoadIndex()) BuildIndex();
+  return true;
+#endif  // _WIN32
+}
+
+void BinFileReader::BuildIndex() {
+  index_.clear();
+  uint64_t offset = 0;
+  while (offset < size_) {
+    uint64_t next = ParseTuple(map_, size_, offset, nullptr, nullptr);
+    if (next == 0) {
+      CHECK(size_ - offset < 4 || IsMagic(map_ + offset))
+          << "File format error: magic word does not match at offset "
+          << offset;
+      LOG(WARNING) << "Ignore the truncated tuple at the end of " << path_;
+      break;
+    }
+    index_.push_back(offset);
+    offset = next;
+  }
+}
+
+// The sidecar has the magic word, the data file size and modification time
+// (in nanoseconds), the number of tuples and their offsets.
+bool BinFileReader::LoadIndex() {
+  std::ifstream fin(path_ + ".idx", std::ios::in | std::ios::binary);
+  if (!fin.is_open()) return false;
+  char magic[4];
+  uint64_t size = 0, count = 0;
+  int64_t mtime = 0;
+  fin.read(magic, sizeof(magic));
+  fin.read(reinterpret_cast<char*>(&size), sizeof(size));
+  fin.read(reinterpret_cast<char*>(&mtime), sizeof(mtime));
+  fin.read(reinterpret_cast<char*>(&count), sizeof(count));
+  // the data file may have been rewritten with the same size
+  if (!fin.good() || memcmp(magic, kIndexMagic, sizeof(magic)) != 0 ||
+      size != size_ || mtime != mtime_ || count > size_)
+    return false;
+  index_.resize(count);
+  fin.read(reinterpret_cast<char*>(index_.data()), count * sizeof(uint64_t));
+  if (!fin.good() || (count > 0 && (index_.front() != 0 ||
+      ParseTuple(map_, size_, index_.back(), nullptr, nullptr) == 0))) {
+    index_.clear();
+    return false;
+  }
+  return true;
+}
+
+bool BinFileReader::SaveIndex() const {
+  CHECK(mmap_mode_) << "The index is built in the memory-mapped mode";
+  std::ofstream fout(path_ + ".idx",
+                     std::ios::binary | std::ios::out | std::ios::trunc);
+  if (!fout.is_open()) return false;
+  uint64_t size = size_, count = index_.size();
+  int64_t mtime = mtime_;
+  fout.write(kIndexMagic, sizeof(kIndexMagic));
+  fout.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  fout.write(reinterpret_cast<const char*>(&mtime), sizeof(mtime));
+  fout.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  fout.write(reinterpret_cast<const char*>(index_.data()),
+             count * sizeof(uint64_t));
+  return fout.good();
+}
+
 bool BinFileReader::OpenFile() {
   buf_ = new char[capacity_];
   fdat_.open(path_, std::ios::in | std::ios::binary);
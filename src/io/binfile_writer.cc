@@ -19,8 +19,43 @@
 #include "singa/io/writer.h"
 #include "singa/utils/logging.h"
 
+#include <cerrno>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // _WIN32
+
 namespace singa {
 namespace io {
+const int BinFileWriter::kDirectAlign;
+
+namespace {
+char* AlignedAlloc(size_t size) {
+  void* ptr = nullptr;
+#ifdef _WIN32
+  ptr = _aligned_malloc(size, BinFileWriter::kDirectAlign);
+#else
+  if (posix_memalign(&ptr, BinFileWriter::kDirectAlign, size) != 0)
+    ptr = nullptr;
+#endif  // _WIN32
+  CHECK(ptr != nullptr) << "Cannot allocate " << size << " bytes";
+  return static_cast<char*>(ptr);
+}
+
+void AlignedFree(char* ptr) {
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif  // _WIN32
+}
+}  // namespace
+
 bool BinFileWriter::Open(const std::string& path, Mode mode) {
   path_ = path;
   mode_ = mode;
@@ -35,8 +70,41 @@ bool BinFileWriter::Open(const std::string& path, Mode mode, int capacity) {
   return OpenFile();
 }
 
+bool BinFileWriter::OpenAsync(const std::string& path, Mode mode,
+                              int capacity, int num_buffers, bool direct) {
+  CHECK(!fdat_.is_open() && fd_ < 0);
+  CHECK_GE(num_buffers, 2);
+  path_ = path;
+  mode_ = mode;
+  // whole blocks for O_DIRECT
+  capacity_ = (capacity + kDirectAlign - 1) / kDirectAlign * kDirectAlign;
+  return OpenAsyncFile(num_buffers, direct);
+}
+
 void BinFileWriter::Close() {
   Flush();
+  if (async_) {
+    full_->Close();
+    if (io_thread_.joinable()) io_thread_.join();
+#if !defined(_WIN32) && defined(O_DIRECT)
+    if (direct_ && bufsize_ > 0)
+      CHECK_EQ(fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT), 0);
+#endif  // O_DIRECT
+    // the unaligned tail
+    if (bufsize_ > 0) WriteOut(buf_, bufsize_);
+    bufsize_ = 0;
+#ifndef _WIN32
+    close(fd_);
+#endif  // _WIN32
+    fd_ = -1;
+    for (char* b : buffers_) AlignedFree(b);
+    buffers_.clear();
+    buf_ = nullptr;
+    free_.reset();
+    full_.reset();
+    async_ = false;
+    direct_ = false;
+  }
   if (buf_ != nullptr) {
     delete [] buf_;
     buf_ = nullptr;
@@ -45,7 +113,7 @@ void BinFileWriter::Close() {
 }
 
 bool BinFileWriter::Write(const std::string& key, const std::string& value) {
-  CHECK(fdat_.is_open()) << "File not open!";
+  CHECK(fdat_.is_open() || fd_ >= 0) << "File not open!";
   if (value.size() == 0) return false;
   // magic_word + (key_len + key) + val_len + val
   char magic[4];
@@ -61,8 +129,9 @@ bool BinFileWriter::Write(const std::string& key, const std::string& value) {
   }
 
   if (bufsize_ + size > capacity_) {
-    fdat_.write(buf_, bufsize_);
-    bufsize_ = 0;
+    Spill();
+    // with O_DIRECT, the unaligned tail stays in the buffer, which has room
+    // for it beyond capacity_
     CHECK_LE(size, capacity_) << "Tuple size is larger than capacity "
                               << "Try a larger capacity size";
   }
@@ -83,13 +152,66 @@ bool BinFileWriter::Write(const std::string& key, const std::string& value) {
 }
 
 void BinFileWriter::Flush() {
-  if (bufsize_ > 0) {
+  if (async_) {
+    Spill();
+    std::unique_lock<std::mutex> lock(mtx_);
+    written_cv_.wait(lock, [this]() { return num_writing_ == 0; });
+  } else if (bufsize_ > 0) {
     fdat_.write(buf_, bufsize_);
     fdat_.flush();
     bufsize_ = 0;
   }
 }
 
+void BinFileWriter::Spill() {
+  if (!async_) {
+    fdat_.write(buf_, bufsize_);
+    bufsize_ = 0;
+    return;
+  }
+  size_t n = bufsize_;
+  if (direct_) n = n / kDirectAlign * kDirectAlign;
+  if (n == 0) return;
+  char* next = nullptr;
+  CHECK(free_->WaitAndPop(next));
+  // the unaligned tail starts the next buffer
+  std::memcpy(next, buf_ + n, bufsize_ - n);
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    num_writing_++;
+  }
+  full_->Push(std::make_pair(buf_, n));
+  buf_ = next;
+  bufsize_ -= static_cast<int>(n);
+}
+
+void BinFileWriter::Run() {
+  std::pair<char*, size_t> job;
+  while (full_->WaitAndPop(job)) {
+    WriteOut(job.first, job.second);
+    free_->Push(job.first);
+    std::lock_guard<std::mutex> lock(mtx_);
+    num_writing_--;
+    written_cv_.notify_all();
+  }
+}
+
+void BinFileWriter::WriteOut(const char* data, size_t size) {
+#ifndef _WIN32
+  while (size > 0) {
+    ssize_t ret = write(fd_, data, size);
+    if (ret < 0 && errno == EINTR) continue;
+    CHECK_GT(ret, 0) << "Cannot write file " << path_ << ": "
+                     << strerror(errno);
+    data += ret;
+    size -= static_cast<size_t>(ret);
+  }
+#else
+  fdat_.write(data, size);
+  CHECK(fdat_.good()) << "Cannot write file " << path_;
+#endif  // _WIN32
+}
+
 bool BinFileWriter::OpenFile() {
   CHECK(buf_ == nullptr);
   buf_ = new char[capacity_];
@@ -108,5 +230,52 @@ bool BinFileWriter::OpenFile() {
   }
   return fdat_.is_open();
 }
+
+bool BinFileWriter::OpenAsyncFile(int num_buffers, bool direct) {
+  CHECK(buf_ == nullptr);
+#ifdef _WIN32
+  direct = false;
+  if (mode_ == kCreate)
+    fdat_.open(path_, std::ios::binary | std::ios::out | std::ios::trunc);
+  else
+    fdat_.open(path_, std::ios::app | std::ios::binary);
+  CHECK(fdat_.is_open()) << "Cannot open file " << path_;
+#else
+  int flags = O_WRONLY | O_CREAT | (mode_ == kCreate ? O_TRUNC : O_APPEND);
+#ifdef O_DIRECT
+  if (direct) {
+    fd_ = open(path_.c_str(), flags | O_DIRECT, 0644);
+    struct stat st;
+    if (fd_ >= 0 && (fstat(fd_, &st) != 0 || st.st_size % kDirectAlign != 0)) {
+      // appending at an unaligned offset
+      close(fd_);
+      fd_ = -1;
+    }
+    if (fd_ < 0) {
+      LOG(WARNING) << "Cannot write " << path_ << " with O_DIRECT";
+      direct = false;
+    }
+  }
+#else
+  direct = false;
+#endif  // O_DIRECT
+  if (fd_ < 0) fd_ = open(path_.c_str(), flags, 0644);
+  CHECK_GE(fd_, 0) << "Cannot open file " << path_ << ": " << strerror(errno);
+#endif  // _WIN32
+  async_ = true;
+  direct_ = direct;
+  free_.reset(new SafeQueue<char*>());
+  full_.reset(new SafeQueue<std::pair<char*, size_t>>());
+  for (int i = 0; i < num_buffers; i++) {
+    // plus the unaligned tail kept by Spill()
+    buffers_.push_back(AlignedAlloc(capacity_ + kDirectAlign));
+    if (i > 0) free_->Push(buffers_.back());
+  }
+  buf_ = buffers_[0];
+  bufsize_ = 0;
+  num_writing_ = 0;
+  io_thread_ = std::thread(&BinFileWriter::Run, this);
+  return true;
+}
 }  // namespace io
 }  // namespace singa
@@ -17,33 +17,151 @@
  */
 
 #include "singa/io/decoder.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <string>
-#include <sstream>
 
-const int kMaxCSVBufSize = 40960;
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // _WIN32
 
 namespace singa {
+namespace {
+const double kPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                         1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                         1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
 
-std::vector<Tensor> CSVDecoder::Decode(std::string value) {
-  std::vector<Tensor> output;
-  std::stringstream ss;
-  ss.str(value);
-  int l = 0;
-  if (has_label_ == true)
-    ss >> l;
-  std::string str;
-  float d[kMaxCSVBufSize];
-  int size = 0;
-  while (std::getline(ss, str, ',')) {
-    float temp;
-    if (std::stringstream(str) >> temp) {
-      CHECK_LE(size, kMaxCSVBufSize - 1);
-      d[size++] = temp;
+inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Parse the number at [p, end) by strtof, for the cases beyond ParseFloat.
+const char* ParseFloatSlow(const char* p, const char* end, float* out) {
+  char buf[64];
+  size_t n = 0;
+  while (p + n < end && n + 1 < sizeof(buf) && p[n] != ',' && p[n] != '\n' &&
+         !IsSpace(p[n])) {
+    buf[n] = p[n];
+    n++;
+  }
+  buf[n] = '\0';
+  char* stop = buf;
+  *out = std::strtof(buf, &stop);
+  return p + (stop - buf);
+}
+
+// Parse a decimal number at [p, end); return the position after it, or p if
+// there is no number. The value is exact if it has at most 15 significant
+// digits and a decimal exponent within [-22, 22], because both the digits and
+// the power of 10 are exact in double; other numbers go to strtof.
+const char* ParseFloat(const char* p, const char* end, float* out) {
+  const char* start = p;
+  bool neg = false;
+  if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+  uint64_t mant = 0;
+  int digits = 0, exp10 = 0;
+  bool any = false;
+  for (; p < end && IsDigit(*p); p++, any = true) {
+    if (mant > 0 || *p != '0') digits++;
+    if (digits <= 19) mant = mant * 10 + (*p - '0');
+    else exp10++;
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && IsDigit(*p); p++, any = true) {
+      if (mant > 0 || *p != '0') digits++;
+      if (digits <= 19) {
+        mant = mant * 10 + (*p - '0');
+        exp10--;
+      }
     }
   }
+  if (!any) {
+    // nan, inf, etc.
+    const char* stop = ParseFloatSlow(start, end, out);
+    return stop;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool eneg = false;
+    if (q < end && (*q == '-' || *q == '+')) eneg = *q++ == '-';
+    if (q < end && IsDigit(*q)) {
+      int e = 0;
+      for (; q < end && IsDigit(*q); q++)
+        if (e < 10000) e = e * 10 + (*q - '0');
+      exp10 += eneg ? -e : e;
+      p = q;
+    }
+  }
+  if (digits > 15 || exp10 < -22 || exp10 > 22)
+    return ParseFloatSlow(start, end, out);
+  double v = static_cast<double>(mant);
+  v = exp10 < 0 ? v / kPow10[-exp10] : v * kPow10[exp10];
+  *out = static_cast<float>(neg ? -v : v);
+  return p;
+}
+
+// Parse one line [p, end) as an optional label and comma separated values;
+// values that cannot be parsed are skipped. Call emit(v) for each value and
+// return the label.
+template <typename Fn>
+int ParseRow(const char* p, const char* end, bool has_label, Fn emit) {
+  int label = 0;
+  float v;
+  if (has_label) {
+    while (p < end && IsSpace(*p)) p++;
+    const char* q = ParseFloat(p, end, &v);
+    if (q != p) label = static_cast<int>(v);
+    p = q;
+  }
+  while (p < end) {
+    while (p < end && (IsSpace(*p) || *p == ',')) p++;
+    if (p == end) break;
+    const char* q = ParseFloat(p, end, &v);
+    if (q != p) emit(v);
+    // skip the rest of the field
+    p = q;
+    while (p < end && *p != ',') p++;
+  }
+  return label;
+}
+
+bool IsBlank(const char* p, const char* end) {
+  for (; p < end; p++)
+    if (!IsSpace(*p)) return false;
+  return true;
+}
+
+// Find the end of the line starting at p, i.e., the '\n' or end.
+const char* LineEnd(const char* p, const char* end) {
+  const void* nl = std::memchr(p, '\n', end - p);
+  return nl != nullptr ? static_cast<const char*>(nl) : end;
+}
+
+// run fn(begin, end) over [0, n) on the thread pool of ctx if there is one
+void ParallelRun(Context* ctx, size_t n,
+                 const std::function<void(size_t, size_t)>& fn) {
+  if (ctx->thread_pool != nullptr && n > 1)
+    ctx->thread_pool->ParallelFor(0, n, 1, fn);
+  else
+    fn(0, n);
+}
 
-  Tensor data(Shape {static_cast<size_t>(size)}, kFloat32);
-  data.CopyDataFromHostPtr(d, size);
+const size_t kChunkSize = 1 << 20;
+}  // namespace
+
+std::vector<Tensor> CSVDecoder::Decode(std::string value) {
+  std::vector<float> d;
+  int l = ParseRow(value.data(), value.data() + value.size(), has_label_,
+                   [&d](float v) { d.push_back(v); });
+
+  std::vector<Tensor> output;
+  Tensor data(Shape {d.size()}, kFloat32);
+  data.CopyDataFromHostPtr(d.data(), d.size());
   output.push_back(data);
   if (has_label_ == true) {
     Tensor label(Shape {1}, kInt);
@@ -52,4 +170,135 @@ std::vector<Tensor> CSVDecoder::Decode(std::string value) {
   }
   return output;
 }
+
+void CSVDecoder::DecodeInto(const char* value, size_t size, size_t index,
+                            std::vector<Tensor>* batch) {
+  CHECK_EQ(batch->size(), has_label_ ? 2u : 1u);
+  Tensor& data = batch->at(0);
+  CHECK_EQ(data.data_type(), kFloat32);
+  CHECK_LT(index, data.shape(0));
+  const size_t cols = data.Size() / data.shape(0);
+  float* row = static_cast<float*>(data.block()->mutable_data()) + index * cols;
+  size_t n = 0;
+  int l = ParseRow(value, value + size, has_label_, [&](float v) {
+    CHECK_LT(n, cols) << "The row does not fit the batch";
+    row[n++] = v;
+  });
+  CHECK_EQ(n, cols) << "The row does not fit the batch";
+  if (has_label_) {
+    Tensor& label = batch->at(1);
+    CHECK_EQ(label.data_type(), kInt);
+    static_cast<int*>(label.block()->mutable_data())[index] = l;
+  }
+}
+
+std::vector<Tensor> CSVDecoder::DecodeBlock(const char* text, size_t size,
+                                            std::shared_ptr<Device> dev) {
+  CHECK_EQ(dev->lang(), kCpp);
+  const char* end = text + size;
+  // the number of values per row is from the first non-empty line
+  size_t cols = 0;
+  for (const char* p = text; p < end; p = LineEnd(p, end) + 1) {
+    const char* e = LineEnd(p, end);
+    if (!IsBlank(p, e)) {
+      ParseRow(p, e, has_label_, [&cols](float) { cols++; });
+      break;
+    }
+  }
+
+  // chunks of whole lines
+  std::vector<const char*> bounds{text};
+  for (size_t i = 1; i < (size + kChunkSize - 1) / kChunkSize; i++) {
+    const char* p = std::max(text + i * kChunkSize, bounds.back());
+    p = std::min(LineEnd(p, end) + 1, end);
+    if (p > bounds.back() && p < end) bounds.push_back(p);
+  }
+  bounds.push_back(end);
+  const size_t nchunk = bounds.size() - 1;
+
+  // count the rows of each chunk, then parse each chunk into its rows
+  std::vector<size_t> offsets(nchunk + 1, 0);
+  size_t* offset = offsets.data();
+  const char* const* bound = bounds.data();
+  dev->Exec([=](Context* ctx) {
+    ParallelRun(ctx, nchunk, [&](size_t begin, size_t stop) {
+      for (size_t i = begin; i < stop; i++)
+        for (const char* p = bound[i]; p < bound[i + 1];) {
+          const char* e = LineEnd(p, bound[i + 1]);
+          if (!IsBlank(p, e)) offset[i + 1]++;
+          p = e + 1;
+        }
+    });
+  }, {}, {});
+  dev->Sync();
+  for (size_t i = 0; i < nchunk; i++) offsets[i + 1] += offsets[i];
+  const size_t rows = offsets[nchunk];
+
+  Tensor data(Shape{rows, cols}, dev, kFloat32);
+  Tensor label(Shape{rows}, dev, kInt);
+  const bool has_label = has_label_;
+  std::vector<Block*> blocks{data.block()};
+  if (has_label) blocks.push_back(label.block());
+  dev->Exec([=](Context* ctx) mutable {
+    float* x = rows ? static_cast<float*>(data.block()->mutable_data())
+                    : nullptr;
+    int* y = rows && has_label ?
+        static_cast<int*>(label.block()->mutable_data()) : nullptr;
+    ParallelRun(ctx, nchunk, [&](size_t begin, size_t stop) {
+      for (size_t i = begin; i < stop; i++) {
+        size_t r = offset[i];
+        for (const char* p = bound[i]; p < bound[i + 1];) {
+          const char* e = LineEnd(p, bound[i + 1]);
+          if (!IsBlank(p, e)) {
+            float* row = x + r * cols;
+            size_t n = 0;
+            int l = ParseRow(p, e, has_label, [&](float v) {
+              CHECK_LT(n, cols) << "Row " << r << " has more than " << cols
+                                << " values";
+              row[n++] = v;
+            });
+            CHECK_EQ(n, cols) << "Row " << r << " has fewer values";
+            if (y != nullptr) y[r] = l;
+            r++;
+          }
+          p = e + 1;
+        }
+      }
+    });
+  }, {}, blocks);
+  // the text and the offsets are borrowed by the parsing
+  dev->Sync();
+
+  std::vector<Tensor> output{data};
+  if (has_label_) output.push_back(label);
+  return output;
+}
+
+std::vector<Tensor> CSVDecoder::DecodeFile(const std::string& path,
+                                           std::shared_ptr<Device> dev) {
+#ifdef _WIN32
+  std::ifstream fin(path, std::ios::in | std::ios::binary);
+  CHECK(fin.is_open()) << "Cannot open file " << path;
+  std::string text((std::istreambuf_iterator<char>(fin)),
+                   std::istreambuf_iterator<char>());
+  return DecodeBlock(text.data(), text.size(), dev);
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  CHECK_GE(fd, 0) << "Cannot open file " << path;
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Cannot stat file " << path;
+  size_t size = static_cast<size_t>(st.st_size);
+  void* ptr = nullptr;
+  if (size > 0) {
+    ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    CHECK(ptr != MAP_FAILED) << "Cannot mmap file " << path;
+    madvise(ptr, size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+  std::vector<Tensor> output =
+      DecodeBlock(static_cast<const char*>(ptr), size, dev);
+  if (ptr != nullptr) munmap(ptr, size);
+  return output;
+#endif  // _WIN32
+}
 }  // namespace singa
@@ -0,0 +1,88 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "singa/io/decoder.h"
+#include "singa/utils/vector_ext.h"
+#include <cstring>
+
+namespace singa {
+
+void Decoder::DecodeInto(const char* value, size_t size, size_t index,
+                         std::vector<Tensor>* batch) {
+  std::vector<Tensor> sample = Decode(std::string(value, size));
+  CHECK_EQ(sample.size(), batch->size());
+  for (size_t k = 0; k < sample.size(); k++) {
+    Tensor& dst = batch->at(k);
+    CHECK_EQ(sample[k].data_type(), dst.data_type());
+    CHECK_EQ(sample[k].Size() * dst.shape(0), dst.Size())
+        << "The sample does not fit the batch";
+    CHECK_LT(index, dst.shape(0));
+    size_t bytes = sample[k].Size() * SizeOf(dst.data_type());
+    std::memcpy(static_cast<char*>(dst.block()->mutable_data()) + index * bytes,
+                sample[k].data<char>(), bytes);
+  }
+}
+
+void ImageToFloat(const uint8_t* hwc, size_t height, size_t width,
+                  size_t channel, bool chw, float* out) {
+  const size_t npixel = height * width;
+  size_t i = 0;
+  if (!chw || channel == 1) {
+    const size_t n = npixel * channel;
+#ifdef SINGA_CONVERTVECTOR
+    for (; i + 4 <= n; i += 4) {
+      u8x4 b;
+      std::memcpy(&b, hwc + i, sizeof(b));
+      f32x4 f = __builtin_convertvector(b, f32x4);
+      std::memcpy(out + i, &f, sizeof(f));
+    }
+#endif  // SINGA_CONVERTVECTOR
+    for (; i < n; i++) out[i] = hwc[i];
+    return;
+  }
+  if (channel == 3) {
+    // de-interleave 4 pixels at a time
+    float* r0 = out;
+    float* r1 = out + npixel;
+    float* r2 = out + 2 * npixel;
+#ifdef SINGA_CONVERTVECTOR
+    for (; i + 4 <= npixel; i += 4) {
+      const uint8_t* p = hwc + i * 3;
+      u8x4 b0 = {p[0], p[3], p[6], p[9]}, b1 = {p[1], p[4], p[7], p[10]},
+           b2 = {p[2], p[5], p[8], p[11]};
+      f32x4 f0 = __builtin_convertvector(b0, f32x4),
+            f1 = __builtin_convertvector(b1, f32x4),
+            f2 = __builtin_convertvector(b2, f32x4);
+      std::memcpy(r0 + i, &f0, sizeof(f0));
+      std::memcpy(r1 + i, &f1, sizeof(f1));
+      std::memcpy(r2 + i, &f2, sizeof(f2));
+    }
+#endif  // SINGA_CONVERTVECTOR
+    for (; i < npixel; i++) {
+      r0[i] = hwc[i * 3];
+      r1[i] = hwc[i * 3 + 1];
+      r2[i] = hwc[i * 3 + 2];
+    }
+    return;
+  }
+  for (; i < npixel; i++)
+    for (size_t c = 0; c < channel; c++)
+      out[c * npixel + i] = hwc[i * channel + c];
+}
+
+}  // namespace singa
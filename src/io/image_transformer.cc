@@ -17,7 +17,10 @@
  */
 
 #include "singa/io/transformer.h"
-#include <time.h>
+#include "singa/utils/vector_ext.h"
+#include <cstdint>
+#include <cstring>
+#include <random>
 
 #ifdef USE_OPENCV
 #include <opencv2/highgui/highgui.hpp>
@@ -25,329 +28,350 @@
 #endif
 
 namespace singa {
+namespace {
+/// Geometry of one image.
+struct ImageShape {
+  size_t channel, height, width;
+  bool hwc;
+  size_t size() const { return channel * height * width; }
+};
 
-Tensor ImageTransformer::Apply(int flag, Tensor& input) {
+/// The window of an image to be extracted and how to flip it.
+struct Window {
+  size_t h_offset, w_offset;
+  bool hmirror, vmirror;
+};
+
+// Parse the shape of a (batch of) image(s); return the number of images.
+size_t ParseShape(const Tensor& input, const string& image_dim_order,
+                  ImageShape* shape) {
   CHECK_LE(input.nDim(), 4u);
   CHECK_GE(input.nDim(), 2u);
-  CHECK_EQ(input.data_type(), kFloat32) << "Data type " << input.data_type()
-                                        << " is invalid for an raw image";
-  srand((unsigned int)time(NULL));
-  /// TODO
-  /// currently only consider one sample each time
+  CHECK(input.data_type() == kFloat32 || input.data_type() == kUChar)
+      << "Data type " << input.data_type() << " is invalid for an raw image";
+  CHECK(!input.transpose());
+  const Shape& s = input.shape();
+  if (s.size() == 2u) {  // gray image
+    *shape = ImageShape{1, s[0], s[1], false};
+    return 1;
+  }
+  size_t b = s.size() == 4u ? 1 : 0;
+  if (image_dim_order == "CHW")
+    *shape = ImageShape{s[b], s[b + 1], s[b + 2], false};
+  else if (image_dim_order == "HWC")
+    *shape = ImageShape{s[b + 2], s[b], s[b + 1], true};
+  else
+    LOG(FATAL) << "Unknow dimension order for images " << image_dim_order
+               << " Only support 'HWC' and 'CHW'";
+  return b ? s[0] : 1;
+}
 
-  /// resize image using opencv resize
-  Tensor temp1;
-#ifdef USE_OPENCV
-  temp1 = resize(input, resize_height_, resize_width_, image_dim_order_);
+// The tensor shape of 'num' images like the input of 'ndim' dimensions.
+Shape MakeShape(size_t ndim, size_t num, const ImageShape& shape) {
+  Shape ret;
+  if (ndim == 4u) ret.push_back(num);
+  if (ndim == 2u)
+    ret.insert(ret.end(), {shape.height, shape.width});
+  else if (shape.hwc)
+    ret.insert(ret.end(), {shape.height, shape.width, shape.channel});
+  else
+    ret.insert(ret.end(), {shape.channel, shape.height, shape.width});
+  return ret;
+}
+
+std::mt19937& Generator() {
+  thread_local std::mt19937 gen(std::random_device{}());
+  return gen;
+}
+
+#ifdef SINGA_VECTOR_EXT
+inline f32x4 Reverse(f32x4 v) {
+#ifdef __clang__
+  return __builtin_shufflevector(v, v, 3, 2, 1, 0);
 #else
-  temp1 = input;
+  return __builtin_shuffle(v, i32x4{3, 2, 1, 0});
 #endif
+}
+#endif  // SINGA_VECTOR_EXT
+
+// dst[i] = src[i] * a + b, or src[n - 1 - i] * a + b if reversed
+template <typename T>
+void Row(const T* src, float* dst, size_t n, float a, float b, bool reverse) {
+  if (!reverse)
+    for (size_t i = 0; i < n; i++) dst[i] = src[i] * a + b;
+  else
+    for (size_t i = 0; i < n; i++) dst[i] = src[n - 1 - i] * a + b;
+}
+
+void Row(const float* src, float* dst, size_t n, float a, float b,
+         bool reverse) {
+  size_t i = 0;
+  if (!reverse) {
+    if (a == 1.f && b == 0.f) {
+      std::memcpy(dst, src, n * sizeof(float));
+      return;
+    }
+#ifdef SINGA_VECTOR_EXT
+    for (; i + 4 <= n; i += 4) {
+      f32x4 v;
+      std::memcpy(&v, src + i, sizeof(v));
+      v = v * a + b;
+      std::memcpy(dst + i, &v, sizeof(v));
+    }
+#endif  // SINGA_VECTOR_EXT
+    for (; i < n; i++) dst[i] = src[i] * a + b;
+  } else {
+#ifdef SINGA_VECTOR_EXT
+    for (; i + 4 <= n; i += 4) {
+      f32x4 v;
+      std::memcpy(&v, src + n - i - 4, sizeof(v));
+      v = Reverse(v) * a + b;
+      std::memcpy(dst + i, &v, sizeof(v));
+    }
+#endif  // SINGA_VECTOR_EXT
+    for (; i < n; i++) dst[i] = src[n - 1 - i] * a + b;
+  }
+}
+
+// Extract the window of an image into 'dst' (of shape 'out'), applying the
+// per-channel affine normalization x * a[c] + b[c] on the fly.
+template <typename T>
+void Extract(const T* src, const ImageShape& in, float* dst,
+             const ImageShape& out, const Window& win, const float* a,
+             const float* b) {
+  const size_t channel = in.channel;
+  for (size_t h = 0; h < out.height; h++) {
+    size_t sh = win.h_offset + (win.vmirror ? out.height - 1 - h : h);
+    if (!in.hwc) {
+      for (size_t c = 0; c < channel; c++)
+        Row(src + (c * in.height + sh) * in.width + win.w_offset,
+            dst + (c * out.height + h) * out.width, out.width, a[c], b[c],
+            win.hmirror);
+      continue;
+    }
+    const T* x = src + (sh * in.width + win.w_offset) * channel;
+    float* y = dst + h * out.width * channel;
+    if (channel == 1) {
+      Row(x, y, out.width, a[0], b[0], win.hmirror);
+    } else if (!win.hmirror) {
+      for (size_t w = 0; w < out.width; w++, x += channel, y += channel)
+        for (size_t c = 0; c < channel; c++) y[c] = x[c] * a[c] + b[c];
+    } else {
+      x += (out.width - 1) * channel;
+      for (size_t w = 0; w < out.width; w++, x -= channel, y += channel)
+        for (size_t c = 0; c < channel; c++) y[c] = x[c] * a[c] + b[c];
+    }
+  }
+}
+
+#ifdef USE_OPENCV
+// Resize one image by cv::resize, which reads and writes the images in place.
+template <typename T>
+void ResizeImage(const T* src, const ImageShape& in, T* dst,
+                 const ImageShape& out) {
+  cv::Size size(out.width, out.height);
+  T* x = const_cast<T*>(src);
+  const int depth = cv::DataType<T>::depth;
+  if (in.hwc) {
+    const int type = CV_MAKETYPE(depth, static_cast<int>(in.channel));
+    cv::Mat mat(in.height, in.width, type, x);
+    cv::Mat resized(out.height, out.width, type, dst);
+    cv::resize(mat, resized, size);
+    CHECK(resized.data == reinterpret_cast<uchar*>(dst));
+  } else {
+    for (size_t c = 0; c < in.channel; c++) {
+      cv::Mat mat(in.height, in.width, CV_MAKETYPE(depth, 1),
+                  x + c * in.height * in.width);
+      cv::Mat resized(out.height, out.width, CV_MAKETYPE(depth, 1),
+                      dst + c * out.height * out.width);
+      cv::resize(mat, resized, size);
+      CHECK(resized.data ==
+            reinterpret_cast<uchar*>(dst + c * out.height * out.width));
+    }
+  }
+}
+#endif  // USE_OPENCV
+
+// Resize and extract the windows of images [begin, end) of 'x' into 'y'.
+template <typename T>
+void TransformImages(const T* x, float* y, size_t begin, size_t end,
+                     const ImageShape& in_shape, const ImageShape& resized,
+                     const ImageShape& out_shape,
+                     const std::vector<Window>& windows, const float* a,
+                     const float* b) {
+  const bool resizing = in_shape.height != resized.height ||
+                        in_shape.width != resized.width;
+  std::vector<T> buf(resizing ? resized.size() : 0);
+  for (size_t i = begin; i < end; i++) {
+    const T* img = x + i * in_shape.size();
+#ifdef USE_OPENCV
+    if (resizing) {
+      ResizeImage(img, in_shape, buf.data(), resized);
+      img = buf.data();
+    }
+#endif  // USE_OPENCV
+    Extract(img, resized, y + i * out_shape.size(), out_shape, windows[i], a,
+            b);
+  }
+}
+
+// The fused pass over each image of the input: resize (if resize_height and
+// resize_width are not 0) and then extract the window of crop_height x
+// crop_width (the whole image if they are 0) with normalization. The images
+// are processed in parallel by the thread pool of the device. The input
+// could be kFloat32 or kUChar; the output is kFloat32.
+Tensor Transform(const Tensor& input, const string& image_dim_order,
+                 size_t resize_height, size_t resize_width,
+                 size_t crop_height, size_t crop_width,
+                 const std::vector<Window>& windows,
+                 const std::vector<float>& a, const std::vector<float>& b) {
+  ImageShape in_shape;
+  const size_t num = ParseShape(input, image_dim_order, &in_shape);
+  CHECK_EQ(windows.size(), num);
+  CHECK_EQ(a.size(), in_shape.channel);
+  ImageShape resized = in_shape;
+  const bool resizing = resize_height > 0 && resize_width > 0 &&
+      (resize_height != in_shape.height || resize_width != in_shape.width);
+  if (resizing) {
+#ifdef USE_OPENCV
+    resized.height = resize_height;
+    resized.width = resize_width;
+#else
+    LOG(FATAL) << "Resizing images needs OpenCV";
+#endif  // USE_OPENCV
+  }
+  ImageShape out_shape = resized;
+  if (crop_height > 0 && crop_width > 0) {
+    out_shape.height = crop_height;
+    out_shape.width = crop_width;
+  }
+  for (const auto& win : windows) {
+    CHECK_LE(out_shape.height + win.h_offset, resized.height);
+    CHECK_LE(out_shape.width + win.w_offset, resized.width);
+  }
 
-  /// crop
-  Tensor temp2;
-  size_t height = 0, width = 0;
-  if (input.nDim() >= 3u) {
-    if (image_dim_order_ == "CHW")
-      height = temp1.shape(input.nDim() - 2), width = temp1.shape(input.nDim() - 1);
-    else if (image_dim_order_ == "HWC")
-      height = temp1.shape(input.nDim() - 3), width = temp1.shape(input.nDim() - 2);
+  auto dev = input.device();
+  CHECK_EQ(dev->lang(), kCpp);
+  Tensor in(input), output(MakeShape(input.nDim(), num, out_shape), dev,
+                           kFloat32);
+  Tensor out(output);
+  dev->Exec([=](Context* ctx) mutable {
+    const void* x = in.block()->data();
+    float* y = static_cast<float*>(out.block()->mutable_data());
+    auto fn = [&](size_t begin, size_t end) {
+      if (in.data_type() == kUChar)
+        TransformImages(static_cast<const uint8_t*>(x), y, begin, end,
+                        in_shape, resized, out_shape, windows, a.data(),
+                        b.data());
+      else
+        TransformImages(static_cast<const float*>(x), y, begin, end, in_shape,
+                        resized, out_shape, windows, a.data(), b.data());
+    };
+    if (ctx->thread_pool != nullptr && num > 1)
+      ctx->thread_pool->ParallelFor(0, num, 1, fn);
     else
-      LOG(FATAL) << "Unknow dimension order for images " << image_dim_order_
-                 << " Only support 'HWC' and 'CHW'";
-  } else /// input is 2D gray image
-    height = temp1.shape(0), width = temp1.shape(1);
+      fn(0, num);
+  }, {in.block()}, {out.block()});
+  return output;
+}
+}  // namespace
+
+Tensor ImageTransformer::Apply(int flag, Tensor& input) {
+  ImageShape shape;
+  const size_t num = ParseShape(input, image_dim_order_, &shape);
+  // images are not resized without OpenCV
+  size_t height = shape.height, width = shape.width;
+  size_t resize_height = 0, resize_width = 0;
+#ifdef USE_OPENCV
+  if (resize_height_ > 0 && resize_width_ > 0) {
+    resize_height = resize_height_, resize_width = resize_width_;
+    height = resize_height, width = resize_width;
+  }
+#endif  // USE_OPENCV
 
+  size_t crop_height = 0, crop_width = 0;
   if (crop_shape_.size() == 2) {
-    if (flag == kTrain) {
+    crop_height = crop_shape_[0], crop_width = crop_shape_[1];
+    if (crop_height > height || crop_width > width)
+      LOG(FATAL) << "Crop size larger than the size of raw image";
+  }
+  std::vector<Window> windows(num);
+  auto& gen = Generator();
+  for (auto& win : windows) {
+    if (crop_height > 0 && flag == kTrain) {
       /// random crop
-      if (crop_shape_[0] > height || crop_shape_[0] > width)
-        LOG(FATAL) << "Crop size larger than the size of raw image";
-      size_t crop_h_offset = rand() % ((height - crop_shape_[0]) / 2),
-             crop_w_offset = rand() % ((width - crop_shape_[1]) / 2);
-      temp2 = crop(temp1, crop_shape_[0], crop_shape_[1],
-                   crop_h_offset, crop_w_offset, image_dim_order_);
-    } else if (flag == kEval) {
+      win.h_offset = std::uniform_int_distribution<size_t>(
+          0, height - crop_height)(gen);
+      win.w_offset = std::uniform_int_distribution<size_t>(
+          0, width - crop_width)(gen);
+    } else if (crop_height > 0) {
       /// central crop
-      size_t crop_h_offset = (height - crop_shape_[0]) / 2,
-             crop_w_offset = (width - crop_shape_[1]) / 2;
-      temp2 = crop(temp1, crop_shape_[0], crop_shape_[1],
-                   crop_h_offset, crop_w_offset, image_dim_order_);
+      win.h_offset = (height - crop_height) / 2;
+      win.w_offset = (width - crop_width) / 2;
+    } else {
+      win.h_offset = win.w_offset = 0;
     }
-  } else temp2 = temp1;
+    win.hmirror = flag == kTrain && horizontal_mirror_ && (gen() & 1u);
+    win.vmirror = false;
+  }
 
-  /// mirror
-  Tensor output;
-  if ((flag == kTrain) && (rand() % 2))
-    output = mirror(temp2, true, false, image_dim_order_);
-  else output = temp2;
-  return output;
+  // normalize by x * a + b = (x * rescale - mean) / std
+  const size_t channel = shape.channel;
+  std::vector<float> a(channel, rescale_ != 0.f ? rescale_ : 1.f),
+      b(channel, 0.f);
+  if (featurewise_center_) {
+    CHECK(mean_.size() == 1u || mean_.size() == channel)
+        << "Need the mean of all channels or of each channel";
+    for (size_t c = 0; c < channel; c++) b[c] = -mean_[mean_.size() > 1 ? c : 0];
+  }
+  if (featurewise_std_norm_) {
+    CHECK(std_.size() == 1u || std_.size() == channel)
+        << "Need the std of all channels or of each channel";
+    for (size_t c = 0; c < channel; c++) {
+      float s = std_[std_.size() > 1 ? c : 0];
+      CHECK_GT(s, 0.f);
+      a[c] /= s;
+      b[c] /= s;
+    }
+  }
+  return Transform(input, image_dim_order_, resize_height, resize_width,
+                   crop_height, crop_width, windows, a, b);
 }
 
 #ifdef USE_OPENCV
 Tensor resize(Tensor& input, const size_t resize_height,
               const size_t resize_width, const string& image_dim_order) {
-  CHECK_LE(input.nDim(), 4u);
-  CHECK_GE(input.nDim(), 2u);
+  ImageShape shape;
+  const size_t num = ParseShape(input, image_dim_order, &shape);
   if (!resize_height || !resize_width) return input;
-  Tensor output;
-  cv::Mat mat;
-  const auto* in = input.data<float>();
-  if (input.nDim() == 4u) {
-    /// TODO
-    /// batch based resize
-    LOG(FATAL) << "Not implemented";
-  } else if (input.nDim() == 3u) {
-    if (image_dim_order == "CHW") {
-      size_t height = input.shape(1), width = input.shape(2),
-             channel = input.shape(0);
-      if (channel == 3u) {
-        mat = cv::Mat(height, width, CV_32FC3, cv::Scalar(0, 0, 0));
-        for (size_t i = 0; i < height; i++)
-          for (size_t j = 0; j < width; j++)
-            for (size_t k = 0; k < channel; k++)
-              mat.at<cv::Vec3f>(i, j)[k] = in[k * height * width + i * width + j];
-      } else if (channel == 1u) {
-        mat = cv::Mat(height, width, CV_32FC1);
-        for (size_t i = 0; i < height; i++)
-          for (size_t j = 0; j < width; j++)
-            mat.at<cv::Vec<float, 1>>(i, j)[0] = in[i * width + j];
-      } else LOG(FATAL) << "Invalid channel size: " << channel;
-    } else if (image_dim_order == "HWC") {
-      size_t height = input.shape(0), width = input.shape(1),
-             channel = input.shape(2);
-      if (channel == 3u) {
-        mat = cv::Mat(height, width, CV_32FC3, cv::Scalar(0, 0, 0));
-        for (size_t i = 0; i < height; i++)
-          for (size_t j = 0; j < width; j++)
-            for (size_t k = 0; k < channel; k++)
-              mat.at<cv::Vec3f>(i, j)[k] =
-                in[i * width * channel + j * channel + k];
-      } else if (channel == 1u) { /// 2D gray image
-        mat = cv::Mat(height, width, CV_32FC1);
-        for (size_t i = 0; i < height; i++)
-          for (size_t j = 0; j < width; j++)
-            mat.at<cv::Vec<float, 1>>(i, j)[0] = in[i * width + j];
-      } else LOG(FATAL) << "Invalid channel size: " << channel;
-    } else {
-      LOG(FATAL) << "Unknow dimension order for images " << image_dim_order
-                 << " Only support 'HWC' and 'CHW'";
-    }
-  } else { /// 2D gray image
-    size_t height = input.shape(0), width = input.shape(1);
-    mat = cv::Mat(height, width, CV_32FC1);
-    for (size_t i = 0; i < height; i++)
-      for (size_t j = 0; j < width; j++)
-        mat.at<cv::Vec<float, 1>>(i, j)[0] = in[i * width + j];
-  }
-  cv::Size size(resize_width, resize_height);
-  cv::Mat resized;
-  cv::resize(mat, resized, size);
-  CHECK_EQ(resized.size().height, resize_height);
-  CHECK_EQ(resized.size().width, resize_width);
-  size_t new_size = resize_height * resize_width * resized.channels();
-  float* out = new float[new_size];
-  if (input.nDim() == 4u) {
-    /// TODO
-    /// batch based resize
-    LOG(FATAL) << "Not implemented";
-  } else if (input.nDim() == 3u) {
-    if (image_dim_order == "CHW") {
-      size_t height = resize_height, width = resize_width,
-             channel = input.shape(0);
-      if (channel == 3u) {
-        for (size_t i = 0; i < height; i++)
-          for (size_t j = 0; j < width; j++)
-            for (size_t k = 0; k < channel; k++)
-              out[k * height * width + i * width + j] = resized.at<cv::Vec3f>(i, j)[k];
-      } else { /// 2D gray image
-        for (size_t i = 0; i < height; i++)
-          for (size_t j = 0; j < width; j++)
-            out[i * width + j] = resized.at<cv::Vec<float, 1>>(i, j)[0];
-      }
-      Tensor temp(Shape{channel, height, width});
-      temp.CopyDataFromHostPtr<float>(out, new_size);
-      output = temp;
-    } else {
-      size_t height = resize_height, width = resize_width,
-             channel = input.shape(2);
-      if (channel == 3u) {
-        for (size_t i = 0; i < height; i++)
-          for (size_t j = 0; j < width; j++)
-            for (size_t k = 0; k < channel; k++)
-              out[i * width * channel + j * channel + k] = resized.at<cv::Vec3f>(i, j)[k];
-      } else { /// 1 channel
-        for (size_t i = 0; i < height; i++)
-          for (size_t j = 0; j < width; j++)
-            out[i * width + j] = resized.at<cv::Vec<float, 1>>(i, j)[0];
-      }
-      Tensor temp(Shape{height, width, channel});
-      temp.CopyDataFromHostPtr<float>(out, new_size);
-      output = temp;
-    }
-  } else { /// 2D gray image
-    size_t height = resize_height, width = resize_width;
-    for (size_t i = 0; i < height; i++)
-      for (size_t j = 0; j < width; j++)
-        out[i * width + j] = resized.at<cv::Vec<float, 1>>(i, j)[0];
-    Tensor temp(Shape{height, width});
-    temp.CopyDataFromHostPtr<float>(out, new_size);
-    output = temp;
-  }
-  delete[] out;
-  return output;
+  return Transform(input, image_dim_order, resize_height, resize_width, 0, 0,
+                   std::vector<Window>(num, Window{0, 0, false, false}),
+                   std::vector<float>(shape.channel, 1.f),
+                   std::vector<float>(shape.channel, 0.f));
 }
 #endif
 
 Tensor crop(Tensor& input, const size_t crop_height, const size_t crop_width,
             const size_t crop_h_offset, const size_t crop_w_offset,
             const string& image_dim_order) {
-  CHECK_LE(input.nDim(), 4u);
-  CHECK_GE(input.nDim(), 2u);
-
-  Tensor output;
-  const float* in = input.data<float>();
-  size_t out_idx = 0, in_idx = 0;
-  if (input.nDim() == 4u) {
-    /// TODO
-    LOG(FATAL) << "Not implemented";
-  } else if (input.nDim() == 3u) {
-    if (image_dim_order == "CHW") {
-      size_t height = input.shape(1), width = input.shape(2),
-             channel = input.shape(0);
-      CHECK_LE(crop_height + crop_h_offset, height);
-      CHECK_LE(crop_width + crop_w_offset, width);
-      float* out = new float[crop_height * crop_width * channel];
-      for (size_t c = 0; c < channel; c++) {
-        for (size_t h = 0; h < crop_height; h++) {
-          for (size_t w = 0; w < crop_width; w++) {
-            in_idx = (c * height + crop_h_offset + h) * width + crop_w_offset + w;
-            out_idx = (c * crop_height + h) * crop_width + w;
-            out[out_idx] = in[in_idx];
-          }
-        }
-      }
-      output.Resize(Shape{channel, crop_height, crop_width});
-      output.CopyDataFromHostPtr<float>(out, crop_height * crop_width * channel);
-      delete[] out;
-    } else if (image_dim_order == "HWC") {
-      size_t height = input.shape(0), width = input.shape(1),
-             channel = input.shape(2);
-      CHECK_LE(crop_height + crop_h_offset, height);
-      CHECK_LE(crop_width + crop_w_offset, width);
-      float* out = new float[crop_height * crop_width * channel];
-      for (size_t c = 0; c < channel; c++) {
-        for (size_t h = 0; h < crop_height; h++) {
-          for (size_t w = 0; w < crop_width; w++) {
-            in_idx = ((crop_h_offset + h) * width + crop_w_offset + w) * channel + c;
-            out_idx = (h * crop_width + w) * channel + c;
-            out[out_idx] = in[in_idx];
-          }
-        }
-      }
-      output.Resize(Shape{crop_height, crop_width, channel});
-      output.CopyDataFromHostPtr<float>(out, crop_height * crop_width * channel);
-      delete[] out;
-    } else {
-      LOG(FATAL) << "Unknow dimension order for images " << image_dim_order
-                 << " Only support 'HWC' and 'CHW'";
-    }
-  } else { /// 2D gray image
-    size_t height = input.shape(0), width = input.shape(1);
-    CHECK_LE(crop_height + crop_h_offset, height);
-    CHECK_LE(crop_width + crop_w_offset, width);
-    float* out = new float[crop_height * crop_width];
-    for (size_t h = 0; h < crop_height; h++) {
-      for (size_t w = 0; w < crop_width; w++) {
-        in_idx = (crop_h_offset + h) * width + crop_w_offset + w;
-        out_idx = h * crop_width + w;
-        out[out_idx] = in[in_idx];
-      }
-    }
-    output.Resize(Shape{crop_height, crop_width});
-    output.CopyDataFromHostPtr<float>(out, crop_height * crop_width);
-    delete[] out;
-  }
-  return output;
+  ImageShape shape;
+  const size_t num = ParseShape(input, image_dim_order, &shape);
+  Window win{crop_h_offset, crop_w_offset, false, false};
+  return Transform(input, image_dim_order, 0, 0, crop_height, crop_width,
+                   std::vector<Window>(num, win),
+                   std::vector<float>(shape.channel, 1.f),
+                   std::vector<float>(shape.channel, 0.f));
 }
 
 Tensor mirror(Tensor& input, const bool horizontal_mirror,
               const bool vertical_mirror, const string& image_dim_order) {
-  CHECK_LE(input.nDim(), 4u);
-  CHECK_GE(input.nDim(), 2u);
   if (!horizontal_mirror && !vertical_mirror) return input;
-
-  Tensor output;
-  const float* in = input.data<float>();
-  size_t out_idx = 0, in_idx = 0;
-  if (input.nDim() == 4u) {
-    /// TODO
-    LOG(FATAL) << "Not implemented";
-  } else if (input.nDim() == 3u) {
-    if (image_dim_order == "CHW") {
-      size_t height = input.shape(1), width = input.shape(2),
-             channel = input.shape(0);
-      float* out = new float[height * width * channel];
-      for (size_t c = 0; c < channel; c++) {
-        for (size_t h = 0; h < height; h++) {
-          for (size_t w = 0; w < width; w++) {
-            in_idx = (c * height + h) * width + w;
-            if (horizontal_mirror && vertical_mirror)
-              out_idx = (c * height + (height - 1 - h)) * width + (width - 1 - w);
-            else if (horizontal_mirror)
-              out_idx = (c * height + h) * width + (width - 1 - w);
-            else /// only do vertical mirror
-              out_idx = (c * height + (height - 1 - h)) * width + w;
-            out[out_idx] = in[in_idx];
-          }
-        }
-      }
-      output.Resize(Shape{channel, height, width});
-      output.CopyDataFromHostPtr<float>(out, height * width * channel);
-      delete[] out;
-    } else if (image_dim_order == "HWC") {
-      size_t height = input.shape(0), width = input.shape(1),
-             channel = input.shape(2);
-      float* out = new float[height * width * channel];
-      for (size_t c = 0; c < channel; c++) {
-        for (size_t h = 0; h < height; h++) {
-          for (size_t w = 0; w < width; w++) {
-            in_idx = (h * width + w) * channel + c;
-            if (horizontal_mirror && vertical_mirror)
-              out_idx = ((height - 1 - h) * width + (width - 1 - w)) * channel + c;
-            else if (horizontal_mirror)
-              out_idx = (h * width + (width - 1 - w)) * channel + c;
-            else /// only do vertical mirror
-              out_idx = ((height - 1 - h) * width + w) * channel + c;
-            out[out_idx] = in[in_idx];
-          }
-        }
-      }
-      output.Resize(Shape{height, width, channel});
-      output.CopyDataFromHostPtr<float>(out, height * width * channel);
-      delete[] out;
-    } else {
-      LOG(FATAL) << "Unknow dimension order for images " << image_dim_order
-                 << " Only support 'HWC' and 'CHW'";
-    }
-  } else { /// 2D gray image
-    size_t height = input.shape(0), width = input.shape(1);
-    float* out = new float[height * width];
-    for (size_t h = 0; h < height; h++) {
-      for (size_t w = 0; w < width; w++) {
-        in_idx = h * width + w;
-        if (horizontal_mirror && vertical_mirror)
-          out_idx = (height - 1 - h) * width + (width - 1 - w);
-        else if (horizontal_mirror)
-          out_idx = h * width + (width - 1 - w);
-        else /// only do vertical mirror
-          out_idx = (height - 1 - h) * width + w;
-        out[out_idx] = in[in_idx];
-      }
-    }
-    output.Resize(Shape{height, width});
-    output.CopyDataFromHostPtr<float>(out, height * width);
-    delete[] out;
-  }
-  return output;
+  ImageShape shape;
+  const size_t num = ParseShape(input, image_dim_order, &shape);
+  Window win{0, 0, horizontal_mirror, vertical_mirror};
+  return Transform(input, image_dim_order, 0, 0, 0, 0,
+                   std::vector<Window>(num, win),
+                   std::vector<float>(shape.channel, 1.f),
+                   std::vector<float>(shape.channel, 0.f));
 }
 } // namespace singa
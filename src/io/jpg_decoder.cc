@@ -21,48 +21,131 @@
 
 #ifdef USE_OPENCV
 
+#include <cstring>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
 namespace singa {
+namespace {
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+// Parse the serialized ImageRecord in 'value' without copying the pixel
+// field, which is returned as 'pixel' and 'pixel_size' pointing into
+// 'value'. 'label' is the first label; false if the record is corrupt.
+bool ParseRecord(const char* value, size_t size, const char** pixel,
+                 size_t* pixel_size, int* label, bool* has_label) {
+  CodedInputStream input(reinterpret_cast<const uint8_t*>(value),
+                         static_cast<int>(size));
+  *pixel = value;
+  *pixel_size = 0;
+  *has_label = false;
+  while (uint32_t tag = input.ReadTag()) {
+    const int field = WireFormatLite::GetTagFieldNumber(tag);
+    const auto wire_type = WireFormatLite::GetTagWireType(tag);
+    int32_t v;
+    if (field == ImageRecord::kPixelFieldNumber &&
+        wire_type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      uint32_t len;
+      if (!input.ReadVarint32(&len)) return false;
+      const size_t pos = input.CurrentPosition();
+      if (len > size - pos || !input.Skip(len)) return false;
+      *pixel = value + pos;
+      *pixel_size = len;
+    } else if (field == ImageRecord::kLabelFieldNumber &&
+               wire_type == WireFormatLite::WIRETYPE_VARINT) {
+      if (!WireFormatLite::ReadPrimitive<int32_t, WireFormatLite::TYPE_INT32>(
+              &input, &v))
+        return false;
+      if (!*has_label) *label = v;
+      *has_label = true;
+    } else if (field == ImageRecord::kLabelFieldNumber &&
+               wire_type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      // packed labels
+      uint32_t len;
+      if (!input.ReadVarint32(&len)) return false;
+      auto limit = input.PushLimit(len);
+      while (input.BytesUntilLimit() > 0) {
+        if (!WireFormatLite::ReadPrimitive<int32_t,
+                                           WireFormatLite::TYPE_INT32>(
+                &input, &v))
+          return false;
+        if (!*has_label) *label = v;
+        *has_label = true;
+      }
+      input.PopLimit(limit);
+    } else if (!WireFormatLite::SkipField(&input, tag)) {
+      return false;
+    }
+  }
+  return input.ConsumedEntireMessage();
+}
+
+// Decode the JPEG bytes; they are wrapped, not copied.
+cv::Mat DecodeImage(const char* pixel, size_t size, int reduce_factor) {
+  cv::Mat buf(1, static_cast<int>(size), CV_8UC1, const_cast<char*>(pixel));
+  int flag = CV_LOAD_IMAGE_COLOR;
+#if CV_MAJOR_VERSION >= 3
+  // the JPEG decoder scales the DCT blocks, which skips most of the work
+  if (reduce_factor == 2) flag = cv::IMREAD_REDUCED_COLOR_2;
+  else if (reduce_factor == 4) flag = cv::IMREAD_REDUCED_COLOR_4;
+  else if (reduce_factor == 8) flag = cv::IMREAD_REDUCED_COLOR_8;
+#endif
+  cv::Mat mat = cv::imdecode(buf, flag);
+  CHECK(mat.data != nullptr) << "Cannot decode the image";
+#if CV_MAJOR_VERSION < 3
+  if (reduce_factor > 1) {
+    cv::Mat reduced;
+    cv::resize(mat, reduced, cv::Size(mat.cols / reduce_factor,
+               mat.rows / reduce_factor), 0, 0, cv::INTER_AREA);
+    mat = reduced;
+  }
+#endif
+  CHECK_EQ(mat.type(), CV_8UC3);
+  if (!mat.isContinuous()) mat = mat.clone();
+  return mat;
+}
+
+// Write the pixels of the image into 'dst' as float or uint8.
+void WriteImage(const cv::Mat& mat, bool chw, bool keep_uint8, void* dst) {
+  const size_t height = mat.rows, width = mat.cols, channel = mat.channels();
+  if (!keep_uint8) {
+    ImageToFloat(mat.data, height, width, channel, chw,
+                 static_cast<float*>(dst));
+  } else if (!chw) {
+    std::memcpy(dst, mat.data, height * width * channel);
+  } else {
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    const size_t npixel = height * width;
+    for (size_t c = 0; c < channel; c++)
+      for (size_t i = 0; i < npixel; i++)
+        out[c * npixel + i] = mat.data[i * channel + c];
+  }
+}
+}  // namespace
 
 std::vector<Tensor> JPGDecoder::Decode(std::string value) {
   std::vector<Tensor> output;
 
   ImageRecord record;
   record.ParseFromString(value);
-  std::vector<uchar> pixel(record.pixel().begin(), record.pixel().end());
-
-  // decode image
-  cv::Mat mat = cv::imdecode(cv::Mat(pixel), CV_LOAD_IMAGE_COLOR);
-  size_t height = mat.size().height, width = mat.size().width, channel = mat.channels();
-  Shape shape(record.shape().begin(), record.shape().end());
-  //CHECK_EQ(shape[0], height);
-  //CHECK_EQ(shape[1], width);
-  //CHECK_EQ(shape[2], channel);
-  Tensor image(shape);
-
-  float* data = new float[image.Size()];
-  if (image_dim_order_ == "CHW") {
-    for (size_t i = 0; i < height; i++)
-      for (size_t j = 0; j < width; j++)
-        for (size_t k = 0; k < channel; k++)
-          data[k * height * width + i * width + j] = static_cast<float>(
-              static_cast<int>(mat.at<cv::Vec3b>(i, j)[k]));
-  } else if (image_dim_order_ == "HWC") {
-
-    for (size_t i = 0; i < height; i++)
-      for (size_t j = 0; j < width; j++)
-        for (size_t k = 0; k < channel; k++)
-          data[i * width * channel + j * channel + k] =
-              static_cast<float>(static_cast<int>(mat.at<cv::Vec3b>(i, j)[k]));
-  } else {
+  const std::string& pixel = record.pixel();
+  cv::Mat mat = DecodeImage(pixel.data(), pixel.size(), reduce_factor_);
+  size_t height = mat.rows, width = mat.cols, channel = mat.channels();
+  Shape shape;
+  if (image_dim_order_ == "CHW")
+    shape = Shape{channel, height, width};
+  else if (image_dim_order_ == "HWC")
+    shape = Shape{height, width, channel};
+  else
     LOG(FATAL) << "Unknow dimension order for images " << image_dim_order_
                << " Only support 'HWC' and 'CHW'";
-  }
-  image.CopyDataFromHostPtr<float>(data, image.Size());
+  Tensor image(shape, keep_uint8_ ? kUChar : kFloat32);
+  WriteImage(mat, image_dim_order_ == "CHW", keep_uint8_,
+             image.block()->mutable_data());
   output.push_back(image);
-  delete[] data;
 
   if (record.label_size()) {
     Tensor label(Shape{1}, kInt);
@@ -72,6 +155,42 @@ std::vector<Tensor> JPGDecoder::Decode(std::string value) {
   }
   return output;
 }
+
+void JPGDecoder::DecodeInto(const char* value, size_t size, size_t index,
+                            std::vector<Tensor>* batch) {
+  const char* pixel;
+  size_t pixel_size;
+  int label = 0;
+  bool has_label;
+  CHECK(ParseRecord(value, size, &pixel, &pixel_size, &label, &has_label))
+      << "Cannot parse the image record";
+  cv::Mat mat = DecodeImage(pixel, pixel_size, reduce_factor_);
+  const bool chw = image_dim_order_ == "CHW";
+  CHECK(chw || image_dim_order_ == "HWC")
+      << "Unknow dimension order for images " << image_dim_order_;
+
+  Tensor& images = batch->at(0);
+  CHECK_EQ(images.nDim(), 4u);
+  CHECK_LT(index, images.shape(0));
+  CHECK_EQ(images.data_type(), keep_uint8_ ? kUChar : kFloat32);
+  const size_t height = mat.rows, width = mat.cols, channel = mat.channels();
+  CHECK(images.shape(chw ? 1 : 3) == channel &&
+        images.shape(chw ? 2 : 1) == height &&
+        images.shape(chw ? 3 : 2) == width)
+      << "The decoded image does not fit the batch";
+  const size_t bytes = height * width * channel * SizeOf(images.data_type());
+  WriteImage(mat, chw, keep_uint8_,
+             static_cast<char*>(images.block()->mutable_data()) +
+                 index * bytes);
+
+  if (batch->size() > 1) {
+    CHECK(has_label) << "The record of image " << index << " has no label";
+    Tensor& labels = batch->at(1);
+    CHECK_EQ(labels.data_type(), kInt);
+    CHECK_EQ(labels.Size(), images.shape(0));
+    static_cast<int*>(labels.block()->mutable_data())[index] = label;
+  }
+}
 }  // namespace singa
 #endif
 
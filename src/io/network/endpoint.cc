@@ -26,6 +26,7 @@
 #include "singa/utils/logging.h"
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netdb.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -33,6 +34,7 @@
 #include <arpa/inet.h>
 
 #include <atomic>
+#include <chrono>
 
 namespace singa {
 
@@ -118,6 +120,11 @@ Message *EndPoint::recv() {
   return ret;
 }
 
+void EndPoint::postRecv(void *buf, std::size_t size) {
+  std::unique_lock<std::mutex> lock(this->mtx_);
+  posted_.push(std::make_pair(static_cast<char *>(buf), size));
+}
+
 EndPointFactory::~EndPointFactory() {
   for (auto &p : ip_ep_map_) {
     delete p.second;
@@ -169,6 +176,12 @@ EndPoint *EndPointFactory::getEp(const char *host) {
   map_mtx_.unlock();
 
   std::unique_lock<std::mutex> eplock(ep->mtx_);
+  if (ep->conn_status_ == CONN_ERROR) {
+    // connect again, e.g., if the remote node was not started before
+    ep->conn_status_ = CONN_INIT;
+    ep->retry_cnt_ = 0;
+    thread_->notify(SIG_EP);
+  }
   while (ep->conn_status_ == CONN_PENDING || ep->conn_status_ == CONN_INIT) {
     ep->pending_cnt_++;
     ep->cv_.wait(eplock);
@@ -182,6 +195,28 @@ EndPoint *EndPointFactory::getEp(const char *host) {
   return ep;
 }
 
+EndPoint *EndPointFactory::waitEp(const char *host) {
+  struct hostent *he;
+  if ((he = gethostbyname(host)) == nullptr) {
+    LOG(INFO) << "Unable to resolve host " << host;
+    return nullptr;
+  }
+  uint32_t ip = ntohl(((struct in_addr **)he->h_addr_list)[0]->s_addr);
+
+  std::unique_lock<std::mutex> lock(map_mtx_);
+  while (true) {
+    if (ip_ep_map_.count(ip)) {
+      EndPoint *ep = ip_ep_map_[ip];
+      std::unique_lock<std::mutex> eplock(ep->mtx_);
+      if (ep->conn_status_ == CONN_EST)
+        return ep;
+    }
+    // the notification is sent without holding map_mtx_, hence it may be
+    // missed
+    map_cv_.wait_for(lock, std::chrono::milliseconds(100));
+  }
+}
+
 void EndPointFactory::getNewEps(std::vector<EndPoint *> &neps) {
   std::unique_lock<std::mutex> lock(this->map_mtx_);
   for (auto &p : this->ip_ep_map_) {
@@ -193,10 +228,20 @@ void EndPointFactory::getNewEps(std::vector<EndPoint *> &neps) {
   }
 }
 
-NetworkThread::NetworkThread(int port) {
+NetworkThread::NetworkThread(int port, const std::string &host) {
   this->port_ = port;
-  thread_ = new std::thread([this] { doWork(); });
+  local_addr_.s_addr = INADDR_ANY;
+  if (!host.empty()) {
+    struct hostent *he = gethostbyname(host.c_str());
+    CHECK(he != nullptr) << "Unable to resolve host " << host;
+    bcopy(he->h_addr_list[0], &local_addr_, sizeof(struct in_addr));
+  }
   this->epf_ = new EndPointFactory(this);
+  thread_ = new std::thread([this] { doWork(); });
+
+  // the event loop must be initialized before notify() is called
+  std::unique_lock<std::mutex> lock(ready_mtx_);
+  ready_cv_.wait(lock, [this] { return ready_; });
 }
 
 void NetworkThread::doWork() {
@@ -217,11 +262,14 @@ void NetworkThread::doWork() {
   if ((socket_fd_ = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
     LOG(FATAL) << "Socket Error: " << strerror(errno);
   }
+  // restarted nodes can listen again while the old connections time out
+  int reuse = 1;
+  setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
 
   bzero(&addr, sizeof(addr));
   addr.sin_family = AF_INET;
   addr.sin_port = htons(this->port_);
-  addr.sin_addr.s_addr = INADDR_ANY;
+  addr.sin_addr = local_addr_;
 
   if (bind(socket_fd_, (struct sockaddr *)&addr, sizeof(addr))) {
     LOG(FATAL) << "Bind Error: " << strerror(errno);
@@ -239,6 +287,12 @@ void NetworkThread::doWork() {
 
   ev_set_userdata(loop_, this);
 
+  {
+    std::unique_lock<std::mutex> lock(ready_mtx_);
+    ready_ = true;
+    ready_cv_.notify_all();
+  }
+
   while (1)
     ev_run(loop_, 0);
 }
@@ -274,6 +328,16 @@ void NetworkThread::onNewEp() {
       // set this fd non-blocking
       fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
 
+      if (local_addr_.s_addr != INADDR_ANY) {
+        // connect from the listening address, by which the peer knows us
+        struct sockaddr_in local;
+        bzero(&local, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_addr = local_addr_;
+        if (bind(fd, (struct sockaddr *)&local, sizeof(local)))
+          LOG(INFO) << "Bind Error: " << strerror(errno);
+      }
+
       this->fd_ep_map_[fd] = ep;
 
       // initialize the addess
@@ -506,6 +570,9 @@ void NetworkThread::afterConnEst(EndPoint *ep, int fd, bool active) {
   // are able to reuse this ep
   if (active) {
     ep->cv_.notify_all();
+  } else {
+    // threads in waitEp()
+    epf_->map_cv_.notify_all();
   }
 }
 
@@ -585,9 +652,11 @@ int NetworkThread::asyncSend(int fd) {
       if (msg.type_ == MSG_ACK) {
         nbytes = write(fd, msg.mdata_ + msg.processed_,
                        msg.getSize() - msg.processed_);
-      } else
-        nbytes = write(fd, msg.msg_ + msg.processed_,
-                       msg.getSize() - msg.processed_);
+      } else {
+        // the buffer and the referenced payload in one call
+        struct iovec iov[2];
+        nbytes = writev(fd, iov, msg.pending(iov));
+      }
 
       if (nbytes == -1) {
         if (errno == EWOULDBLOCK) {
@@ -726,11 +795,18 @@ void NetworkThread::onRecv(int fd) {
 
     // start reading the real data
     if (msg.msg_ == nullptr) {
-      msg.msg_ = new char[msg.getSize()];
+      // the payload goes to the posted buffer directly if it fits
+      if (msg.psize_ > 0 && !ep->posted_.empty() &&
+          ep->posted_.front().second >= msg.psize_) {
+        msg.payload_ = ep->posted_.front().first;
+        ep->posted_.pop();
+      }
+      msg.msg_ = (char *)malloc(msg.bufSize());
       memcpy(msg.msg_, msg.mdata_, Message::hsize_);
     }
 
-    nread = read(fd, msg.msg_ + msg.processed_, msg.getSize() - msg.processed_);
+    struct iovec iov[2];
+    nread = readv(fd, iov, msg.pending(iov));
     if (nread <= 0) {
       if (errno != EWOULDBLOCK || nread == 0) {
         // socket error or shuts down
@@ -35,6 +35,8 @@ Message::Message(Message &&msg) {
   std::swap(msize_, msg.msize_);
   std::swap(psize_, msg.psize_);
   std::swap(msg_, msg.msg_);
+  std::swap(payload_, msg.payload_);
+  std::swap(owner_, msg.owner_);
   std::swap(type_, msg.type_);
   std::swap(id_, msg.id_);
 }
@@ -61,20 +63,61 @@ void Message::setId(uint32_t id) {
   appendInteger(msg_, type_, id_);
 }
 
+std::size_t Message::bufSize() {
+  return hsize_ + msize_ + (payload_ == nullptr ? psize_ : 0);
+}
+
+int Message::pending(struct iovec *iov) {
+  int n = 0;
+  std::size_t buf_size = bufSize();
+  if (processed_ < buf_size) {
+    iov[n].iov_base = msg_ + processed_;
+    iov[n++].iov_len = buf_size - processed_;
+  }
+  if (payload_ != nullptr) {
+    std::size_t offset = processed_ > buf_size ? processed_ - buf_size : 0;
+    if (offset < psize_) {
+      iov[n].iov_base = payload_ + offset;
+      iov[n++].iov_len = psize_ - offset;
+    }
+  }
+  return n;
+}
+
 void Message::setMetadata(const void *buf, int size) {
+  // a copied payload follows the metadata
+  std::size_t copied = payload_ == nullptr ? psize_ : 0;
+  char *old = msg_;
+  std::size_t old_msize = msize_;
   this->msize_ = size;
-  msg_ = (char *)malloc(this->getSize());
+  msg_ = (char *)malloc(this->bufSize());
   appendInteger(msg_, type_, id_, msize_, psize_);
   memcpy(msg_ + hsize_, buf, size);
+  if (old) {
+    memcpy(msg_ + hsize_ + msize_, old + hsize_ + old_msize, copied);
+    free(old);
+  }
 }
 
 void Message::setPayload(const void *buf, int size) {
+  payload_ = nullptr;
+  owner_.reset();
   this->psize_ = size;
-  msg_ = (char *)realloc(msg_, this->getSize());
-  appendInteger(msg_ + hsize_ - sizeof(psize_), psize_);
+  msg_ = (char *)realloc(msg_, this->bufSize());
+  appendInteger(msg_, type_, id_, msize_, psize_);
   memcpy(msg_ + hsize_ + msize_, buf, size);
 }
 
+void Message::setPayloadRef(const void *buf, std::size_t size,
+                            std::shared_ptr<void> owner) {
+  this->psize_ = size;
+  payload_ = static_cast<char *>(const_cast<void *>(buf));
+  owner_ = owner;
+  // drop the copied payload, if any
+  msg_ = (char *)realloc(msg_, this->bufSize());
+  appendInteger(msg_, type_, id_, msize_, psize_);
+}
+
 std::size_t Message::getMetadata(void **p) {
   if (this->msize_ == 0)
     *p = nullptr;
@@ -86,6 +129,8 @@ std::size_t Message::getMetadata(void **p) {
 std::size_t Message::getPayload(void **p) {
   if (this->psize_ == 0)
     *p = nullptr;
+  else if (payload_ != nullptr)
+    *p = payload_;
   else
     *p = msg_ + hsize_ + msize_;
   return this->psize_;
@@ -0,0 +1,167 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "singa/io/pipeline.h"
+#include "singa/utils/logging.h"
+
+#include <cstring>
+
+namespace singa {
+
+DataPipeline::DataPipeline(io::Reader* reader, Decoder* decoder,
+                           Transformer* transformer, size_t batchsize,
+                           int num_workers, int prefetch,
+                           std::shared_ptr<Device> device)
+    : reader_(reader), decoder_(decoder), transformer_(transformer),
+      batchsize_(batchsize), device_(device) {
+  CHECK(reader_ != nullptr && decoder_ != nullptr);
+  CHECK_GT(batchsize_, 0u);
+  CHECK_GT(prefetch, 0);
+  CHECK_EQ(device_->lang(), kCpp) << "Batches are assembled on a host device";
+  // the calling thread of ParallelFor works too
+  if (num_workers > 1) pool_.reset(new ThreadPool(num_workers - 1));
+  slots_.resize(prefetch + 1);
+}
+
+void DataPipeline::Start(int flag) {
+  Stop();
+  reader_->SeekToFirst();
+  free_.reset(new SafeQueue<int>());
+  ready_.reset(new SafeQueue<int>());
+  for (size_t i = 0; i < slots_.size(); i++) free_->Push(i);
+  ended_ = false;
+  loader_ = std::thread(&DataPipeline::Load, this, flag);
+}
+
+bool DataPipeline::Next(std::vector<Tensor>* batch) {
+  CHECK(ready_ != nullptr) << "Call Start() first";
+  if (held_ >= 0) free_->Push(held_);
+  held_ = -1;
+  int id = -1;
+  if (ended_ || !ready_->WaitAndPop(id) || id < 0) {
+    ended_ = true;
+    return false;
+  }
+  held_ = id;
+  const Slot& slot = slots_[id];
+  batch->clear();
+  for (const auto& t : slot.tensors) {
+    if (slot.size == batchsize_) {
+      batch->push_back(t);
+    } else {
+      // the last batch of the data is smaller
+      Shape shape(t.shape());
+      shape[0] = slot.size;
+      Tensor part(shape, device_, t.data_type());
+      CopyDataToFrom(&part, t, part.Size());
+      batch->push_back(part);
+    }
+  }
+  return true;
+}
+
+void DataPipeline::Stop() {
+  if (free_ != nullptr) free_->Close();
+  if (ready_ != nullptr) ready_->Close();
+  if (loader_.joinable()) loader_.join();
+  held_ = -1;
+  ended_ = true;
+}
+
+void DataPipeline::Load(int flag) {
+  std::vector<std::string> values(batchsize_);
+  std::string key;
+  while (true) {
+    size_t n = 0;
+    while (n < batchsize_ && reader_->Read(&key, &values[n])) n++;
+    if (n == 0) break;
+    int id;
+    if (!free_->WaitAndPop(id)) return;
+    // the previous user of the slot may have pending operations on it
+    device_->Sync();
+    values.resize(n);
+    Fill(flag, values, &slots_[id]);
+    values.resize(batchsize_);
+    if (!ready_->Push(id)) return;
+    if (n < batchsize_) break;
+  }
+  ready_->Push(-1);
+}
+
+std::vector<Tensor> DataPipeline::Process(int flag, const std::string& value) {
+  std::vector<Tensor> sample = decoder_->Decode(value);
+  CHECK(!sample.empty()) << "Nothing is decoded";
+  if (transformer_ != nullptr)
+    sample[0] = transformer_->Apply(flag, sample[0]);
+  return sample;
+}
+
+void DataPipeline::Fill(int flag, const std::vector<std::string>& values,
+                        Slot* slot) {
+  // the first sample decides the shapes of the batch tensors
+  std::vector<Tensor> first = Process(flag, values[0]);
+  bool fit = slot->tensors.size() == first.size();
+  for (size_t k = 0; fit && k < first.size(); k++) {
+    Shape shape(slot->tensors[k].shape());
+    shape.erase(shape.begin());
+    fit = shape == first[k].shape() &&
+          slot->tensors[k].data_type() == first[k].data_type();
+  }
+  if (!fit) {
+    slot->tensors.clear();
+    for (const auto& t : first) {
+      Shape shape(t.shape());
+      shape.insert(shape.begin(), batchsize_);
+      slot->tensors.push_back(Tensor(shape, device_, t.data_type()));
+    }
+  }
+  std::vector<char*> dst;
+  std::vector<size_t> bytes;
+  for (size_t k = 0; k < first.size(); k++) {
+    dst.push_back(static_cast<char*>(slot->tensors[k].block()->mutable_data()));
+    bytes.push_back(first[k].Size() * SizeOf(first[k].data_type()));
+  }
+
+  auto copy = [&](size_t i, const std::vector<Tensor>& sample) {
+    CHECK_EQ(sample.size(), first.size()) << "Sample " << i;
+    for (size_t k = 0; k < sample.size(); k++) {
+      CHECK(sample[k].shape() == first[k].shape() &&
+            sample[k].data_type() == first[k].data_type())
+          << "Samples of a batch must have the same shape and type";
+      CHECK(!sample[k].transpose());
+      std::memcpy(dst[k] + i * bytes[k], sample[k].data<char>(), bytes[k]);
+    }
+  };
+  copy(0, first);
+  auto work = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      if (transformer_ == nullptr)
+        decoder_->DecodeInto(values[i].data(), values[i].size(), i,
+                             &slot->tensors);
+      else
+        copy(i, Process(flag, values[i]));
+    }
+  };
+  if (pool_ != nullptr)
+    pool_->ParallelFor(1, values.size(), 1, work);
+  else
+    work(1, values.size());
+  slot->size = values.size();
+}
+
+}  // namespace singa
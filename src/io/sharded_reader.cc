@@ -0,0 +1,173 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "singa/io/reader.h"
+#include "singa/utils/logging.h"
+
+#include <algorithm>
+#include <random>
+
+#ifndef _WIN32
+#include <glob.h>
+#endif  // _WIN32
+
+namespace singa {
+namespace io {
+
+ShardedReader::ShardedReader(int num_threads, int capacity, int block,
+                             bool shuffle, unsigned seed,
+                             ReaderCreator creator)
+    : num_threads_(num_threads), capacity_(capacity), block_(block),
+      shuffle_(shuffle), seed_(seed), creator_(creator) {
+  CHECK_GT(num_threads_, 0);
+  CHECK_GT(capacity_, 0);
+  CHECK_GT(block_, 0);
+}
+
+bool ShardedReader::Open(const std::string& path) {
+  std::vector<std::string> shards;
+#ifdef _WIN32
+  shards.push_back(path);
+#else
+  glob_t result;
+  int ret = glob(path.c_str(), 0, nullptr, &result);
+  if (ret == 0)
+    for (size_t i = 0; i < result.gl_pathc; i++)
+      shards.push_back(result.gl_pathv[i]);
+  globfree(&result);
+  if (ret != 0 && ret != GLOB_NOMATCH)
+    LOG(WARNING) << "Cannot expand the pattern " << path;
+#endif  // _WIN32
+  if (shards.empty()) {
+    LOG(WARNING) << "No shard matches " << path;
+    return false;
+  }
+  return Open(shards);
+}
+
+bool ShardedReader::Open(const std::vector<std::string>& shards) {
+  Close();
+  shards_ = shards;
+  epoch_ = 0;
+  count_ = -1;
+  StartEpoch();
+  return true;
+}
+
+void ShardedReader::Close() {
+  StopEpoch();
+  shards_.clear();
+}
+
+bool ShardedReader::Read(std::string* key, std::string* value) {
+  CHECK(!shards_.empty()) << "No shard is open!";
+  while (pos_ >= block_buf_.size()) {
+    if (live_.empty()) return false;
+    Block next;
+    size_t tid = live_[next_];
+    if (!queues_[tid]->WaitAndPop(next) || next.empty()) {
+      // an empty block marks the end of the thread's shards
+      live_.erase(live_.begin() + next_);
+      if (next_ >= live_.size()) next_ = 0;
+      continue;
+    }
+    block_buf_.swap(next);
+    pos_ = 0;
+    next_ = (next_ + 1) % live_.size();
+  }
+  *key = std::move(block_buf_[pos_].first);
+  *value = std::move(block_buf_[pos_].second);
+  pos_++;
+  return true;
+}
+
+int ShardedReader::Count() {
+  if (count_ < 0) {
+    count_ = 0;
+    for (const auto& shard : shards_) {
+      std::unique_ptr<Reader> reader(CreateReader());
+      CHECK(reader->Open(shard)) << "Cannot open shard " << shard;
+      count_ += reader->Count();
+      reader->Close();
+    }
+  }
+  return count_;
+}
+
+void ShardedReader::SeekToFirst() {
+  CHECK(!shards_.empty()) << "No shard is open!";
+  StopEpoch();
+  epoch_++;
+  StartEpoch();
+}
+
+void ShardedReader::StartEpoch() {
+  std::vector<std::string> order(shards_);
+  if (shuffle_)
+    std::shuffle(order.begin(), order.end(),
+                 std::mt19937(seed_ + static_cast<unsigned>(epoch_)));
+  size_t nthreads = std::min(order.size(), static_cast<size_t>(num_threads_));
+  for (size_t t = 0; t < nthreads; t++) {
+    std::vector<std::string> assigned;
+    for (size_t i = t; i < order.size(); i += nthreads)
+      assigned.push_back(order[i]);
+    queues_.emplace_back(new SafeQueue<Block>(capacity_));
+    threads_.emplace_back(&ShardedReader::Run, this, queues_.back().get(),
+                          std::move(assigned));
+    live_.push_back(t);
+  }
+  next_ = 0;
+}
+
+void ShardedReader::StopEpoch() {
+  for (auto& queue : queues_) queue->Close();
+  for (auto& thread : threads_) thread.join();
+  threads_.clear();
+  queues_.clear();
+  live_.clear();
+  block_buf_.clear();
+  pos_ = 0;
+}
+
+void ShardedReader::Run(SafeQueue<Block>* queue,
+                        std::vector<std::string> shards) {
+  std::unique_ptr<Reader> reader(CreateReader());
+  Block block;
+  std::string key, value;
+  for (const auto& shard : shards) {
+    CHECK(reader->Open(shard)) << "Cannot open shard " << shard;
+    while (reader->Read(&key, &value)) {
+      block.emplace_back(std::move(key), std::move(value));
+      if (block.size() == static_cast<size_t>(block_)) {
+        if (!queue->Push(std::move(block))) return;
+        block = Block();
+      }
+    }
+    reader->Close();
+  }
+  if (!block.empty() && !queue->Push(std::move(block))) return;
+  queue->Push(Block());
+}
+
+Reader* ShardedReader::CreateReader() const {
+  if (creator_) return creator_();
+  return new BinFileReader();
+}
+
+}  // namespace io
+}  // namespace singa
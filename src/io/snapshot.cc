@@ -22,80 +22,377 @@
 #include "singa/singa_config.h"
 #include "singa/io/snapshot.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <unordered_set>
 #include <unordered_map>
 #include <memory>
+#include <thread>
 #include <utility>
 #include <iostream>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // _WIN32
+
 namespace singa {
+namespace {
+const char kFileMagic[4] = {'s', 'g', 't', 's'};
+const char kRecordMagic[4] = {'s', 'g', 't', 'r'};
+const char kIndexMagic[4] = {'s', 'g', 't', 'i'};
+const uint32_t kFormatVersion = 1;
+/// alignment of the tensor data in the file
+const uint64_t kDataAlign = 64;
+
+/// Fixed part of a record header, followed by the key, the shape (uint64_t)
+/// and the stride (int64_t).
+struct RecordHeader {
+  char magic[4];
+  uint32_t key_size;
+  uint32_t data_type;
+  uint32_t ndim;
+  uint32_t nstride;
+  uint32_t reserved;
+  uint64_t offset;
+  uint64_t nbytes;
+  uint64_t checksum;
+};
+
+/// End of the file: the index, which has a copy of each record header, is at
+/// index_offset.
+struct IndexFooter {
+  uint64_t index_offset;
+  uint64_t count;
+  uint32_t reserved;
+  char magic[4];
+};
+
+/// Fletcher-like checksum of 4-byte words.
+uint64_t Checksum(const char* data, size_t size) {
+  uint64_t a = 0, b = 0;
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    uint32_t w;
+    std::memcpy(&w, data + i, sizeof(w));
+    a += w;
+    b += a;
+  }
+  for (; i < size; i++) {
+    a += static_cast<unsigned char>(data[i]);
+    b += a;
+  }
+  return (b << 32) ^ a;
+}
+
+// Load the whole file at 'path'; return nullptr if it cannot be opened.
+std::shared_ptr<char> LoadFile(const std::string& path, size_t* size) {
+#ifdef _WIN32
+  std::ifstream fin(path, std::ios::in | std::ios::binary | std::ios::ate);
+  if (!fin.is_open()) return nullptr;
+  *size = static_cast<size_t>(fin.tellg());
+  std::shared_ptr<char> buf(new char[*size + 1], std::default_delete<char[]>());
+  fin.seekg(0);
+  fin.read(buf.get(), *size);
+  CHECK(fin.good()) << "Cannot read file " << path;
+  return buf;
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return nullptr;
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Cannot stat file " << path;
+  *size = static_cast<size_t>(st.st_size);
+  if (*size == 0) {
+    close(fd);
+    return std::shared_ptr<char>(new char[1], std::default_delete<char[]>());
+  }
+  // private writable pages, hence tensors over them could be updated in place
+  void* ptr = mmap(nullptr, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  CHECK(ptr != MAP_FAILED) << "Cannot mmap file " << path;
+  size_t len = *size;
+  return std::shared_ptr<char>(static_cast<char*>(ptr),
+                               [len](char* p) { munmap(p, len); });
+#endif  // _WIN32
+}
+
+// Parse a TensorProto into a tensor over a host buffer.
+Tensor ParseProto(const char* value, size_t size) {
+  TensorProto tp;
+  CHECK(tp.ParseFromArray(value, static_cast<int>(size)));
+  Shape shape(tp.shape().begin(), tp.shape().end());
+  std::vector<int> stride(tp.stride().begin(), tp.stride().end());
+  DataType dtype = tp.data_type();
+  const size_t num = Product(shape), nbytes = num * SizeOf(dtype);
+  if (nbytes == 0) return Tensor();
+  std::shared_ptr<char> buf(new char[nbytes], std::default_delete<char[]>());
+  switch (dtype) {
+  case kFloat32:
+    CHECK_EQ(static_cast<size_t>(tp.float_data_size()), num);
+    std::memcpy(buf.get(), tp.float_data().data(), nbytes);
+    break;
+  case kDouble:
+    CHECK_EQ(static_cast<size_t>(tp.double_data_size()), num);
+    std::memcpy(buf.get(), tp.double_data().data(), nbytes);
+    break;
+  case kInt:
+    CHECK_EQ(static_cast<size_t>(tp.int_data_size()), num);
+    std::memcpy(buf.get(), tp.int_data().data(), nbytes);
+    break;
+  default: { LOG(FATAL) << "Unsupported Type" << DataType_Name(dtype); }
+  }
+  return Tensor(new Block(buf.get(), nbytes, 0, buf), shape, defaultDevice,
+                dtype, stride);
+}
+
+// Flush the file at 'path' (or a directory) to disk.
+void SyncFile(const std::string& path, bool must) {
+#ifndef _WIN32
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    CHECK(!must) << "Cannot open file " << path;
+    return;
+  }
+  int ret = fsync(fd);
+  close(fd);
+  CHECK(!must || ret == 0) << "Cannot sync file " << path;
+#endif  // _WIN32
+}
+
+std::string DirName(const std::string& path) {
+  size_t pos = path.rfind('/');
+  if (pos == std::string::npos) return ".";
+  return pos == 0 ? "/" : path.substr(0, pos);
+}
+}  // namespace
+
 Snapshot::Snapshot(const std::string& prefix, Mode mode, int max_param_size /*in MB*/)
     : prefix_(prefix),
       mode_(mode),
-      bin_writer_ptr_(mode_ == kWrite ? (new io::BinFileWriter) : nullptr),
-      text_writer_ptr_(mode_ == kWrite ? (new io::TextFileWriter) : nullptr),
-      bin_reader_ptr_(mode_ == kRead ? (new io::BinFileReader) : nullptr) {
+      text_writer_ptr_(mode_ == kWrite ? (new io::TextFileWriter) : nullptr) {
   if (mode_ == kWrite) {
     // changed to .bin since v1.0.1
-    bin_writer_ptr_->Open(prefix + ".bin", io::kCreate, max_param_size << 20);
+    bin_file_.open(prefix + ".bin",
+                   std::ios::out | std::ios::binary | std::ios::trunc);
+    CHECK(bin_file_.is_open()) << "Cannot create file " << prefix + ".bin";
+    bin_file_.write(kFileMagic, sizeof(kFileMagic));
+    bin_file_.write(reinterpret_cast<const char*>(&kFormatVersion),
+                    sizeof(kFormatVersion));
+    bin_pos_ = sizeof(kFileMagic) + sizeof(kFormatVersion);
     text_writer_ptr_->Open(prefix + ".desc", io::kCreate);
 
     // write the current version ids
     //text_writer_ptr_->Write("SINGA_VERSION", std::to_string(SINGA_VERSION));
     text_writer_ptr_->Write("", "SINGA VERSION: " + std::to_string(SINGA_VERSION));
   } else if (mode == kRead) {
-
-    /*
-    auto text_reader_ptr = new io::TextFileReader();
-    text_reader_ptr->Open(prefix + ".desc");
-    std::string key, val;
-    while (text_reader_ptr->Read(&key, &val)) {
-      if (key == "0")
-        version_ = std::stoi(val);
-    }
-    delete text_reader_ptr;
-    */
-    std::string key, val;
-    if (!bin_reader_ptr_->Open(prefix + ".bin", max_param_size << 20))
-      CHECK(bin_reader_ptr_->Open(prefix + ".model", max_param_size << 20))
-        << "Cannot open the checkpoint bin file:" << prefix + ".bin (>=1.0.1) "
-        <<" or " << prefix + " .model (used by 1.0.0)";
-    singa::TensorProto tp;
-    while (bin_reader_ptr_->Read(&key, &val)) {
-      /*
-      if (key == "SINGA_VERSION") {
-        CHECK(version_ == std::stoi(val)) << key << " in .bin and .desc mismatch: "
-          << val << " (bin) vs " << version_ << " (desc)";
-        continue;
-      }
-      */
-
-      CHECK(param_names_.count(key) == 0);
-      param_names_.insert(key);
-      CHECK(tp.ParseFromString(val));
-      param_map_[key].FromProto(tp);
+    if (!OpenTensorFile(prefix + ".bin")) {
+      proto_format_ = true;
+      OpenProtoFile(prefix, max_param_size);
     }
-    //need ro set version_ by getting data form param_map_["SINGA_VERSION"]?
   } else {
     LOG(FATAL)
         << "Mode for snapshot should be Snapshot::kWrite or Snapshot::kRead";
   }
 }
 
+Snapshot::~Snapshot() {
+  if (mode_ != kWrite || !bin_file_.is_open()) return;
+  // the index of the records and the footer
+  IndexFooter footer;
+  footer.index_offset = bin_pos_;
+  footer.count = keys_.size();
+  footer.reserved = 0;
+  std::memcpy(footer.magic, kIndexMagic, sizeof(kIndexMagic));
+  bin_file_.write(index_.data(), index_.size());
+  bin_file_.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+  bin_file_.close();
+  CHECK(!bin_file_.fail()) << "Cannot write the checkpoint " << prefix_;
+}
+
+uint64_t Snapshot::AddRecord(const char* base, uint64_t pos, uint64_t end,
+                             const std::string& path) {
+  RecordHeader h;
+  CHECK_LE(pos + sizeof(h), end) << "Truncated checkpoint " << path;
+  std::memcpy(&h, base + pos, sizeof(h));
+  CHECK_EQ(std::memcmp(h.magic, kRecordMagic, sizeof(kRecordMagic)), 0)
+      << "Corrupted checkpoint " << path << " at " << pos;
+  pos += sizeof(h);
+  uint64_t meta = h.key_size + (h.ndim + h.nstride) * sizeof(uint64_t);
+  CHECK_LE(pos + meta, end) << "Truncated checkpoint " << path;
+  std::string key(base + pos, h.key_size);
+  pos += h.key_size;
+  Record rec;
+  rec.data_type = static_cast<DataType>(h.data_type);
+  for (uint32_t i = 0; i < h.ndim; i++, pos += sizeof(uint64_t)) {
+    uint64_t d;
+    std::memcpy(&d, base + pos, sizeof(d));
+    rec.shape.push_back(static_cast<size_t>(d));
+  }
+  for (uint32_t i = 0; i < h.nstride; i++, pos += sizeof(int64_t)) {
+    int64_t s;
+    std::memcpy(&s, base + pos, sizeof(s));
+    rec.stride.push_back(static_cast<int>(s));
+  }
+  rec.offset = h.offset;
+  rec.nbytes = h.nbytes;
+  rec.checksum = h.checksum;
+  CHECK(h.offset <= end && h.nbytes <= end - h.offset)
+      << "Truncated checkpoint " << path;
+  CHECK(rec.nbytes == 0 ||
+        rec.nbytes == Product(rec.shape) * SizeOf(rec.data_type))
+      << "Corrupted checkpoint " << path << " for " << key;
+  CHECK(param_names_.count(key) == 0);
+  param_names_.insert(key);
+  keys_.push_back(key);
+  records_[key] = rec;
+  return pos;
+}
+
+bool Snapshot::OpenTensorFile(const std::string& path) {
+  size_t size = 0;
+  std::shared_ptr<char> file = LoadFile(path, &size);
+  if (file == nullptr || size < sizeof(kFileMagic) + sizeof(uint32_t) ||
+      std::memcmp(file.get(), kFileMagic, sizeof(kFileMagic)) != 0)
+    return false;
+  const char* base = file.get();
+  uint32_t version;
+  std::memcpy(&version, base + sizeof(kFileMagic), sizeof(version));
+  CHECK_LE(version, kFormatVersion) << "The checkpoint " << path
+                                    << " is of a newer format";
+  const uint64_t start = sizeof(kFileMagic) + sizeof(version);
+  IndexFooter footer;
+  if (size >= start + sizeof(footer))
+    std::memcpy(&footer, base + size - sizeof(footer), sizeof(footer));
+  if (size >= start + sizeof(footer) &&
+      std::memcmp(footer.magic, kIndexMagic, sizeof(kIndexMagic)) == 0) {
+    // only the index at the end is parsed, hence the pages of the records
+    // are not touched until they are read
+    CHECK(footer.index_offset >= start &&
+          footer.index_offset <= size - sizeof(footer))
+        << "Corrupted index of checkpoint " << path;
+    uint64_t pos = footer.index_offset, end = size - sizeof(footer);
+    for (uint64_t i = 0; i < footer.count; i++) {
+      pos = AddRecord(base, pos, end, path);
+      CHECK_LE(records_[keys_.back()].offset + records_[keys_.back()].nbytes,
+               footer.index_offset) << "Corrupted index of checkpoint " << path;
+    }
+  } else {
+    // files without the index, e.g., not closed properly
+    uint64_t pos = start;
+    while (pos < size) {
+      AddRecord(base, pos, size, path);
+      const Record& rec = records_[keys_.back()];
+      CHECK_GE(rec.offset, pos) << "Corrupted checkpoint " << path;
+      pos = rec.offset + rec.nbytes;
+    }
+  }
+  file_ = file;
+  return true;
+}
+
+void Snapshot::OpenProtoFile(const std::string& prefix, int max_param_size) {
+  /*
+  auto text_reader_ptr = new io::TextFileReader();
+  text_reader_ptr->Open(prefix + ".desc");
+  std::string key, val;
+  while (text_reader_ptr->Read(&key, &val)) {
+    if (key == "0")
+      version_ = std::stoi(val);
+  }
+  delete text_reader_ptr;
+  */
+  bin_reader_ptr_.reset(new io::BinFileReader);
+  std::string path = prefix + ".bin";
+  if (!bin_reader_ptr_->Open(path)) {
+    path = prefix + ".model";
+    CHECK(bin_reader_ptr_->Open(path))
+      << "Cannot open the checkpoint bin file:" << prefix + ".bin (>=1.0.1) "
+      <<" or " << prefix + " .model (used by 1.0.0)";
+  }
+  if (bin_reader_ptr_->mapped()) {
+    // the tensors are parsed when they are read
+    io::StringView key, val;
+    while (bin_reader_ptr_->Read(&key, &val)) {
+      Record rec;
+      rec.proto = val;
+      CHECK(param_names_.count(key.ToString()) == 0);
+      param_names_.insert(key.ToString());
+      keys_.push_back(key.ToString());
+      records_[keys_.back()] = rec;
+    }
+    return;
+  }
+
+  // no memory mapping, e.g., on Windows
+  CHECK(bin_reader_ptr_->Open(path, max_param_size << 20));
+  std::string key, val;
+  while (bin_reader_ptr_->Read(&key, &val)) {
+    /*
+    if (key == "SINGA_VERSION") {
+      CHECK(version_ == std::stoi(val)) << key << " in .bin and .desc mismatch: "
+        << val << " (bin) vs " << version_ << " (desc)";
+      continue;
+    }
+    */
+
+    CHECK(param_names_.count(key) == 0);
+    param_names_.insert(key);
+    keys_.push_back(key);
+    param_map_[key] = ParseProto(val.data(), val.size());
+  }
+  bin_reader_ptr_.reset();
+  //need ro set version_ by getting data form param_map_["SINGA_VERSION"]?
+}
+
 void Snapshot::Write(const std::string& key, const Tensor& param) {
   CHECK(mode_ == kWrite);
   CHECK(param_names_.count(key) == 0);
   param_names_.insert(key);
-  TensorProto tp;
-  param.ToProto(&tp);
-  std::string serialized_str;
-  CHECK(tp.SerializeToString(&serialized_str));
-  bin_writer_ptr_->Write(key, serialized_str);
-//  bin_writer_ptr_->Flush();
+  keys_.push_back(key);
+  // the data is written from host memory
+  Tensor host = param.device()->lang() == kCpp ? param
+                                               : param.Clone(defaultDevice);
+  const Shape& shape = host.shape();
+  const std::vector<int>& stride = host.stride();
+  RecordHeader h;
+  std::memcpy(h.magic, kRecordMagic, sizeof(kRecordMagic));
+  h.key_size = static_cast<uint32_t>(key.size());
+  h.data_type = static_cast<uint32_t>(host.data_type());
+  h.ndim = static_cast<uint32_t>(shape.size());
+  h.nstride = static_cast<uint32_t>(stride.size());
+  h.reserved = 0;
+  h.nbytes = host.Size() * SizeOf(host.data_type());
+  const char* data = h.nbytes > 0 ? host.data<char>() : nullptr;
+  h.checksum = Checksum(data, h.nbytes);
+
+  std::string head(reinterpret_cast<const char*>(&h), sizeof(h));
+  head += key;
+  for (size_t d : shape) {
+    uint64_t v = d;
+    head.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+  for (int s : stride) {
+    int64_t v = s;
+    head.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+  uint64_t end = bin_pos_ + head.size();
+  h.offset = (end + kDataAlign - 1) / kDataAlign * kDataAlign;
+  std::memcpy(&head[offsetof(RecordHeader, offset)], &h.offset,
+              sizeof(h.offset));
+  // the index has a copy of the header
+  index_ += head;
+  head.append(h.offset - end, '\0');
+  bin_file_.write(head.data(), head.size());
+  if (h.nbytes > 0) bin_file_.write(data, h.nbytes);
+  CHECK(bin_file_.good()) << "Cannot write the checkpoint of " << key;
+  bin_pos_ = h.offset + h.nbytes;
 
   std::string desc_str = "parameter name: " + key;
-  Shape shape = param.shape();
   desc_str += "\tdata type: " + std::to_string(param.data_type());
   desc_str += "\tdim: " + std::to_string(shape.size());
   desc_str += "\tshape:";
@@ -104,32 +401,206 @@ void Snapshot::Write(const std::string& key, const Tensor& param) {
  // text_writer_ptr_->Flush();
 }
 
+Snapshot::Record* Snapshot::Find(const std::string& key) {
+  auto it = records_.find(key);
+  CHECK(it != records_.end()) << "No tensor " << key << " in the checkpoint";
+  return &it->second;
+}
+
+Tensor Snapshot::MakeTensor(Record* rec) {
+  if (proto_format_) return ParseProto(rec->proto.data(), rec->proto.size());
+  // e.g., a default-constructed tensor without data
+  if (rec->nbytes == 0) return Tensor();
+  char* data = file_.get() + rec->offset;
+  if (!rec->verified) {
+    CHECK_EQ(Checksum(data, rec->nbytes), rec->checksum)
+        << "Checksum mismatch of the checkpoint " << prefix_ << ".bin";
+    rec->verified = true;
+  }
+  Block* block = new Block(data, rec->nbytes, 0, file_);
+  return Tensor(block, rec->shape, defaultDevice, rec->data_type, rec->stride);
+}
+
 std::vector<std::pair<std::string, Tensor>> Snapshot::Read() {
+  return ReadAll();
+}
+
+std::vector<std::pair<std::string, Tensor>> Snapshot::ReadAll(int num_threads) {
   CHECK(mode_ == kRead);
+  if (num_threads <= 0)
+    num_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  std::vector<Tensor> tensors(keys_.size());
+  std::vector<Record*> todo(keys_.size(), nullptr);
+  for (size_t i = 0; i < keys_.size(); i++) {
+    auto it = param_map_.find(keys_[i]);
+    if (it != param_map_.end())
+      tensors[i] = it->second;
+    else
+      todo[i] = Find(keys_[i]);
+  }
+  // the records are distinct and MakeTensor() does not use the device
+  auto decode = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      if (todo[i] != nullptr) tensors[i] = MakeTensor(todo[i]);
+  };
+  if (num_threads > 1 && keys_.size() > 1) {
+    ThreadPool pool(std::min(num_threads, static_cast<int>(keys_.size())) - 1);
+    pool.ParallelFor(0, keys_.size(), 1, decode);
+  } else {
+    decode(0, keys_.size());
+  }
+
   std::vector<std::pair<std::string, Tensor>> ret;
-  for (auto it = param_map_.begin(); it != param_map_.end(); ++it)
-    ret.push_back(*it);
+  for (size_t i = 0; i < keys_.size(); i++) {
+    if (proto_format_ && todo[i] != nullptr) param_map_[keys_[i]] = tensors[i];
+    ret.push_back(std::make_pair(keys_[i], tensors[i]));
+  }
   return ret;
 }
 
 std::vector<std::pair<std::string, Shape>> Snapshot::ReadShape() {
   CHECK(mode_ == kRead);
   std::vector<std::pair<std::string, Shape>> ret;
-  for (auto it = param_map_.begin(); it != param_map_.end(); ++it)
-    ret.push_back(std::make_pair(it->first, it->second.shape()));
+  for (const auto& key : keys_)
+    ret.push_back(std::make_pair(key, ReadShape(key)));
   return ret;
 }
 
 Tensor Snapshot::Read(const std::string& key) {
   CHECK(mode_ == kRead);
-  CHECK(param_map_.count(key) == 1);
-  return param_map_[key];
+  auto it = param_map_.find(key);
+  if (it != param_map_.end()) return it->second;
+  Tensor t = MakeTensor(Find(key));
+  // parsed tensors are cached; mapped ones are cheap to create
+  if (proto_format_) param_map_[key] = t;
+  return t;
 }
 
 Shape Snapshot::ReadShape(const std::string& key) {
   CHECK(mode_ == kRead);
-  CHECK(param_map_.count(key) == 1);
-  return param_map_[key].shape();
+  if (proto_format_) return Read(key).shape();
+  return Find(key)->shape;
+}
+
+struct Checkpointer::Job {
+  int step;
+  /// captured tensors on the host device
+  std::vector<std::pair<std::string, Tensor>> tensors;
+  std::mutex mtx;
+  std::condition_variable cv;
+  /// number of tensors being copied
+  size_t num_copying = 0;
+
+  void Copied() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (--num_copying == 0) cv.notify_all();
+  }
+  void WaitCopied() {
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this]() { return num_copying == 0; });
+  }
+};
+
+Checkpointer::Checkpointer(const std::string& prefix, int keep,
+                           int max_pending)
+    : prefix_(prefix), keep_(keep > 0 ? keep : 0),
+      host_(std::make_shared<CppCPU>()), jobs_(max_pending) {
+  CHECK_GT(max_pending, 0);
+  writer_ = std::thread(&Checkpointer::Run, this);
+}
+
+Checkpointer::~Checkpointer() {
+  jobs_.Close();
+  // the queued jobs are still written
+  if (writer_.joinable()) writer_.join();
+}
+
+void Checkpointer::Save(int step,
+                        const std::vector<std::pair<std::string, Tensor>>& params) {
+  auto job = std::make_shared<Job>();
+  job->step = step;
+  job->num_copying = params.size() + 1;
+  for (const auto& p : params) {
+    const Tensor& src = p.second;
+    if (src.Size() == 0) {
+      job->tensors.push_back(std::make_pair(p.first, Tensor()));
+      job->Copied();
+      continue;
+    }
+    size_t nbytes = src.MemSize();
+    std::shared_ptr<char> buf(new char[nbytes], std::default_delete<char[]>());
+    Tensor dst(new Block(buf.get(), nbytes, 0, buf), src.shape(), host_,
+               src.data_type(), src.stride());
+    // run by the device of src after the pending writes of src, and before
+    // its later writes
+    CopyDataToFrom(&dst, src, src.Size());
+    src.device()->Exec([job](Context* ctx) { job->Copied(); }, {dst.block()},
+                       {});
+    job->tensors.push_back(std::make_pair(p.first, dst));
+  }
+  job->Copied();
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    num_pending_++;
+  }
+  CHECK(jobs_.Push(job)) << "The checkpointer is closed";
+}
+
+void Checkpointer::Wait() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  done_cv_.wait(lock, [this]() { return num_pending_ == 0; });
+}
+
+std::vector<std::string> Checkpointer::checkpoints() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return std::vector<std::string>(kept_.begin(), kept_.end());
+}
+
+void Checkpointer::Run() {
+  std::shared_ptr<Job> job;
+  while (jobs_.WaitAndPop(job)) {
+    job->WaitCopied();
+    Write(job.get());
+    job.reset();
+    std::lock_guard<std::mutex> lock(mtx_);
+    num_pending_--;
+    done_cv_.notify_all();
+  }
+}
+
+void Checkpointer::Write(Job* job) {
+  const std::string name = prefix_ + "-" + std::to_string(job->step);
+  const std::string tmp = name + ".tmp";
+  {
+    Snapshot snapshot(tmp, Snapshot::kWrite);
+    for (const auto& p : job->tensors) snapshot.Write(p.first, p.second);
+  }
+  // the .bin file is renamed last, hence it marks a complete checkpoint
+  for (const char* ext : {".desc", ".bin"}) {
+    SyncFile(tmp + ext, true);
+#ifdef _WIN32
+    std::remove((name + ext).c_str());
+#endif  // _WIN32
+    CHECK_EQ(std::rename((tmp + ext).c_str(), (name + ext).c_str()), 0)
+        << "Cannot rename " << tmp + ext;
+  }
+  SyncFile(DirName(name), false);
+
+  std::vector<std::string> removed;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = std::find(kept_.begin(), kept_.end(), name);
+    if (it != kept_.end()) kept_.erase(it);
+    kept_.push_back(name);
+    while (keep_ > 0 && kept_.size() > keep_) {
+      removed.push_back(kept_.front());
+      kept_.pop_front();
+    }
+  }
+  for (const auto& old : removed) {
+    std::remove((old + ".bin").c_str());
+    std::remove((old + ".desc").c_str());
+  }
 }
 
 }  //  namespace singa
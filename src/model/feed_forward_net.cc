@@ -23,8 +23,48 @@
 #include "singa/model/initializer.h"
 #include "singa/utils/logging.h"
 #include "singa/utils/channel.h"
+#include "singa/utils/safe_queue.h"
+#include <future>
 namespace singa {
 
+/// Applies the gradient buckets of FeedForwardNet::TrainOnBatch() in order.
+class FeedForwardNet::BucketUpdater {
+ public:
+  struct Bucket {
+    int step = 0;
+    vector<string> names;
+    vector<Tensor> grads, values;
+    size_t bytes = 0;
+    /// set for the last bucket of a batch
+    std::shared_ptr<std::promise<void>> done;
+  };
+
+  explicit BucketUpdater(std::shared_ptr<Updater> updater)
+      : updater_(updater), thread_([this]() { Run(); }) {}
+  ~BucketUpdater() {
+    queue_.Close();
+    thread_.join();
+  }
+
+  void Push(Bucket&& bucket) { queue_.Push(std::move(bucket)); }
+
+ private:
+  void Run() {
+    Bucket bucket;
+    while (queue_.WaitAndPop(bucket)) {
+      if (!bucket.names.empty())
+        updater_->ApplyBucket(bucket.step, bucket.names, bucket.grads,
+                              bucket.values);
+      if (bucket.done != nullptr) bucket.done->set_value();
+      bucket = Bucket();
+    }
+  }
+
+  std::shared_ptr<Updater> updater_;
+  SafeQueue<Bucket> queue_;
+  std::thread thread_;
+};
+
 FeedForwardNet::~FeedForwardNet() {
 }
 
@@ -80,6 +120,8 @@ void FeedForwardNet::Compile(bool shuffle, bool to_register,
   bool test = metric != nullptr;
   CHECK(train || test) << "Must set updater and loss, or set metric";
   updater_ = updater;
+  // bound to the previous updater
+  bucket_updater_.reset();
   loss_ = loss;
   metric_ = metric;
   const auto specs = GetParamSpecs();
@@ -123,7 +165,11 @@ FeedForwardNet FeedForwardNet::Clone(std::shared_ptr<Device> device) {
 }
 
 void FeedForwardNet::AsType(DataType dtype) {
-  LOG(FATAL) << "FeedForwardNet::AsType not implemented";
+  // an int8 model needs a scale per tensor, see Quantize()
+  CHECK(dtype != kChar && dtype != kUChar)
+      << "Use Quantize() to convert parameters into int8";
+  for (auto layer : layers_) layer->AsType(dtype);
+  dtype_ = dtype;
 }
 
 void FeedForwardNet::Train(size_t batchsize, int nb_epoch, const Tensor& x,
@@ -191,16 +237,54 @@ const std::pair<float, float> FeedForwardNet::TrainOnBatch(int epoch,
                                                            const Tensor& x,
                                                            const Tensor& y) {
   int flag = kTrain;
-  const Tensor fea = Forward(flag, x);
-  float loss = loss_->Evaluate(flag, fea, y);
-  float metric = metric_->Evaluate(fea, y);
-  const Tensor grad = loss_->Backward();
-  auto grads = Backward(kTrain, grad / static_cast<float>(x.shape(0)));
-  auto names = GetParamNames();
-  auto values = GetParamValues();
-  for (size_t k = 0; k < grads.size(); k++) {
-    updater_->Apply(epoch, names[k], grads[k], values.at(k));
+  float loss, metric;
+  auto dev = x.device();
+  dev->StartIteration();
+  {
+    // the temporary tensors are released within the iteration
+    const Tensor fea = Forward(flag, x);
+    loss = loss_->Evaluate(flag, fea, y);
+    metric = metric_->Evaluate(fea, y);
+    const Tensor grad = loss_->Backward();
+    if (bucket_size_ > 0) {
+      CHECK(dev->vm() == nullptr)
+          << "OverlapUpdate() does not work with virtual memory";
+      if (bucket_updater_ == nullptr)
+        bucket_updater_ = std::make_shared<BucketUpdater>(updater_);
+      BucketUpdater::Bucket bucket;
+      bucket.step = epoch;
+      auto emit = [&](Layer* layer, const vector<Tensor>& grads) {
+        const auto names = layer->param_names();
+        const auto values = layer->param_values();
+        CHECK_EQ(names.size(), grads.size());
+        for (size_t k = 0; k < grads.size(); k++) {
+          bucket.names.push_back(names[k]);
+          bucket.grads.push_back(grads[k]);
+          bucket.values.push_back(values.at(k));
+          bucket.bytes += grads[k].Size() * SizeOf(grads[k].data_type());
+        }
+        if (bucket.bytes >= bucket_size_) {
+          bucket_updater_->Push(std::move(bucket));
+          bucket = BucketUpdater::Bucket();
+          bucket.step = epoch;
+        }
+      };
+      Backward(kTrain, grad / static_cast<float>(x.shape(0)), emit);
+      // the parameters must be updated before the next batch
+      bucket.done = std::make_shared<std::promise<void>>();
+      auto done = bucket.done->get_future();
+      bucket_updater_->Push(std::move(bucket));
+      done.wait();
+    } else {
+      auto grads = Backward(kTrain, grad / static_cast<float>(x.shape(0)));
+      auto names = GetParamNames();
+      auto values = GetParamValues();
+      for (size_t k = 0; k < grads.size(); k++) {
+        updater_->Apply(epoch, names[k], grads[k], values.at(k));
+      }
+    }
   }
+  dev->EndIteration();
   return std::make_pair(loss, metric);
 }
 
@@ -215,7 +299,9 @@ const Tensor FeedForwardNet::Forward(int flag, const Tensor& data) {
   return output;
 }
 
-const vector<Tensor> FeedForwardNet::Backward(int flag, const Tensor& grad) {
+const vector<Tensor> FeedForwardNet::Backward(
+    int flag, const Tensor& grad,
+    const std::function<void(Layer*, const vector<Tensor>&)>& emit) {
   vector<Tensor> param_grads;
   std::stack<Tensor> buf;
   Tensor tmp = grad;
@@ -223,6 +309,7 @@ const vector<Tensor> FeedForwardNet::Backward(int flag, const Tensor& grad) {
     // LOG(INFO) << layers_.at(i)->name() << " : " << tmp.L1();
     auto ret = layers_.at(i)->Backward(flag, tmp);
     tmp = ret.first;
+    if (emit) emit(layers_.at(i).get(), ret.second);
     if (ret.second.size()) {
       for (int k = (int)ret.second.size() - 1; k >= 0; k--) {
         buf.push(ret.second[k]);
@@ -20,6 +20,7 @@
 ************************************************************/
 #include <vector>
 #include "batchnorm.h"
+#include "singa/core/tensor_expr.h"
 
 namespace singa {
 RegisterLayerClass(singa_batchnorm, BatchNorm);
@@ -63,6 +64,17 @@ void BatchNorm::ToDevice(std::shared_ptr<Device> device) {
   dbnBias_.ToDevice(device);
   runningMean_.ToDevice(device);
   runningVariance_.ToDevice(device);
+  cache_.Clear();
+}
+
+void BatchNorm::AsType(DataType dtype) {
+  bnScale_.AsType(dtype);
+  bnBias_.AsType(dtype);
+  dbnScale_.AsType(dtype);
+  dbnBias_.AsType(dtype);
+  runningMean_.AsType(dtype);
+  runningVariance_.AsType(dtype);
+  cache_.Clear();
 }
 
 const Tensor BatchNorm::Forward(int flag, const Tensor& input) {
@@ -72,25 +84,19 @@ const Tensor BatchNorm::Forward(int flag, const Tensor& input) {
   output.ResetLike(x);
   // TODO(wangwei) input sample shape check
   if ((flag & kTrain) == kTrain) {  // forward for train
+    CHECK_EQ(bnScale_.data_type(), input.data_type())
+        << "BatchNorm with converted parameters is for inference only";
     if (is_2d_) {                   // batchnorm_per_activation mode
       auto mean = Average(x, 0);
       runningMean_ *= 1.0f - factor_;
       Axpy(factor_, mean, &runningMean_);
-      auto xnorm = x.Clone();
-      SubRow(mean, &xnorm);
-      xnorm = Square(xnorm);
-      auto var = Average(xnorm, 0);
+      // the elementwise ops are fused into one pass per Eval()
+      auto var = Average(Square(SubRow(mean, x)).Eval(), 0);
       runningVariance_ *= 1.0f - factor_;
       Axpy(factor_, var, &runningVariance_);
-      Tensor tmp = var.Clone();
-      tmp = Sqrt(tmp);
-      tmp += 1e-6f;
-      xnorm = x.Clone();
-      SubRow(mean, &xnorm);
-      DivRow(tmp, &xnorm);
-      output = xnorm.Clone();
-      MultRow(bnScale_, &output);
-      AddRow(bnBias_, &output);
+      auto xnorm = DivRow(Sqrt(TensorExpr(var)) + 1e-6f, SubRow(mean, x))
+                       .Eval();
+      output = AddRow(bnBias_, MultRow(bnScale_, xnorm)).Eval();
       buf_.push(x);
       buf_.push(mean);
       buf_.push(var);
@@ -100,28 +106,28 @@ const Tensor BatchNorm::Forward(int flag, const Tensor& input) {
                     "implemented yet...";
     }
   } else {         // forward for test
+    // compute in the type of the input, e.g., for kFloat16 parameters
+    const DataType dtype = input.data_type();
+    Tensor bn_scale = cache_.Get(0, bnScale_, dtype);
+    Tensor bn_bias = cache_.Get(1, bnBias_, dtype);
+    Tensor running_mean = cache_.Get(2, runningMean_, dtype);
+    Tensor running_var = cache_.Get(3, runningVariance_, dtype);
     if (is_2d_) {  // batchnorm_per_activation mode
-      auto xnorm = x.Clone();
-      SubRow(runningMean_, &xnorm);
-      Tensor tmp = runningVariance_.Clone();
-      tmp = Sqrt(tmp);
-      tmp += 1e-6f;
-      DivRow(tmp, &xnorm);
-      output = xnorm.Clone();
-      MultRow(bnScale_, &output);
-      AddRow(bnBias_, &output);
+      auto xnorm = DivRow(Sqrt(TensorExpr(running_var)) + 1e-6f,
+                          SubRow(running_mean, x));
+      output = AddRow(bn_bias, MultRow(bn_scale, xnorm)).Eval();
     } else {  // batchnorm_spatial mode
-      runningMean_.Reshape(Shape{channels_, 1});
-      runningVariance_.Reshape(Shape{channels_, 1});
-      bnScale_.Reshape(Shape{channels_, 1});
-      bnBias_.Reshape(Shape{channels_, 1});
+      running_mean.Reshape(Shape{channels_, 1});
+      running_var.Reshape(Shape{channels_, 1});
+      bn_scale.Reshape(Shape{channels_, 1});
+      bn_bias.Reshape(Shape{channels_, 1});
 
       std::vector<Tensor> mean_stack, var_stack, scale_stack, bias_stack;
       for (unsigned i = 0; i < height_ * width_; ++i) {
-        mean_stack.push_back(runningMean_);
-        var_stack.push_back(runningVariance_);
-        scale_stack.push_back(bnScale_);
-        bias_stack.push_back(bnBias_);
+        mean_stack.push_back(running_mean);
+        var_stack.push_back(running_var);
+        scale_stack.push_back(bn_scale);
+        bias_stack.push_back(bn_bias);
       }
       auto mean = ConcatenateColumns(mean_stack);
       auto var = ConcatenateColumns(var_stack);
@@ -142,11 +148,6 @@ const Tensor BatchNorm::Forward(int flag, const Tensor& input) {
 
       MultRow(scale, &output);
       AddRow(bias, &output);
-
-      runningMean_.Reshape(Shape{channels_});
-      runningVariance_.Reshape(Shape{channels_});
-      bnScale_.Reshape(Shape{channels_});
-      bnBias_.Reshape(Shape{channels_});
     }
   }
 
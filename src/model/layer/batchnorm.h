@@ -59,20 +59,28 @@ class BatchNorm : public Layer {
   void set_bnScale(Tensor x) {
     bnScale_.ResetLike(x);
     bnScale_.CopyData(x);
+    cache_.Clear();
   }
   void set_bnBias(Tensor x) {
     bnBias_.ResetLike(x);
     bnBias_.CopyData(x);
+    cache_.Clear();
   }
   void set_runningMean(Tensor x) {
     runningMean_.ResetLike(x);
     runningMean_.CopyData(x);
+    cache_.Clear();
   }
   void set_runningVariance(Tensor x) {
     runningVariance_.ResetLike(x);
     runningVariance_.CopyData(x);
+    cache_.Clear();
   }
   virtual void ToDevice(std::shared_ptr<Device> device) override;
+  /// The parameters of a converted model, e.g., a kFloat16 model, are
+  /// converted into the type of the input at the first Forward() for
+  /// evaluation; such a layer cannot be trained.
+  virtual void AsType(DataType dtype) override;
 
  protected:
   float factor_;
@@ -81,6 +89,9 @@ class BatchNorm : public Layer {
   Tensor bnScale_, bnBias_;
   Tensor dbnScale_, dbnBias_;
   Tensor runningMean_, runningVariance_;
+  /// bnScale_, bnBias_, runningMean_ and runningVariance_ in the type of the
+  /// input
+  ParamCache cache_;
   // Store intermediate data, i.e., input tensor
   std::stack<Tensor> buf_;
   Shape out_sample_shape_;
@@ -17,6 +17,9 @@
  */
 
 #include "./convolution.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
 #include <vector>
 #include "singa/model/layer.h"
 
@@ -103,6 +106,64 @@ void Convolution::Setup(const Shape &in_sample, const LayerConf &conf) {
   for (const auto &spec : conf.param()) param_specs_.push_back(spec);
 }
 
+namespace {
+// max bytes of the workspace of one group of images; larger batches are
+// processed group by group
+const size_t kWorkspaceSize = 64 << 20;
+
+// num of images per group given the workspace floats of one image
+size_t GroupSize(size_t batchsize, size_t floats_per_image) {
+  size_t n = kWorkspaceSize / (sizeof(float) * std::max<size_t>(floats_per_image, 1));
+  return std::max<size_t>(1, std::min(batchsize, n));
+}
+
+// Make 't' a float tensor of 'shape' on 'dev', reusing its block if the size
+// does not change.
+void Workspace(const Shape& shape, std::shared_ptr<Device> dev, Tensor* t) {
+  if (t->device() != dev || t->data_type() != kFloat32 ||
+      t->Size() != Product(shape))
+    *t = Tensor(shape, dev, kFloat32);
+  else
+    t->Reshape(shape);
+}
+
+// run fn(begin, end) over [0, n) on the thread pool of ctx if there is one
+void ParallelRun(Context* ctx, size_t n,
+                 const std::function<void(size_t, size_t)>& fn) {
+  if (ctx->thread_pool != nullptr && n > 1)
+    ctx->thread_pool->ParallelFor(0, n, 1, fn);
+  else
+    fn(0, n);
+}
+
+vector<Block*> Blocks(const vector<Tensor>& tensors) {
+  vector<Block*> blocks;
+  for (const auto& t : tensors) blocks.push_back(t.block());
+  return blocks;
+}
+}  // namespace
+
+void Convolution::Im2colGroup(const Tensor& input, size_t start, size_t num) {
+  auto dev = input.device();
+  Workspace(Shape{col_height_, num * col_width_}, dev, &col_buf_);
+  Tensor col(col_buf_);
+  const int channels = channels_, height = height_, width = width_,
+            kernel_h = kernel_h_, kernel_w = kernel_w_, pad_h = pad_h_,
+            pad_w = pad_w_, stride_h = stride_h_, stride_w = stride_w_;
+  const size_t imagesize = channels_ * height_ * width_;
+  const size_t col_width = col_width_;
+  dev->Exec([=](Context* ctx) mutable {
+    const float* in = static_cast<const float*>(input.block()->data());
+    float* colptr = static_cast<float*>(col.block()->mutable_data());
+    ParallelRun(ctx, num, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        Im2col(in + (start + i) * imagesize, channels, height, width,
+               kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w,
+               colptr + i * col_width, num * col_width);
+    });
+  }, {input.block()}, {col.block()});
+}
+
 /// \copydoc Layer::Forward(int flag, const Tensor&)
 const Tensor Convolution::Forward(int flag, const Tensor &input) {
   CHECK(buf_.empty());
@@ -110,7 +171,6 @@ const Tensor Convolution::Forward(int flag, const Tensor &input) {
   CHECK_EQ(input.nDim(), 4u);
   if (flag & kTrain) buf_.push(input);
   size_t batchsize = input.shape(0);
-  size_t imagesize = input.Size() / batchsize;
   // TODO(wangwei) update the layer config if the input sample shape changes
   CHECK(input.shape(1) == channels_ && input.shape(2) == height_ &&
       input.shape(3) == width_) << "input sample shape should not change";
@@ -118,28 +178,188 @@ const Tensor Convolution::Forward(int flag, const Tensor &input) {
   auto dev = input.device();
   Shape shape{batchsize, num_filters_, conv_height_, conv_width_};
   Tensor output(shape, dev, dtype);
-  Tensor col_data(Shape{col_height_, col_width_});
-  float *data_col = new float[col_height_ * col_width_];
-  auto in_data = input.data<float>();
-  for (size_t b = 0; b < batchsize; b++) {
-    Im2col(in_data + b * imagesize, channels_, height_, width_, kernel_h_,
-        kernel_w_, pad_h_, pad_w_, stride_h_, stride_w_, data_col);
-    col_data.CopyDataFromHostPtr(data_col, col_height_ * col_width_);
-    Tensor each = Mult(weight_, col_data);
-    if (bias_term_) {
-      AddColumn(bias_, &each);
-    }
-    CopyDataToFrom(&output, each, each.Size(), b * each.Size());
+  // compute in the type of the input, e.g., for kFloat16 parameters
+  Tensor weight = cache_.Get(0, weight_, dtype);
+  Tensor bias = cache_.Get(1, bias_, dtype);
+  if (kernel_h_ == 3 && kernel_w_ == 3 && stride_h_ == 1 && stride_w_ == 1) {
+    ForwardWinograd(input, weight, bias, &output);
+    return output;
+  }
+
+  // im2col of a group of images and one GEMM for the whole group, whose
+  // result is then scattered into the output images
+  size_t group = GroupSize(batchsize, (col_height_ + num_filters_) * col_width_);
+  for (size_t b = 0; b < batchsize; b += group) {
+    size_t num = std::min(group, batchsize - b);
+    Im2colGroup(input, b, num);
+    Workspace(Shape{num_filters_, num * col_width_}, dev, &gemm_buf_);
+    Mult(weight, col_buf_, &gemm_buf_);
+
+    Tensor out(output), gemm(gemm_buf_);
+    const size_t nfilter = num_filters_, col_width = col_width_;
+    const bool bias_term = bias_term_;
+    vector<Block*> read_blocks{gemm.block()};
+    if (bias_term) read_blocks.push_back(bias.block());
+    dev->Exec([=](Context* ctx) mutable {
+      const float* src = static_cast<const float*>(gemm.block()->data());
+      const float* bptr = bias_term ?
+          static_cast<const float*>(bias.block()->data()) : nullptr;
+      float* dst = static_cast<float*>(out.block()->mutable_data()) +
+                   b * nfilter * col_width;
+      ParallelRun(ctx, num, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          for (size_t f = 0; f < nfilter; f++) {
+            const float* x = src + (f * num + i) * col_width;
+            float* y = dst + (i * nfilter + f) * col_width;
+            const float v = bptr ? bptr[f] : 0.f;
+            for (size_t k = 0; k < col_width; k++) y[k] = x[k] + v;
+          }
+      });
+    }, read_blocks, {out.block()});
   }
-  delete[] data_col;
   return output;
 }
 
+// Winograd F(2x2, 3x3): each 2x2 output tile is computed from a 4x4 input
+// tile d and the filter g as A^T [(G g G^T) .* (B^T d B)] A, where the
+// elementwise product is done for all channels and tiles of one of the 16
+// tile elements by one GEMM.
+void Convolution::ForwardWinograd(const Tensor& input, const Tensor& weight,
+                                  const Tensor& bias, Tensor* output) {
+  auto dev = input.device();
+  const size_t nfilter = num_filters_, channels = channels_;
+  const size_t height = height_, width = width_, pad_h = pad_h_, pad_w = pad_w_;
+  const size_t conv_height = conv_height_, conv_width = conv_width_;
+  const size_t tile_h = (conv_height + 1) / 2, tile_w = (conv_width + 1) / 2;
+  const size_t ntile = tile_h * tile_w, batchsize = input.shape(0);
+  wino_u_.resize(16);
+  wino_v_.resize(16);
+  wino_m_.resize(16);
+  for (auto& u : wino_u_) Workspace(Shape{nfilter, channels}, dev, &u);
+
+  // U = G g G^T
+  vector<Tensor> u(wino_u_);
+  dev->Exec([=](Context* ctx) mutable {
+    const float* w = static_cast<const float*>(weight.block()->data());
+    float* uptr[16];
+    for (int k = 0; k < 16; k++)
+      uptr[k] = static_cast<float*>(u[k].block()->mutable_data());
+    for (size_t i = 0; i < nfilter * channels; i++) {
+      const float* g = w + i * 9;
+      float t[4][3];
+      for (int c = 0; c < 3; c++) {
+        t[0][c] = g[c];
+        t[1][c] = 0.5f * (g[c] + g[3 + c] + g[6 + c]);
+        t[2][c] = 0.5f * (g[c] - g[3 + c] + g[6 + c]);
+        t[3][c] = g[6 + c];
+      }
+      for (int r = 0; r < 4; r++) {
+        uptr[r * 4][i] = t[r][0];
+        uptr[r * 4 + 1][i] = 0.5f * (t[r][0] + t[r][1] + t[r][2]);
+        uptr[r * 4 + 2][i] = 0.5f * (t[r][0] - t[r][1] + t[r][2]);
+        uptr[r * 4 + 3][i] = t[r][2];
+      }
+    }
+  }, {weight.block()}, Blocks(u));
+
+  size_t group = GroupSize(batchsize, 16 * (channels + nfilter) * ntile);
+  for (size_t b = 0; b < batchsize; b += group) {
+    const size_t num = std::min(group, batchsize - b), ntotal = num * ntile;
+    for (auto& v : wino_v_) Workspace(Shape{channels, ntotal}, dev, &v);
+    for (auto& m : wino_m_) Workspace(Shape{nfilter, ntotal}, dev, &m);
+
+    // V = B^T d B
+    vector<Tensor> v(wino_v_);
+    dev->Exec([=](Context* ctx) mutable {
+      const float* in = static_cast<const float*>(input.block()->data());
+      float* vptr[16];
+      for (int k = 0; k < 16; k++)
+        vptr[k] = static_cast<float*>(v[k].block()->mutable_data());
+      ParallelRun(ctx, num * channels, [&](size_t begin, size_t end) {
+        for (size_t ic = begin; ic < end; ic++) {
+          const size_t i = ic / channels, c = ic % channels;
+          const float* im = in + ((b + i) * channels + c) * height * width;
+          float* col[16];
+          for (int k = 0; k < 16; k++)
+            col[k] = vptr[k] + c * ntotal + i * ntile;
+          for (size_t th = 0; th < tile_h; th++)
+            for (size_t tw = 0; tw < tile_w; tw++) {
+              float d[4][4], t[4][4];
+              const int h0 = static_cast<int>(2 * th) - static_cast<int>(pad_h),
+                        w0 = static_cast<int>(2 * tw) - static_cast<int>(pad_w);
+              for (int r = 0; r < 4; r++)
+                for (int s = 0; s < 4; s++) {
+                  int h = h0 + r, w = w0 + s;
+                  d[r][s] = (h >= 0 && h < (int)height && w >= 0 &&
+                             w < (int)width) ? im[h * width + w] : 0.f;
+                }
+              for (int s = 0; s < 4; s++) {
+                t[0][s] = d[0][s] - d[2][s];
+                t[1][s] = d[1][s] + d[2][s];
+                t[2][s] = d[2][s] - d[1][s];
+                t[3][s] = d[1][s] - d[3][s];
+              }
+              const size_t k = th * tile_w + tw;
+              for (int r = 0; r < 4; r++) {
+                col[r * 4][k] = t[r][0] - t[r][2];
+                col[r * 4 + 1][k] = t[r][1] + t[r][2];
+                col[r * 4 + 2][k] = t[r][2] - t[r][1];
+                col[r * 4 + 3][k] = t[r][1] - t[r][3];
+              }
+            }
+        }
+      });
+    }, {input.block()}, Blocks(v));
+
+    for (int k = 0; k < 16; k++) Mult(wino_u_[k], wino_v_[k], &wino_m_[k]);
+
+    // Y = A^T M A, plus the bias
+    vector<Tensor> m(wino_m_);
+    Tensor out(*output);
+    const bool bias_term = bias_term_;
+    vector<Block*> read_blocks = Blocks(m);
+    if (bias_term) read_blocks.push_back(bias.block());
+    dev->Exec([=](Context* ctx) mutable {
+      const float* mptr[16];
+      for (int k = 0; k < 16; k++)
+        mptr[k] = static_cast<const float*>(m[k].block()->data());
+      const float* bptr = bias_term ?
+          static_cast<const float*>(bias.block()->data()) : nullptr;
+      float* dst = static_cast<float*>(out.block()->mutable_data());
+      ParallelRun(ctx, num * nfilter, [&](size_t begin, size_t end) {
+        for (size_t fi = begin; fi < end; fi++) {
+          const size_t i = fi / nfilter, f = fi % nfilter;
+          float* y = dst + ((b + i) * nfilter + f) * conv_height * conv_width;
+          const float bv = bptr ? bptr[f] : 0.f;
+          for (size_t th = 0; th < tile_h; th++)
+            for (size_t tw = 0; tw < tile_w; tw++) {
+              const size_t k = f * ntotal + i * ntile + th * tile_w + tw;
+              float x[4][4], t[2][4];
+              for (int e = 0; e < 16; e++) x[e / 4][e % 4] = mptr[e][k];
+              for (int s = 0; s < 4; s++) {
+                t[0][s] = x[0][s] + x[1][s] + x[2][s];
+                t[1][s] = x[1][s] - x[2][s] - x[3][s];
+              }
+              for (size_t r = 0; r < 2 && 2 * th + r < conv_height; r++) {
+                float* row = y + (2 * th + r) * conv_width + 2 * tw;
+                row[0] = t[r][0] + t[r][1] + t[r][2] + bv;
+                if (2 * tw + 1 < conv_width)
+                  row[1] = t[r][1] - t[r][2] - t[r][3] + bv;
+              }
+            }
+        }
+      });
+    }, read_blocks, {out.block()});
+  }
+}
+
 /// \copydoc Layer::Backward(int, const Tensor&, const Tensor&);
 const std::pair<Tensor, vector<Tensor>> Convolution::Backward(
     int flag, const Tensor &grad) {
   CHECK_EQ(grad.device()->lang(), kCpp);
   CHECK_EQ(grad.nDim(), 4u);
+  CHECK_EQ(weight_.data_type(), grad.data_type())
+      << "Convolution with converted parameters is for inference only";
   CHECK(!buf_.empty());
   Tensor src_data = buf_.top();
   buf_.pop();
@@ -155,7 +375,7 @@ const std::pair<Tensor, vector<Tensor>> Convolution::Backward(
     auto tmpshp = Shape{batchsize * num_filters_, grad.Size() / (batchsize * num_filters_)};
     Tensor tmp1 = Reshape(grad, tmpshp);
 
-    Tensor tmp2(Shape{batchsize * num_filters_});
+    Tensor tmp2(Shape{batchsize * num_filters_}, grad.device());
     SumColumns(tmp1, &tmp2);
     Tensor tmp3 = Reshape(tmp2, Shape{batchsize, num_filters_});
 
@@ -163,86 +383,131 @@ const std::pair<Tensor, vector<Tensor>> Convolution::Backward(
     SumRows(tmp3, &db);
   }
 
-  auto in_data = src_data.data<float>();
-  Tensor col_data(Shape{col_height_, col_width_});
-  float *data_col = new float[col_height_ * col_width_];
-  float *dx_b = new float[imagesize];
-  for (size_t b = 0; b < batchsize; b++) {
-    Im2col(in_data + b * imagesize, channels_, height_, width_, kernel_h_,
-           kernel_w_, pad_h_, pad_w_, stride_h_, stride_w_, data_col);
-
-    col_data.CopyDataFromHostPtr(data_col, col_height_ * col_width_);
-    Tensor grad_b(Shape{num_filters_, conv_height_ * conv_width_});
-    CopyDataToFrom(&grad_b, grad, grad_b.Size(), 0, b * grad_b.Size());
-    dw += Mult(grad_b, Transpose(col_data));
-    Tensor dcol_b = Mult(Transpose(weight_), grad_b);
-    auto dcol_data = dcol_b.data<float>();
-    Col2im(dcol_data, channels_, height_, width_, kernel_h_, kernel_w_, pad_h_,
-           pad_w_, stride_h_, stride_w_, dx_b);
-    dx.CopyDataFromHostPtr(dx_b, imagesize, b * imagesize);
+  // per group of images: dw += grad * col^T, and col2im of weight^T * grad
+  auto dev = src_data.device();
+  size_t group = GroupSize(batchsize, (col_height_ + num_filters_) * col_width_);
+  for (size_t b = 0; b < batchsize; b += group) {
+    const size_t num = std::min(group, batchsize - b);
+    Im2colGroup(src_data, b, num);
+
+    // gather the gradients of the group into {num_filters_, num * col_width_}
+    Workspace(Shape{num_filters_, num * col_width_}, dev, &gemm_buf_);
+    Tensor gemm(gemm_buf_);
+    const size_t nfilter = num_filters_, col_width = col_width_;
+    dev->Exec([=](Context* ctx) mutable {
+      const float* src = static_cast<const float*>(grad.block()->data()) +
+                         b * nfilter * col_width;
+      float* dst = static_cast<float*>(gemm.block()->mutable_data());
+      for (size_t i = 0; i < num; i++)
+        for (size_t f = 0; f < nfilter; f++)
+          memcpy(dst + (f * num + i) * col_width,
+                 src + (i * nfilter + f) * col_width, col_width * sizeof(float));
+    }, {grad.block()}, {gemm.block()});
+    Mult(1.0f, gemm_buf_, Transpose(col_buf_), 1.0f, &dw);
+
+    // the columns are no longer needed, hence reused for their gradients
+    Mult(Transpose(weight_), gemm_buf_, &col_buf_);
+    Tensor col(col_buf_), out(dx);
+    const int channels = channels_, height = height_, width = width_,
+              kernel_h = kernel_h_, kernel_w = kernel_w_, pad_h = pad_h_,
+              pad_w = pad_w_, stride_h = stride_h_, stride_w = stride_w_;
+    dev->Exec([=](Context* ctx) mutable {
+      const float* colptr = static_cast<const float*>(col.block()->data());
+      float* dxptr = static_cast<float*>(out.block()->mutable_data());
+      ParallelRun(ctx, num, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          Col2im(colptr + i * col_width, channels, height, width, kernel_h,
+                 kernel_w, pad_h, pad_w, stride_h, stride_w,
+                 dxptr + (b + i) * imagesize, num * col_width);
+      });
+    }, {col.block()}, {out.block()});
   }
   param_grad.push_back(dw);
   if (bias_term_)
     param_grad.push_back(db);
-  delete[] data_col;
-  delete[] dx_b;
   return std::make_pair(dx, param_grad);
 }
 void Convolution::ToDevice(std::shared_ptr<Device> device) {
   Layer::ToDevice(device);
   weight_.ToDevice(device);
   bias_.ToDevice(device);
+  cache_.Clear();
+}
+
+void Convolution::AsType(DataType dtype) {
+  Layer::AsType(dtype);
+  weight_.AsType(dtype);
+  bias_.AsType(dtype);
+  cache_.Clear();
+}
+
+// first index of [0, n) whose position index * stride - pad + offset is not
+// before 0, and the end of those before 'size'
+inline void InsideRange(int n, int size, int pad, int offset, int stride,
+                        int* begin, int* end) {
+  int lo = pad - offset, hi = size + pad - offset;
+  *begin = lo > 0 ? std::min(n, (lo + stride - 1) / stride) : 0;
+  *end = hi > 0 ? std::min(n, (hi + stride - 1) / stride) : 0;
+  *end = std::max(*begin, *end);
 }
 
 void Im2col(const float *data_im, const int channels,
-                         const int height, const int width,
-                         const int kernel_h, const int kernel_w,
-                         const int pad_h, const int pad_w,
-                         const int stride_h, const int stride_w,
-                         float *data_col) {
+            const int height, const int width,
+            const int kernel_h, const int kernel_w,
+            const int pad_h, const int pad_w,
+            const int stride_h, const int stride_w,
+            float *data_col, const int ld_col) {
   int height_col = (height + 2 * pad_h - kernel_h) / stride_h + 1;
   int width_col  = ( width + 2 * pad_w - kernel_w) / stride_w + 1;
+  int ld = ld_col > 0 ? ld_col : height_col * width_col;
   int channels_col = channels * kernel_h * kernel_w;
   for (int c = 0; c < channels_col; ++c) {
     int w_offset = c % kernel_w;
     int h_offset = (c / kernel_w) % kernel_h;
     int c_im = c / kernel_h / kernel_w;
+    // the columns [w_begin, w_end) read inside the image, others are padding
+    int w_begin, w_end;
+    InsideRange(width_col, width, pad_w, w_offset, stride_w, &w_begin, &w_end);
     for (int h = 0; h < height_col; ++h) {
-      for (int w = 0; w < width_col; ++w) {
-        int h_pad = h * stride_h - pad_h + h_offset;
-        int w_pad = w * stride_w - pad_w + w_offset;
-        if (h_pad >= 0 && h_pad < height && w_pad >= 0 && w_pad < width)
-          data_col[(c * height_col + h) * width_col + w] =
-              data_im[(c_im * height + h_pad) * width + w_pad];
-        else
-          data_col[(c * height_col + h) * width_col + w] = 0;
+      float* col = data_col + c * ld + h * width_col;
+      int h_pad = h * stride_h - pad_h + h_offset;
+      if (h_pad < 0 || h_pad >= height) {
+        std::fill(col, col + width_col, 0.f);
+        continue;
       }
+      const float* im = data_im + (c_im * height + h_pad) * width;
+      std::fill(col, col + w_begin, 0.f);
+      for (int w = w_begin; w < w_end; ++w)
+        col[w] = im[w * stride_w - pad_w + w_offset];
+      std::fill(col + w_end, col + width_col, 0.f);
     }
   }
 }
 
 void Col2im(const float *data_col, const int channels,
-                         const int height, const int width,
-                         const int kernel_h, const int kernel_w,
-                         const int pad_h, const int pad_w,
-                         const int stride_h, const int stride_w,
-                         float *data_im) {
+            const int height, const int width,
+            const int kernel_h, const int kernel_w,
+            const int pad_h, const int pad_w,
+            const int stride_h, const int stride_w,
+            float *data_im, const int ld_col) {
   memset(data_im, 0, height * width * channels * sizeof(float));
   int height_col = (height + 2 * pad_h - kernel_h) / stride_h + 1;
   int width_col  = ( width + 2 * pad_w - kernel_w) / stride_w + 1;
+  int ld = ld_col > 0 ? ld_col : height_col * width_col;
   int channels_col = channels * kernel_h * kernel_w;
   for (int c = 0; c < channels_col; ++c) {
     int w_offset = c % kernel_w;
     int h_offset = (c / kernel_w) % kernel_h;
     int c_im = c / kernel_h / kernel_w;
+    int w_begin, w_end;
+    InsideRange(width_col, width, pad_w, w_offset, stride_w, &w_begin, &w_end);
     for (int h = 0; h < height_col; ++h) {
-      for (int w = 0; w < width_col; ++w) {
-        int h_pad = h * stride_h - pad_h + h_offset;
-        int w_pad = w * stride_w - pad_w + w_offset;
-        if (h_pad >= 0 && h_pad < height && w_pad >= 0 && w_pad < width)
-          data_im[(c_im * height + h_pad) * width + w_pad] +=
-              data_col[(c * height_col + h) * width_col + w];
-      }
+      int h_pad = h * stride_h - pad_h + h_offset;
+      if (h_pad < 0 || h_pad >= height) continue;
+      const float* col = data_col + c * ld + h * width_col;
+      float* im = data_im + (c_im * height + h_pad) * width;
+      for (int w = w_begin; w < w_end; ++w)
+        im[w * stride_w - pad_w + w_offset] += col[w];
     }
   }
 }
@@ -45,6 +45,10 @@ class Convolution : public Layer {
                                                    const Tensor& grad) override;
 
   void ToDevice(std::shared_ptr<Device> device) override;
+  /// The parameters of a converted model, e.g., a kFloat16 model, are
+  /// converted into the type of the input at the first Forward(); the
+  /// Backward() of such a layer is not supported.
+  void AsType(DataType dtype) override;
 
   const std::vector<Tensor> param_values() override {
     if (bias_term_)
@@ -70,10 +74,12 @@ class Convolution : public Layer {
   void set_weight(Tensor w) {
     weight_.ResetLike(w);
     weight_.CopyData(w);
+    cache_.Clear();
   }
   void set_bias(Tensor b) {
     bias_.ResetLike(b);
     bias_.CopyData(b);
+    cache_.Clear();
   }
 
  protected:
@@ -82,21 +88,41 @@ class Convolution : public Layer {
   size_t channels_, height_, width_;
   size_t col_height_, col_width_, conv_height_, conv_width_, num_filters_;
   Tensor weight_, bias_;
+  /// weight_ and bias_ in the type of the input
+  ParamCache cache_;
   // store intermediate data, i.e., input tensor
   std::stack<Tensor> buf_;
   bool bias_term_;
   vector<size_t> out_sample_shape_;
+
+ private:
+  /// im2col of images [start, start + num) of 'input' into col_buf_, whose
+  /// shape is {col_height_, num * col_width_}.
+  void Im2colGroup(const Tensor& input, size_t start, size_t num);
+  /// Forward of 3x3 kernels with stride 1 via Winograd F(2x2, 3x3).
+  void ForwardWinograd(const Tensor& input, const Tensor& weight,
+                       const Tensor& bias, Tensor* output);
+
+  /// Workspaces of the cpp implementation, which are reused across calls.
+  Tensor col_buf_, gemm_buf_;
+  /// Winograd transformed filters, inputs and products, one per element of
+  /// the 4x4 tiles.
+  vector<Tensor> wino_u_, wino_v_, wino_m_;
 };
 
+/// Unfold the patches of one image into the columns of data_col, whose rows
+/// are 'ld_col' apart; ld_col = 0 means height_col * width_col. A larger
+/// ld_col puts the columns of several images side by side.
 void Im2col(const float* data_im, const int channels, const int height,
             const int width, const int kernel_h, const int kernel_w,
             const int pad_h, const int pad_w, const int stride_h,
-            const int stride_w, float* data_col);
+            const int stride_w, float* data_col, const int ld_col = 0);
 
+/// The reverse of Im2col, which accumulates the columns into data_im.
 void Col2im(const float* data_col, const int channels, const int height,
             const int width, const int kernel_h, const int kernel_w,
             const int pad_h, const int pad_w, const int stride_h,
-            const int stride_w, float* data_im);
+            const int stride_w, float* data_im, const int ld_col = 0);
             
 }  // namespace singa
 #endif  // SRC_MODEL_LAYER_CONVOLUTION_H_
@@ -93,6 +93,8 @@ const Tensor CudnnBatchNorm::Forward(int flag, const Tensor& input) {
   // TODO(wangji): check device id of input and params
   output.ResetLike(x);
   if ((flag & kTrain) == kTrain) {
+    CHECK_EQ(bnScale_.data_type(), dtype)
+        << "BatchNorm with converted parameters is for inference only";
     output.device()->Exec(
         [=](Context* ctx) {
           Block* inBlock = x.block(), * outBlock = output.block(),
@@ -117,13 +119,18 @@ const Tensor CudnnBatchNorm::Forward(int flag, const Tensor& input) {
          resultSaveMean_.block(), resultSaveVariance_.block()});
     buf_.push(x);
   } else {
+    // compute in the type of the input, e.g., for kFloat16 parameters
+    Tensor bn_scale = cache_.Get(0, bnScale_, dtype);
+    Tensor bn_bias = cache_.Get(1, bnBias_, dtype);
+    Tensor running_mean = cache_.Get(2, runningMean_, dtype);
+    Tensor running_var = cache_.Get(3, runningVariance_, dtype);
     output.device()->Exec(
         [=](Context* ctx) {
           Block* inBlock = x.block(), * outBlock = output.block(),
-                 * runningMeanBlock = runningMean_.block(),
-                 * runningVarBlock = runningVariance_.block(),
-                 * bnScaleBlock = bnScale_.block(),
-                 * bnBiasBlock = bnBias_.block();
+                 * runningMeanBlock = running_mean.block(),
+                 * runningVarBlock = running_var.block(),
+                 * bnScaleBlock = bn_scale.block(),
+                 * bnBiasBlock = bn_bias.block();
           const float alpha = 1.0f, beta = 0.0f;
           double epsilon = CUDNN_BN_MIN_EPSILON;
           CUDNN_CHECK(cudnnBatchNormalizationForwardInference(
@@ -132,8 +139,8 @@ const Tensor CudnnBatchNorm::Forward(int flag, const Tensor& input) {
               param_desc_, bnScaleBlock->data(), bnBiasBlock->data(),
               runningMeanBlock->data(), runningVarBlock->data(), epsilon));
         },
-        {x.block(), bnScale_.block(), bnBias_.block(), runningMean_.block(),
-         runningVariance_.block()},
+        {x.block(), bn_scale.block(), bn_bias.block(), running_mean.block(),
+         running_var.block()},
         {output.block()});
   }
   if (is_2d_) output.Reshape(Shape{shape.at(0), shape.at(1)});
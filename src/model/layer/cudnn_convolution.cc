@@ -187,9 +187,12 @@ const Tensor CudnnConvolution::Forward(int flag, const Tensor &input) {
 
   Shape shape{batchsize, num_filters_, conv_height_, conv_width_};
   Tensor output(shape, dev, dtype);
-  output.device()->Exec([input, output, this](Context * ctx) {
+  // compute in the type of the input, e.g., for kFloat16 parameters
+  Tensor weight = cache_.Get(0, weight_, dtype);
+  Tensor bias = cache_.Get(1, bias_, dtype);
+  output.device()->Exec([input, output, weight, this](Context * ctx) {
     Block *inblock = input.block(), *outblock = output.block(),
-           *wblock = this->weight_.block();
+           *wblock = weight.block();
     float alpha = 1.f, beta = 0.f;
     cudnnConvolutionForward(ctx->cudnn_handle, &alpha, this->x_desc_,
                             inblock->data(), this->filter_desc_, wblock->data(),
@@ -197,16 +200,16 @@ const Tensor CudnnConvolution::Forward(int flag, const Tensor &input) {
                             this->workspace_.block()->mutable_data(),
                             this->workspace_count_ * sizeof(float), &beta,
                             this->y_desc_, outblock->mutable_data());
-  }, {input.block(), weight_.block()}, {output.block()}, workspace_.block());
+  }, {input.block(), weight.block()}, {output.block()}, workspace_.block());
 
   if (bias_term_) {
-    output.device()->Exec([output, this](Context * ctx) {
+    output.device()->Exec([output, bias, this](Context * ctx) {
       float beta = 1.f, alpha = 1.0f;
-      Block *outblock = output.block(), *bblock = this->bias_.block();
+      Block *outblock = output.block(), *bblock = bias.block();
       cudnnAddTensor(ctx->cudnn_handle, &alpha, this->bias_desc_,
                      bblock->data(), &beta, this->y_desc_,
                      outblock->mutable_data());
-    }, {output.block(), bias_.block()}, {output.block()});
+    }, {output.block(), bias.block()}, {output.block()});
   }
   return output;
 }
@@ -216,6 +219,8 @@ int flag, const Tensor &grad) {
   CHECK(has_init_cudnn_);
   CHECK_EQ(grad.device()->lang(), kCuda);
   CHECK_EQ(grad.nDim(), 4u);
+  CHECK_EQ(weight_.data_type(), grad.data_type())
+      << "Convolution with converted parameters is for inference only";
   CHECK(!buf_.empty());
   Tensor src_data = buf_.top();
   buf_.pop();
@@ -307,8 +307,11 @@ const vector<Tensor> CudnnRNN::Forward(int flag, const vector<Tensor> &inputs) {
 
   // LOG(INFO) << "hidden size " << hy.Size();
   // LOG(INFO) << "weight size " << weight_.Size() << " value " << weight_.L1();
+  // compute in the type of the input, e.g., for kFloat16 parameters; the
+  // copy is kept alive by cache_
+  Tensor weight = cache_.Get(0, weight_, dtype);
   Block *inb = input.block(), *outb = output.block(),
-         *wb = this->weight_.block(), *hxb = hx.block(), *cxb = cx.block(),
+         *wb = weight.block(), *hxb = hx.block(), *cxb = cx.block(),
           *hyb = hy.block(), *cyb = cy.block(),
            *wspace = this->workspace_.block(),
             *rspace = this->reserve_space_.block();
@@ -379,6 +382,8 @@ int flag, const vector<Tensor> &grads) {
 
   auto dev = y.device();
   auto dtype = y.data_type();
+  CHECK_EQ(weight_.data_type(), dtype)
+      << "RNN with converted parameters is for inference only";
 
   CHECK_GT(grads.size(), 1u + has_cell_);
   size_t num_dy = grads.size() - has_cell_ - 1;
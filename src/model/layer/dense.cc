@@ -54,12 +54,15 @@ const Tensor Dense::Forward(int flag, const Tensor &input) {
   CHECK(buf_.empty());
   Tensor output;
   CHECK_EQ(input.nDim(), 2u);
+  // compute in the type of the input, e.g., for kFloat16 parameters
+  Tensor weight = cache_.Get(0, weight_, input.data_type());
+  Tensor bias = cache_.Get(1, bias_, input.data_type());
   if (transpose_)  // use the transposed version of weight_ for computing
-    output = Mult(input, Transpose(weight_));
+    output = Mult(input, Transpose(weight));
   else
-    output = Mult(input, weight_);
+    output = Mult(input, weight);
   if (bias_term_)
-    AddRow(bias_, &output);
+    AddRow(bias, &output);
   if (flag & kTrain)
     buf_.push(input);
   return output;
@@ -72,6 +75,8 @@ const std::pair<Tensor, vector<Tensor>> Dense::Backward(int flag,
   CHECK(!buf_.empty());
   Tensor src_data = buf_.top();
   buf_.pop();
+  CHECK_EQ(weight_.data_type(), grad.data_type())
+      << "Dense with converted parameters is for inference only";
   Tensor db, dw, dx;
   dw.ResetLike(weight_);
   dx.ResetLike(src_data);
@@ -96,5 +101,13 @@ void Dense::ToDevice(std::shared_ptr<Device> device) {
   Layer::ToDevice(device);
   weight_.ToDevice(device);
   bias_.ToDevice(device);
+  cache_.Clear();
+}
+
+void Dense::AsType(DataType dtype) {
+  Layer::AsType(dtype);
+  weight_.AsType(dtype);
+  bias_.AsType(dtype);
+  cache_.Clear();
 }
 } // namespace singa
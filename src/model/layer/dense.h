@@ -45,6 +45,11 @@ class Dense : public Layer {
                                                    const Tensor& grad) override;
 
   void ToDevice(std::shared_ptr<Device> device) override;
+  /// Parameters of other types than the input, e.g., kFloat16 for a smaller
+  /// model, are converted into the type of the input at the first Forward()
+  /// and the copies are kept until the parameters are converted, moved or
+  /// set; the Backward() of such a layer is not supported.
+  void AsType(DataType dtype) override;
   const std::vector<Tensor> param_values() override {
     if (bias_term_)
       return std::vector<Tensor>{weight_, bias_};
@@ -60,10 +65,12 @@ class Dense : public Layer {
   void set_weight(Tensor w) {
     weight_.ResetLike(w);
     weight_.CopyData(w);
+    cache_.Clear();
   }
   void set_bias(Tensor b) {
     bias_.ResetLike(b);
     bias_.CopyData(b);
+    cache_.Clear();
   }
 
  protected:
@@ -74,6 +81,8 @@ class Dense : public Layer {
   bool bias_term_ = true;
   size_t vdim_, hdim_;
   Tensor weight_, bias_;
+  /// weight_ and bias_ in the type of the input
+  ParamCache cache_;
   // Tensor data_, grad_;
   std::stack<Tensor> buf_;
 };
@@ -44,6 +44,9 @@ const Tensor OpenclConvolution::Forward(int flag, const Tensor &input) {
   Shape shape{batchsize, num_filters_, conv_height_, conv_width_};
   Tensor output(shape, device, data_type);
   Tensor col_data(Shape{col_height_, col_width_}, device, data_type);
+  // compute in the type of the input, e.g., for kFloat16 parameters
+  Tensor weight = cache_.Get(0, weight_, data_type);
+  Tensor bias = cache_.Get(1, bias_, data_type);
 
   for (size_t b = 0; b < batchsize; b++) {
     int offset = b * imagesize;
@@ -62,10 +65,10 @@ const Tensor OpenclConvolution::Forward(int flag, const Tensor &input) {
     {input.block()},
     {col_data.block()});
 
-    Tensor each = Mult(weight_, col_data);
+    Tensor each = Mult(weight, col_data);
 
     if (bias_term_) {
-      AddColumn(bias_, &each);
+      AddColumn(bias, &each);
     }
 
     CopyDataToFrom(&output, each, each.Size(), b * each.Size());
@@ -81,6 +84,8 @@ OpenclConvolution::Backward(int flag, const Tensor &grad) {
   CHECK(!buf_.empty());
   CHECK_EQ(grad.device()->lang(), kOpencl);
   CHECK_EQ(grad.nDim(), 4u);
+  CHECK_EQ(weight_.data_type(), grad.data_type())
+      << "Convolution with converted parameters is for inference only";
 
   std::vector<Tensor> param_grad;
 
@@ -36,6 +36,8 @@ void PReLU::Setup(const Shape& in_sample, const LayerConf &conf) {
 
 const Tensor PReLU::Forward(int flag, const Tensor &input) {
   Tensor output;
+  // compute in the type of the input, e.g., for kFloat16 parameters
+  Tensor a = cache_.Get(0, a_, input.data_type());
   if (!channel_shared_) {
     size_t n, c, h, w;
     Tensor temp = (input <= 0.f);
@@ -48,7 +50,7 @@ const Tensor PReLU::Forward(int flag, const Tensor &input) {
         temp.Reshape(Shape{n * c, h * w});
         Tensor temp_a(Shape{n, c}, input.device(), input.data_type());
         Uniform(1.f, 1.f, &temp_a);
-        MultRow(a_, &temp_a);
+        MultRow(a, &temp_a);
         temp_a.Reshape(Shape{n * c});
         MultColumn(temp_a, &temp);
       } else if (format_ == "NHWC") {
@@ -57,7 +59,7 @@ const Tensor PReLU::Forward(int flag, const Tensor &input) {
         w = temp.shape(2);
         c = temp.shape(3);
         temp.Reshape(Shape{n * h * w, c});
-        MultRow(a_, &temp);
+        MultRow(a, &temp);
       } else {
         LOG(FATAL) << "Incorrect input format for prelu layer.";
       }
@@ -70,8 +72,8 @@ const Tensor PReLU::Forward(int flag, const Tensor &input) {
     // share the first param of Tensor A along all channels
     LOG(FATAL) << "Not implemented";
   // TODO(wangwei) cannot access the data in this way. The data could be on GPU.
-    auto a = a_.data<float>()[0];
-    output = input * ((input > 0.f) + (input <= 0.f) * a);
+    auto a0 = a.data<float>()[0];
+    output = input * ((input > 0.f) + (input <= 0.f) * a0);
   }
   if (flag & kTrain) buf_.push(input);
   return output;
@@ -80,6 +82,8 @@ const Tensor PReLU::Forward(int flag, const Tensor &input) {
 const std::pair<Tensor, vector<Tensor> > PReLU::Backward(int flag,
                                                          const Tensor &grad) {
   vector<Tensor> param_grad;
+  CHECK_EQ(a_.data_type(), grad.data_type())
+      << "PReLU with converted parameters is for inference only";
   CHECK(!buf_.empty());
   Tensor input_grad, input = buf_.top();
   buf_.pop();
@@ -145,6 +149,13 @@ const std::pair<Tensor, vector<Tensor> > PReLU::Backward(int flag,
 void PReLU::ToDevice(std::shared_ptr<Device> device) {
   Layer::ToDevice(device);
   a_.ToDevice(device);
+  cache_.Clear();
+}
+
+void PReLU::AsType(DataType dtype) {
+  Layer::AsType(dtype);
+  a_.AsType(dtype);
+  cache_.Clear();
 }
 
 } // namespace singa
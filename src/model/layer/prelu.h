@@ -45,6 +45,10 @@ class PReLU : public Layer {
       int flag, const Tensor &grad) override;
 
   void ToDevice(std::shared_ptr<Device> device);
+  /// The parameters of a converted model, e.g., a kFloat16 model, are
+  /// converted into the type of the input at the first Forward(); the
+  /// Backward() of such a layer is not supported.
+  void AsType(DataType dtype) override;
 
   const bool Channel_shared() const { return channel_shared_; }
   const Tensor A() const { return a_; }
@@ -53,12 +57,14 @@ class PReLU : public Layer {
   void Set_a(Tensor a) {
     a_.ResetLike(a);
     a_.CopyData(a);
+    cache_.Clear();
   }
 
  protected:
   bool channel_shared_;
   std::string format_;  // format_ has two valid value, i.e. NCHW, NHWC
   Tensor a_;            // shape of a_ is 2D, i.e. (channels, 1)
+  ParamCache cache_;    // a_ in the type of the input
   std::stack<Tensor> buf_;
   Shape out_sample_shape_;
 };
@@ -99,5 +99,12 @@ const std::pair<vector<Tensor>, vector<Tensor>> RNN::Backward(int flag,
 void RNN::ToDevice(std::shared_ptr<Device> device) {
   Layer::ToDevice(device);
   weight_.ToDevice(device);
+  cache_.Clear();
+}
+
+void RNN::AsType(DataType dtype) {
+  Layer::AsType(dtype);
+  weight_.AsType(dtype);
+  cache_.Clear();
 }
 }  /* singa */
@@ -68,6 +68,10 @@ class RNN : public Layer {
   }
 
   void ToDevice(std::shared_ptr<Device> device) override;
+  /// The parameters of a converted model, e.g., a kFloat16 model, are
+  /// converted into the type of the input at the first Forward(); the
+  /// Backward() of such a layer is not supported.
+  void AsType(DataType dtype) override;
   /// Return the internal state stack, which should be empty at the beginning
   /// of one iteration.
   // std::stack<Tensor> states() const { return states_; }
@@ -91,6 +95,8 @@ class RNN : public Layer {
   float dropout_ = 0.0f;
   string input_mode_, direction_, rnn_mode_;
   Tensor weight_;
+  /// weight_ in the type of the input
+  ParamCache cache_;
 };
 }  // namespace singa
 #endif  // SRC_MODEL_LAYER_RNN_H_
@@ -67,7 +67,7 @@ Tensor CpuBatchNormForwardInference(const BatchNormHandle &bnh, const Tensor& x,
 
   Tensor w = get_bn_weight_from(bnScale, bnBias);
 
-  y.device()->Exec([&y, &x, &running_mean, &running_var, &w, &bnh](Context * ctx) {
+  y.device()->Exec([y, x, running_mean, running_var, w, &bnh](Context * ctx) {
     try {
       auto eng = *ctx->engine;
       using namespace mkldnn;
@@ -115,7 +115,7 @@ CpuBatchNormForwardTraining(const BatchNormHandle &bnh, const Tensor &x, const T
   // combine scale and bias to construct weight tensor in required format for backward
   Tensor w = get_bn_weight_from(bnScale, bnBias);
 
-  y.device()->Exec([&x, &y, &mean, &var, &w, &bnh](Context * ctx) {
+  y.device()->Exec([x, y, mean, var, w, &bnh](Context * ctx) {
     try {
       auto eng = *ctx->engine;
       using namespace mkldnn;
@@ -163,7 +163,7 @@ const std::vector<Tensor> CpuBatchNormBackwardx(const BatchNormHandle &bnh,
 
   Tensor dw(Shape{bnScale.Size(), 2});
 
-  dx.device()->Exec([&dw, &x, &dx, &y, &dy, &w, &mean, &var, &bnh](Context * ctx) {
+  dx.device()->Exec([dw, x, dx, y, dy, w, mean, var, &bnh](Context * ctx) {
 
     try {
       auto eng = *ctx->engine;
@@ -104,7 +104,7 @@ Tensor CpuConvForward(const Tensor &x, Tensor &W,  Tensor &b,
   Shape shape{ch.batchsize, ch.num_filters, ch.conv_height, ch.conv_width};
   Tensor output(shape, dev, dtype);
 
-  output.device()->Exec([&output, &x, &W, &b, &ch](Context * ctx) {
+  output.device()->Exec([output, x, W, b, &ch](Context * ctx) {
     Block *inblock = x.block(), *outblock = output.block(), *wblock = W.block(), *bblock = b.block();
 
     try {
@@ -183,7 +183,7 @@ Tensor CpuConvBackwardx(const Tensor &dy, Tensor &W, const Tensor &x,
   Tensor dx;
   dx.ResetLike(x);
 
-  dy.device()->Exec([&x, &dx, &dy, &W, &ch](Context * ctx) {
+  dy.device()->Exec([x, dx, dy, W, &ch](Context * ctx) {
     Block *wblock = W.block(), *dyblock = dy.block(), *dxblock = dx.block(), *inblock = x.block();
 
     try {
@@ -249,7 +249,7 @@ Tensor CpuConvBackwardW(const Tensor &dy, const Tensor &x, const Tensor &W,
   Tensor dW;
   dW.ResetLike(W);
 
-  dy.device()->Exec([&x, &dy, &dW, &ch](Context * ctx) {
+  dy.device()->Exec([x, dy, dW, &ch](Context * ctx) {
     Block *dwblock = dW.block(), *dyblock = dy.block(), *inblock = x.block(), *dbblock = ch.db->block();
 
     try {
@@ -89,7 +89,7 @@ Tensor CpuPoolingForward(const PoolingHandle &ph, const Tensor &x) {
            }, x.device(), x.data_type());
 
 
-  y.device()->Exec([&y, &x, &ph](Context * ctx) {
+  y.device()->Exec([y, x, &ph](Context * ctx) {
 
 
     try {
@@ -121,7 +121,7 @@ Tensor CpuPoolingBackward(const PoolingHandle &ph, const Tensor &grad, const Ten
   Tensor in_grad;
   in_grad.ResetLike(x);
 
-  in_grad.device()->Exec([&in_grad, &grad, &ph](Context * ctx) {
+  in_grad.device()->Exec([in_grad, grad, &ph](Context * ctx) {
     try {
       auto eng = *ctx->engine;
       using namespace mkldnn;
@@ -15,15 +15,292 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-#ifndef DISABLE_WARNINGS
-
 #ifndef SRC_MODEL_OPTIMIZER_LOCAL_ALL_REDUCE_H_
 #define SRC_MODEL_OPTIMIZER_LOCAL_ALL_REDUCE_H_
 #include "singa/model/optimizer.h"
+#include "singa/utils/integer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+#ifdef ENABLE_DIST
+#include <unistd.h>
+#endif  // ENABLE_DIST
 
 namespace singa {
+
+namespace {
+/// Wait until the pending operations on the tensors are done.
+void Sync(const vector<Tensor>& tensors) {
+  std::set<Device*> devices;
+  for (const auto& t : tensors)
+    if (devices.insert(t.device().get()).second) t.device()->Sync();
 }
 
-#endif  // SRC_MODEL_OPTIMIZER_LOCAL_ALL_REDUCE_H_
+/// Offsets of the tensors in the concatenation of them.
+vector<size_t> Offsets(const vector<Tensor>& tensors) {
+  vector<size_t> offset(1, 0);
+  for (const auto& t : tensors) {
+    CHECK(!t.transpose()) << "Transposed tensors are not supported";
+    offset.push_back(offset.back() + t.Size());
+  }
+  return offset;
+}
+
+/// Call func(i, lo, len) for the part [lo, lo + len) of tensor i that is in
+/// [begin, end) of the concatenation.
+template <typename Func>
+void ForEachPart(const vector<size_t>& offset, size_t begin, size_t end,
+                 Func func) {
+  for (size_t i = 0; i + 1 < offset.size(); i++) {
+    size_t lo = std::max(begin, offset[i]), hi = std::min(end, offset[i + 1]);
+    if (lo < hi) func(i, lo - offset[i], hi - lo);
+  }
+}
+}  // namespace
+
+LocalAllReduce::LocalAllReduce(int num_workers)
+    : num_workers_(num_workers), tensors_(num_workers, nullptr) {
+  CHECK_GT(num_workers_, 0);
+}
+
+void LocalAllReduce::AllReduce(int rank, vector<Tensor>* tensors,
+                               float scale) {
+  Run(rank, tensors, -1, true, scale);
+}
+
+void LocalAllReduce::AllReduce(int rank, Tensor* tensor, float scale) {
+  // the tensor shares the block with its copy in the vector
+  vector<Tensor> tensors{*tensor};
+  Run(rank, &tensors, -1, true, scale);
+}
+
+void LocalAllReduce::Reduce(int rank, vector<Tensor>* tensors, int root,
+                            float scale) {
+  CHECK(root >= 0 && root < num_workers_);
+  Run(rank, tensors, root, false, scale);
+}
+
+void LocalAllReduce::Barrier() {
+  // read before arriving, hence the barrier cannot be passed in between
+  int generation = generation_.load();
+  if (count_.fetch_add(1) + 1 == num_workers_) {
+    // reset before releasing the others, who may enter the next barrier
+    count_.store(0);
+    generation_.fetch_add(1);
+    // the lock orders the update before a worker starting to sleep
+    { std::lock_guard<std::mutex> lock(mtx_); }
+    cv_.notify_all();
+    return;
+  }
+  const int kSpin = 4096;
+  for (int i = 0; i < kSpin; i++)
+    if (generation_.load() != generation) return;
+  std::unique_lock<std::mutex> lock(mtx_);
+  cv_.wait(lock, [this, generation] { return generation_ != generation; });
+}
+
+void LocalAllReduce::Run(int rank, vector<Tensor>* tensors, int dst,
+                         bool gather, float scale) {
+  CHECK(rank >= 0 && rank < num_workers_);
+  Sync(*tensors);
+  tensors_[rank] = tensors;
+  Barrier();
+
+  vector<size_t> offset = Offsets(*tensors);
+  const vector<Tensor>& first = *tensors_[0];
+  CHECK_EQ(first.size(), tensors->size());
+  for (size_t i = 0; i < first.size(); i++)
+    CHECK_EQ(first[i].Size(), tensors->at(i).Size())
+        << "Tensor " << i << " differs in size among workers";
+  size_t total = offset.back();
+  size_t chunk = (total + num_workers_ - 1) / num_workers_;
+  size_t begin = std::min(total, chunk * rank);
+  size_t end = std::min(total, begin + chunk);
 
-#endif
\ No newline at end of file
+  // reduce-scatter: sum the chunk of this worker into the tensors of 'dst'
+  vector<Tensor>& target = *tensors_[dst < 0 ? rank : dst];
+  ForEachPart(offset, begin, end, [&](size_t i, size_t lo, size_t len) {
+    Tensor& out = target[i];
+    bool host = true;
+    for (auto t : tensors_)
+      host = host && t->at(i).device()->lang() == kCpp &&
+             t->at(i).data_type() == kFloat32;
+    if (host) {
+      float* y = static_cast<float*>(out.block()->mutable_data()) + lo;
+      for (auto t : tensors_) {
+        if (t == &target) continue;
+        const float* x = static_cast<const float*>(t->at(i).block()->data());
+        x += lo;
+        for (size_t k = 0; k < len; k++) y[k] += x[k];
+      }
+      if (scale != 1.0f)
+        for (size_t k = 0; k < len; k++) y[k] *= scale;
+    } else {
+      // on the device of the output
+      Tensor sum(Shape{len}, out.device(), out.data_type());
+      Tensor part(Shape{len}, out.device(), out.data_type());
+      CopyDataToFrom(&sum, out, len, 0, lo);
+      for (auto t : tensors_) {
+        if (t == &target) continue;
+        CopyDataToFrom(&part, t->at(i), len, 0, lo);
+        sum += part;
+      }
+      if (scale != 1.0f) sum *= scale;
+      CopyDataToFrom(&out, sum, len, lo, 0);
+    }
+  });
+  Sync(target);
+  Barrier();
+  if (!gather) return;
+
+  // all-gather: copy the summed chunk to the other workers
+  ForEachPart(offset, begin, end, [&](size_t i, size_t lo, size_t len) {
+    for (auto t : tensors_)
+      if (t != tensors) CopyDataToFrom(&t->at(i), tensors->at(i), len, lo, lo);
+  });
+  for (auto t : tensors_)
+    if (t != tensors) Sync(*t);
+  Barrier();
+}
+
+#ifdef ENABLE_DIST
+namespace {
+EndPoint* Connect(NetworkThread* net, const string& host, bool active) {
+  if (!active) return net->epf_->waitEp(host.c_str());
+  const int kMaxTry = 60;
+  for (int i = 0; i < kMaxTry; i++) {
+    EndPoint* ep = net->epf_->getEp(host.c_str());
+    if (ep != nullptr) return ep;
+    LOG(INFO) << "Waiting for " << host;
+    sleep(1);
+  }
+  LOG(FATAL) << "Unable to connect to " << host;
+  return nullptr;
+}
+}  // namespace
+
+RingAllReduce::RingAllReduce(NetworkThread* net, const vector<string>& hosts,
+                             int rank)
+    : num_(hosts.size()), rank_(rank), prev_(nullptr), next_(nullptr) {
+  CHECK(rank_ >= 0 && rank_ < num_);
+  if (num_ == 1) return;
+  int next = (rank_ + 1) % num_, prev = (rank_ + num_ - 1) % num_;
+  // the lower rank of two neighbours connects to the other, hence there is
+  // one connection between them
+  next_ = Connect(net, hosts[next], rank_ < next);
+  prev_ = Connect(net, hosts[prev], rank_ < prev);
+}
+
+void RingAllReduce::Send(const float* begin, const float* end,
+                         std::shared_ptr<void> owner) {
+  Message msg;
+  char meta[sizeof(uint32_t)];
+  appendInteger(meta, ++sent_);
+  msg.setMetadata(meta, sizeof(meta));
+  msg.setPayloadRef(begin, (end - begin) * sizeof(float), owner);
+  CHECK_GE(next_->send(&msg), 0) << "Lost connection to the next process";
+}
+
+std::shared_ptr<Message> RingAllReduce::Receive(size_t size) {
+  while (true) {
+    Message* msg = prev_->recv();
+    CHECK(msg != nullptr) << "Lost connection to the previous process";
+    void* meta = nullptr;
+    CHECK_EQ(msg->getMetadata(&meta), sizeof(uint32_t));
+    uint32_t seq;
+    readInteger(static_cast<char*>(meta), seq);
+    if (seq <= received_) {
+      // resent after reconnection
+      delete msg;
+      continue;
+    }
+    received_ = seq;
+    void* data = nullptr;
+    CHECK_EQ(msg->getPayload(&data), size * sizeof(float))
+        << "Tensors differ in size among processes";
+    return std::shared_ptr<Message>(msg);
+  }
+}
+
+void RingAllReduce::AllReduce(vector<Tensor>* tensors, float scale) {
+  if (num_ == 1) {
+    if (scale != 1.0f)
+      for (auto& t : *tensors) t *= scale;
+    return;
+  }
+  vector<size_t> offset = Offsets(*tensors);
+  size_t total = offset.back();
+  for (const auto& t : *tensors) CHECK_EQ(t.data_type(), kFloat32);
+  // a new buffer for every call, as the messages read it until they are
+  // acknowledged
+  std::shared_ptr<float> buf(new float[std::max<size_t>(total, 1)],
+                             std::default_delete<float[]>());
+  // a host tensor over the part of 'flat' for tensor i
+  auto view = [&](std::shared_ptr<float> flat, size_t i) {
+    size_t nbytes = tensors->at(i).Size() * sizeof(float);
+    return Tensor(new Block(flat.get() + offset[i], nbytes, 0, flat),
+                  tensors->at(i).shape(), defaultDevice);
+  };
+  for (size_t i = 0; i < tensors->size(); i++) {
+    Tensor host = view(buf, i);
+    CopyDataToFrom(&host, tensors->at(i), host.Size());
+  }
+  Sync(*tensors);
+  defaultDevice->Sync();
+
+  size_t chunk = (total + num_ - 1) / num_;
+  auto lo = [&](int k) { return std::min(total, chunk * k); };
+  auto hi = [&](int k) { return std::min(total, chunk * (k + 1)); };
+  auto mod = [this](int k) { return (k % num_ + num_) % num_; };
+  float* data = buf.get();
+
+  // reduce-scatter; chunk rank + 1 is complete at the end
+  for (int s = 0; s < num_ - 1; s++) {
+    int k = mod(rank_ - s);
+    Send(data + lo(k), data + hi(k), buf);
+    int m = mod(rank_ - s - 1);
+    auto msg = Receive(hi(m) - lo(m));
+    void* x = nullptr;
+    msg->getPayload(&x);
+    float* y = data + lo(m);
+    for (size_t i = 0; i < hi(m) - lo(m); i++)
+      y[i] += static_cast<float*>(x)[i];
+  }
+  int own = mod(rank_ + 1);
+  if (scale != 1.0f)
+    for (size_t i = lo(own); i < hi(own); i++) data[i] *= scale;
+
+  // all-gather; the received chunks are forwarded from the messages
+  vector<std::shared_ptr<Message>> got(num_);
+  for (int s = 0; s < num_ - 1; s++) {
+    int k = mod(rank_ + 1 - s);
+    if (k == own) {
+      Send(data + lo(k), data + hi(k), buf);
+    } else {
+      void* x = nullptr;
+      got[k]->getPayload(&x);
+      float* p = static_cast<float*>(x);
+      Send(p, p + hi(k) - lo(k), got[k]);
+    }
+    int m = mod(rank_ - s);
+    got[m] = Receive(hi(m) - lo(m));
+  }
+
+  // assemble the result in a new buffer and copy it to the tensors
+  std::shared_ptr<float> out(new float[std::max<size_t>(total, 1)],
+                             std::default_delete<float[]>());
+  for (int k = 0; k < num_; k++) {
+    void* x = data + lo(k);
+    if (k != own) got[k]->getPayload(&x);
+    if (hi(k) > lo(k))
+      memcpy(out.get() + lo(k), x, (hi(k) - lo(k)) * sizeof(float));
+  }
+  for (size_t i = 0; i < tensors->size(); i++)
+    CopyDataToFrom(&tensors->at(i), view(out, i), tensors->at(i).Size());
+  Sync(*tensors);
+}
+#endif  // ENABLE_DIST
+}  // namespace singa
+
+#endif  // SRC_MODEL_OPTIMIZER_LOCAL_ALL_REDUCE_H_
@@ -0,0 +1,403 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "singa/model/updater.h"
+#ifdef ENABLE_DIST
+
+#include "singa/utils/integer.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+
+namespace singa {
+
+namespace {
+/// Requests of the workers and replies of the servers.
+enum Op : uint8_t { kRegister, kInit, kPush, kPull, kValue, kStop };
+
+/// Metadata of a message; the payload, if any, is the raw tensor data.
+struct Meta {
+  uint8_t op = kStop;
+  /// sequence number of the request of a worker to a server, by which the
+  /// duplicates resent after reconnection are dropped
+  uint32_t seq = 0;
+  int32_t step = 0;
+  int32_t dtype = kFloat32;
+  std::string name;
+  Shape shape;
+  /// e.g., the serialized ParamSpec
+  std::string extra;
+};
+
+const int kHeadSize = sizeof(uint8_t) + 2 * sizeof(int32_t) +
+                      4 * sizeof(uint32_t);
+
+std::string Pack(const Meta& meta) {
+  std::string buf(kHeadSize + meta.shape.size() * sizeof(uint64_t) +
+                      meta.name.size() + meta.extra.size(),
+                  '\0');
+  char* p = &buf[0];
+  p += appendInteger(p, meta.op, meta.seq, meta.step, meta.dtype,
+                     static_cast<uint32_t>(meta.shape.size()),
+                     static_cast<uint32_t>(meta.name.size()),
+                     static_cast<uint32_t>(meta.extra.size()));
+  for (size_t d : meta.shape) p += appendInteger(p, static_cast<uint64_t>(d));
+  memcpy(p, meta.name.data(), meta.name.size());
+  memcpy(p + meta.name.size(), meta.extra.data(), meta.extra.size());
+  return buf;
+}
+
+Meta Unpack(Message* msg) {
+  void* data = nullptr;
+  size_t size = msg->getMetadata(&data);
+  CHECK_GE(size, static_cast<size_t>(kHeadSize)) << "Invalid message";
+  char* p = static_cast<char*>(data);
+  Meta meta;
+  uint32_t ndim, nname, nextra;
+  p += readInteger(p, meta.op, meta.seq, meta.step, meta.dtype, ndim, nname,
+                   nextra);
+  CHECK_EQ(size, kHeadSize + ndim * sizeof(uint64_t) + nname + nextra)
+      << "Invalid message";
+  for (uint32_t i = 0; i < ndim; i++) {
+    uint64_t d;
+    p += readInteger(p, d);
+    meta.shape.push_back(d);
+  }
+  meta.name.assign(p, nname);
+  meta.extra.assign(p + nname, nextra);
+  return meta;
+}
+
+/// Send the metadata and 'payload' (if not empty) without copying the
+/// payload, which is kept by the message until it is acknowledged.
+/// Return false if the EndPoint is disconnected.
+bool Send(EndPoint* ep, const Meta& meta, const Tensor& payload = Tensor()) {
+  Message msg;
+  std::string buf = Pack(meta);
+  msg.setMetadata(buf.data(), buf.size());
+  if (!payload.empty()) {
+    auto owner = std::make_shared<Tensor>(payload);
+    msg.setPayloadRef(owner->data<char>(),
+                      owner->Size() * SizeOf(owner->data_type()), owner);
+  }
+  return ep->send(&msg) >= 0;
+}
+
+/// A tensor on the default (host) device over the payload of the message,
+/// which is deleted with the tensor.
+Tensor PayloadTensor(Message* msg, const Meta& meta) {
+  std::shared_ptr<Message> owner(msg);
+  void* data = nullptr;
+  size_t size = owner->getPayload(&data);
+  DataType dtype = static_cast<DataType>(meta.dtype);
+  size_t count = 1;
+  for (size_t d : meta.shape) count *= d;
+  CHECK_EQ(size, count * SizeOf(dtype)) << "Invalid payload of " << meta.name;
+  return Tensor(new Block(data, size, 0, owner), meta.shape, defaultDevice,
+                dtype);
+}
+
+/// A copy of 't' on the default (host) device.
+Tensor HostCopy(const Tensor& t) {
+  CHECK(!t.transpose()) << "Transposed tensors are not supported";
+  Tensor host(t.shape(), defaultDevice, t.data_type());
+  CopyDataToFrom(&host, t, t.Size());
+  return host;
+}
+
+/// Get the EndPoint of 'host', waiting for it to start if necessary.
+EndPoint* Connect(NetworkThread* net, const std::string& host) {
+  const int kMaxTry = 60;
+  for (int i = 0; i < kMaxTry; i++) {
+    EndPoint* ep = net->epf_->getEp(host.c_str());
+    if (ep != nullptr) return ep;
+    LOG(INFO) << "Waiting for " << host;
+    sleep(1);
+  }
+  LOG(FATAL) << "Unable to connect to " << host;
+  return nullptr;
+}
+}  // namespace
+
+// ========================= DistUpdater =====================================
+DistUpdater::DistUpdater(Optimizer* opt, NetworkThread* net,
+                         const std::vector<std::string>& servers)
+    : Updater(opt) {
+  CHECK(!servers.empty());
+  for (const auto& host : servers) {
+    servers_.emplace_back(new Server());
+    servers_.back()->ep = Connect(net, host);
+  }
+}
+
+DistUpdater::~DistUpdater() { Stop(); }
+
+void DistUpdater::Register(const string& name, const ParamSpec& specs) {
+  opt_->Register(name, specs);
+  Server* server = servers_[std::hash<string>()(name) % servers_.size()].get();
+  Meta meta;
+  meta.op = kRegister;
+  meta.name = name;
+  specs.SerializeToString(&meta.extra);
+  std::unique_lock<std::mutex> lock(server->mtx);
+  meta.seq = ++server->seq;
+  CHECK(Send(server->ep, meta)) << "Lost connection to the server of " << name;
+  initialized_[name] = false;
+}
+
+void DistUpdater::Apply(int step, const string& name, Tensor& grad,
+                        Tensor& value) {
+  Request(kPush, step, name, grad, value);
+}
+
+void DistUpdater::Pull(const string& name, Tensor& value) {
+  Request(kPull, 0, name, Tensor(), value);
+}
+
+void DistUpdater::Request(int op, int step, const string& name,
+                          const Tensor& grad, Tensor& value) {
+  CHECK(!stopped_);
+  CHECK(initialized_.count(name) == 1) << "Parameter " << name
+                                       << " has not been registered before.";
+  Server* server = servers_[std::hash<string>()(name) % servers_.size()].get();
+  std::unique_lock<std::mutex> lock(server->mtx);
+  Meta meta;
+  meta.step = step;
+  meta.name = name;
+  meta.dtype = value.data_type();
+  meta.shape = value.shape();
+  if (!initialized_.at(name)) {
+    // a copy, as the value is overwritten by the reply
+    meta.op = kInit;
+    meta.seq = ++server->seq;
+    CHECK(Send(server->ep, meta, HostCopy(value)))
+        << "Lost connection to the server of " << name;
+    initialized_[name] = true;
+  }
+
+  // receive the value in place if possible
+  Tensor host = value;
+  CHECK(!value.transpose()) << "Transposed tensors are not supported";
+  if (value.device()->lang() != kCpp)
+    host = Tensor(value.shape(), defaultDevice, value.data_type());
+  host.device()->Sync();
+  size_t nbytes = host.Size() * SizeOf(host.data_type());
+  char* dst = static_cast<char*>(host.block()->mutable_data());
+  server->ep->postRecv(dst, nbytes);
+
+  meta.op = static_cast<uint8_t>(op);
+  Tensor payload;
+  if (op == kPush) {
+    CHECK(!grad.transpose()) << "Transposed tensors are not supported";
+    meta.dtype = grad.data_type();
+    meta.shape = grad.shape();
+    payload = grad.device()->lang() == kCpp ? grad : HostCopy(grad);
+  }
+  meta.seq = ++server->seq;
+  CHECK(Send(server->ep, meta, payload))
+      << "Lost connection to the server of " << name;
+
+  Message* msg = Receive(server, meta.seq);
+  CHECK(msg != nullptr) << "Lost connection to the server of " << name;
+  CHECK(Unpack(msg).op == kValue) << "Unexpected reply";
+  void* data = nullptr;
+  CHECK_EQ(msg->getPayload(&data), nbytes) << "Invalid value of " << name;
+  if (data != dst) memcpy(dst, data, nbytes);
+  delete msg;
+  if (host.block() != value.block()) CopyDataToFrom(&value, host, host.Size());
+}
+
+Message* DistUpdater::Receive(Server* server, uint32_t seq) {
+  while (true) {
+    Message* msg = server->ep->recv();
+    if (msg == nullptr || Unpack(msg).seq == seq) return msg;
+    // a duplicate of an earlier reply
+    delete msg;
+  }
+}
+
+void DistUpdater::Stop() {
+  if (stopped_) return;
+  stopped_ = true;
+  Meta meta;
+  meta.op = kStop;
+  for (auto& server : servers_) {
+    std::unique_lock<std::mutex> lock(server->mtx);
+    meta.seq = ++server->seq;
+    // the server may exit before its reply is sent
+    if (Send(server->ep, meta)) delete Receive(server.get(), meta.seq);
+  }
+}
+
+// ========================= ParamServer =====================================
+ParamServer::ParamServer(Optimizer* opt, NetworkThread* net,
+                         const std::vector<std::string>& workers,
+                         int staleness, std::shared_ptr<Device> dev)
+    : opt_(opt), net_(net), workers_(workers), staleness_(staleness),
+      dev_(dev) {
+  CHECK(!workers_.empty());
+}
+
+void ParamServer::Run() {
+  eps_.clear();
+  // the workers connect to the servers
+  for (const auto& host : workers_)
+    eps_.push_back(net_->epf_->waitEp(host.c_str()));
+  stopped_.assign(workers_.size(), false);
+  seq_.assign(workers_.size(), 0);
+  running_ = static_cast<int>(workers_.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < eps_.size(); i++)
+    threads.emplace_back(&ParamServer::Serve, this, static_cast<int>(i));
+  for (auto& t : threads) t.join();
+}
+
+void ParamServer::Serve(int worker) {
+  while (true) {
+    Message* msg = eps_[worker]->recv();
+    if (msg == nullptr) {
+      LOG(ERROR) << "Lost connection to worker " << workers_[worker];
+      std::unique_lock<std::mutex> lock(mtx_);
+      Leave(worker);
+      return;
+    }
+    if (!Handle(worker, msg)) return;
+  }
+}
+
+bool ParamServer::Handle(int worker, Message* msg) {
+  Meta meta = Unpack(msg);
+  std::unique_lock<std::mutex> lock(mtx_);
+  if (meta.seq <= seq_[worker]) {
+    // resent after reconnection
+    delete msg;
+    return true;
+  }
+  seq_[worker] = meta.seq;
+  if (meta.op == kStop) {
+    delete msg;
+    Leave(worker);
+    Send(eps_[worker], meta);
+    return false;
+  }
+  if (meta.op == kRegister) {
+    delete msg;
+    if (params_.count(meta.name) == 0) {
+      ParamSpec specs;
+      specs.ParseFromString(meta.extra);
+      opt_->Register(meta.name, specs);
+      params_[meta.name].clock.assign(workers_.size(), 0);
+    }
+    return true;
+  }
+
+  CHECK(params_.count(meta.name) == 1) << "Parameter " << meta.name
+                                       << " has not been registered before.";
+  Param& param = params_.at(meta.name);
+  if (meta.op == kPull) {
+    delete msg;
+    Reply(meta.name, param, {worker});
+    return true;
+  }
+  Tensor payload = PayloadTensor(msg, meta);
+  if (dev_ != defaultDevice) payload.ToDevice(dev_);
+  if (meta.op == kInit) {
+    // the first worker initializes the parameter
+    if (param.value.empty()) param.value = payload;
+    return true;
+  }
+
+  CHECK(meta.op == kPush) << "Unknown request";
+  CHECK(!param.value.empty()) << "Parameter " << meta.name
+                              << " is not initialized";
+  param.waiting.push_back(worker);
+  if (staleness_ < 0) {
+    if (param.count == 0) {
+      param.sum.ResetLike(param.value);
+      param.sum.CopyData(payload);
+    } else {
+      Add(param.sum, payload, &param.sum);
+    }
+    param.step = meta.step;
+    if (++param.count >= running_) Update(meta.name, &param);
+  } else {
+    opt_->Apply(meta.step, meta.name, payload, param.value);
+    param.clock[worker]++;
+    ReplyReady(meta.name, &param);
+  }
+  return true;
+}
+
+void ParamServer::Leave(int worker) {
+  if (stopped_[worker]) return;
+  stopped_[worker] = true;
+  running_--;
+  for (auto& p : params_) {
+    if (staleness_ < 0) {
+      if (p.second.count > 0 && p.second.count >= running_)
+        Update(p.first, &p.second);
+    } else {
+      ReplyReady(p.first, &p.second);
+    }
+  }
+}
+
+void ParamServer::Update(const string& name, Param* param) {
+  Div(param->sum, static_cast<float>(param->count), &param->sum);
+  opt_->Apply(param->step, name, param->sum, param->value);
+  param->count = 0;
+  Reply(name, *param, param->waiting);
+  param->waiting.clear();
+}
+
+void ParamServer::ReplyReady(const string& name, Param* param) {
+  int slowest = std::numeric_limits<int>::max();
+  for (size_t i = 0; i < stopped_.size(); i++)
+    if (!stopped_[i]) slowest = std::min(slowest, param->clock[i]);
+  std::vector<int> ready, waiting;
+  for (int w : param->waiting) {
+    if (param->clock[w] - staleness_ <= slowest)
+      ready.push_back(w);
+    else
+      waiting.push_back(w);
+  }
+  param->waiting.swap(waiting);
+  if (!ready.empty()) Reply(name, *param, ready);
+}
+
+void ParamServer::Reply(const string& name, const Param& param,
+                        const std::vector<int>& workers) {
+  Meta meta;
+  meta.op = kValue;
+  meta.name = name;
+  meta.dtype = param.value.data_type();
+  meta.shape = param.value.shape();
+  // one snapshot shared by the replies until they are acknowledged
+  Tensor snapshot = HostCopy(param.value);
+  for (int w : workers) {
+    // the reply of the last request, for which the worker is waiting
+    meta.seq = seq_[w];
+    if (!stopped_[w] && !Send(eps_[w], meta, snapshot))
+      LOG(ERROR) << "Lost connection to worker " << workers_[w];
+  }
+}
+}  // namespace singa
+#endif  // ENABLE_DIST
@@ -23,55 +23,90 @@ namespace singa {
 
 void LocalUpdater::Register(const string& name, const ParamSpec& specs) {
   opt_->Register(name, specs);
-  param_buffer_[name];
-  param_buffer_[name].ToDevice(dev_);
-  sum_[name];
-  sum_[name].ToDevice(dev_);
-  for (int i = 0; i < total_num_; ++i) {
-    grad_buffer_[std::make_pair(i, name)];
-    grad_buffer_[std::make_pair(i, name)].ToDevice(dev_);
-  }
-  dev_index_[name] = 0;
-  to_updater_finished_[name] = 0;
-  mtx_[name];
+  if (index_.count(name)) return;
+  index_[name] = params_.size();
+  Param* param = new Param();
+  param->name = name;
+  param->grad.ToDevice(dev_);
+  param->value.ToDevice(dev_);
+  param->reducer.reset(new LocalAllReduce(total_num_));
+  params_.push_back(std::unique_ptr<Param>(param));
+}
+
+int LocalUpdater::Index(const string& name) const {
+  auto it = index_.find(name);
+  CHECK(it != index_.end()) << "Parameter " << name
+                            << " has not been registered before.";
+  return it->second;
 }
 
 void LocalUpdater::Apply(int step, const string& name, Tensor& grad,
                          Tensor& value) {
-  CHECK(param_buffer_.count(name) == 1) << "Parameter " << name
-                                        << " has not been registered before.";
-  int nth = dev_index_[name]++;
-  auto key = std::make_pair(nth, name);
-  if (grad_buffer_[key].Size() != grad.Size()) {
-    grad_buffer_[key].Resize(grad.shape());
-    grad_buffer_[key].AsType(grad.data_type());
-  }
-  grad_buffer_[key].CopyData(grad);
+  Apply(step, Index(name), grad, value);
+}
 
-  std::unique_lock<std::mutex> lock(mtx_[name]);
-  ++to_updater_finished_[name];
-  if (to_updater_finished_[name] != total_num_) {
-    while (to_updater_finished_[name] > 0) {
-      to_updater_all_finished_[name].wait(lock);
-    }
-  } else {
-    if (param_buffer_[name].Size() != value.Size()) {
-      param_buffer_[name].Resize(value.shape());
-      param_buffer_[name].AsType(value.data_type());
-      param_buffer_[name].CopyData(value);
-      sum_[name].ResetLike(param_buffer_[name]);
+void LocalUpdater::Apply(int step, int index, Tensor& grad, Tensor& value) {
+  // the copies share the memory of the tensors
+  vector<Tensor> grads{grad}, values{value};
+  Update(step, vector<int>{index}, grads, values);
+}
+
+void LocalUpdater::ApplyBucket(int step, const vector<string>& names,
+                               vector<Tensor>& grads, vector<Tensor>& values) {
+  CHECK_EQ(names.size(), grads.size());
+  CHECK_EQ(names.size(), values.size());
+  if (names.empty()) return;
+  vector<int> indices;
+  for (const auto& name : names) indices.push_back(Index(name));
+  Update(step, indices, grads, values);
+}
+
+void LocalUpdater::Update(int step, const vector<int>& indices,
+                          vector<Tensor>& grads, vector<Tensor>& values) {
+  vector<Param*> params;
+  for (int index : indices) {
+    CHECK(index >= 0 && index < static_cast<int>(params_.size()));
+    params.push_back(params_[index].get());
+  }
+  Param* head = params[0];
+  int nth = head->arrived.fetch_add(1);
+  CHECK_LT(nth, total_num_) << "Too many threads updating " << head->name;
+  // every thread averages 1/total_num_ of the gradients into the gradients
+  // of the first thread, which then updates the parameters
+  head->reducer->Reduce(nth, &grads, 0, 1.0f / total_num_);
+  if (nth == 0) {
+    for (size_t k = 0; k < params.size(); k++) {
+      Tensor grad = grads[k];
+      if (grad.device() != dev_) {
+        Tensor& buf = params[k]->grad;
+        if (buf.Size() != grad.Size() || buf.data_type() != grad.data_type()) {
+          buf.Resize(grad.shape());
+          buf.AsType(grad.data_type());
+        }
+        buf.CopyData(grad);
+        grad = buf;
+      }
+      Tensor& master = params[k]->value;
+      Tensor& value = values[k];
+      if (master.Size() != value.Size()) {
+        if (value.device() == dev_) {
+          // share the memory of this replica
+          master = value;
+        } else {
+          master.Resize(value.shape());
+          master.AsType(value.data_type());
+          master.CopyData(value);
+        }
+      }
+      opt_->Apply(step, params[k]->name, grad, master);
     }
-    sum_[name].SetValue(.0f);
-    for (int i = 0; i < total_num_; ++i)
-      Add(sum_[name], grad_buffer_[std::make_pair(i, name)], &sum_[name]);
-    Div(sum_[name], static_cast<float>(total_num_), &sum_[name]);
-    opt_->Apply(step, name, sum_[name], param_buffer_[name]);
-    to_updater_finished_[name] = 0;
-    dev_index_[name] = 0;
-    to_updater_all_finished_[name].notify_all();
+    // all threads have arrived, and none arrives again before the barrier
+    head->arrived.store(0);
   }
-  lock.unlock();
-  value.CopyData(param_buffer_[name]);
+  head->reducer->Barrier();
+  for (size_t k = 0; k < params.size(); k++)
+    if (values[k].block() != params[k]->value.block())
+      values[k].CopyData(params[k]->value);
 }
 
 }  // namesapce singa
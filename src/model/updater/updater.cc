@@ -29,4 +29,12 @@ void Updater::Register(const string& name, const ParamSpec& specs) {
 void Updater::Apply(int step, const string& name, Tensor& grad, Tensor& value) {
   opt_->Apply(step, name, grad, value);
 }
+
+void Updater::ApplyBucket(int step, const vector<string>& names,
+                          vector<Tensor>& grads, vector<Tensor>& values) {
+  CHECK_EQ(names.size(), grads.size());
+  CHECK_EQ(names.size(), values.size());
+  for (size_t k = 0; k < names.size(); k++)
+    Apply(step, names[k], grads[k], values[k]);
+}
 }  // namesapce singa
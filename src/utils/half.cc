@@ -0,0 +1,111 @@
+/************************************************************
+*
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an
+* "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+* KIND, either express or implied.  See the License for the
+* specific language governing permissions and limitations
+* under the License.
+*
+*************************************************************/
+
+#include "singa/utils/half.h"
+#include "singa/utils/vector_ext.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SINGA_F16C_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace singa {
+
+#ifdef SINGA_F16C_DISPATCH
+namespace {
+bool HasF16C() {
+  static const bool has = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  }();
+  return has;
+}
+
+__attribute__((target("avx,f16c")))
+size_t HalfToFloatF16C(const half* in, float* out, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+  }
+  return i;
+}
+
+__attribute__((target("avx,f16c")))
+size_t FloatToHalfF16C(const float* in, half* out, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i),
+                                _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), h);
+  }
+  return i;
+}
+}  // namespace
+#endif  // SINGA_F16C_DISPATCH
+
+void HalfToFloat(const half* in, float* out, size_t n) {
+  size_t i = 0;
+#ifdef SINGA_F16C_DISPATCH
+  if (HasF16C()) i = HalfToFloatF16C(in, out, n);
+#endif  // SINGA_F16C_DISPATCH
+  for (; i < n; i++) out[i] = HalfBitsToFloat(in[i].bits);
+}
+
+void FloatToHalf(const float* in, half* out, size_t n) {
+  size_t i = 0;
+#ifdef SINGA_F16C_DISPATCH
+  if (HasF16C()) i = FloatToHalfF16C(in, out, n);
+#endif  // SINGA_F16C_DISPATCH
+  for (; i < n; i++) out[i].bits = FloatToHalfBits(in[i]);
+}
+
+// bf16 is the upper half of float, hence vectors of plain integer ops
+void BFloat16ToFloat(const bfloat16* in, float* out, size_t n) {
+  size_t i = 0;
+#ifdef SINGA_CONVERTVECTOR
+  for (; i + 8 <= n; i += 8) {
+    u16x8 h;
+    std::memcpy(&h, in + i, sizeof(h));
+    u32x8 x = __builtin_convertvector(h, u32x8) << 16;
+    std::memcpy(out + i, &x, sizeof(x));
+  }
+#endif  // SINGA_CONVERTVECTOR
+  for (; i < n; i++) out[i] = BFloat16BitsToFloat(in[i].bits);
+}
+
+void FloatToBFloat16(const float* in, bfloat16* out, size_t n) {
+  size_t i = 0;
+#ifdef SINGA_CONVERTVECTOR
+  for (; i + 8 <= n; i += 8) {
+    u32x8 x;
+    std::memcpy(&x, in + i, sizeof(x));
+    u32x8 r = (x + 0x7fffu + ((x >> 16) & 1u)) >> 16;
+    u32x8 nan = (u32x8)((x & 0x7fffffffu) > 0x7f800000u);
+    r = (r & ~nan) | (((x >> 16) | 0x40u) & nan);
+    u16x8 h = __builtin_convertvector(r, u16x8);
+    std::memcpy(out + i, &h, sizeof(h));
+  }
+#endif  // SINGA_CONVERTVECTOR
+  for (; i < n; i++) out[i].bits = FloatToBFloat16Bits(in[i]);
+}
+
+}  // namespace singa
@@ -0,0 +1,156 @@
+/************************************************************
+*
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an
+* "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+* KIND, either express or implied.  See the License for the
+* specific language governing permissions and limitations
+* under the License.
+*
+*************************************************************/
+
+#include "singa/utils/thread_pool.h"
+
+#include <algorithm>
+
+#include "singa/utils/logging.h"
+
+namespace singa {
+
+thread_local ThreadPool* ThreadPool::current_ = nullptr;
+thread_local int ThreadPool::worker_ = -1;
+
+ThreadPool::ThreadPool(int num_threads) : num_tasks_(0), next_queue_(0) {
+  CHECK_GE(num_threads, 0);
+  for (int i = 0; i < num_threads; i++)
+    queues_.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+  for (int i = 0; i < num_threads; i++)
+    workers_.push_back(std::thread(&ThreadPool::Run, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& t : workers_) t.join();
+}
+
+void ThreadPool::Submit(std::function<void()>&& task) {
+  if (workers_.empty()) {
+    task();
+    return;
+  }
+  int k = current_ == this ? worker_ : next_queue_++ % queues_.size();
+  {
+    std::lock_guard<std::mutex> lock(queues_[k]->mtx);
+    queues_[k]->tasks.push_back(std::move(task));
+    num_tasks_++;
+  }
+  // lock to avoid missing a worker that is about to wait
+  std::lock_guard<std::mutex> lock(mtx_);
+  cv_.notify_one();
+}
+
+bool ThreadPool::Take(int worker, std::function<void()>* task) {
+  {
+    TaskQueue& q = *queues_[worker];
+    std::lock_guard<std::mutex> lock(q.mtx);
+    if (!q.tasks.empty()) {
+      *task = std::move(q.tasks.back());
+      q.tasks.pop_back();
+      num_tasks_--;
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues_.size(); i++) {
+    TaskQueue& q = *queues_[(worker + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(q.mtx);
+    if (!q.tasks.empty()) {
+      *task = std::move(q.tasks.front());
+      q.tasks.pop_front();
+      num_tasks_--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::Run(int worker) {
+  current_ = this;
+  worker_ = worker;
+  std::function<void()> task;
+  while (true) {
+    if (Take(worker, &task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.wait(lock, [this]() { return stop_ || num_tasks_ > 0; });
+    if (stop_ && num_tasks_ == 0) break;
+  }
+}
+
+namespace {
+/// Shared by the calling thread and the helper tasks of one ParallelFor.
+struct Loop {
+  std::atomic<size_t> next{0};
+  size_t done = 0;
+  std::mutex mtx;
+  std::condition_variable cv;
+};
+}  // namespace
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain,
+                             const std::function<void(size_t, size_t)>& fn) {
+  if (end <= begin) return;
+  size_t n = end - begin;
+  size_t num_chunks = (n + std::max<size_t>(grain, 1) - 1)
+                      / std::max<size_t>(grain, 1);
+  // a few chunks per thread to balance the load
+  num_chunks = std::min(num_chunks, (workers_.size() + 1) * 4);
+  if (num_chunks <= 1) {
+    fn(begin, end);
+    return;
+  }
+  size_t chunk = (n + num_chunks - 1) / num_chunks;
+  num_chunks = (n + chunk - 1) / chunk;
+
+  auto loop = std::make_shared<Loop>();
+  // 'fn' is accessed only when a chunk is taken, i.e., before this function
+  // returns; helpers started later find no chunk left.
+  auto work = [loop, &fn, begin, end, chunk, num_chunks]() {
+    size_t k, ndone = 0;
+    while ((k = loop->next++) < num_chunks) {
+      fn(begin + k * chunk, std::min(end, begin + (k + 1) * chunk));
+      ndone++;
+    }
+    if (ndone > 0) {
+      std::lock_guard<std::mutex> lock(loop->mtx);
+      loop->done += ndone;
+      if (loop->done == num_chunks) loop->cv.notify_all();
+    }
+  };
+  size_t num_helpers = std::min(num_chunks - 1, workers_.size());
+  for (size_t i = 0; i < num_helpers; i++)
+    Submit(std::function<void()>(work));
+  work();
+  std::unique_lock<std::mutex> lock(loop->mtx);
+  loop->cv.wait(lock, [&loop, num_chunks]() {
+    return loop->done == num_chunks;
+  });
+}
+
+}  // namespace singa
@@ -0,0 +1,191 @@
+/************************************************************
+*
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an
+* "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+* KIND, either express or implied.  See the License for the
+* specific language governing permissions and limitations
+* under the License.
+*
+*************************************************************/
+
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+#include "singa/model/optimizer.h"
+#include "singa/model/updater.h"
+#include "gtest/gtest.h"
+#ifdef ENABLE_DIST
+#include <sys/wait.h>
+#include <unistd.h>
+#endif  // ENABLE_DIST
+
+using singa::Shape;
+using singa::Tensor;
+
+namespace {
+// tensors of 10 floats in total, where x[k] of worker r is r + 0.5 k
+std::vector<Tensor> MakeTensors(int rank) {
+  std::vector<Tensor> tensors{Tensor(Shape{7}), Tensor(Shape{2, 1}),
+                              Tensor(Shape{1})};
+  float k = 0;
+  for (auto& t : tensors) {
+    std::vector<float> x(t.Size());
+    for (auto& v : x) v = rank + 0.5f * k++;
+    t.CopyDataFromHostPtr(x.data(), x.size());
+  }
+  return tensors;
+}
+
+// the number of values of tensors that differ from the (scaled) sum of
+// MakeTensors() over 'num' workers
+int CountWrong(const std::vector<Tensor>& tensors, int num, float scale) {
+  int wrong = 0;
+  float k = 0;
+  for (const auto& t : tensors) {
+    const float* x = t.data<float>();
+    for (size_t i = 0; i < t.Size(); i++) {
+      float expected = scale * (num * (num - 1) / 2 + num * 0.5f * k++);
+      if (std::abs(x[i] - expected) > 1e-4f) wrong++;
+    }
+  }
+  return wrong;
+}
+}  // namespace
+
+TEST(LocalAllReduce, AllReduce) {
+  const int kNum = 4;
+  singa::LocalAllReduce reducer(kNum);
+  std::vector<int> wrong(kNum, 0);
+  std::vector<std::thread> threads;
+  for (int r = 0; r < kNum; r++) {
+    threads.push_back(std::thread([&reducer, &wrong, r]() {
+      // twice to reuse the reducer
+      for (int round = 0; round < 2; round++) {
+        std::vector<Tensor> tensors = MakeTensors(r);
+        reducer.AllReduce(r, &tensors, 1.0f / kNum);
+        wrong[r] += CountWrong(tensors, kNum, 1.0f / kNum);
+      }
+    }));
+  }
+  for (auto& t : threads) t.join();
+  for (int r = 0; r < kNum; r++) EXPECT_EQ(0, wrong[r]) << "worker " << r;
+}
+
+TEST(LocalAllReduce, Reduce) {
+  const int kNum = 3;
+  singa::LocalAllReduce reducer(kNum);
+  std::vector<std::vector<Tensor>> tensors;
+  for (int r = 0; r < kNum; r++) tensors.push_back(MakeTensors(r));
+  std::vector<std::thread> threads;
+  for (int r = 0; r < kNum; r++)
+    threads.push_back(std::thread(
+        [&reducer, &tensors, r]() { reducer.Reduce(r, &tensors[r], 1); }));
+  for (auto& t : threads) t.join();
+  EXPECT_EQ(0, CountWrong(tensors[1], kNum, 1.0f));
+  // the others are not changed
+  EXPECT_EQ(0, CountWrong(tensors[0], 1, 1.0f));
+  EXPECT_FLOAT_EQ(2.0f, tensors[2][0].data<float>()[0]);
+}
+
+TEST(LocalUpdater, Threads) {
+  const int kNum = 3;
+  singa::SGD sgd;
+  sgd.SetLearningRateGenerator([](int step) { return 0.1f; });
+  singa::LocalUpdater updater(kNum, &sgd);
+  updater.Register("w", singa::ParamSpec());
+  updater.Register("b", singa::ParamSpec());
+  std::vector<int> wrong(kNum, 0);
+  std::vector<std::thread> threads;
+  for (int r = 0; r < kNum; r++) {
+    threads.push_back(std::thread([&updater, &wrong, r]() {
+      Tensor w(Shape{6}), b(Shape{2}), grad_w(Shape{6}), grad_b(Shape{2});
+      w.SetValue(1.0f);
+      b.SetValue(1.0f);
+      for (int step = 0; step < 3; step++) {
+        // the average gradient is 2; it is reduced in place, like the
+        // gradients computed anew by every step
+        grad_w.SetValue(r + 1.0f);
+        grad_b.SetValue(r + 1.0f);
+        updater.Apply(step, "w", grad_w, w);
+        updater.Apply(step, "b", grad_b, b);
+        for (const Tensor* t : {&w, &b})
+          for (size_t i = 0; i < t->Size(); i++)
+            if (std::abs(t->data<float>()[i] - (0.8f - 0.2f * step)) > 1e-5f)
+              wrong[r]++;
+      }
+    }));
+  }
+  for (auto& t : threads) t.join();
+  for (int r = 0; r < kNum; r++) EXPECT_EQ(0, wrong[r]) << "worker " << r;
+}
+
+TEST(LocalUpdater, SharedValue) {
+  const int kNum = 4;
+  singa::SGD sgd;
+  sgd.SetLearningRateGenerator([](int step) { return 0.1f; });
+  singa::LocalUpdater updater(kNum, &sgd);
+  updater.Register("w", singa::ParamSpec());
+  EXPECT_EQ(0, updater.Index("w"));
+  // one parameter tensor for all threads, which is updated once per step
+  Tensor w(Shape{5});
+  w.SetValue(1.0f);
+  std::vector<std::thread> threads;
+  for (int r = 0; r < kNum; r++) {
+    threads.push_back(std::thread([&updater, &w, r]() {
+      Tensor value = w, grad(Shape{5});
+      for (int step = 0; step < 3; step++) {
+        grad.SetValue(r + 1.0f);
+        updater.Apply(step, 0, grad, value);
+      }
+    }));
+  }
+  for (auto& t : threads) t.join();
+  // the average gradient is 2.5
+  for (size_t i = 0; i < w.Size(); i++)
+    EXPECT_NEAR(1.0f - 3 * 0.25f, w.data<float>()[i], 1e-5f);
+}
+
+#ifdef ENABLE_DIST
+TEST(RingAllReduce, Processes) {
+  // every process listens on its own loopback address
+  const std::vector<std::string> hosts = {"127.0.0.31", "127.0.0.32",
+                                          "127.0.0.33"};
+  const int kNum = hosts.size();
+  const int port = 20000 + getpid() % 20000;
+  std::vector<pid_t> pids;
+  for (int r = 0; r < kNum; r++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      singa::NetworkThread net(port, hosts[r]);
+      singa::RingAllReduce reducer(&net, hosts, r);
+      int wrong = 0;
+      for (int round = 0; round < 2; round++) {
+        std::vector<Tensor> tensors = MakeTensors(r);
+        reducer.AllReduce(&tensors, 0.5f);
+        wrong += CountWrong(tensors, kNum, 0.5f);
+      }
+      // the last chunks are acknowledged before exiting
+      sleep(1);
+      _exit(wrong == 0 ? 0 : 1);
+    }
+    pids.push_back(pid);
+  }
+  for (pid_t pid : pids) {
+    int status;
+    waitpid(pid, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+}
+#endif  // ENABLE_DIST
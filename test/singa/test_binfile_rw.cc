@@ -21,6 +21,9 @@
 
 #include "../include/singa/io/reader.h"
 #include "../include/singa/io/writer.h"
+#include <chrono>
+#include <thread>
+#include <vector>
 #include "gtest/gtest.h"
 
 const char* path_bin = "./binfile_test";
@@ -64,6 +67,73 @@ TEST(BinFileWriter, Append) {
   writer.Close();
 }
 
+TEST(BinFileWriter, Async) {
+  const std::string path = "./binfile_async_test";
+  for (bool direct : {false, true}) {
+    BinFileWriter writer;
+    EXPECT_TRUE(writer.OpenAsync(path, singa::io::kCreate, 5000, 3, direct));
+    std::string value;
+    for (int i = 0; i < 1000; i++) {
+      value.assign(i % 300 + 1, static_cast<char>('a' + i % 26));
+      EXPECT_TRUE(writer.Write(std::to_string(i), value));
+      if (i == 500) {
+        writer.Flush();
+        // the tuples before the flush are in the file, except the unaligned
+        // tail with O_DIRECT
+        BinFileReader reader;
+        reader.Open(path, 5000);
+        int count = 0;
+        std::string key, val;
+        while (reader.Read(&key, &val)) count++;
+        if (writer.direct())
+          EXPECT_GT(count, 480);
+        else
+          EXPECT_EQ(501, count);
+      }
+    }
+    writer.Close();
+
+    BinFileReader reader;
+    reader.Open(path);
+    std::string key, val;
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_TRUE(reader.Read(&key, &val));
+      EXPECT_EQ(std::to_string(i), key);
+      EXPECT_EQ(std::string(i % 300 + 1, static_cast<char>('a' + i % 26)), val);
+    }
+    EXPECT_FALSE(reader.Read(&key, &val));
+    reader.Close();
+    remove(path.c_str());
+  }
+}
+
+TEST(BinFileWriter, AsyncCrossBlock) {
+  const std::string path = "./binfile_cross_test";
+  for (bool direct : {false, true}) {
+    BinFileWriter writer;
+    EXPECT_TRUE(writer.OpenAsync(path, singa::io::kCreate, 4096, 2, direct));
+    // the second tuple crosses the first block boundary, leaving an unaligned
+    // tail when the buffer is spilled; the third one nearly fills a buffer
+    const std::vector<size_t> sizes = {100, 4000, 4050, 10};
+    for (size_t i = 0; i < sizes.size(); i++)
+      EXPECT_TRUE(writer.Write(std::to_string(i),
+                               std::string(sizes[i], 'a' + i)));
+    writer.Close();
+
+    BinFileReader reader;
+    reader.Open(path, 8192);
+    std::string key, val;
+    for (size_t i = 0; i < sizes.size(); i++) {
+      ASSERT_TRUE(reader.Read(&key, &val));
+      EXPECT_EQ(std::to_string(i), key);
+      EXPECT_EQ(std::string(sizes[i], 'a' + i), val);
+    }
+    EXPECT_FALSE(reader.Read(&key, &val));
+    reader.Close();
+    remove(path.c_str());
+  }
+}
+
 TEST(BinFileReader, Read) {
   BinFileReader reader;
   bool ret;
@@ -131,3 +201,106 @@ TEST(BinFileReader, SeekToFirst) {
   reader.Close();
   remove(path_bin);
 }
+
+TEST(BinFileReader, MmapRandomAccess) {
+  const char* path = "./binfile_mmap_test";
+  BinFileWriter writer;
+  writer.Open(path, singa::io::kCreate);
+  for (int i = 0; i < 100; i++)
+    writer.Write(i % 3 ? std::to_string(i) : "", "value" + std::to_string(i));
+  writer.Close();
+
+  BinFileReader reader;
+  EXPECT_TRUE(reader.Open(path));
+  EXPECT_TRUE(reader.mapped());
+  EXPECT_EQ(100, reader.Count());
+  singa::io::StringView key, value;
+  for (int i = 0; i < 100; i++) {
+    EXPECT_TRUE(reader.Read(&key, &value));
+    EXPECT_EQ(i % 3 ? std::to_string(i) : "", key.ToString());
+    EXPECT_EQ("value" + std::to_string(i), value.ToString());
+  }
+  EXPECT_FALSE(reader.Read(&key, &value));
+
+  reader.Seek(43);
+  std::string k, v;
+  EXPECT_TRUE(reader.Read(&k, &v));
+  EXPECT_EQ("43", k);
+  EXPECT_EQ("value43", v);
+  reader.ReadAt(99, &key, &value);
+  EXPECT_EQ("value99", value.ToString());
+
+  // a shuffled pass visits every tuple once
+  reader.Shuffle(7);
+  std::vector<int> seen(100, 0);
+  bool in_order = true;
+  for (int i = 0; i < 100; i++) {
+    EXPECT_TRUE(reader.Read(&key, &value));
+    int id = std::stoi(value.ToString().substr(5));
+    seen[id]++;
+    in_order = in_order && id == i;
+  }
+  EXPECT_FALSE(in_order);
+  for (int c : seen) EXPECT_EQ(1, c);
+  reader.Close();
+  remove(path);
+}
+
+TEST(BinFileReader, MmapIndexFile) {
+  const char* path = "./binfile_index_test";
+  const std::string index_path = std::string(path) + ".idx";
+  BinFileWriter writer;
+  writer.Open(path, singa::io::kCreate);
+  for (int i = 0; i < 10; i++)
+    writer.Write(std::to_string(i), std::string(i + 1, 'a'));
+  writer.Close();
+  {
+    // a truncated tuple at the end is ignored
+    std::ofstream fout(path, std::ios::app | std::ios::binary);
+    fout.write("sg\1\0", 4);
+  }
+
+  BinFileReader reader;
+  EXPECT_TRUE(reader.Open(path));
+  EXPECT_EQ(10, reader.Count());
+  EXPECT_TRUE(reader.SaveIndex());
+  reader.Close();
+
+  EXPECT_TRUE(reader.Open(path));
+  EXPECT_EQ(10, reader.Count());
+  singa::io::StringView key, value;
+  reader.ReadAt(9, &key, &value);
+  EXPECT_EQ("9", key.ToString());
+  EXPECT_EQ(10u, value.size());
+  reader.Close();
+
+  // a stale index is ignored
+  writer.Open(path, singa::io::kCreate);
+  writer.Write("x", "y");
+  writer.Close();
+  EXPECT_TRUE(reader.Open(path));
+  EXPECT_EQ(1, reader.Count());
+  reader.Close();
+
+  // so is one of a file rewritten with the same size and the same last
+  // offset, but different offsets in between
+  const std::vector<std::vector<size_t>> lens = {{2, 4, 2}, {4, 2, 2}};
+  for (size_t round = 0; round < lens.size(); round++) {
+    // file timestamps may be as coarse as one second
+    if (round > 0) std::this_thread::sleep_for(std::chrono::seconds(1));
+    writer.Open(path, singa::io::kCreate);
+    for (size_t i = 0; i < lens[round].size(); i++)
+      writer.Write(std::to_string(i), std::string(lens[round][i], 'a' + i));
+    writer.Close();
+    EXPECT_TRUE(reader.Open(path));
+    if (round == 0) {
+      EXPECT_TRUE(reader.SaveIndex());
+    }
+    reader.ReadAt(1, &key, &value);
+    EXPECT_EQ("1", key.ToString());
+    EXPECT_EQ(std::string(lens[round][1], 'b'), value.ToString());
+    reader.Close();
+  }
+  remove(path);
+  remove(index_path.c_str());
+}
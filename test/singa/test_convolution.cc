@@ -23,6 +23,7 @@
 #ifdef USE_CBLAS
 #include "../src/model/layer/convolution.h"
 
+#include <vector>
 #include "gtest/gtest.h"
 
 using singa::Convolution;
@@ -205,4 +206,96 @@ TEST(Convolution, Backward) {
                   dwptr[7]);
   EXPECT_FLOAT_EQ(dy[0] * x[4] + dy[4] * x[13], dwptr[8]);
 }
+
+// Direct convolution of x {n, c, h, w} by w {f, c, kh, kw} as the reference.
+struct ConvRef {
+  size_t n, c, h, w, f, kh, kw, ph, pw, sh, sw, oh, ow;
+  ConvRef(size_t n, size_t c, size_t h, size_t w, size_t f, size_t kh,
+          size_t kw, size_t ph, size_t pw, size_t sh, size_t sw)
+      : n(n), c(c), h(h), w(w), f(f), kh(kh), kw(kw), ph(ph), pw(pw), sh(sh),
+        sw(sw), oh((h + 2 * ph - kh) / sh + 1), ow((w + 2 * pw - kw) / sw + 1) {}
+
+  // calls fn(x index, w index, y index) for every multiply-add
+  template <typename Fn>
+  void Visit(Fn fn) const {
+    for (size_t b = 0; b < n; b++)
+      for (size_t o = 0; o < f; o++)
+        for (size_t y = 0; y < oh; y++)
+          for (size_t z = 0; z < ow; z++)
+            for (size_t i = 0; i < c; i++)
+              for (size_t r = 0; r < kh; r++)
+                for (size_t s = 0; s < kw; s++) {
+                  int hi = (int)(y * sh + r) - (int)ph;
+                  int wi = (int)(z * sw + s) - (int)pw;
+                  if (hi < 0 || hi >= (int)h || wi < 0 || wi >= (int)w)
+                    continue;
+                  fn(((b * c + i) * h + hi) * w + wi,
+                     ((o * c + i) * kh + r) * kw + s,
+                     ((b * f + o) * oh + y) * ow + z);
+                }
+  }
+};
+
+void CheckConv(const ConvRef& ref, std::shared_ptr<singa::Device> dev) {
+  std::vector<float> x(ref.n * ref.c * ref.h * ref.w),
+      w(ref.f * ref.c * ref.kh * ref.kw), bias(ref.f),
+      dy(ref.n * ref.f * ref.oh * ref.ow);
+  for (size_t i = 0; i < x.size(); i++) x[i] = ((i * 37) % 17) * 0.1f - 0.8f;
+  for (size_t i = 0; i < w.size(); i++) w[i] = ((i * 11) % 7) * 0.2f - 0.6f;
+  for (size_t i = 0; i < bias.size(); i++) bias[i] = i * 0.5f;
+  for (size_t i = 0; i < dy.size(); i++) dy[i] = ((i * 13) % 5) * 0.3f - 0.6f;
+
+  Convolution conv;
+  singa::LayerConf conf;
+  singa::ConvolutionConf *convconf = conf.mutable_convolution_conf();
+  convconf->set_kernel_h(ref.kh);
+  convconf->set_kernel_w(ref.kw);
+  convconf->set_pad_h(ref.ph);
+  convconf->set_pad_w(ref.pw);
+  convconf->set_stride_h(ref.sh);
+  convconf->set_stride_w(ref.sw);
+  convconf->set_num_output(ref.f);
+  conv.Setup(Shape{ref.c, ref.h, ref.w}, conf);
+  singa::Tensor wt(Shape{ref.f, ref.c * ref.kh * ref.kw}, dev),
+      bt(Shape{ref.f}, dev), in(Shape{ref.n, ref.c, ref.h, ref.w}, dev),
+      grad(Shape{ref.n, ref.f, ref.oh, ref.ow}, dev);
+  wt.CopyDataFromHostPtr(w.data(), w.size());
+  bt.CopyDataFromHostPtr(bias.data(), bias.size());
+  in.CopyDataFromHostPtr(x.data(), x.size());
+  grad.CopyDataFromHostPtr(dy.data(), dy.size());
+  conv.set_weight(wt);
+  conv.set_bias(bt);
+
+  std::vector<float> y(dy.size()), dx(x.size(), 0.f), dw(w.size(), 0.f);
+  for (size_t i = 0; i < y.size(); i++)
+    y[i] = bias[(i / (ref.oh * ref.ow)) % ref.f];
+  ref.Visit([&](size_t xi, size_t wi, size_t yi) {
+    y[yi] += x[xi] * w[wi];
+    dx[xi] += dy[yi] * w[wi];
+    dw[wi] += dy[yi] * x[xi];
+  });
+
+  singa::Tensor out = conv.Forward(singa::kTrain, in);
+  ASSERT_EQ(y.size(), out.Size());
+  const float* yptr = out.data<float>();
+  for (size_t i = 0; i < y.size(); i++) EXPECT_NEAR(y[i], yptr[i], 1e-4f);
+
+  auto ret = conv.Backward(singa::kTrain, grad);
+  const float* dxptr = ret.first.data<float>();
+  for (size_t i = 0; i < dx.size(); i++) EXPECT_NEAR(dx[i], dxptr[i], 1e-4f);
+  const float* dwptr = ret.second[0].data<float>();
+  for (size_t i = 0; i < dw.size(); i++) EXPECT_NEAR(dw[i], dwptr[i], 1e-3f);
+}
+
+TEST(Convolution, Winograd) {
+  // 3x3 kernels with stride 1, odd and even output sizes
+  CheckConv(ConvRef(3, 4, 7, 6, 5, 3, 3, 1, 1, 1, 1), singa::defaultDevice);
+  CheckConv(ConvRef(2, 3, 6, 5, 2, 3, 3, 0, 2, 1, 1), singa::defaultDevice);
+}
+
+TEST(Convolution, Im2colGroups) {
+  auto dev = std::make_shared<singa::CppCPU>(4);
+  CheckConv(ConvRef(5, 3, 9, 8, 4, 5, 3, 2, 1, 2, 1), dev);
+  CheckConv(ConvRef(2, 2, 6, 7, 3, 2, 2, 0, 0, 1, 3), dev);
+}
 #endif  // USE_CBLAS
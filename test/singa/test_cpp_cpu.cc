@@ -19,8 +19,10 @@
 *
 *************************************************************/
 
+#include <cstring>
 #include "gtest/gtest.h"
 #include  "singa/core/device.h"
+#include "singa/core/tensor.h"
 #include "singa/proto/core.pb.h"
 
 using singa::CppCPU;
@@ -70,3 +72,58 @@ TEST(CppCPU, CopyData) {
   dev.FreeBlock(c);
 }
 
+
+TEST(CppCPU, ExecutorContexts) {
+  CppCPU dev(3);
+  EXPECT_NE(dev.context(0), dev.context(1));
+  EXPECT_NE(dev.context(1), dev.context(2));
+  EXPECT_NE(nullptr, dev.context(0)->thread_pool);
+  EXPECT_EQ(dev.context(0)->thread_pool, dev.context(2)->thread_pool);
+  // the default device runs every operation by the caller only
+  CppCPU sync_dev;
+  EXPECT_EQ(nullptr, sync_dev.context(0)->thread_pool);
+}
+
+TEST(CppCPU, GetAllocatedMem) {
+  CppCPU dev;
+  EXPECT_EQ(0u, dev.GetAllocatedMem());
+  Block* b = dev.NewBlock(1000);
+  EXPECT_EQ(1024u, dev.GetAllocatedMem());
+  dev.FreeBlock(b);
+  EXPECT_EQ(0u, dev.GetAllocatedMem());
+}
+
+TEST(CppCPU, NewBlockZero) {
+  CppCPU dev;
+  Block* b = dev.NewBlock(1000);
+  memset(b->mutable_data(), 1, 1000);
+  dev.FreeBlock(b);
+  // the freed memory is reused, and cleared on request only
+  b = dev.NewBlock(1000, true);
+  const char* ptr = static_cast<const char*>(b->mutable_data());
+  int nonzero = 0;
+  for (int i = 0; i < 1000; i++) nonzero += ptr[i] != 0;
+  EXPECT_EQ(0, nonzero);
+  dev.FreeBlock(b);
+}
+
+TEST(CppCPU, VirtualMemory) {
+  auto dev = std::make_shared<CppCPU>();
+  dev->EnableVirtualMemory();
+  singa::Tensor x(singa::Shape{4}, dev);
+  x.SetValue(1.0f);
+  for (int iter = 0; iter < 3; iter++) {
+    dev->StartIteration();
+    {
+      singa::Tensor y = x * 2.0f;
+      singa::Tensor z = y + x;
+      singa::Tensor w = z * z;
+      const float* wptr = w.data<float>();
+      for (int i = 0; i < 4; i++) EXPECT_FLOAT_EQ(9.0f, wptr[i]);
+    }
+    dev->EndIteration();
+    if (iter > 0) {
+      EXPECT_EQ(3u, dev->vm()->num_arena_allocs());
+    }
+  }
+}
@@ -24,6 +24,9 @@
 #include "gtest/gtest.h"
 #include <sstream>
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
 
 using singa::Shape;
 using singa::Tensor;
@@ -58,3 +61,67 @@ TEST(CSV, EncoderDecode) {
   for (size_t i = 0; i < size; i++) EXPECT_EQ(in_data[i], out_data[i]);
   EXPECT_EQ(in_label, out_label[0]);
 }
+
+TEST(CSV, DecodeInto) {
+  singa::CSVDecoder decoder;
+  singa::DecoderConf conf;
+  conf.set_has_label(true);
+  decoder.Setup(conf);
+  std::vector<Tensor> batch{Tensor(Shape{2, 3}), Tensor(Shape{2}, singa::kInt)};
+  std::string row0 = "7,1.5,-2e3,0.25", row1 = "3, 4 ,5,  6\r";
+  decoder.DecodeInto(row0.data(), row0.size(), 0, &batch);
+  decoder.DecodeInto(row1.data(), row1.size(), 1, &batch);
+  const float* x = batch[0].data<float>();
+  const int* y = batch[1].data<int>();
+  EXPECT_FLOAT_EQ(1.5f, x[0]);
+  EXPECT_FLOAT_EQ(-2000.0f, x[1]);
+  EXPECT_FLOAT_EQ(0.25f, x[2]);
+  EXPECT_FLOAT_EQ(4.0f, x[3]);
+  EXPECT_FLOAT_EQ(6.0f, x[5]);
+  EXPECT_EQ(7, y[0]);
+  EXPECT_EQ(3, y[1]);
+}
+
+TEST(CSV, DecodeFile) {
+  // row i is "i % 10, i * 0.125, -i, i * 1e-3, 1.0000001e25" with blank lines
+  const char* path = "./csv_test.csv";
+  const int kRows = 100000;
+  {
+    std::ofstream fout(path);
+    fout.precision(10);
+    for (int i = 0; i < kRows; i++) {
+      fout << i % 10 << "," << i * 0.125 << ",-" << i << "," << i << "e-3,"
+           << "1.0000001e25\r\n";
+      if (i % 1000 == 0) fout << "\n";
+    }
+  }
+  singa::CSVDecoder decoder;
+  singa::DecoderConf conf;
+  conf.set_has_label(true);
+  decoder.Setup(conf);
+  auto dev = std::make_shared<singa::CppCPU>(4);
+  std::vector<Tensor> out = decoder.DecodeFile(path, dev);
+  remove(path);
+  ASSERT_EQ(2u, out.size());
+  ASSERT_EQ(static_cast<size_t>(kRows), out[0].shape(0));
+  ASSERT_EQ(4u, out[0].shape(1));
+  ASSERT_EQ(static_cast<size_t>(kRows), out[1].shape(0));
+  const float* x = out[0].data<float>();
+  const int* y = out[1].data<int>();
+  for (int i = 0; i < kRows; i++) {
+    ASSERT_EQ(i % 10, y[i]);
+    ASSERT_EQ(static_cast<float>(i * 0.125), x[i * 4]);
+    ASSERT_EQ(static_cast<float>(-i), x[i * 4 + 1]);
+    ASSERT_EQ(std::strtof((std::to_string(i) + "e-3").c_str(), nullptr),
+              x[i * 4 + 2]);
+    ASSERT_EQ(1.0000001e25f, x[i * 4 + 3]);
+  }
+
+  // the same values as decoding row by row
+  std::string text = "1,2.5,3\n\n-1,4,1e-30\n";
+  std::vector<Tensor> block = decoder.DecodeBlock(text.data(), text.size());
+  ASSERT_EQ(2u, block[0].shape(0));
+  std::vector<Tensor> row = decoder.Decode("-1,4,1e-30");
+  EXPECT_EQ(row[0].data<float>()[1], block[0].data<float>()[3]);
+  EXPECT_EQ(-1, block[1].data<int>()[1]);
+}
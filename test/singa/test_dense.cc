@@ -36,6 +36,28 @@ TEST(Dense, Setup) {
   EXPECT_EQ(3u, dense.num_output());
   EXPECT_EQ(2u, dense.num_input());
 }
+
+TEST(Dense, AsType) {
+  Dense dense;
+  singa::LayerConf conf;
+  conf.mutable_dense_conf()->set_num_output(3);
+  dense.Setup(Shape{2}, conf);
+  const float we[6] = {1.0f, -1.5f, 0.25f, 2.0f, 0.0f, 1.0f};
+  singa::Tensor weight(singa::Shape{2, 3});
+  weight.CopyDataFromHostPtr(we, 6);
+  singa::Tensor bias(singa::Shape{3});
+  bias.SetValue(0.5f);
+  dense.set_weight(weight);
+  dense.set_bias(bias);
+
+  dense.AsType(singa::kFloat16);
+  for (const auto& p : dense.param_values())
+    EXPECT_EQ(singa::kFloat16, p.data_type());
+  dense.AsType(singa::kFloat32);
+  const float* wptr = dense.weight().data<float>();
+  for (int i = 0; i < 6; i++) EXPECT_FLOAT_EQ(we[i], wptr[i]);
+  EXPECT_FLOAT_EQ(0.5f, dense.bias().data<float>()[2]);
+}
 #ifdef USE_CBLAS
 TEST(Dense, ForwardCpp) {
   Dense dense;
@@ -133,6 +155,38 @@ TEST(Dense, BackwardCpp) {
   for (int i = 0; i < 3; i++)
     EXPECT_FLOAT_EQ((dy[0 * 3 + i] + dy[1 * 3 + i] + dy[2 * 3 + i]), dbiasx[i]);
 }
+
+TEST(Dense, AsTypeForwardCpp) {
+  Dense dense;
+  singa::LayerConf conf;
+  conf.mutable_dense_conf()->set_num_output(3);
+  dense.Setup(Shape{2}, conf);
+  const float we[6] = {1.0f, -1.5f, 0.25f, 2.0f, 0.0f, 1.0f};
+  singa::Tensor weight(singa::Shape{2, 3});
+  weight.CopyDataFromHostPtr(we, 6);
+  singa::Tensor bias(singa::Shape{3});
+  bias.SetValue(0.5f);
+  dense.set_weight(weight);
+  dense.set_bias(bias);
+  dense.AsType(singa::kFloat16);
+
+  const float x[2] = {2.0f, 1.0f};
+  singa::Tensor in(singa::Shape{1, 2});
+  in.CopyDataFromHostPtr(x, 2);
+  for (int k = 0; k < 2; k++) {
+    singa::Tensor out = dense.Forward(singa::kEval, in);
+    EXPECT_EQ(singa::kFloat32, out.data_type());
+    for (int j = 0; j < 3; j++)
+      EXPECT_FLOAT_EQ(x[0] * we[j] + x[1] * we[3 + j] + 0.5f,
+                      out.data<float>()[j]);
+  }
+  // the parameters are converted again once they are set
+  bias.SetValue(1.0f);
+  bias.AsType(singa::kFloat16);
+  dense.set_bias(bias);
+  singa::Tensor out = dense.Forward(singa::kEval, in);
+  EXPECT_FLOAT_EQ(x[0] * we[0] + x[1] * we[3] + 1.0f, out.data<float>()[0]);
+}
 #endif  // USE_CBLAS
 
 #ifdef USE_CUDA
@@ -0,0 +1,146 @@
+/************************************************************
+*
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an
+* "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+* KIND, either express or implied.  See the License for the
+* specific language governing permissions and limitations
+* under the License.
+*
+*************************************************************/
+
+#include "singa/singa_config.h"
+#ifdef ENABLE_DIST
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "singa/model/updater.h"
+#include "gtest/gtest.h"
+
+using singa::Tensor;
+
+namespace {
+// every process listens on its own loopback address
+const std::vector<std::string> kServers = {"127.0.0.11", "127.0.0.12"};
+const std::vector<std::string> kWorkers = {"127.0.0.21", "127.0.0.22"};
+const std::vector<std::string> kParams = {"w1", "b1", "w2", "b2"};
+const int kSteps = 3;
+const float kLR = 0.1f;
+
+int RunServer(int port, size_t id, int staleness) {
+  singa::NetworkThread net(port, kServers[id]);
+  singa::SGD sgd;
+  sgd.SetLearningRateGenerator([](int step) { return kLR; });
+  singa::ParamServer server(&sgd, &net, kWorkers, staleness);
+  server.Run();
+  return 0;
+}
+
+// worker i pushes gradients of i + 1 for all parameters, which start from 1
+int RunWorker(int port, size_t id, int staleness) {
+  singa::NetworkThread net(port, kWorkers[id]);
+  singa::SGD sgd;
+  singa::DistUpdater updater(&sgd, &net, kServers);
+  std::vector<Tensor> values;
+  for (const auto& name : kParams) {
+    updater.Register(name, singa::ParamSpec());
+    values.push_back(Tensor(singa::Shape{5}));
+    values.back().SetValue(1.0f);
+  }
+  Tensor grad(singa::Shape{5});
+  grad.SetValue(id + 1.0f);
+
+  int failed = 0;
+  auto check = [&failed](const Tensor& value, float low, float high) {
+    const float* x = value.data<float>();
+    for (size_t i = 0; i < value.Size(); i++) {
+      if (x[i] < low - 1e-5f || x[i] > high + 1e-5f) {
+        LOG(ERROR) << "Value " << x[i] << " is out of [" << low << ", "
+                   << high << "]";
+        failed++;
+      }
+    }
+  };
+  for (int step = 0; step < kSteps; step++) {
+    for (size_t k = 0; k < kParams.size(); k++) {
+      updater.Apply(step, kParams[k], grad, values[k]);
+      if (staleness < 0) {
+        // the average gradient is 1.5
+        float expected = 1.0f - kLR * 1.5f * (step + 1);
+        check(values[k], expected, expected);
+      }
+    }
+  }
+  for (size_t k = 0; k < kParams.size(); k++) {
+    if (staleness < 0) {
+      Tensor value(singa::Shape{5});
+      updater.Pull(kParams[k], value);
+      check(value, 1.0f - kLR * 1.5f * kSteps, 1.0f - kLR * 1.5f * kSteps);
+    } else {
+      // all gradients of this worker and at least kSteps - staleness of the
+      // other one are applied
+      float own = kLR * (id + 1) * kSteps, other = kLR * (2 - id);
+      check(values[k], 1.0f - own - other * kSteps,
+            1.0f - own - other * (kSteps - staleness));
+    }
+  }
+  updater.Stop();
+  return failed;
+}
+
+// run the servers and workers in child processes; return the number of
+// processes that fail
+int RunAll(int port, int staleness) {
+  std::vector<pid_t> pids;
+  for (size_t i = 0; i < kServers.size() + kWorkers.size(); i++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      int ret = i < kServers.size()
+                    ? RunServer(port, i, staleness)
+                    : RunWorker(port, i - kServers.size(), staleness);
+      _exit(ret == 0 ? 0 : 1);
+    }
+    pids.push_back(pid);
+  }
+  int failed = 0;
+  for (int t = 0; t < 600 && !pids.empty(); t++) {
+    for (auto it = pids.begin(); it != pids.end();) {
+      int status;
+      if (waitpid(*it, &status, WNOHANG) == *it) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+        it = pids.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    usleep(100000);
+  }
+  for (pid_t pid : pids) {
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    failed++;
+  }
+  return failed;
+}
+}  // namespace
+
+TEST(DistUpdater, Sync) {
+  EXPECT_EQ(0, RunAll(20000 + getpid() % 20000, -1));
+}
+
+TEST(DistUpdater, BoundedStaleness) {
+  EXPECT_EQ(0, RunAll(20001 + getpid() % 20000, 1));
+}
+#endif  // ENABLE_DIST
@@ -0,0 +1,239 @@
+/************************************************************
+*
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an
+* "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+* KIND, either express or implied.  See the License for the
+* specific language governing permissions and limitations
+* under the License.
+*
+*************************************************************/
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "singa/model/feed_forward_net.h"
+#include "gtest/gtest.h"
+
+using singa::Shape;
+using singa::Tensor;
+
+namespace {
+// layers of 4 -> 3 -> 3 -> 2, whose parameters are set to distinct constants
+void AddLayers(singa::FeedForwardNet* net) {
+  const std::vector<size_t> dims = {4, 3, 3, 2};
+  float v = 0.0f;
+  for (size_t i = 0; i + 1 < dims.size(); i++) {
+    singa::LayerConf conf;
+    conf.set_name("fc" + std::to_string(i));
+    conf.set_type("singa_dense");
+    conf.mutable_dense_conf()->set_num_output(dims[i + 1]);
+    for (const std::string suffix : {"_w", "_b"}) {
+      auto spec = conf.add_param();
+      spec->set_name(conf.name() + suffix);
+      spec->mutable_filler()->set_type("constant");
+      spec->mutable_filler()->set_value(v += 0.05f);
+    }
+    Shape in{dims[i]};
+    net->Add(conf, &in);
+  }
+}
+
+// a convolution layer of 3 filters, whose weights are random
+singa::LayerConf ConvConf(const std::string& name, size_t kernel, size_t pad,
+                          size_t stride) {
+  singa::LayerConf conf;
+  conf.set_name(name);
+  conf.set_type("singacpp_convolution");
+  auto conv_conf = conf.mutable_convolution_conf();
+  conv_conf->add_kernel_size(kernel);
+  conv_conf->add_pad(pad);
+  conv_conf->add_stride(stride);
+  conv_conf->set_num_output(3);
+  auto w = conf.add_param();
+  w->set_name(name + "_w");
+  w->mutable_filler()->set_type("gaussian");
+  w->mutable_filler()->set_std(0.2f);
+  auto b = conf.add_param();
+  b->set_name(name + "_b");
+  b->mutable_filler()->set_value(0.1f);
+  return conf;
+}
+
+// conv 3x3 (Winograd), batchnorm, conv 2x2 of stride 2 (im2col), flatten and
+// dense layers over 2x6x6 images
+void AddConvLayers(singa::FeedForwardNet* net) {
+  Shape in{2, 6, 6};
+  net->Add(ConvConf("conv0", 3, 1, 1), &in);
+  singa::LayerConf bn;
+  bn.set_name("bn");
+  bn.set_type("singacpp_batchnorm");
+  // scale, bias, running mean and running variance
+  for (const float v : {1.5f, 0.2f, 0.1f, 2.0f}) {
+    auto spec = bn.add_param();
+    spec->set_name("bn" + std::to_string(bn.param_size()));
+    spec->mutable_filler()->set_value(v);
+  }
+  net->Add(bn);
+  net->Add(ConvConf("conv1", 2, 0, 2));
+  singa::LayerConf flat;
+  flat.set_name("flat");
+  flat.set_type("singacpp_flatten");
+  net->Add(flat);
+  singa::LayerConf dense;
+  dense.set_name("fc");
+  dense.set_type("singa_dense");
+  dense.mutable_dense_conf()->set_num_output(2);
+  for (const std::string suffix : {"_w", "_b"}) {
+    auto spec = dense.add_param();
+    spec->set_name(dense.name() + suffix);
+    spec->mutable_filler()->set_value(0.05f);
+  }
+  net->Add(dense);
+}
+
+// a batch of 'n' samples, whose label is 1 if the first feature is positive
+std::pair<Tensor, Tensor> Batch(int b, size_t n) {
+  std::vector<float> x(n * 4);
+  std::vector<int> y(n);
+  for (size_t i = 0; i < x.size(); i++)
+    x[i] = static_cast<float>((i * 7 + b * 3) % 11) / 5.0f - 1.0f;
+  for (size_t i = 0; i < n; i++) y[i] = x[i * 4] > 0;
+  Tensor tx(Shape{n, 4}), ty(Shape{n}, singa::defaultDevice, singa::kInt);
+  tx.CopyDataFromHostPtr(x.data(), x.size());
+  ty.CopyDataFromHostPtr(y.data(), y.size());
+  return std::make_pair(tx, ty);
+}
+
+// train 'net' over 3 batches
+void Train(singa::FeedForwardNet* net) {
+  for (int b = 0; b < 3; b++) {
+    auto batch = Batch(b, 8);
+    net->TrainOnBatch(0, batch.first, batch.second);
+  }
+}
+
+int CountDiff(const singa::FeedForwardNet& a, const singa::FeedForwardNet& b) {
+  auto x = a.GetParamValues(), y = b.GetParamValues();
+  int diff = 0;
+  for (size_t k = 0; k < x.size(); k++)
+    for (size_t i = 0; i < x[k].Size(); i++)
+      if (std::abs(x[k].data<float>()[i] - y[k].data<float>()[i]) > 1e-5f)
+        diff++;
+  return diff;
+}
+}  // namespace
+
+TEST(FeedForwardNet, OverlapUpdate) {
+  singa::SGD sgd;
+  sgd.SetLearningRateGenerator([](int step) { return 0.1f; });
+  singa::SoftmaxCrossEntropy loss;
+  singa::Accuracy acc;
+
+  singa::FeedForwardNet base;
+  AddLayers(&base);
+  base.Compile(false, &sgd, &loss, &acc);
+  Train(&base);
+  // one bucket per layer, and one bucket for all layers
+  for (size_t bucket_size : {1u, 1u << 20}) {
+    singa::FeedForwardNet net;
+    AddLayers(&net);
+    net.OverlapUpdate(bucket_size);
+    net.Compile(false, &sgd, &loss, &acc);
+    Train(&net);
+    EXPECT_EQ(0, CountDiff(base, net)) << "bucket size " << bucket_size;
+  }
+}
+
+TEST(FeedForwardNet, OverlapLocalUpdate) {
+  singa::SGD sgd;
+  sgd.SetLearningRateGenerator([](int step) { return 0.1f; });
+  singa::SoftmaxCrossEntropy loss;
+  singa::Accuracy acc;
+
+  singa::FeedForwardNet base;
+  AddLayers(&base);
+  base.Compile(false, &sgd, &loss, &acc);
+  Train(&base);
+  // replicas trained over the same batches get the same average gradients
+  const int kNum = 2;
+  auto updater = std::make_shared<singa::LocalUpdater>(kNum, &sgd);
+  std::vector<singa::FeedForwardNet> nets(kNum);
+  // the loss and metric keep states of a batch, hence one per replica
+  std::vector<singa::SoftmaxCrossEntropy> losses(kNum);
+  std::vector<singa::Accuracy> accs(kNum);
+  std::vector<std::thread> threads;
+  for (int r = 0; r < kNum; r++) {
+    AddLayers(&nets[r]);
+    // buckets of fc2 and fc1, and of fc0
+    nets[r].OverlapUpdate(64);
+    nets[r].Compile(false, r == 0, updater, &losses[r], &accs[r]);
+  }
+  for (int r = 0; r < kNum; r++)
+    threads.push_back(std::thread([&nets, r]() { Train(&nets[r]); }));
+  for (auto& t : threads) t.join();
+  for (int r = 0; r < kNum; r++) EXPECT_EQ(0, CountDiff(base, nets[r]));
+}
+
+TEST(FeedForwardNet, AsTypeForward) {
+  singa::SGD sgd;
+  singa::SoftmaxCrossEntropy loss;
+  singa::Accuracy acc;
+  singa::FeedForwardNet net;
+  AddLayers(&net);
+  net.Compile(false, &sgd, &loss, &acc);
+  Tensor x = Batch(0, 8).first;
+  Tensor expected = net.Forward(singa::kEval, x);
+  for (auto dtype : {singa::kFloat16, singa::kBFloat16}) {
+    net.AsType(dtype);
+    for (const auto& p : net.GetParamValues()) EXPECT_EQ(dtype, p.data_type());
+    // the (fp32) input decides the type of the computation
+    Tensor y = net.Forward(singa::kEval, x);
+    ASSERT_EQ(singa::kFloat32, y.data_type());
+    ASSERT_EQ(expected.Size(), y.Size());
+    for (size_t i = 0; i < y.Size(); i++)
+      EXPECT_NEAR(expected.data<float>()[i], y.data<float>()[i], 1e-2f);
+    net.AsType(singa::kFloat32);
+  }
+}
+
+TEST(FeedForwardNet, AsTypeForwardConv) {
+  singa::SGD sgd;
+  singa::SoftmaxCrossEntropy loss;
+  singa::Accuracy acc;
+  singa::FeedForwardNet net;
+  AddConvLayers(&net);
+  net.Compile(false, &sgd, &loss, &acc);
+  const size_t n = 4;
+  std::vector<float> data(n * 2 * 6 * 6);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = static_cast<float>((i * 7) % 11) / 5.0f - 1.0f;
+  Tensor x(Shape{n, 2, 6, 6});
+  x.CopyDataFromHostPtr(data.data(), data.size());
+  Tensor expected = net.Forward(singa::kEval, x);
+  for (auto dtype : {singa::kFloat16, singa::kBFloat16}) {
+    net.AsType(dtype);
+    for (const auto& p : net.GetParamValues()) EXPECT_EQ(dtype, p.data_type());
+    Tensor y = net.Forward(singa::kEval, x);
+    ASSERT_EQ(singa::kFloat32, y.data_type());
+    ASSERT_EQ(expected.Size(), y.Size());
+    for (size_t i = 0; i < y.Size(); i++)
+      EXPECT_NEAR(expected.data<float>()[i], y.data<float>()[i], 2e-2f);
+    net.AsType(singa::kFloat32);
+  }
+  Tensor y = net.Forward(singa::kEval, x);
+  for (size_t i = 0; i < y.Size(); i++)
+    EXPECT_NEAR(expected.data<float>()[i], y.data<float>()[i], 2e-2f);
+}
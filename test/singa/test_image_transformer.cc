@@ -22,7 +22,9 @@
 #include "singa/io/transformer.h"
 #include "gtest/gtest.h"
 #include <time.h>
+#include <cmath>
 #include <iostream>
+#include <vector>
 
 // decide whether to use opencv
 // #include "singa/singa_config.h"
@@ -259,3 +261,123 @@ TEST(ImageTransformer, Mirror) {
       }
   delete[] x;
 }
+
+TEST(ImageTransformer, ApplyBatch) {
+  const size_t num = 6, channel = 3, height = 7, width = 9;
+  const size_t crop_height = 4, crop_width = 5;
+  std::vector<float> x(num * channel * height * width);
+  for (size_t i = 0; i < x.size(); i++) x[i] = (float)((i * 37) % 256);
+  singa::Tensor in(singa::Shape{num, channel, height, width});
+  in.CopyDataFromHostPtr<float>(x.data(), x.size());
+  const float mean[] = {1.f, 2.f, 3.f}, stddev[] = {2.f, 4.f, 8.f};
+
+  singa::ImageTransformer img_transformer;
+  singa::TransformerConf conf;
+  conf.set_horizontal_mirror(true);
+  conf.set_image_dim_order("CHW");
+  conf.add_crop_shape(crop_height);
+  conf.add_crop_shape(crop_width);
+  conf.set_rescale(0.5f);
+  conf.set_featurewise_center(true);
+  conf.set_featurewise_std_norm(true);
+  for (size_t c = 0; c < channel; c++) {
+    conf.add_mean(mean[c]);
+    conf.add_std(stddev[c]);
+  }
+  img_transformer.Setup(conf);
+
+  // value of the (h, w) pixel of the window (oh, ow) of image n
+  auto expect = [&](size_t n, size_t c, size_t oh, size_t ow, bool flip,
+                    size_t h, size_t w) {
+    size_t sw = ow + (flip ? crop_width - 1 - w : w);
+    float v = x[((n * channel + c) * height + oh + h) * width + sw];
+    return (v * 0.5f - mean[c]) / stddev[c];
+  };
+
+  singa::Tensor out = img_transformer.Apply(singa::kEval, in);
+  ASSERT_EQ(4u, out.nDim());
+  EXPECT_EQ(num, out.shape(0));
+  EXPECT_EQ(crop_height, out.shape(2));
+  EXPECT_EQ(crop_width, out.shape(3));
+  const float* y = out.data<float>();
+  for (size_t n = 0; n < num; n++)
+    for (size_t c = 0; c < channel; c++)
+      for (size_t h = 0; h < crop_height; h++)
+        for (size_t w = 0; w < crop_width; w++)
+          EXPECT_NEAR(expect(n, c, 1, 2, false, h, w),
+                      y[((n * channel + c) * crop_height + h) * crop_width + w],
+                      1e-5);
+
+  // every image is some (mirrored) window of the input
+  out = img_transformer.Apply(singa::kTrain, in);
+  y = out.data<float>();
+  for (size_t n = 0; n < num; n++) {
+    bool found = false;
+    for (size_t oh = 0; oh + crop_height <= height && !found; oh++)
+      for (size_t ow = 0; ow + crop_width <= width && !found; ow++)
+        for (int flip = 0; flip < 2 && !found; flip++) {
+          bool match = true;
+          for (size_t c = 0; c < channel && match; c++)
+            for (size_t h = 0; h < crop_height && match; h++)
+              for (size_t w = 0; w < crop_width && match; w++)
+                match = std::fabs(expect(n, c, oh, ow, flip, h, w) -
+                    y[((n * channel + c) * crop_height + h) * crop_width + w])
+                    < 1e-5;
+          found = match;
+        }
+    EXPECT_TRUE(found) << "image " << n;
+  }
+}
+
+TEST(ImageTransformer, MirrorBatch) {
+  const size_t num = 2, channel = 2, height = 3, width = 11;
+  std::vector<float> x(num * height * width * channel);
+  for (size_t i = 0; i < x.size(); i++) x[i] = (float)i;
+  singa::Tensor in(singa::Shape{num, height, width, channel});
+  in.CopyDataFromHostPtr<float>(x.data(), x.size());
+  singa::Tensor out = singa::mirror(in, true, true, "HWC");
+  const float* y = out.data<float>();
+  for (size_t n = 0; n < num; n++)
+    for (size_t h = 0; h < height; h++)
+      for (size_t w = 0; w < width; w++)
+        for (size_t c = 0; c < channel; c++) {
+          size_t out_idx = ((n * height + h) * width + w) * channel + c;
+          size_t in_idx = ((n * height + height - 1 - h) * width + width - 1 -
+                           w) * channel + c;
+          EXPECT_EQ(x[in_idx], y[out_idx]);
+        }
+
+  // gray images with rows longer than a SIMD vector
+  singa::Tensor gray(singa::Shape{height, width});
+  gray.CopyDataFromHostPtr<float>(x.data(), height * width);
+  out = singa::mirror(gray, true, false, "CHW");
+  y = out.data<float>();
+  for (size_t h = 0; h < height; h++)
+    for (size_t w = 0; w < width; w++)
+      EXPECT_EQ(x[h * width + width - 1 - w], y[h * width + w]);
+}
+
+TEST(ImageTransformer, ApplyUChar) {
+  const size_t channel = 3, height = 4, width = 6;
+  std::vector<unsigned char> x(channel * height * width);
+  for (size_t i = 0; i < x.size(); i++) x[i] = (unsigned char)((i * 53) % 256);
+  singa::Tensor in(singa::Shape{height, width, channel}, singa::kUChar);
+  in.CopyDataFromHostPtr<unsigned char>(x.data(), x.size());
+
+  singa::ImageTransformer img_transformer;
+  singa::TransformerConf conf;
+  conf.set_image_dim_order("HWC");
+  conf.set_featurewise_center(true);
+  conf.add_mean(128.f);
+  conf.add_crop_shape(2u);
+  conf.add_crop_shape(4u);
+  img_transformer.Setup(conf);
+  singa::Tensor out = img_transformer.Apply(singa::kEval, in);
+  EXPECT_EQ(singa::kFloat32, out.data_type());
+  const float* y = out.data<float>();
+  for (size_t h = 0; h < 2; h++)
+    for (size_t w = 0; w < 4; w++)
+      for (size_t c = 0; c < channel; c++)
+        EXPECT_FLOAT_EQ(x[((h + 1) * width + w + 1) * channel + c] - 128.f,
+                        y[(h * 4 + w) * channel + c]);
+}
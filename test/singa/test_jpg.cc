@@ -23,6 +23,21 @@
 #include "singa/io/decoder.h"
 #include "gtest/gtest.h"
 #include <time.h>
+#include <vector>
+
+TEST(Decoder, ImageToFloat) {
+  const size_t height = 3, width = 5, channel = 3;
+  std::vector<uint8_t> hwc(height * width * channel);
+  for (size_t i = 0; i < hwc.size(); i++) hwc[i] = (uint8_t)((i * 29) % 256);
+  std::vector<float> chw(hwc.size()), same(hwc.size());
+  singa::ImageToFloat(hwc.data(), height, width, channel, true, chw.data());
+  singa::ImageToFloat(hwc.data(), height, width, channel, false, same.data());
+  for (size_t i = 0; i < height * width; i++)
+    for (size_t c = 0; c < channel; c++) {
+      EXPECT_EQ(hwc[i * channel + c], chw[c * height * width + i]);
+      EXPECT_EQ(hwc[i * channel + c], same[i * channel + c]);
+    }
+}
 
 #ifdef USE_OPENCV
 #include <opencv2/highgui/highgui.hpp>
@@ -97,4 +112,44 @@ TEST(Decoder, Decode) {
   for(size_t i = 0; i < total; i++)
     EXPECT_LE(fabs(in_pixel[i]-out_pixel[i]), 10.f);*/
 }
+
+TEST(Decoder, DecodeInto) {
+  singa::JPGEncoder encoder;
+  singa::EncoderConf encoder_conf;
+  encoder_conf.set_image_dim_order("HWC");
+  encoder.Setup(encoder_conf);
+  const size_t height = 16, width = 8, channel = 3;
+  std::vector<unsigned char> raw(height * width * channel);
+  for (size_t i = 0; i < raw.size(); i++) raw[i] = (unsigned char)(i % 251);
+  Tensor pixel(Shape{height, width, channel}, singa::kUChar),
+      label(Shape{1}, singa::kInt);
+  pixel.CopyDataFromHostPtr<unsigned char>(raw.data(), raw.size());
+  int raw_label = 3;
+  label.CopyDataFromHostPtr<int>(&raw_label, 1);
+  std::vector<Tensor> input{pixel, label};
+  std::string value = encoder.Encode(input);
+
+  for (int keep_uint8 = 0; keep_uint8 < 2; keep_uint8++) {
+    singa::JPGDecoder decoder;
+    singa::DecoderConf decoder_conf;
+    decoder_conf.set_image_dim_order("CHW");
+    decoder_conf.set_keep_uint8(keep_uint8);
+    decoder_conf.set_reduce_factor(2);
+    decoder.Setup(decoder_conf);
+    std::vector<Tensor> ref = decoder.Decode(value);
+    ASSERT_EQ(channel, ref[0].shape(0));
+    ASSERT_EQ(height / 2, ref[0].shape(1));
+    ASSERT_EQ(width / 2, ref[0].shape(2));
+
+    auto dtype = keep_uint8 ? singa::kUChar : singa::kFloat32;
+    std::vector<Tensor> batch{
+        Tensor(Shape{2, channel, height / 2, width / 2}, dtype),
+        Tensor(Shape{2, 1}, singa::kInt)};
+    decoder.DecodeInto(value.data(), value.size(), 1, &batch);
+    size_t bytes = ref[0].Size() * singa::SizeOf(dtype);
+    EXPECT_EQ(0, memcmp(ref[0].data<char>(), batch[0].data<char>() + bytes,
+                        bytes));
+    EXPECT_EQ(raw_label, batch[1].data<int>()[1]);
+  }
+}
 #endif
@@ -25,6 +25,7 @@
 #include "singa/singa_config.h"
 #include "singa/utils/timer.h"
 #include "singa/utils/cuda_utils.h"
+#include <thread>
 
 #ifdef USE_CUDA
 /*
@@ -97,3 +98,102 @@ TEST(MemPool, CompareCudaCnmem) {
   EXPECT_GE(cuda_time, cn_time);
 }
 #endif  // USE_CUDA
+
+TEST(CppMemPool, ReuseSizeClass) {
+  singa::CppMemPool pool;
+  void *p1 = nullptr, *p2 = nullptr;
+  pool.Malloc(&p1, 1000);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(p1) % 64);
+  auto usage = pool.GetMemUsage();
+  EXPECT_EQ(0u, usage.first);
+  EXPECT_EQ(1024u, usage.second);
+  pool.Free(p1);
+  EXPECT_EQ(1024u, pool.GetMemUsage().first);
+  // 900 and 1000 bytes fall into the same size class
+  pool.Malloc(&p2, 900);
+  EXPECT_EQ(p1, p2);
+  EXPECT_EQ(0u, pool.GetMemUsage().first);
+  pool.Free(p2);
+  pool.ReleaseCache();
+  EXPECT_EQ(0u, pool.GetMemUsage().second);
+}
+
+TEST(CppMemPool, MaxCacheSize) {
+  singa::CppMemPool pool(256);
+  void *p1 = nullptr, *p2 = nullptr;
+  pool.Malloc(&p1, 200);
+  pool.Malloc(&p2, 200);
+  pool.Free(p1);
+  pool.Free(p2);
+  EXPECT_EQ(256u, pool.GetMemUsage().first);
+}
+
+TEST(CppMemPool, CrossThreadFree) {
+  singa::CppMemPool pool;
+  void* ptr = nullptr;
+  pool.Malloc(&ptr, 4096);
+  std::thread t([&pool, ptr]() { pool.Free(ptr); });
+  t.join();
+  // cached by the shard of the other thread
+  void* ptr2 = nullptr;
+  pool.Malloc(&ptr2, 4096);
+  EXPECT_EQ(ptr, ptr2);
+  pool.Free(ptr2);
+}
+
+TEST(VirtualMemory, ReuseDisjointLifetimes) {
+  singa::VirtualMemory vm([](size_t size) { return malloc(size); },
+                          [](void* ptr) { free(ptr); });
+  void *a, *b, *c;
+  for (int iter = 0; iter < 3; iter++) {
+    vm.StartIteration();
+    a = vm.Malloc(100);
+    b = vm.Malloc(200);
+    vm.Free(a);
+    c = vm.Malloc(100);
+    vm.Free(b);
+    vm.Free(c);
+    vm.EndIteration();
+    if (iter == 0) {
+      // recorded iteration
+      EXPECT_EQ(0u, vm.num_arena_allocs());
+      // 'a' and 'c' share one range
+      EXPECT_EQ(384u, vm.arena_size());
+    } else {
+      EXPECT_EQ(3u, vm.num_arena_allocs());
+      EXPECT_EQ(a, c);
+      EXPECT_NE(a, b);
+    }
+  }
+}
+
+TEST(VirtualMemory, Replan) {
+  singa::VirtualMemory vm([](size_t size) { return malloc(size); },
+                          [](void* ptr) { free(ptr); });
+  // allocated before the iteration and freed within it
+  void* p = vm.Malloc(64);
+  vm.StartIteration();
+  void* a = vm.Malloc(128);
+  vm.Free(p);
+  vm.Free(a);
+  vm.EndIteration();
+  EXPECT_EQ(128u, vm.arena_size());
+
+  // a different size drops the plan
+  vm.StartIteration();
+  a = vm.Malloc(1000);
+  vm.Free(a);
+  vm.EndIteration();
+  EXPECT_EQ(0u, vm.num_arena_allocs());
+  // recorded again
+  vm.StartIteration();
+  a = vm.Malloc(1000);
+  vm.Free(a);
+  vm.EndIteration();
+  EXPECT_EQ(1024u, vm.arena_size());
+  vm.StartIteration();
+  a = vm.Malloc(1000);
+  EXPECT_EQ(1u, vm.num_arena_allocs());
+  vm.Free(a);
+  vm.EndIteration();
+}
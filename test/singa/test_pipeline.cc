@@ -0,0 +1,111 @@
+/************************************************************
+*
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an
+* "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+* KIND, either express or implied.  See the License for the
+* specific language governing permissions and limitations
+* under the License.
+*
+*************************************************************/
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "singa/io/pipeline.h"
+#include "gtest/gtest.h"
+
+using singa::Tensor;
+
+namespace {
+class Double : public singa::Transformer {
+ public:
+  Tensor Apply(int flag, Tensor& input) override { return input * 2.0f; }
+};
+}  // namespace
+
+class TestDataPipeline : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    // line i is "label i, i, i + 0.5, -i"
+    std::ofstream fout(path);
+    for (int i = 0; i < kNum; i++)
+      fout << i << "," << i << "," << i + 0.5f << "," << -i << "\n";
+    fout.close();
+    singa::DecoderConf conf;
+    conf.set_has_label(true);
+    decoder.Setup(conf);
+    reader.Open(path);
+  }
+  virtual void TearDown() {
+    reader.Close();
+    remove(path);
+  }
+  // check the batch of samples [start, start + size)
+  void CheckBatch(const std::vector<Tensor>& batch, int start, size_t size,
+                  float scale) {
+    ASSERT_EQ(2u, batch.size());
+    ASSERT_EQ(size, batch[0].shape(0));
+    ASSERT_EQ(3u, batch[0].shape(1));
+    ASSERT_EQ(size, batch[1].shape(0));
+    EXPECT_EQ(singa::kInt, batch[1].data_type());
+    const float* x = batch[0].data<float>();
+    const int* y = batch[1].data<int>();
+    for (size_t i = 0; i < size; i++) {
+      int id = start + static_cast<int>(i);
+      EXPECT_EQ(id, y[i]);
+      EXPECT_FLOAT_EQ(scale * id, x[i * 3]);
+      EXPECT_FLOAT_EQ(scale * (id + 0.5f), x[i * 3 + 1]);
+      EXPECT_FLOAT_EQ(-scale * id, x[i * 3 + 2]);
+    }
+  }
+
+  const char* path = "./pipeline_test.csv";
+  const int kNum = 22;
+  singa::io::TextFileReader reader;
+  singa::CSVDecoder decoder;
+};
+
+TEST_F(TestDataPipeline, Batches) {
+  singa::DataPipeline pipeline(&reader, &decoder, nullptr, 4, 3, 2);
+  for (int epoch = 0; epoch < 2; epoch++) {
+    pipeline.Start();
+    std::vector<Tensor> batch;
+    int start = 0;
+    while (pipeline.Next(&batch)) {
+      size_t size = std::min(4, kNum - start);
+      CheckBatch(batch, start, size, 1.0f);
+      start += static_cast<int>(size);
+    }
+    EXPECT_EQ(kNum, start);
+    EXPECT_FALSE(pipeline.Next(&batch));
+  }
+}
+
+TEST_F(TestDataPipeline, TransformStopEarly) {
+  Double transformer;
+  singa::DataPipeline pipeline(&reader, &decoder, &transformer, 5, 1, 1);
+  pipeline.Start(singa::kEval);
+  std::vector<Tensor> batch;
+  EXPECT_TRUE(pipeline.Next(&batch));
+  CheckBatch(batch, 0, 5, 2.0f);
+  EXPECT_TRUE(pipeline.Next(&batch));
+  CheckBatch(batch, 5, 5, 2.0f);
+  pipeline.Stop();
+  EXPECT_FALSE(pipeline.Next(&batch));
+
+  pipeline.Start();
+  EXPECT_TRUE(pipeline.Next(&batch));
+  CheckBatch(batch, 0, 5, 2.0f);
+}
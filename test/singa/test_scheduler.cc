@@ -0,0 +1,129 @@
+/************************************************************
+*
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an
+* "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+* KIND, either express or implied.  See the License for the
+* specific language governing permissions and limitations
+* under the License.
+*
+*************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "gtest/gtest.h"
+#include "singa/core/scheduler.h"
+#include "singa/core/tensor.h"
+
+using singa::Block;
+using singa::Context;
+using singa::Scheduler;
+
+namespace {
+Scheduler::ExecFn RunWith(Context* ctx) {
+  return [ctx](std::function<void(Context*)>&& fn, int executor) {
+    fn(ctx);
+  };
+}
+}  // namespace
+
+TEST(Scheduler, ReadAfterWrite) {
+  Context ctx;
+  Scheduler sched(4, RunWith(&ctx));
+  Block b(nullptr, 4);
+  std::vector<int> order;
+  for (int i = 0; i < 20; i++) {
+    sched.Submit([&order, i](Context* ctx) {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      order.push_back(i);
+    }, {&b}, {&b});
+  }
+  sched.Wait();
+  EXPECT_EQ(0u, sched.num_pending());
+  ASSERT_EQ(20u, order.size());
+  for (int i = 0; i < 20; i++) EXPECT_EQ(i, order[i]);
+}
+
+TEST(Scheduler, WriteAfterRead) {
+  Context ctx;
+  Scheduler sched(4, RunWith(&ctx));
+  Block a(nullptr, 4), b(nullptr, 4);
+  std::atomic<int> nread(0);
+  int seen = -1;
+  for (int i = 0; i < 3; i++) {
+    sched.Submit([&nread](Context* ctx) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      nread++;
+    }, {&a}, {});
+  }
+  // the write on 'a' must wait for all three reads
+  sched.Submit([&nread, &seen](Context* ctx) { seen = nread; }, {&b}, {&a});
+  sched.Wait();
+  EXPECT_EQ(3, seen);
+}
+
+TEST(Scheduler, IndependentOpsRunConcurrently) {
+  Context ctx;
+  Scheduler sched(2, RunWith(&ctx));
+  Block a(nullptr, 4), b(nullptr, 4);
+  std::atomic<int> arrived(0);
+  std::atomic<bool> overlapped(true);
+  auto op = [&arrived, &overlapped](Context* ctx) {
+    arrived++;
+    auto start = std::chrono::steady_clock::now();
+    // each op waits for the other; it would time out if run serially.
+    while (arrived < 2) {
+      if (std::chrono::steady_clock::now() - start > std::chrono::seconds(2)) {
+        overlapped = false;
+        break;
+      }
+    }
+  };
+  sched.Submit(op, {}, {&a});
+  sched.Submit(op, {}, {&b});
+  sched.Wait();
+  EXPECT_TRUE(overlapped);
+}
+
+TEST(Scheduler, AsyncCppCPU) {
+  auto dev = std::make_shared<singa::CppCPU>(4);
+  EXPECT_TRUE(dev->async());
+  singa::Tensor x(singa::Shape{2, 3}, dev), y(singa::Shape{2, 3}, dev);
+  const float dat[] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f};
+  x.CopyDataFromHostPtr(dat, 6);
+  y.SetValue(2.0f);
+  // two independent branches joined by the last Add
+  singa::Tensor p = x * y, q = x + y;
+  singa::Tensor z = p + q;
+  z += 1.0f;
+  dev->Sync();
+  const float* zptr = z.data<float>();
+  for (int i = 0; i < 6; i++)
+    EXPECT_FLOAT_EQ(dat[i] * 2.0f + dat[i] + 2.0f + 1.0f, zptr[i]);
+  EXPECT_FLOAT_EQ(21.0f, singa::Sum(x));
+}
+
+TEST(Scheduler, AsTypeAfterPendingWrite) {
+  auto dev = std::make_shared<singa::CppCPU>(4);
+  singa::Tensor x(singa::Shape{64}, dev), y(singa::Shape{64}, dev);
+  y.SetValue(1.5f);
+  // both conversions are ordered after the pending writes, without a Sync
+  x.CopyData(y * 2.0f);
+  x.AsType(singa::kFloat16).AsType(singa::kFloat32);
+  singa::Tensor z = x + 1.0f;
+  dev->Sync();
+  for (size_t i = 0; i < z.Size(); i++)
+    EXPECT_FLOAT_EQ(4.0f, z.data<float>()[i]);
+}
@@ -0,0 +1,130 @@
+/************************************************************
+*
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an
+* "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+* KIND, either express or implied.  See the License for the
+* specific language governing permissions and limitations
+* under the License.
+*
+*************************************************************/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "singa/io/reader.h"
+#include "singa/io/writer.h"
+#include "gtest/gtest.h"
+
+using singa::io::ShardedReader;
+
+class TestShardedReader : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    // shard i has i + 3 tuples with keys "i-j"
+    for (int i = 0; i < kShards; i++) {
+      singa::io::BinFileWriter writer;
+      writer.Open(Shard(i), singa::io::kCreate);
+      for (int j = 0; j < i + 3; j++) {
+        std::string key = std::to_string(i) + "-" + std::to_string(j);
+        writer.Write(key, "value " + key);
+        keys.push_back(key);
+      }
+      writer.Close();
+    }
+    std::sort(keys.begin(), keys.end());
+  }
+  virtual void TearDown() {
+    for (int i = 0; i < kShards; i++) remove(Shard(i).c_str());
+  }
+  std::string Shard(int i) { return "./sharded_test." + std::to_string(i); }
+  std::vector<std::string> ReadEpoch(ShardedReader* reader) {
+    std::vector<std::string> ret;
+    std::string key, value;
+    while (reader->Read(&key, &value)) {
+      EXPECT_EQ("value " + key, value);
+      ret.push_back(key);
+    }
+    return ret;
+  }
+
+  const int kShards = 5;
+  std::vector<std::string> keys;
+};
+
+TEST_F(TestShardedReader, ReadAll) {
+  ShardedReader reader(3, 2, 4);
+  EXPECT_TRUE(reader.Open("./sharded_test.*"));
+  EXPECT_EQ(5u, reader.shards().size());
+  EXPECT_EQ(25, reader.Count());
+  std::vector<std::string> got = ReadEpoch(&reader);
+  std::sort(got.begin(), got.end());
+  EXPECT_TRUE(got == keys);
+
+  // the next epoch gives the same order without shuffling
+  reader.SeekToFirst();
+  std::vector<std::string> first = ReadEpoch(&reader);
+  reader.SeekToFirst();
+  EXPECT_TRUE(first == ReadEpoch(&reader));
+  reader.Close();
+}
+
+TEST_F(TestShardedReader, Interleave) {
+  // one tuple from each thread in turn; thread 0 has shards 0 and 2
+  ShardedReader reader(2, 1, 1);
+  EXPECT_TRUE(reader.Open(std::vector<std::string>{Shard(0), Shard(1),
+                                                   Shard(2)}));
+  std::vector<std::string> got = ReadEpoch(&reader);
+  ASSERT_EQ(12u, got.size());
+  EXPECT_EQ("0-0", got[0]);
+  EXPECT_EQ("1-0", got[1]);
+  EXPECT_EQ("0-1", got[2]);
+  EXPECT_EQ("2-0", got[6]);
+  EXPECT_EQ("1-3", got[7]);
+  EXPECT_EQ("2-1", got[8]);
+  EXPECT_EQ("2-4", got[11]);
+}
+
+TEST_F(TestShardedReader, ShuffleDeterministic) {
+  ShardedReader reader1(2, 4, 3, true, 11), reader2(2, 4, 3, true, 11);
+  reader1.Open("./sharded_test.*");
+  reader2.Open("./sharded_test.*");
+  std::vector<std::vector<std::string>> epochs;
+  for (int e = 0; e < 4; e++) {
+    std::vector<std::string> got = ReadEpoch(&reader1);
+    EXPECT_TRUE(got == ReadEpoch(&reader2));
+    epochs.push_back(got);
+    std::sort(got.begin(), got.end());
+    EXPECT_TRUE(got == keys);
+    reader1.SeekToFirst();
+    reader2.SeekToFirst();
+  }
+  EXPECT_EQ(4, reader1.epoch());
+  bool differ = false;
+  for (int e = 1; e < 4; e++) differ = differ || epochs[e] != epochs[0];
+  EXPECT_TRUE(differ);
+}
+
+TEST_F(TestShardedReader, StopEarly) {
+  // the I/O threads are blocked on full queues when the epoch is stopped
+  ShardedReader reader(4, 1, 1);
+  reader.Open("./sharded_test.*");
+  std::string key, value;
+  EXPECT_TRUE(reader.Read(&key, &value));
+  reader.SeekToFirst();
+  EXPECT_EQ(25u, ReadEpoch(&reader).size());
+  EXPECT_FALSE(reader.Read(&key, &value));
+  reader.SeekToFirst();
+  EXPECT_TRUE(reader.Read(&key, &value));
+  reader.Close();
+}
@@ -22,6 +22,7 @@
 #include "gtest/gtest.h"
 #include "singa/io/snapshot.h"
 #include "singa/io/reader.h"
+#include "singa/io/writer.h"
 #include "singa/core/tensor.h"
 
 #include <string>
@@ -97,6 +98,163 @@ TEST(Snapshot, ReadIntTest) {
   }
 }
 
+TEST(Snapshot, ZeroCopyRead) {
+  const size_t n = 1 << 16;
+  std::vector<float> big(n);
+  for (size_t i = 0; i < n; i++) big[i] = static_cast<float>(i) * 0.5f;
+  {
+    singa::Snapshot snapshot(prefix + ".zc", singa::Snapshot::kWrite);
+    singa::Tensor empty, t(singa::Shape{n});
+    t.CopyDataFromHostPtr(big.data(), n);
+    singa::Tensor d(singa::Shape{4}, singa::defaultDevice, singa::kDouble);
+    d.CopyDataFromHostPtr(double_data, 4);
+    singa::Tensor m(singa::Shape{2, 2});
+    m.CopyDataFromHostPtr(param_1_data, 4);
+    snapshot.Write("odd key", d);
+    snapshot.Write("Empty", empty);
+    snapshot.Write("Big", t);
+    snapshot.Write("Transposed", singa::Transpose(m));
+  }
+  singa::Snapshot snapshot(prefix + ".zc", singa::Snapshot::kRead);
+  auto shapes = snapshot.ReadShape();
+  ASSERT_EQ(4u, shapes.size());
+  EXPECT_EQ("odd key", shapes[0].first);
+  EXPECT_EQ("Transposed", shapes[3].first);
+  EXPECT_EQ(0u, snapshot.ReadShape("Empty").size());
+  EXPECT_EQ(0u, snapshot.Read("Empty").Size());
+
+  singa::Tensor t1 = snapshot.Read("Big"), t2 = snapshot.Read("Big");
+  const float* data = t1.data<float>();
+  // both tensors are over the mapped file
+  EXPECT_EQ(data, t2.data<float>());
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(data) % 64);
+  for (size_t i = 0; i < n; i++) ASSERT_EQ(big[i], data[i]);
+
+  singa::Tensor d = snapshot.Read("odd key");
+  EXPECT_EQ(singa::kDouble, d.data_type());
+  for (size_t i = 0; i < 4; i++) EXPECT_EQ(double_data[i], d.data<double>()[i]);
+  singa::Tensor m = snapshot.Read("Transposed");
+  EXPECT_TRUE(m.transpose());
+  EXPECT_EQ(1, m.stride()[0]);
+  EXPECT_EQ(2, m.stride()[1]);
+  for (size_t i = 0; i < 4; i++)
+    EXPECT_FLOAT_EQ(param_1_data[i], m.data<float>()[i]);
+
+  // updates are private to the tensor
+  t1 += 1.0f;
+  EXPECT_EQ(big[3] + 1.0f, t2.data<float>()[3]);
+  singa::Snapshot again(prefix + ".zc", singa::Snapshot::kRead);
+  EXPECT_EQ(big[3], again.Read("Big").data<float>()[3]);
+}
+
+TEST(Snapshot, ReadProtoFormat) {
+  // written as by singa <= 1.x
+  {
+    singa::io::BinFileWriter writer;
+    writer.Open(prefix + ".pb.bin", singa::io::kCreate);
+    singa::Tensor t(singa::Shape{4});
+    t.CopyDataFromHostPtr(param_2_data, 4);
+    singa::TensorProto tp;
+    t.ToProto(&tp);
+    std::string str;
+    tp.SerializeToString(&str);
+    writer.Write("Param", str);
+    writer.Close();
+  }
+  singa::Snapshot snapshot(prefix + ".pb", singa::Snapshot::kRead);
+  EXPECT_EQ(4u, snapshot.ReadShape("Param")[0]);
+  const float* data = snapshot.Read("Param").data<float>();
+  for (size_t i = 0; i < 4; i++) EXPECT_FLOAT_EQ(param_2_data[i], data[i]);
+  EXPECT_EQ(1u, snapshot.Read().size());
+  EXPECT_EQ(data, snapshot.Read("Param").data<float>());
+}
+
+TEST(Snapshot, IndexAndReadAll) {
+  const int kNum = 50;
+  auto value = [](int k, size_t i) { return k * 100.0f + i; };
+  {
+    singa::Snapshot snapshot(prefix + ".idx", singa::Snapshot::kWrite);
+    for (int k = 0; k < kNum; k++) {
+      size_t n = 10 + 37 * k;
+      std::vector<float> data(n);
+      for (size_t i = 0; i < n; i++) data[i] = value(k, i);
+      singa::Tensor t(singa::Shape{n});
+      t.CopyDataFromHostPtr(data.data(), n);
+      snapshot.Write("p" + std::to_string(k), t);
+    }
+  }
+  auto check = [&](singa::Snapshot* snapshot) {
+    auto all = snapshot->ReadAll(4);
+    ASSERT_EQ(static_cast<size_t>(kNum), all.size());
+    for (int k = 0; k < kNum; k++) {
+      EXPECT_EQ("p" + std::to_string(k), all[k].first);
+      ASSERT_EQ(10u + 37 * k, all[k].second.Size());
+      const float* data = all[k].second.data<float>();
+      for (size_t i = 0; i < all[k].second.Size(); i++)
+        ASSERT_EQ(value(k, i), data[i]);
+      EXPECT_EQ(data, snapshot->Read(all[k].first).data<float>());
+    }
+  };
+
+  std::string bytes;
+  {
+    std::ifstream fin(prefix + ".idx.bin", std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(fin),
+                 std::istreambuf_iterator<char>());
+  }
+  // without the index, the record headers are parsed one by one
+  uint64_t index_offset;
+  memcpy(&index_offset, bytes.data() + bytes.size() - 24, sizeof(uint64_t));
+  ASSERT_LT(index_offset, bytes.size());
+  std::ofstream(prefix + ".noidx.bin", std::ios::binary)
+      << bytes.substr(0, index_offset);
+  {
+    singa::Snapshot snapshot(prefix + ".noidx", singa::Snapshot::kRead);
+    check(&snapshot);
+  }
+  // with the index, the record headers in the file are not parsed
+  bytes[8] = 'X';
+  std::ofstream(prefix + ".idx.bin", std::ios::binary) << bytes;
+  singa::Snapshot snapshot(prefix + ".idx", singa::Snapshot::kRead);
+  EXPECT_EQ(37u + 10, snapshot.ReadShape("p1")[0]);
+  check(&snapshot);
+}
+
+TEST(Snapshot, Checkpointer) {
+  auto dev = std::make_shared<singa::CppCPU>(2);
+  singa::Tensor w(singa::Shape{1000}, dev), b(singa::Shape{4}, dev, singa::kInt);
+  w.SetValue(0.0f);
+  b.CopyDataFromHostPtr(int_data, 4);
+  const std::string ckpt = prefix + ".ckpt";
+  {
+    singa::Checkpointer checkpointer(ckpt, 2);
+    for (int step = 1; step <= 4; step++) {
+      checkpointer.Save(step, {{"w", w}, {"b", b}});
+      // updates after Save() are not in the checkpoint
+      w += 1.0f;
+    }
+    checkpointer.Wait();
+    auto kept = checkpointer.checkpoints();
+    ASSERT_EQ(2u, kept.size());
+    EXPECT_EQ(ckpt + "-3", kept[0]);
+    EXPECT_EQ(ckpt + "-4", kept[1]);
+  }
+  EXPECT_FALSE(std::ifstream(ckpt + "-2.bin").good());
+  EXPECT_FALSE(std::ifstream(ckpt + "-4.tmp.bin").good());
+  for (int step = 3; step <= 4; step++) {
+    singa::Snapshot snapshot(ckpt + "-" + std::to_string(step),
+                             singa::Snapshot::kRead);
+    const float* data = snapshot.Read("w").data<float>();
+    for (size_t i = 0; i < 1000; i++) ASSERT_EQ(step - 1.0f, data[i]);
+    const int* label = snapshot.Read("b").data<int>();
+    for (size_t i = 0; i < 4; i++) EXPECT_EQ(int_data[i], label[i]);
+  }
+  for (int step = 3; step <= 4; step++) {
+    std::remove((ckpt + "-" + std::to_string(step) + ".bin").c_str());
+    std::remove((ckpt + "-" + std::to_string(step) + ".desc").c_str());
+  }
+}
+
 /*
 TEST(Snapshot, ReadDoubleTest) {
   {
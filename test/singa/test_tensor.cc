@@ -16,6 +16,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <cmath>
 #include "gtest/gtest.h"
 #include "singa/core/tensor.h"
 using singa::Tensor;
@@ -75,6 +77,75 @@ TEST(TensorClass, AsType) {
   EXPECT_EQ(singa::kFloat16, t.data_type());
 }
 
+TEST(TensorClass, AsTypeConvert) {
+  const size_t n = 37;  // not a multiple of the vector width
+  float x[n];
+  for (size_t i = 0; i < n; i++) x[i] = (i - 18.0f) * 0.75f;
+  Tensor t(Shape{n});
+  t.CopyDataFromHostPtr(x, n);
+
+  Tensor h = t;
+  h.AsType(singa::kFloat16).AsType(singa::kFloat32);
+  Tensor b = t;
+  b.AsType(singa::kBFloat16);
+  EXPECT_EQ(2 * n, b.MemSize());
+  b.AsType(singa::kDouble).AsType(singa::kFloat32);
+  Tensor c = t;
+  c.AsType(singa::kChar);
+  const float* hptr = h.data<float>();
+  const float* bptr = b.data<float>();
+  const int8_t* cptr = static_cast<const int8_t*>(c.block()->data());
+  const float* tptr = t.data<float>();
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_FLOAT_EQ(x[i], tptr[i]);  // the source is not changed
+    EXPECT_FLOAT_EQ(x[i], hptr[i]);
+    EXPECT_FLOAT_EQ(x[i], bptr[i]);
+    EXPECT_EQ(static_cast<int8_t>(std::round(x[i])), cptr[i]);
+  }
+
+  float big[3] = {1e6f, -1e6f, 2.5f};
+  Tensor s(Shape{3});
+  s.CopyDataFromHostPtr(big, 3);
+  s.AsType(singa::kChar);
+  const int8_t* sptr = static_cast<const int8_t*>(s.block()->data());
+  EXPECT_EQ(127, sptr[0]);
+  EXPECT_EQ(-128, sptr[1]);
+  EXPECT_EQ(3, sptr[2]);
+}
+
+TEST(TensorClass, AsTypeTransposed) {
+  const float x[6] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f};
+  Tensor t(Shape{2, 3});
+  t.CopyDataFromHostPtr(x, 6);
+  t.T();
+  t.AsType(singa::kFloat16);
+  EXPECT_FALSE(t.transpose());
+  t.AsType(singa::kFloat32);
+  const float* tptr = t.data<float>();
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 2; c++)
+      EXPECT_FLOAT_EQ(x[c * 3 + r], tptr[r * 2 + c]);
+}
+
+TEST(TensorClass, Quantize) {
+  const size_t n = 20;
+  float x[n];
+  for (size_t i = 0; i < n; i++) x[i] = (i - 10.0f) * 0.3f;
+  Tensor t(Shape{n});
+  t.CopyDataFromHostPtr(x, n);
+  const float scale = 3.0f / 127;
+  Tensor q = Quantize(t, scale);
+  EXPECT_EQ(singa::kChar, q.data_type());
+  Tensor d = Dequantize(q, scale);
+  const int8_t* qptr = static_cast<const int8_t*>(q.block()->data());
+  const float* dptr = d.data<float>();
+  for (size_t i = 0; i < n; i++) {
+    float e = std::min(std::max(std::round(x[i] / scale), -127.f), 127.f);
+    EXPECT_EQ(static_cast<int8_t>(e), qptr[i]);
+    EXPECT_NEAR(x[i], dptr[i], scale / 2 + 1e-6f);
+  }
+}
+
 TEST(TensorClass, ToDevice) {
   Tensor t(Shape{2, 3});
   EXPECT_EQ(singa::defaultDevice, t.device());
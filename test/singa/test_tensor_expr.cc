@@ -0,0 +1,108 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include "gtest/gtest.h"
+#include "singa/core/tensor_expr.h"
+
+using singa::Shape;
+using singa::Tensor;
+using singa::TensorExpr;
+
+class TestTensorExpr : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    x.CopyDataFromHostPtr(dx, 6);
+    row.CopyDataFromHostPtr(drow, 3);
+    col.CopyDataFromHostPtr(dcol, 2);
+  }
+  const float dx[6] = {1.0f, -2.0f, 3.0f, 4.0f, -5.0f, 6.0f};
+  const float drow[3] = {0.5f, 1.0f, 2.0f};
+  const float dcol[2] = {2.0f, 4.0f};
+  Tensor x{Shape{2, 3}}, row{Shape{3}}, col{Shape{2}};
+};
+
+TEST_F(TestTensorExpr, Elementwise) {
+  TensorExpr e = (Abs(TensorExpr(x)) * 2.0f + x) / 4.0f - Square(x * x / x);
+  EXPECT_TRUE(e.shape() == x.shape());
+  Tensor z = e.Eval();
+  const float* zptr = z.data<float>();
+  for (int i = 0; i < 6; i++) {
+    float v = (std::fabs(dx[i]) * 2.0f + dx[i]) / 4.0f - dx[i] * dx[i];
+    EXPECT_FLOAT_EQ(v, zptr[i]);
+  }
+}
+
+TEST_F(TestTensorExpr, Scalars) {
+  Tensor z = (1.0f - ReLU(TensorExpr(x)) + (TensorExpr(2.0f) * 3.0f)).Eval();
+  Tensor c = (TensorExpr(x) > 0.0f).Eval();
+  const float* zptr = z.data<float>();
+  const float* cptr = c.data<float>();
+  for (int i = 0; i < 6; i++) {
+    EXPECT_FLOAT_EQ(1.0f - (dx[i] > 0 ? dx[i] : 0.0f) + 6.0f, zptr[i]);
+    EXPECT_FLOAT_EQ(dx[i] > 0 ? 1.0f : 0.0f, cptr[i]);
+  }
+}
+
+TEST_F(TestTensorExpr, RowColumn) {
+  // the row expression is evaluated once and broadcast
+  Tensor z = AddColumn(col, DivRow(Sqrt(TensorExpr(row)) + 1.0f,
+                                   SubRow(row, x))).Eval();
+  const float* zptr = z.data<float>();
+  for (int r = 0; r < 2; r++)
+    for (int c = 0; c < 3; c++) {
+      float v = (dx[r * 3 + c] - drow[c]) / (std::sqrt(drow[c]) + 1.0f);
+      EXPECT_FLOAT_EQ(v + dcol[r], zptr[r * 3 + c]);
+    }
+}
+
+TEST_F(TestTensorExpr, TransposedLeaf) {
+  Tensor t = x;
+  t.T();
+  Tensor z = (TensorExpr(t) * 2.0f).Eval();
+  ASSERT_EQ(3u, z.shape(0));
+  const float* zptr = z.data<float>();
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 2; c++)
+      EXPECT_FLOAT_EQ(dx[c * 3 + r] * 2.0f, zptr[r * 2 + c]);
+}
+
+TEST_F(TestTensorExpr, InPlace) {
+  (Exp(TensorExpr(x)) + x).Eval(&x);
+  const float* xptr = x.data<float>();
+  for (int i = 0; i < 6; i++)
+    EXPECT_FLOAT_EQ(std::exp(dx[i]) + dx[i], xptr[i]);
+}
+
+TEST(TensorExpr, ParallelLarge) {
+  auto dev = std::make_shared<singa::CppCPU>(4);
+  const size_t nrow = 300, ncol = 1001;
+  Tensor x(Shape{nrow, ncol}, dev), v(Shape{ncol}, dev);
+  std::vector<float> dx(nrow * ncol), dv(ncol);
+  for (size_t i = 0; i < dx.size(); i++) dx[i] = (i % 97) * 0.1f;
+  for (size_t i = 0; i < ncol; i++) dv[i] = (i % 13) * 0.5f;
+  x.CopyDataFromHostPtr(dx.data(), dx.size());
+  v.CopyDataFromHostPtr(dv.data(), dv.size());
+  Tensor z = MultRow(v, Tanh(TensorExpr(x)) + x).Eval();
+  const float* zptr = z.data<float>();
+  for (size_t r = 0; r < nrow; r++)
+    for (size_t c = 0; c < ncol; c++) {
+      float e = dx[r * ncol + c];
+      EXPECT_NEAR((std::tanh(e) + e) * dv[c], zptr[r * ncol + c], 1e-4f);
+    }
+}
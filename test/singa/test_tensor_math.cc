@@ -16,8 +16,11 @@
  * limitations under the License.
  */
 
+#include <cmath>
+#include <vector>
 #include "gtest/gtest.h"
 #include "singa/core/tensor.h"
+#include "singa/utils/half.h"
 using singa::Tensor;
 using singa::Shape;
 using singa::Device;
@@ -74,6 +77,116 @@ TEST_F(TensorMath, ExpStrideCpp) {
   EXPECT_NEAR(exp(dat1[3]), dptr1[4], 1e-5);
 }
 
+TEST_F(TensorMath, SimdTailCpp) {
+  // 37 elements cover the vector body and the scalar tail of every width
+  const size_t n = 37;
+  float dat[n];
+  for (size_t i = 0; i < n; i++) dat[i] = static_cast<float>(i) - 18.5f;
+  Tensor x(Shape{n});
+  x.CopyDataFromHostPtr(dat, n);
+  Tensor r = ReLU(x), s = Sign(x), g = x >= 0.5f, c = Abs(x);
+  const float *rptr = r.data<float>(), *sptr = s.data<float>();
+  const float *gptr = g.data<float>(), *cptr = c.data<float>();
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_FLOAT_EQ(dat[i] >= 0.f ? dat[i] : 0.f, rptr[i]);
+    EXPECT_FLOAT_EQ(static_cast<float>((dat[i] > 0) - (dat[i] < 0)), sptr[i]);
+    EXPECT_FLOAT_EQ(dat[i] >= 0.5f ? 1.f : 0.f, gptr[i]);
+    EXPECT_FLOAT_EQ(fabs(dat[i]), cptr[i]);
+  }
+}
+
+TEST_F(TensorMath, BinaryStrideCpp) {
+  float dat[35];
+  for (size_t i = 0; i < 35; i++) dat[i] = static_cast<float>(i);
+  Tensor x(Shape{5, 7}), y(Shape{7, 5});
+  x.CopyDataFromHostPtr(dat, 35);
+  y.CopyDataFromHostPtr(dat, 35);
+  Tensor z = Transpose(x) - y;
+  const float *zptr = z.data<float>();
+  for (size_t i = 0; i < 7; i++)
+    for (size_t j = 0; j < 5; j++)
+      EXPECT_FLOAT_EQ(dat[j * 7 + i] - dat[i * 5 + j], zptr[i * 5 + j]);
+
+  // rows of a broadcast tensor are contiguous
+  Tensor w = Broadcast(Reshape(x, Shape{1, 35}), Shape{3, 35});
+  Tensor v(Shape{3, 35});
+  v.SetValue(1.f);
+  Tensor u = w * v;
+  const float *uptr = u.data<float>();
+  for (size_t i = 0; i < 3; i++)
+    for (size_t j = 0; j < 35; j++)
+      EXPECT_FLOAT_EQ(dat[j], uptr[i * 35 + j]);
+}
+
+TEST_F(TensorMath, DoubleCpp) {
+  const double dat[3] = {1.0, 2.0, 1e-10};
+  Tensor x(Shape{3}, singa::kDouble);
+  x.CopyDataFromHostPtr(dat, 3);
+  Tensor y = Sqrt(x) * x + 1.0;
+  const double *yptr = y.data<double>();
+  for (size_t i = 0; i < 3; i++)
+    EXPECT_DOUBLE_EQ(sqrt(dat[i]) * dat[i] + 1.0, yptr[i]);
+}
+
+TEST_F(TensorMath, IntCpp) {
+  const int dat[6] = {0, 3, 1, 4, -1, 5};
+  Tensor x(Shape{6}, singa::kInt), y(Shape{6}, singa::kInt);
+  x.CopyDataFromHostPtr(dat, 6);
+  y.SetValue(2);
+  Tensor z = (x + 1) * y / 3, g = x > 2, m = Abs(x) - y;
+  const int *zptr = z.data<int>(), *gptr = g.data<int>(),
+            *mptr = m.data<int>();
+  for (size_t i = 0; i < 6; i++) {
+    EXPECT_EQ((dat[i] + 1) * 2 / 3, zptr[i]);
+    EXPECT_EQ(dat[i] > 2 ? 1 : 0, gptr[i]);
+    EXPECT_EQ(abs(dat[i]) - 2, mptr[i]);
+  }
+}
+
+TEST_F(TensorMath, HalfCpp) {
+  // 300 elements cover the fp16 conversion chunks and their tails
+  const size_t n = 300;
+  std::vector<singa::half> dat(n);
+  for (size_t i = 0; i < n; i++)
+    dat[i] = singa::half(static_cast<float>(i) * 0.25f - 30.0f);
+  Tensor x(Shape{n}, singa::kFloat16);
+  x.CopyDataFromHostPtr(dat.data(), n);
+  Tensor r = ReLU(x) + 0.5f, s = Exp(x * 0.1f), t = Transpose(
+      Reshape(x, Shape{20, 15})) - 1.0f;
+  const singa::half *rptr = r.data<singa::half>(),
+                    *sptr = s.data<singa::half>(),
+                    *tptr = t.data<singa::half>();
+  for (size_t i = 0; i < n; i++) {
+    float v = dat[i];
+    // scalars are converted to fp16; every op rounds its result once
+    EXPECT_EQ(singa::half(std::max(v, 0.f) + 0.5f).bits, rptr[i].bits);
+    float e = exp(static_cast<float>(singa::half(v * singa::half(0.1f))));
+    EXPECT_NEAR(e, sptr[i], 1e-3f * e);
+  }
+  for (size_t i = 0; i < 15; i++)
+    for (size_t j = 0; j < 20; j++)
+      EXPECT_FLOAT_EQ(dat[j * 15 + i] - 1.0f, tptr[i * 20 + j]);
+}
+
+TEST_F(TensorMath, HalfConversion) {
+  const float dat[] = {0.f, -0.f, 1.f, -2.5f, 65504.f, 65520.f, 6.1035156e-5f,
+                       5.9604645e-8f, 2.9802322e-8f, 1.0009766f, 1.0004883f};
+  const uint16_t bits[] = {0x0000, 0x8000, 0x3c00, 0xc100, 0x7bff, 0x7c00,
+                           0x0400, 0x0001, 0x0000, 0x3c01, 0x3c00};
+  const size_t n = sizeof(bits) / sizeof(bits[0]);
+  std::vector<singa::half> h(n);
+  singa::FloatToHalf(dat, h.data(), n);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_EQ(bits[i], h[i].bits) << dat[i];
+    EXPECT_EQ(bits[i], singa::half(dat[i]).bits) << dat[i];
+  }
+  std::vector<float> f(n);
+  singa::HalfToFloat(h.data(), f.data(), n);
+  for (size_t i = 0; i < n; i++)
+    EXPECT_EQ(singa::HalfBitsToFloat(bits[i]), f[i]);
+  EXPECT_TRUE(std::isnan(static_cast<float>(singa::half(NAN))));
+}
+
 TEST_F(TensorMath, LogCpp) {
   Tensor p = Log(a);
   const float *dptr1 = p.data<float>();
@@ -158,6 +271,55 @@ TEST_F(TensorMath, SumCpp) {
   EXPECT_FLOAT_EQ(11.0f, dptr2[2]);
 }
 
+TEST_F(TensorMath, ReduceCpp) {
+  // many blocks over several threads, with a tail for the SIMD loop
+  auto dev = std::make_shared<singa::CppCPU>(4);
+  const size_t nrow = 301, ncol = 1003;
+  std::vector<float> x(nrow * ncol);
+  for (size_t i = 0; i < x.size(); i++) x[i] = ((i * 7919) % 1000) * 1e-3f - 0.3f;
+  Tensor t(Shape{nrow, ncol}, dev);
+  t.CopyDataFromHostPtr(x.data(), x.size());
+  double sum = 0, asum = 0, sqr = 0;
+  std::vector<double> rsum(nrow, 0), csum(ncol, 0);
+  for (size_t r = 0; r < nrow; r++)
+    for (size_t c = 0; c < ncol; c++) {
+      double v = x[r * ncol + c];
+      sum += v, asum += std::fabs(v), sqr += v * v;
+      rsum[r] += v, csum[c] += v;
+    }
+  EXPECT_NEAR(sum, singa::Sum<float>(t), 1e-6 * asum);
+  EXPECT_NEAR(asum / x.size(), t.L1(), 1e-6);
+  EXPECT_NEAR(std::sqrt(sqr) / x.size(), t.L2(), 1e-9);
+
+  // the order of a transposed view does not matter
+  Tensor tt = Transpose(t);
+  EXPECT_NEAR(sum, singa::Sum<float>(tt), 1e-6 * asum);
+
+  Tensor cols = Sum(t, 1), rows = Sum(tt, 1), avg = Average(t, 0);
+  ASSERT_EQ(nrow, cols.Size());
+  ASSERT_EQ(ncol, rows.Size());
+  const float* cptr = cols.data<float>();
+  const float* rptr = rows.data<float>();
+  const float* aptr = avg.data<float>();
+  for (size_t r = 0; r < nrow; r++) EXPECT_NEAR(rsum[r], cptr[r], 1e-3);
+  for (size_t c = 0; c < ncol; c++) {
+    EXPECT_NEAR(csum[c], rptr[c], 1e-3);
+    EXPECT_NEAR(csum[c] / nrow, aptr[c], 1e-5);
+  }
+}
+
+TEST_F(TensorMath, ReduceBroadcastCpp) {
+  // a broadcast view visits the row 3 times
+  Tensor row(Shape{1, 6});
+  row.CopyDataFromHostPtr(dat1, 6);
+  Tensor m = Broadcast(row, Shape{3, 6});
+  EXPECT_FLOAT_EQ(63.0f, singa::Sum<float>(m));
+  Tensor h(Shape{2, 3}, singa::kFloat16);
+  h.SetValue(0.5f);
+  EXPECT_FLOAT_EQ(3.0f, singa::Sum<float>(h));
+  EXPECT_FLOAT_EQ(0.5f, h.L1());
+}
+
 TEST_F(TensorMath, SoftMaxCpp) {
   Tensor p1 = SoftMax(Reshape(e, Shape{1, 6}));
   const float *dptr1 = p1.data<float>();
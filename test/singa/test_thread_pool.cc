@@ -0,0 +1,84 @@
+/************************************************************
+*
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*   http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an
+* "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+* KIND, either express or implied.  See the License for the
+* specific language governing permissions and limitations
+* under the License.
+*
+*************************************************************/
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "gtest/gtest.h"
+#include "singa/core/tensor.h"
+#include "singa/utils/thread_pool.h"
+
+using singa::ThreadPool;
+
+TEST(ThreadPool, Submit) {
+  std::atomic<int> count(0);
+  {
+    ThreadPool pool(3);
+    for (int i = 0; i < 100; i++) pool.Submit([&count]() { count++; });
+  }
+  // the destructor runs the remaining tasks
+  EXPECT_EQ(100, count);
+}
+
+TEST(ThreadPool, ParallelFor) {
+  ThreadPool pool(3);
+  std::vector<int> v(10001, 0);
+  pool.ParallelFor(1, v.size(), 100, [&v](size_t b, size_t e) {
+    for (size_t i = b; i < e; i++) v[i]++;
+  });
+  EXPECT_EQ(0, v[0]);
+  for (size_t i = 1; i < v.size(); i++) EXPECT_EQ(1, v[i]);
+}
+
+TEST(ThreadPool, NestedParallelFor) {
+  ThreadPool pool(2);
+  std::atomic<size_t> sum(0);
+  pool.ParallelFor(0, 8, 1, [&pool, &sum](size_t b, size_t e) {
+    for (size_t i = b; i < e; i++)
+      pool.ParallelFor(0, 1000, 10, [&sum](size_t b2, size_t e2) {
+        sum += e2 - b2;
+      });
+  });
+  EXPECT_EQ(8000u, sum);
+}
+
+TEST(ThreadPool, NoWorker) {
+  ThreadPool pool(0);
+  int count = 0;
+  pool.Submit([&count]() { count++; });
+  pool.ParallelFor(0, 100, 1, [&count](size_t b, size_t e) {
+    count += e - b;
+  });
+  EXPECT_EQ(101, count);
+}
+
+TEST(ThreadPool, ChunkedTensorMath) {
+  auto dev = std::make_shared<singa::CppCPU>(4);
+  const size_t n = 300000;
+  singa::Tensor x(singa::Shape{n}, dev), y(singa::Shape{n}, dev);
+  std::vector<float> dat(n);
+  for (size_t i = 0; i < n; i++) dat[i] = static_cast<float>(i % 97);
+  x.CopyDataFromHostPtr(dat.data(), n);
+  y.SetValue(1.0f);
+  singa::Tensor z = x * y + x;
+  const float* zptr = z.data<float>();
+  for (size_t i = 0; i < n; i++) ASSERT_FLOAT_EQ(2 * dat[i], zptr[i]);
+}